@@ -4,6 +4,25 @@
    pathToSave = UI.savepanel("Save Model To ", "~/", "model")
    model = Sketchup.active_model
    pathToSave = pathToSave.chomp(File.extname(pathToSave))
+   # Section planes for the XML exporter, which cannot read them itself
+   planes = model.entities.grep(Sketchup::SectionPlane).map { |sp| sp.get_plane }
+   model.set_attribute("SkpToXML", "SectionPlanes", planes.flatten)
+   # Layers hidden by each scene that saves the layer visibility
+   model.pages.each { |page|
+     if page.use_hidden_layers?
+       page.set_attribute("SkpToXML", "HiddenLayers", page.layers.map { |layer| layer.name })
+     else
+       page.delete_attribute("SkpToXML", "HiddenLayers")
+     end
+   }
+   # Where the importer keeps the outline meshes, so the exporter can write
+   # them ready made when the model is saved into a Unity project
+   assets = pathToSave.index("/Assets/")
+   if assets
+     model.set_attribute("SkpToXML", "LinesMeshDirectory", pathToSave[0, assets] + "/Assets/Within/Resources/Models/LinesMeshes/")
+   else
+     model.delete_attribute("SkpToXML", "LinesMeshDirectory")
+   end
    #UI.messagebox(pathToSave)
    model.export(pathToSave + ".fbx",false);
    model.export(pathToSave + ".xml",false);
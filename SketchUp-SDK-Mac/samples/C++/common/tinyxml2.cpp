@@ -1533,6 +1533,28 @@ void XMLDocument::Clear()
 }
 
 
+size_t XMLDocument::PoolBytes() const
+{
+    return _elementPool.Bytes() + _attributePool.Bytes() +
+           _textPool.Bytes() + _commentPool.Bytes();
+}
+
+
+void XMLDocument::TrimPools( size_t maxBytes )
+{
+    size_t bytes = PoolBytes();
+    if ( bytes <= maxBytes ) {
+        return;
+    }
+    // Each pool keeps its share of maxBytes
+    double share = double( maxBytes ) / bytes;
+    _elementPool.Trim( size_t( _elementPool.Bytes() * share ) );
+    _attributePool.Trim( size_t( _attributePool.Bytes() * share ) );
+    _textPool.Trim( size_t( _textPool.Bytes() * share ) );
+    _commentPool.Trim( size_t( _commentPool.Bytes() * share ) );
+}
+
+
 XMLElement* XMLDocument::NewElement( const char* name )
 {
     XMLElement* ele = new (_elementPool.Alloc()) XMLElement( this );
@@ -1725,11 +1747,11 @@ void XMLDocument::PrintError() const
 }
 
 
-XMLPrinter::XMLPrinter( FILE* file, bool compact ) :
+XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
     _elementJustOpened( false ),
     _firstElement( true ),
     _fp( file ),
-    _depth( 0 ),
+    _depth( depth ),
     _textDepth( -1 ),
     _processEntities( true ),
     _compactMode( compact )
@@ -1775,12 +1797,20 @@ void XMLPrinter::Print( const char* format, ... )
         char* p = _buffer.PushArr( len ) - 1;
         memcpy( p, _accumulator.Mem(), len+1 );
 #else
-        int len = vsnprintf( 0, 0, format, va );
-        // Close out and re-start the va-args
-        va_end( va );
-        va_start( va, format );
-        char* p = _buffer.PushArr( len ) - 1;
-        vsnprintf( p, len+1, format, va );
+        // Try the free space first, most pieces are small. The terminating
+        // null is overwritten by the new text.
+        int avail = _buffer.Capacity() - _buffer.Size() + 1;
+        int len = vsnprintf( _buffer.Mem() + _buffer.Size() - 1, avail, format, va );
+        if ( len < avail ) {
+            _buffer.PushArr( len );
+        }
+        else {
+            // Close out and re-start the va-args
+            va_end( va );
+            va_start( va, format );
+            char* p = _buffer.PushArr( len ) - 1;
+            vsnprintf( p, len+1, format, va );
+        }
 #endif
     }
     va_end( va );
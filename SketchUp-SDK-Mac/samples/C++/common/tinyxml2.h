@@ -309,6 +309,9 @@ public:
     int CurrentAllocs() const		{
         return _currentAllocs;
     }
+    size_t Bytes() const			{
+        return size_t( _blockPtrs.Size() ) * sizeof( Block );
+    }
 
     virtual void* Alloc() {
         if ( !_root ) {
@@ -345,6 +348,26 @@ public:
         chunk->next = _root;
         _root = chunk;
     }
+    // Deletes the blocks beyond maxBytes. Does nothing while items are
+    // allocated from the pool.
+    void Trim( size_t maxBytes ) {
+        if ( _currentAllocs != 0 ) {
+            return;
+        }
+        while( Bytes() > maxBytes ) {
+            delete _blockPtrs.Pop();
+        }
+        // Rebuild the free list over the remaining blocks, in order
+        _root = 0;
+        for( int i=_blockPtrs.Size()-1; i>=0; --i ) {
+            Block* block = _blockPtrs[i];
+            for( int j=COUNT-1; j>=0; --j ) {
+                block->chunk[j].next = _root;
+                _root = &block->chunk[j];
+            }
+        }
+    }
+
     void Trace( const char* name ) {
         printf( "Mempool %s watermark=%d [%dk] current=%d size=%d nAlloc=%d blocks=%d\n",
                 name, _maxAllocs, _maxAllocs*SIZE/1024, _currentAllocs, SIZE, _nAllocs, _blockPtrs.Size() );
@@ -1582,6 +1605,17 @@ public:
     /// Clear the document, resetting it to the initial state.
     void Clear();
 
+    /** Bytes held by the node and attribute pools, in use or not. Clear()
+    	keeps the pool memory, so a document that is reused holds the
+    	high-water mark of what it has stored.
+    */
+    size_t PoolBytes() const;
+    /** Releases pool memory until the pools hold at most maxBytes
+    	together, in proportion to their size. Does nothing while they hold
+    	less. The document must be empty, e.g. right after Clear().
+    */
+    void TrimPools( size_t maxBytes );
+
     // internal
     char* Identify( char* p, XMLNode** node );
 
@@ -1864,9 +1898,11 @@ public:
     	this will print to the FILE. Else it will print
     	to memory, and the result is available in CStr().
     	If 'compact' is set to true, then output is created
-    	with only required whitespace and newlines.
+    	with only required whitespace and newlines. 'depth' is the
+    	indentation level of the first element, for printing a
+    	subtree as it appears inside a document.
     */
-    XMLPrinter( FILE* file=0, bool compact = false );
+    XMLPrinter( FILE* file=0, bool compact = false, int depth = 0 );
     ~XMLPrinter()	{}
 
     /** If streaming, write the BOM and declaration. */
@@ -0,0 +1,288 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <algorithm>
+
+#include "./xmlcellvisibility.h"
+#include "./xmlthreadutils.h"
+
+using namespace XmlGeomUtils;
+
+static const double kPi = 3.14159265358979323846;
+// Faces tilted less than about 45 degrees count as floors
+static const double kFloorNormalZ = 0.7;
+// Less space above a floor than this is a slab or furniture, not a room
+static const double kMinHeadroom = 24.0;
+static const size_t kMaxFloorsPerColumn = 64;
+// Keeps the rays off the faces they start from (inches, relative)
+static const double kAbsoluteBias = 1.0e-2;
+static const double kRelativeBias = 1.0e-5;
+static const size_t kColumnsPerChunk = 16;
+static const size_t kCellsPerChunk = 1;
+
+namespace {
+
+// Small deterministic generator, seeded per cell so the result does not
+// depend on how the cells are spread over the threads.
+class CRandom {
+ public:
+  explicit CRandom(size_t seed)
+    : state_(static_cast<unsigned>(seed) * 2654435761u + 12345u) {}
+
+  // Uniform in [0, 1)
+  double Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return (state_ >> 8) * (1.0 / 16777216.0);
+  }
+
+  size_t NextIndex(size_t count) {
+    return std::min(count - 1, static_cast<size_t>(Next() * count));
+  }
+
+ private:
+  unsigned state_;
+};
+
+// Finds the floors under each grid column
+class CFloorTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CFloorTask(const CXmlWorldGeometry& geometry, const CXmlPolygonBvh& bvh,
+             size_t num_columns_x, double cell_size, double cell_height,
+             double bias,
+             std::vector<std::vector<XmlVisibilityCellInfo> >& columns)
+    : geometry_(geometry), bvh_(bvh), num_columns_x_(num_columns_x),
+      cell_size_(cell_size), cell_height_(cell_height), bias_(bias),
+      columns_(columns) {}
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      FindFloors(i % num_columns_x_, i / num_columns_x_, columns_[i]);
+    }
+  }
+
+ private:
+  void FindFloors(size_t ix, size_t iy,
+                  std::vector<XmlVisibilityCellInfo>& cells) const {
+    const CPoint3d& min = geometry_.min();
+    const CPoint3d& max = geometry_.max();
+    double x0 = min.x() + ix * cell_size_;
+    double y0 = min.y() + iy * cell_size_;
+    CPoint3d origin(x0 + 0.5 * cell_size_, y0 + 0.5 * cell_size_,
+                    max.z() + 1.0);
+    CVector3d down(0.0, 0.0, -1.0);
+    double max_t = max.z() - min.z() + 2.0;
+
+    // Walk down the column. Every hit is the ceiling of the next one.
+    double ceiling_z = origin.z() + cell_height_;
+    double t = 0.0;
+    size_t polygon = 0;
+    for (size_t floor = 0; floor < kMaxFloorsPerColumn &&
+         bvh_.Intersect(origin, down, t, max_t, t, polygon); ++floor) {
+      double z = origin.z() - t;
+      if (fabs(geometry_.polygons()[polygon].normal_.z()) >= kFloorNormalZ &&
+          ceiling_z - z >= kMinHeadroom) {
+        XmlVisibilityCellInfo cell;
+        cell.min_.SetLocation(x0, y0, z);
+        cell.max_.SetLocation(x0 + cell_size_, y0 + cell_size_,
+                              z + std::min(ceiling_z - z, cell_height_));
+        cells.push_back(cell);
+      }
+      ceiling_z = z;
+      t += bias_;
+    }
+  }
+
+  const CXmlWorldGeometry& geometry_;
+  const CXmlPolygonBvh& bvh_;
+  size_t num_columns_x_;
+  double cell_size_;
+  double cell_height_;
+  double bias_;
+  std::vector<std::vector<XmlVisibilityCellInfo> >& columns_;
+};
+
+// Samples what can be seen from each cell
+class CCellTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CCellTask(const CXmlWorldGeometry& geometry, const CXmlPolygonBvh& bvh,
+            const std::vector<std::vector<size_t> >& group_polygons,
+            const std::vector<std::vector<size_t> >& group_segments,
+            size_t rays_per_cell, size_t rays_per_group, double bias,
+            std::vector<XmlVisibilityCellInfo>& cells)
+    : geometry_(geometry), bvh_(bvh), group_polygons_(group_polygons),
+      group_segments_(group_segments), rays_per_cell_(rays_per_cell),
+      rays_per_group_(rays_per_group), bias_(bias), cells_(cells) {
+    far_ = 2.0 * (geometry.max() - geometry.min()).Length() + 1.0;
+  }
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      SampleCell(i, cells_[i]);
+    }
+  }
+
+ private:
+  size_t GroupIndex(int group) const {
+    return group < 0 ? static_cast<size_t>(geometry_.num_groups()) :
+                       static_cast<size_t>(group);
+  }
+
+  CPoint3d RandomPointInCell(const XmlVisibilityCellInfo& cell,
+                             CRandom& random) const {
+    // Lifted off the floor the cell stands on
+    double height = std::max(cell.max_.z() - cell.min_.z() - 2.0 * bias_, 0.0);
+    return CPoint3d(
+        cell.min_.x() + random.Next() * (cell.max_.x() - cell.min_.x()),
+        cell.min_.y() + random.Next() * (cell.max_.y() - cell.min_.y()),
+        cell.min_.z() + bias_ + random.Next() * height);
+  }
+
+  // Somewhere between the center and a corner of the outer loop, which is
+  // on the face unless it is strongly concave.
+  CPoint3d RandomPointOnPolygon(size_t polygon, CRandom& random) const {
+    const XmlWorldLoop& loop =
+        geometry_.loops()[geometry_.polygons()[polygon].first_loop_];
+    const CPoint3d* points = &geometry_.points()[loop.first_point_];
+    CVector3d sum;
+    for (size_t i = 0; i < loop.num_points_; ++i) {
+      sum += points[i] - CPoint3d();
+    }
+    CPoint3d center = CPoint3d() + sum / static_cast<double>(loop.num_points_);
+    const CPoint3d& corner = points[random.NextIndex(loop.num_points_)];
+    return center + (corner - center) * random.Next();
+  }
+
+  void SampleCell(size_t index, XmlVisibilityCellInfo& cell) const {
+    size_t num_groups = group_polygons_.size();
+    std::vector<char> visible(num_groups, 0);
+    CRandom random(index);
+
+    // Random directions find the large surroundings
+    for (size_t i = 0; i < rays_per_cell_; ++i) {
+      CPoint3d origin = RandomPointInCell(cell, random);
+      double z = 2.0 * random.Next() - 1.0;
+      double phi = 2.0 * kPi * random.Next();
+      double r = sqrt(std::max(1.0 - z * z, 0.0));
+      CVector3d direction(r * cos(phi), r * sin(phi), z);
+      double t = 0.0;
+      size_t polygon = 0;
+      if (bvh_.Intersect(origin, direction, 0.0, far_, t, polygon))
+        visible[GroupIndex(geometry_.polygons()[polygon].group_)] = 1;
+    }
+
+    // Aimed rays find the small groups the random ones passed by
+    for (size_t group = 0; group < num_groups; ++group) {
+      const std::vector<size_t>& polygons = group_polygons_[group];
+      const std::vector<size_t>& segments = group_segments_[group];
+      for (size_t i = 0; i < rays_per_group_ && !visible[group]; ++i) {
+        CPoint3d origin = RandomPointInCell(cell, random);
+        if (!polygons.empty()) {
+          CPoint3d target = RandomPointOnPolygon(
+              polygons[random.NextIndex(polygons.size())], random);
+          CVector3d direction = target - origin;
+          double length = direction.Length();
+          double t = 0.0;
+          size_t polygon = 0;
+          if (length > 0.0 &&
+              bvh_.Intersect(origin, direction, 0.0,
+                             1.0 + (bias_ + kRelativeBias * length) / length,
+                             t, polygon)) {
+            visible[GroupIndex(geometry_.polygons()[polygon].group_)] = 1;
+          }
+        } else if (!segments.empty()) {
+          // Outline only groups do not occlude, test for a clear line of sight
+          const XmlWorldSegment& segment =
+              geometry_.segments()[segments[random.NextIndex(segments.size())]];
+          CPoint3d target = segment.start_ +
+                            (segment.end_ - segment.start_) * random.Next();
+          CVector3d direction = target - origin;
+          double length = direction.Length();
+          if (length <= bias_ ||
+              !bvh_.IsOccluded(origin, direction, 0.0,
+                  1.0 - (bias_ + kRelativeBias * length) / length)) {
+            visible[group] = 1;
+          }
+        }
+      }
+    }
+
+    cell.visible_groups_.assign(num_groups, false);
+    for (size_t group = 0; group < num_groups; ++group) {
+      cell.visible_groups_[group] = visible[group] != 0;
+    }
+  }
+
+  const CXmlWorldGeometry& geometry_;
+  const CXmlPolygonBvh& bvh_;
+  const std::vector<std::vector<size_t> >& group_polygons_;
+  const std::vector<std::vector<size_t> >& group_segments_;
+  size_t rays_per_cell_;
+  size_t rays_per_group_;
+  double bias_;
+  double far_;
+  std::vector<XmlVisibilityCellInfo>& cells_;
+};
+
+} // end anonymous namespace
+
+CXmlCellVisibilityPass::CXmlCellVisibilityPass(
+    const CXmlWorldGeometry& geometry, const CXmlPolygonBvh& bvh)
+  : geometry_(geometry),
+    bvh_(bvh),
+    cell_size_(48.0),
+    max_columns_(4096),
+    cell_height_(96.0),
+    rays_per_cell_(256),
+    rays_per_group_(8) {
+}
+
+size_t CXmlCellVisibilityPass::Compute(
+    std::vector<XmlVisibilityCellInfo>& cells) const {
+  cells.clear();
+  const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+  if (polygons.empty())
+    return 0;
+
+  // Size the grid
+  CVector3d extent = geometry_.max() - geometry_.min();
+  double cell_size = std::max(cell_size_, 1.0);
+  size_t num_x = 0, num_y = 0;
+  for (;;) {
+    num_x = static_cast<size_t>(ceil(extent.x() / cell_size));
+    num_y = static_cast<size_t>(ceil(extent.y() / cell_size));
+    num_x = std::max(num_x, static_cast<size_t>(1));
+    num_y = std::max(num_y, static_cast<size_t>(1));
+    if (num_x * num_y <= std::max(max_columns_, static_cast<size_t>(1)))
+      break;
+    cell_size *= 1.25;
+  }
+  double bias = kAbsoluteBias + kRelativeBias * extent.Length();
+
+  // Cells, in column order
+  std::vector<std::vector<XmlVisibilityCellInfo> > columns(num_x * num_y);
+  CFloorTask floor_task(geometry_, bvh_, num_x, cell_size,
+                        std::max(cell_height_, kMinHeadroom), bias, columns);
+  XmlThreadUtils::RunParallel(floor_task, columns.size(), kColumnsPerChunk);
+  for (size_t i = 0; i < columns.size(); ++i) {
+    cells.insert(cells.end(), columns[i].begin(), columns[i].end());
+  }
+
+  // What makes up each group, the loose geometry last
+  size_t num_groups = static_cast<size_t>(geometry_.num_groups()) + 1;
+  std::vector<std::vector<size_t> > group_polygons(num_groups);
+  std::vector<std::vector<size_t> > group_segments(num_groups);
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    int group = polygons[i].group_;
+    group_polygons[group < 0 ? num_groups - 1 : group].push_back(i);
+  }
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  for (size_t i = 0; i < segments.size(); ++i) {
+    int group = segments[i].group_;
+    group_segments[group < 0 ? num_groups - 1 : group].push_back(i);
+  }
+
+  CCellTask cell_task(geometry_, bvh_, group_polygons, group_segments,
+                      rays_per_cell_, rays_per_group_, bias, cells);
+  XmlThreadUtils::RunParallel(cell_task, cells.size(), kCellsPerChunk);
+  return cells.size();
+}
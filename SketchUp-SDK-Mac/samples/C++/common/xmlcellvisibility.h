@@ -0,0 +1,50 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLCELLVISIBILITY_H
+#define SKPTOXML_COMMON_XMLCELLVISIBILITY_H
+
+#include <vector>
+
+#include "./xmlfile.h"
+#include "./xmlpolygonbvh.h"
+#include "./xmlworldgeometry.h"
+
+// CXmlCellVisibilityPass - Precomputes a potentially visible set for walk
+// throughs. The model is split into columns on a horizontal grid and every
+// floor found under a column, with enough headroom above it, becomes a cell.
+// Rays are then cast from random points inside each cell, in random
+// directions and towards the groups not seen yet, and every group hit first
+// is marked visible from that cell. Sampling can miss small gaps, so the
+// result is an approximation tuned by the ray counts. Cells are processed in
+// parallel and the result does not depend on the number of threads.
+class CXmlCellVisibilityPass {
+ public:
+  CXmlCellVisibilityPass(const CXmlWorldGeometry& geometry,
+                         const CXmlPolygonBvh& bvh);
+
+  // Fills cells with the navigable cells, in grid order, and what is visible
+  // from each of them. Returns the number of cells.
+  size_t Compute(std::vector<XmlVisibilityCellInfo>& cells) const;
+
+  // Horizontal size of a cell in inches. Grown if the grid would have more
+  // than max_columns columns.
+  void set_cell_size(double inches) { cell_size_ = inches; }
+  void set_max_columns(size_t count) { max_columns_ = count; }
+  // Height of the space above a floor covered by its cell
+  void set_cell_height(double inches) { cell_height_ = inches; }
+  // Rays in random directions from each cell
+  void set_rays_per_cell(size_t count) { rays_per_cell_ = count; }
+  // Rays aimed at each group not seen by the random rays
+  void set_rays_per_group(size_t count) { rays_per_group_ = count; }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  const CXmlPolygonBvh& bvh_;
+  double cell_size_;
+  size_t max_columns_;
+  double cell_height_;
+  size_t rays_per_cell_;
+  size_t rays_per_group_;
+};
+
+#endif // SKPTOXML_COMMON_XMLCELLVISIBILITY_H
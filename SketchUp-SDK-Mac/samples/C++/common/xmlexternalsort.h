@@ -0,0 +1,206 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLEXTERNALSORT_H
+#define SKPTOXML_COMMON_XMLEXTERNALSORT_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// CXmlExternalSorter - Sorts more records than may fit in memory. Records
+// are gathered in a buffer of max_bytes, and each time it is full it is
+// sorted and spilled to a temporary file as a run. Finish sorts what is
+// left, and Next then hands out all the records in order, merging the runs
+// with a heap through read buffers that share max_bytes. Once there are
+// kMaxRuns runs they are merged into one, so the number of open files stays
+// bounded; that merge needs about twice max_bytes. Without a cap, or while
+// the records fit, it is a plain std::sort in memory. Records are written
+// as bytes, T must be plain data. If a run cannot be written the records
+// stay in memory, so the sort completes either way.
+template <typename T, typename Less = std::less<T> >
+class CXmlExternalSorter {
+ public:
+  // A max_bytes of 0 keeps everything in memory
+  explicit CXmlExternalSorter(size_t max_bytes, const Less& less = Less())
+    : less_(less),
+      max_records_(max_bytes / sizeof(T)),
+      read_records_(0),
+      num_spilled_runs_(0) {
+    if (max_bytes > 0 && max_records_ < kMinRunRecords)
+      max_records_ = kMinRunRecords;
+  }
+
+  ~CXmlExternalSorter() { CloseRuns(); }
+
+  void Add(const T& record) {
+    buffer_.push_back(record);
+    if (max_records_ > 0 && buffer_.size() >= max_records_)
+      SpillRun();
+  }
+
+  // Ends adding, Next may be called from now on
+  void Finish() {
+    std::sort(buffer_.begin(), buffer_.end(), less_);
+    CRun run;
+    runs_.push_back(run);
+    runs_.back().records_.swap(buffer_);
+    StartMerge();
+  }
+
+  // Returns false once all records have been handed out
+  bool Next(T& record) {
+    if (heap_.empty())
+      return false;
+    std::pop_heap(heap_.begin(), heap_.end(), CRunGreater(*this));
+    CRun& run = runs_[heap_.back()];
+    record = run.records_[run.next_++];
+    if (run.next_ < run.records_.size() || Refill(run))
+      std::push_heap(heap_.begin(), heap_.end(), CRunGreater(*this));
+    else
+      heap_.pop_back();
+    return true;
+  }
+
+  // Runs written to temporary files, merges included
+  size_t num_spilled_runs() const { return num_spilled_runs_; }
+
+ private:
+  // Runs merged at once, and the smallest run worth a file
+  enum { kMaxRuns = 64, kMinRunRecords = 1024 };
+
+  // A sorted run, read through records_. The records still in memory are a
+  // run without a file.
+  struct CRun {
+    CRun() : file_(NULL), next_(0) {}
+
+    FILE* file_;
+    std::vector<T> records_;
+    size_t next_;
+  };
+
+  // Orders the heap by the runs' current records, smallest on top. Equal
+  // records come from the earlier run first.
+  struct CRunGreater {
+    explicit CRunGreater(const CXmlExternalSorter& sorter)
+      : sorter_(sorter) {}
+
+    bool operator()(size_t a, size_t b) const {
+      const CRun& run_a = sorter_.runs_[a];
+      const CRun& run_b = sorter_.runs_[b];
+      const T& record_a = run_a.records_[run_a.next_];
+      const T& record_b = run_b.records_[run_b.next_];
+      if (sorter_.less_(record_b, record_a))
+        return true;
+      if (sorter_.less_(record_a, record_b))
+        return false;
+      return a > b;
+    }
+
+    const CXmlExternalSorter& sorter_;
+  };
+  friend struct CRunGreater;
+
+  void SpillRun() {
+    std::sort(buffer_.begin(), buffer_.end(), less_);
+    FILE* file = tmpfile();
+    if (file == NULL ||
+        fwrite(&buffer_[0], sizeof(T), buffer_.size(), file) !=
+        buffer_.size()) {
+      if (file != NULL)
+        fclose(file);
+      max_records_ = 0;
+      return;
+    }
+    CRun run;
+    run.file_ = file;
+    runs_.push_back(run);
+    buffer_.clear();
+    ++num_spilled_runs_;
+    if (runs_.size() >= kMaxRuns)
+      MergeRuns();
+  }
+
+  // Merges the spilled runs into one. Keeps them if it cannot be written.
+  void MergeRuns() {
+    FILE* file = tmpfile();
+    if (file == NULL)
+      return;
+    StartMerge();
+    std::vector<T> out;
+    out.reserve(read_records_);
+    bool ok = true;
+    T record;
+    while (ok && Next(record)) {
+      out.push_back(record);
+      if (out.size() == read_records_ || heap_.empty()) {
+        ok = fwrite(&out[0], sizeof(T), out.size(), file) == out.size();
+        out.clear();
+      }
+    }
+    if (!ok) {
+      fclose(file);
+      return;
+    }
+    CloseRuns();
+    CRun run;
+    run.file_ = file;
+    runs_.push_back(run);
+    ++num_spilled_runs_;
+  }
+
+  // Reads each run from its start and puts it on the heap
+  void StartMerge() {
+    read_records_ = kMinRunRecords;
+    if (max_records_ / runs_.size() > read_records_)
+      read_records_ = max_records_ / runs_.size();
+    heap_.clear();
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      CRun& run = runs_[i];
+      if (run.file_ != NULL) {
+        rewind(run.file_);
+        run.records_.clear();
+      }
+      run.next_ = 0;
+      if (run.next_ < run.records_.size() || Refill(run))
+        heap_.push_back(i);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), CRunGreater(*this));
+  }
+
+  // Reads the next records of a run, false at its end
+  bool Refill(CRun& run) {
+    if (run.file_ == NULL)
+      return false;
+    run.records_.resize(read_records_);
+    size_t count = fread(&run.records_[0], sizeof(T), read_records_,
+                         run.file_);
+    run.records_.resize(count);
+    run.next_ = 0;
+    return count > 0;
+  }
+
+  void CloseRuns() {
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      if (runs_[i].file_ != NULL)
+        fclose(runs_[i].file_);
+    }
+    runs_.clear();
+    heap_.clear();
+  }
+
+ private:
+  Less less_;
+  size_t max_records_;
+  size_t read_records_;
+  size_t num_spilled_runs_;
+  std::vector<T> buffer_;
+  std::vector<CRun> runs_;
+  // Indices in runs_ of the runs with records left
+  std::vector<size_t> heap_;
+
+  CXmlExternalSorter(const CXmlExternalSorter&);
+  void operator=(const CXmlExternalSorter&);
+};
+
+#endif // SKPTOXML_COMMON_XMLEXTERNALSORT_H
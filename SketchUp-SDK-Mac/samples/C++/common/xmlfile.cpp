@@ -1,10 +1,12 @@
 // Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
 
+#include <algorithm>
 #include <vector>
 #include <sstream>
 
 #include "./xmlfile.h"
 #include "./tinyxml2.h"
+#include "./xmlparallelprinter.h"
 
 // XML tags
 static const std::string kSkpToXMLTag("SkpToXML");
@@ -31,6 +33,7 @@ static const std::string kTextureTag("Texture");
 static const std::string kColorTag("Color");
 static const std::string kColorFormat("#%02x%02x%02x");
 static const std::string kCountTag("Count");
+static const std::string kIndexTag("Index");
 static const std::string kFaceTag("Face");
 static const std::string kEdgeTag("Edge");
 static const std::string kFrontMaterialTag("FrontMaterial");
@@ -49,35 +52,69 @@ static const std::string kUTag("u");
 static const std::string kVTag("v");
 static const std::string kStartTag("Start");
 static const std::string kEndTag("End");
+static const std::string kInnerTag("Inner");
+static const std::string kScenesTag("Scenes");
+static const std::string kSceneTag("Scene");
+static const std::string kCameraTag("Camera");
+static const std::string kEyeTag("Eye");
+static const std::string kTargetTag("Target");
+static const std::string kUpTag("Up");
+static const std::string kPerspectiveTag("Perspective");
+static const std::string kFOVTag("FOV");
+static const std::string kAspectRatioTag("AspectRatio");
+static const std::string kHeightTag("Height");
+static const std::string kVisibleLinesTag("VisibleLines");
+static const std::string kVisibleLayersTag("VisibleLayers");
+static const std::string kBitsTag("Bits");
+static const std::string kVisibilityCellsTag("VisibilityCells");
+static const std::string kCellTag("Cell");
+static const std::string kMinTag("Min");
+static const std::string kMaxTag("Max");
+static const std::string kSectionsTag("Sections");
+static const std::string kSectionTag("Section");
+static const std::string kNormalTag("Normal");
+static const std::string kOffsetTag("Offset");
+static const std::string kDuplicateOutlinesTag("DuplicateOutlines");
+static const std::string kHiddenOutlinesTag("HiddenOutlines");
+static const std::string kOutlineTag("Outline");
+static const std::string kCollisionOnlyTag("CollisionOnly");
+static const std::string kSoftTag("Soft");
+static const std::string kStoreTag("Store");
+
+// Pool memory a closed file keeps for the next one, all node types together
+static const size_t kDefaultRetainedPoolBytes = 64 * 1024 * 1024;
 
 using namespace XmlGeomUtils;
 
 //------------------------------------------------------------------------------
 
-XmlGroupInfo::XmlGroupInfo() {
-  entities_ = new XmlEntitiesInfo;
-}
-
-XmlGroupInfo::XmlGroupInfo(const XmlGroupInfo& info) {
-  entities_ = new XmlEntitiesInfo(*info.entities_);
-  transform_ = info.transform_;
-}
-
-XmlGroupInfo::~XmlGroupInfo() {
-  delete entities_;
-}
-
-const XmlGroupInfo& XmlGroupInfo::operator = (const XmlGroupInfo& info) {
-  *entities_ = *info.entities_;
-  transform_ = info.transform_;
-  return *this;
+void XmlModelInfo::Swap(XmlModelInfo& other) {
+  layers_.swap(other.layers_);
+  materials_.swap(other.materials_);
+  definitions_.swap(other.definitions_);
+  std::swap(entities_, other.entities_);
+  scenes_.swap(other.scenes_);
+  visibility_cells_.swap(other.visibility_cells_);
+  sections_.swap(other.sections_);
+  duplicate_outlines_.swap(other.duplicate_outlines_);
+  hidden_outlines_.swap(other.hidden_outlines_);
+  names_.Swap(other.names_);
+  component_instances_.swap(other.component_instances_);
+  groups_.swap(other.groups_);
+  faces_.swap(other.faces_);
+  vertices_.swap(other.vertices_);
+  edges_.swap(other.edges_);
+  curves_.swap(other.curves_);
 }
 
 //------------------------------------------------------------------------------
 
 CXmlFile::CXmlFile()
   : xml_doc_(NULL),
-    create_new_file_(false) {
+    parent_node_(NULL),
+    create_new_file_(false),
+    is_open_(false),
+    retained_pool_bytes_(kDefaultRetainedPoolBytes) {
 }
 
 CXmlFile::~CXmlFile() {
@@ -88,16 +125,20 @@ bool CXmlFile::Open(const std::string& filename, bool create_new_file) {
   if (filename.empty())
     return false;
 
-  if (xml_doc_) {
+  if (is_open_) {
     printf("Warning! opening already open file\n");
     return true;
   }
 
   filename_ = filename;
   create_new_file_ = create_new_file;
+  names_.Clear();
 
-  xml_doc_ = new tinyxml2::XMLDocument;
+  // The document is kept between files, along with its memory pools
+  if (xml_doc_ == NULL)
+    xml_doc_ = new tinyxml2::XMLDocument;
   parent_node_ = xml_doc_;
+  is_open_ = true;
 
   bool ok = true;
 
@@ -110,11 +151,18 @@ bool CXmlFile::Open(const std::string& filename, bool create_new_file) {
 }
 
 void CXmlFile::Close(bool cancelled) {
-  if (create_new_file_ && !cancelled)
-    xml_doc_->SaveFile(filename_.c_str());
-  delete xml_doc_;
-  xml_doc_ = NULL;
+  if (!is_open_)
+    return;
+  if (create_new_file_ && !cancelled) {
+    // Same output as SaveFile, printed on all cores
+    CXmlParallelPrinter printer(*xml_doc_);
+    if (!printer.Save(filename_))
+      xml_doc_->SaveFile(filename_.c_str());
+  }
+  xml_doc_->Clear();
+  xml_doc_->TrimPools(retained_pool_bytes_);
   parent_node_ = NULL;
+  is_open_ = false;
 }
 
 static size_t FindLastSlash(const std::string& filename) {
@@ -174,6 +222,19 @@ void CXmlFile::StartGroup() {
   WriteStartTag(kGroupTag.c_str());
 }
 
+void CXmlFile::StartGroup(const std::string& layer_name, int layer_index,
+                          bool outline, bool collision_only) {
+  tinyxml2::XMLElement* elem = WriteStartTag(kGroupTag.c_str());
+  if (!outline)
+    elem->SetAttribute(kOutlineTag.c_str(), false);
+  if (collision_only)
+    elem->SetAttribute(kCollisionOnlyTag.c_str(), true);
+
+  // Layer (optional)
+  if (!layer_name.empty())
+    WriteLayerReference(layer_name, layer_index);
+}
+
 void CXmlFile::StartMaterials() {
   WriteStartTag(kMaterialsTag.c_str());
 }
@@ -182,6 +243,18 @@ void CXmlFile::StartComponentDefinitions() {
   WriteStartTag(kCompDefsTag.c_str());
 }
 
+void CXmlFile::StartScenes() {
+  WriteStartTag(kScenesTag.c_str());
+}
+
+void CXmlFile::StartVisibilityCells() {
+  WriteStartTag(kVisibilityCellsTag.c_str());
+}
+
+void CXmlFile::StartSections() {
+  WriteStartTag(kSectionsTag.c_str());
+}
+
 void CXmlFile::StartComponentDefinition(const std::string& name) {
   tinyxml2::XMLElement* elem = WriteStartTag(kCompDefTag.c_str());
   elem->SetAttribute(kNameTag.c_str(), name.c_str());
@@ -190,13 +263,15 @@ void CXmlFile::StartComponentDefinition(const std::string& name) {
 bool CXmlFile::ReadComponentDefinitionInfo(
     const tinyxml2::XMLNode* parent_node,
     bool readEntities,
+    XmlModelInfo& model_info,
     XmlComponentDefinitionInfo& info) const {
   const char* name = parent_node->ToElement()->Attribute(kNameTag.c_str());
   if (name == NULL)
     return false;
-  info.name_ = name;
+  info.name_id_ = model_info.names_.Intern(name);
   
-  return !readEntities || ReadEntities(parent_node, info.entities_);
+  return !readEntities ||
+         ReadEntities(parent_node, model_info, info.entities_);
 }
 
 void CXmlFile::PopParentNode() {
@@ -224,7 +299,8 @@ bool CXmlFile::ReadLayerInfo(const tinyxml2::XMLNode* parent_node,
 
   // Material info (optional)
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  info.has_material_info_ = ReadMaterialInfo(child, info.material_info_);
+  info.has_material_info_ =
+      child != NULL && ReadMaterialInfo(child, info.material_info_);
 
   return ok;
 }
@@ -241,10 +317,18 @@ void CXmlFile::WriteLayerInfo(const XmlLayerInfo& info) {
 }
 
 bool CXmlFile::ReadColor(const tinyxml2::XMLNode* parent_node,
-                         const SUColor& color) const {
+                         SUColor& color) const {
   const char* attrib = parent_node->ToElement()->Attribute(kColorTag.c_str());
   if (attrib != NULL) {
-    sscanf(attrib, kColorFormat.c_str(), &color.red, &color.green, &color.blue);
+    // %x needs ints, the components are bytes
+    unsigned int red = 0;
+    unsigned int green = 0;
+    unsigned int blue = 0;
+    sscanf(attrib, kColorFormat.c_str(), &red, &green, &blue);
+    color.red = static_cast<SUByte>(red);
+    color.green = static_cast<SUByte>(green);
+    color.blue = static_cast<SUByte>(blue);
+    color.alpha = 255;
     return true;
   }
   return false;
@@ -256,6 +340,14 @@ void CXmlFile::WriteColor(const SUColor& color) {
   parent_node_->ToElement()->SetAttribute(kColorTag.c_str(), buf);
 }
 
+void CXmlFile::WriteLayerReference(const std::string& name, int index) {
+  tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
+  elem->SetAttribute(kNameTag.c_str(), name.c_str());
+  if (index >= 0)
+    elem->SetAttribute(kIndexTag.c_str(), index);
+  PopParentNode();
+}
+
 bool CXmlFile::ReadMaterialInfo(const tinyxml2::XMLNode* parent_node,
                                 XmlMaterialInfo& info) const {
   const tinyxml2::XMLElement* elem = parent_node->ToElement();
@@ -342,6 +434,7 @@ static bool ReadPoint(const tinyxml2::XMLNode* parent_node,
 }
 
 bool CXmlFile::ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
+                            CXmlStringTable& names,
                             XmlEdgeInfo& info) const {
   // Layer (optional)
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
@@ -352,7 +445,8 @@ bool CXmlFile::ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
     const char* layer_name = elem->Attribute(kNameTag.c_str());
     if (layer_name != NULL) {
       info.has_layer_ = true;
-      info.layer_name_ = layer_name;
+      info.layer_name_id_ = names.Intern(layer_name);
+      elem->QueryIntAttribute(kIndexTag.c_str(), &info.layer_index_);
     } else {
       info.has_layer_ = false;
     }
@@ -391,11 +485,8 @@ void CXmlFile::WriteEdgeInfo(const XmlEdgeInfo& info) {
   WriteStartTag(kEdgeTag.c_str());
 
   // Layer (optional)
-  if (info.has_layer_) {
-    tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.layer_name_.c_str());
-    PopParentNode();
-  }
+  if (info.has_layer_)
+    WriteLayerReference(names_.Get(info.layer_name_id_), info.layer_index_);
 
   // Color (optional)
   if (info.has_color_) {
@@ -424,16 +515,19 @@ void CXmlFile::WriteEdgeInfo(const XmlEdgeInfo& info) {
 }
 
 bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
-                            XmlFaceInfo& info) const {
+                            CXmlStringTable& names,
+                            XmlFaceInfo& info,
+                            std::vector<XmlFaceVertex>& vertices) const {
+  // Hole of the preceding face (optional)
+  parent_node->ToElement()->QueryBoolAttribute(kInnerTag.c_str(),
+                                               &info.is_inner_loop_);
+
   // Front material (optional)
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
   if (child->Value() == kFrontMaterialTag) {
     const tinyxml2::XMLElement* elem = child->ToElement();
     const char* mat_name = elem->Attribute(kNameTag.c_str());
-    if (mat_name != NULL)
-      info.front_mat_name_ = mat_name;
-    else
-      info.front_mat_name_.clear();
+    info.front_mat_name_id_ = (mat_name != NULL) ? names.Intern(mat_name) : 0;
     elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_front_texture_);
     child = child->NextSibling();
   }
@@ -442,10 +536,7 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
   if (child->Value() == kBackMaterialTag) {
     const tinyxml2::XMLElement* elem = child->ToElement();
     const char* mat_name = elem->Attribute(kNameTag.c_str());
-    if (mat_name != NULL)
-      info.back_mat_name_ = mat_name;
-    else
-      info.back_mat_name_.clear();
+    info.back_mat_name_id_ = (mat_name != NULL) ? names.Intern(mat_name) : 0;
     elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_back_texture_);
     child = child->NextSibling();
   }
@@ -455,7 +546,8 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
     const tinyxml2::XMLElement* elem = child->ToElement();
     const char* layer_name = elem->Attribute(kNameTag.c_str());
     if (layer_name != NULL) {
-      info.layer_name_ = layer_name;
+      info.layer_name_id_ = names.Intern(layer_name);
+      elem->QueryIntAttribute(kIndexTag.c_str(), &info.layer_index_);
     }
     child = child->NextSibling();
   }
@@ -472,6 +564,8 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
     ok = elem->QueryIntAttribute(kCountTag.c_str(), &triangle_count) == 
          tinyxml2::XML_NO_ERROR;
   }
+  info.first_vertex_ = vertices.size();
+  info.num_vertices_ = 0;
   if (ok) {
     const tinyxml2::XMLNode* vertex_node = child->FirstChild();
     while (ok && vertex_node != NULL && vertex_node->Value() == kVertexTag) {
@@ -480,6 +574,9 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
       if (pt_node != NULL) {
         const tinyxml2::XMLElement* elem = pt_node->ToElement();
         XmlFaceVertex vertex;
+        vertex_node->ToElement()->QueryBoolAttribute(kSoftTag.c_str(),
+                                                     &vertex.soft_edge_);
+        vertex.has_edge_color_ = ReadColor(vertex_node, vertex.edge_color_);
         if (ReadPoint(pt_node, vertex.vertex_)) {
           // Front texture coords
           const tinyxml2::XMLNode* node = pt_node;
@@ -519,7 +616,8 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
             }
           }
           
-          info.vertices_.push_back(vertex);
+          vertices.push_back(vertex);
+          info.num_vertices_++;
         } else {
           ok = false;
         }
@@ -532,41 +630,44 @@ bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
 
     // If a mesh is given, check the number of vertices
     if (!info.has_single_loop_) {
-      ok &= (info.vertices_.size() == triangle_count * 3);
+      ok &= (info.num_vertices_ == triangle_count * 3);
     }
   } // if (ok)
 
   return ok;
 }
 
-void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
-  WriteStartTag(kFaceTag.c_str());
+void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info,
+                             const std::vector<XmlFaceVertex>& vertices) {
+  tinyxml2::XMLElement* face_elem = WriteStartTag(kFaceTag.c_str());
+  if (info.is_inner_loop_) {
+    face_elem->SetAttribute(kInnerTag.c_str(), true);
+  }
 
   // Front material (optional)
-  if (!info.front_mat_name_.empty()) {
+  if (info.front_mat_name_id_ != 0) {
     tinyxml2::XMLElement* elem = WriteStartTag(kFrontMaterialTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.front_mat_name_.c_str());
+    elem->SetAttribute(kNameTag.c_str(),
+                       names_.Get(info.front_mat_name_id_).c_str());
     elem->SetAttribute(kHasTextureTag.c_str(), info.has_front_texture_);
     PopParentNode();
   }
 
   // Back material (optional)
-  if (!info.back_mat_name_.empty()) {
+  if (info.back_mat_name_id_ != 0) {
     tinyxml2::XMLElement* elem = WriteStartTag(kBackMaterialTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.back_mat_name_.c_str());
+    elem->SetAttribute(kNameTag.c_str(),
+                       names_.Get(info.back_mat_name_id_).c_str());
     elem->SetAttribute(kHasTextureTag.c_str(), info.has_back_texture_);
     PopParentNode();
   }
 
   // Layer (optional)
-  if (!info.layer_name_.empty()) {
-    tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.layer_name_.c_str());
-    PopParentNode();
-  }
+  if (info.layer_name_id_ != 0)
+    WriteLayerReference(names_.Get(info.layer_name_id_), info.layer_index_);
 
   // Loop or Triangles
-  size_t count = info.vertices_.size();
+  size_t count = info.num_vertices_;
   if (info.has_single_loop_) {
     WriteStartTag(kLoopTag.c_str());
   } else {
@@ -576,8 +677,12 @@ void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
 
   // Vertices
   for (size_t i = 0; i < count; i++) {
-    WriteStartTag(kVertexTag.c_str());
-    const XmlFaceVertex& vertex_info = info.vertices_[i];
+    tinyxml2::XMLElement* vertex_elem = WriteStartTag(kVertexTag.c_str());
+    const XmlFaceVertex& vertex_info = vertices[info.first_vertex_ + i];
+    if (vertex_info.soft_edge_)
+      vertex_elem->SetAttribute(kSoftTag.c_str(), true);
+    if (vertex_info.has_edge_color_)
+      WriteColor(vertex_info.edge_color_);
     {
       tinyxml2::XMLElement* elem = WriteStartTag(kPointTag.c_str());
       elem->SetAttribute(kXTag.c_str(), vertex_info.vertex_.x());
@@ -608,12 +713,13 @@ void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
 }
 
 bool CXmlFile::ReadCurveInfo(const tinyxml2::XMLNode* parent_node,
+                             CXmlStringTable& names,
                              XmlCurveInfo& info) const {
   bool ok = true;
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
   while (child != NULL) {
     XmlEdgeInfo edge_info;
-    if (ReadEdgeInfo(child, edge_info)) {
+    if (ReadEdgeInfo(child, names, edge_info)) {
       info.edges_.push_back(edge_info);
     } else {
       ok = false;
@@ -667,9 +773,116 @@ void CXmlFile::WriteTransformation(const SUTransformation& transform) {
   PopParentNode();
 }
 
+// Entity counts of a document, for sizing the pools before reading
+struct XmlEntityCounts {
+  XmlEntityCounts()
+    : instances_(0), groups_(0), faces_(0), vertices_(0), edges_(0),
+      curves_(0) {}
+
+  size_t instances_;
+  size_t groups_;
+  size_t faces_;
+  size_t vertices_;
+  size_t edges_;
+  size_t curves_;
+};
+
+static void CountEntities(const tinyxml2::XMLNode* parent_node,
+                          XmlEntityCounts& counts) {
+  const tinyxml2::XMLElement* child = parent_node->FirstChildElement();
+  while (child != NULL) {
+    const char* tag = child->Value();
+    if (tag == kComponentInstanceTag) {
+      counts.instances_++;
+    } else if (tag == kGroupTag) {
+      counts.groups_++;
+      CountEntities(child, counts);
+    } else if (tag == kFaceTag) {
+      counts.faces_++;
+      const tinyxml2::XMLElement* elem = child->LastChildElement();
+      if (elem != NULL) {
+        const tinyxml2::XMLElement* vertex =
+            elem->FirstChildElement(kVertexTag.c_str());
+        for (; vertex != NULL;
+             vertex = vertex->NextSiblingElement(kVertexTag.c_str())) {
+          counts.vertices_++;
+        }
+      }
+    } else if (tag == kEdgeTag) {
+      counts.edges_++;
+    } else if (tag == kCurveTag) {
+      counts.curves_++;
+    } else if (tag == kCompDefTag) {
+      CountEntities(child, counts);
+    }
+    child = child->NextSiblingElement();
+  }
+}
+
+// Sizes the entity pools for the definitions and geometry of the file. The
+// definitions of a package store are in files of their own and are not
+// counted, the pools grow as they are read.
+static void ReserveEntities(const tinyxml2::XMLDocument* xml_doc,
+                            XmlModelInfo& model_info) {
+  XmlEntityCounts counts;
+  const tinyxml2::XMLElement* elem = xml_doc->FirstChildElement();
+  while (elem != NULL) {
+    if (elem->Value() == kCompDefsTag || elem->Value() == kGeometryTag)
+      CountEntities(elem, counts);
+    elem = elem->NextSiblingElement();
+  }
+  model_info.component_instances_.reserve(counts.instances_);
+  model_info.groups_.reserve(counts.groups_);
+  model_info.faces_.reserve(counts.faces_);
+  model_info.vertices_.reserve(counts.vertices_);
+  model_info.edges_.reserve(counts.edges_);
+  model_info.curves_.reserve(counts.curves_);
+}
+
+// Sets the layer indices the file left out from the layer names. The
+// definitions of a package store have none, as the models sharing them
+// each have their own Layers section.
+static void ResolveLayerIndices(XmlModelInfo& model_info) {
+  std::vector<int> indices(model_info.names_.size(), -1);
+  for (size_t i = 0; i < model_info.layers_.size(); ++i) {
+    int id = model_info.names_.Find(model_info.layers_[i].name_.c_str());
+    if (id > 0 && indices[id] < 0)
+      indices[id] = static_cast<int>(i);
+  }
+  for (size_t i = 0; i < model_info.component_instances_.size(); ++i) {
+    XmlComponentInstanceInfo& info = model_info.component_instances_[i];
+    if (info.layer_index_ < 0)
+      info.layer_index_ = indices[info.layer_name_id_];
+  }
+  for (size_t i = 0; i < model_info.groups_.size(); ++i) {
+    XmlGroupInfo& info = model_info.groups_[i];
+    if (info.layer_index_ < 0)
+      info.layer_index_ = indices[info.layer_name_id_];
+  }
+  for (size_t i = 0; i < model_info.faces_.size(); ++i) {
+    XmlFaceInfo& info = model_info.faces_[i];
+    if (info.layer_index_ < 0)
+      info.layer_index_ = indices[info.layer_name_id_];
+  }
+  for (size_t i = 0; i < model_info.edges_.size(); ++i) {
+    XmlEdgeInfo& info = model_info.edges_[i];
+    if (info.has_layer_ && info.layer_index_ < 0)
+      info.layer_index_ = indices[info.layer_name_id_];
+  }
+  for (size_t i = 0; i < model_info.curves_.size(); ++i) {
+    std::vector<XmlEdgeInfo>& edges = model_info.curves_[i].edges_;
+    for (size_t e = 0; e < edges.size(); ++e) {
+      if (edges[e].has_layer_ && edges[e].layer_index_ < 0)
+        edges[e].layer_index_ = indices[edges[e].layer_name_id_];
+    }
+  }
+}
+
 bool CXmlFile::GetModelInfo(XmlModelInfo& model_info) const {
   // Clear out the given model info
-  model_info = XmlModelInfo();
+  XmlModelInfo empty_info;
+  model_info.Swap(empty_info);
+  ReserveEntities(xml_doc_, model_info);
 
   bool ok = true;
 
@@ -682,12 +895,23 @@ bool CXmlFile::GetModelInfo(XmlModelInfo& model_info) const {
     } else if (tag == kMaterialsTag) {
       ok &= ReadMaterials(child, model_info.materials_);
     } else if (tag == kCompDefsTag) {
-      ok &= ReadComponentDefinitions(child, model_info.definitions_);
+      ok &= ReadComponentDefinitions(child, model_info);
     } else if (tag == kGeometryTag) {
-      ok &= ReadEntities(child, model_info.entities_);
+      ok &= ReadEntities(child, model_info, model_info.entities_);
+    } else if (tag == kScenesTag) {
+      ok &= ReadScenes(child, model_info.scenes_);
+    } else if (tag == kVisibilityCellsTag) {
+      ok &= ReadVisibilityCells(child, model_info.visibility_cells_);
+    } else if (tag == kSectionsTag) {
+      ok &= ReadSections(child, model_info.names_, model_info.sections_);
+    } else if (tag == kDuplicateOutlinesTag) {
+      ok &= ReadOutlineFlags(child, model_info.duplicate_outlines_);
+    } else if (tag == kHiddenOutlinesTag) {
+      ok &= ReadOutlineFlags(child, model_info.hidden_outlines_);
     }
     child = child->NextSibling();
   }
+  ResolveLayerIndices(model_info);
 
   return ok;
 }
@@ -725,13 +949,28 @@ bool CXmlFile::ReadMaterials(const tinyxml2::XMLNode* parent_node,
 }
 
 bool CXmlFile::ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
-    std::vector<XmlComponentDefinitionInfo>& def_infos) const {
+                                        XmlModelInfo& model_info) const {
+  // Models of a package only name the definitions they use, each is in a
+  // file of its own in the store directory, see CXmlPackageBuilder. The
+  // store is found next to the model, as the textures are.
+  const char* store = parent_node->ToElement()->Attribute(kStoreTag.c_str());
+  tinyxml2::XMLDocument store_doc;
+
   bool ok = true;
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
   while (child != NULL) {
+    const tinyxml2::XMLNode* node = child;
+    const char* name = child->ToElement()->Attribute(kNameTag.c_str());
+    if (store != NULL && child->FirstChild() == NULL && name != NULL) {
+      std::string path = GetTextureDirectory() + store + "/" + name + ".xml";
+      node = NULL;
+      if (store_doc.LoadFile(path.c_str()) == tinyxml2::XML_NO_ERROR)
+        node = store_doc.FirstChildElement(kCompDefTag.c_str());
+    }
     XmlComponentDefinitionInfo info;
-    if (ReadComponentDefinitionInfo(child, true, info)) {
-      def_infos.push_back(info);
+    if (node != NULL &&
+        ReadComponentDefinitionInfo(node, true, model_info, info)) {
+      model_info.definitions_.push_back(info);
     } else {
       ok = false;
     }
@@ -744,24 +983,26 @@ bool CXmlFile::ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
 void CXmlFile::WriteComponentInstanceInfo(
     const XmlComponentInstanceInfo& info) {
   tinyxml2::XMLElement* elem = WriteStartTag(kComponentInstanceTag.c_str());
+  if (!info.outline_)
+    elem->SetAttribute(kOutlineTag.c_str(), false);
+  if (info.collision_only_)
+    elem->SetAttribute(kCollisionOnlyTag.c_str(), true);
   
   // Definition name
-  StartComponentDefinition(info.definition_name_);
+  StartComponentDefinition(names_.Get(info.definition_name_id_));
   PopParentNode();
 
   // Material (optional)
-  if (!info.material_name_.empty()) {
+  if (info.material_name_id_ != 0) {
     tinyxml2::XMLElement* elem = WriteStartTag(kMaterialTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.material_name_.c_str());
+    elem->SetAttribute(kNameTag.c_str(),
+                       names_.Get(info.material_name_id_).c_str());
     PopParentNode();
   }
 
   // Layer (optional)
-  if (!info.layer_name_.empty()) {
-    tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.layer_name_.c_str());
-    PopParentNode();
-  }
+  if (info.layer_name_id_ != 0)
+    WriteLayerReference(names_.Get(info.layer_name_id_), info.layer_index_);
 
   // Transformation
   WriteTransformation(info.transform_);
@@ -769,19 +1010,31 @@ void CXmlFile::WriteComponentInstanceInfo(
 }
 
 bool CXmlFile::ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
+                                         CXmlStringTable& names,
                                          XmlComponentInstanceInfo& info) const {
   bool ok = true;
 
+  // Export hints (optional)
+  parent_node->ToElement()->QueryBoolAttribute(kOutlineTag.c_str(),
+                                               &info.outline_);
+  parent_node->ToElement()->QueryBoolAttribute(kCollisionOnlyTag.c_str(),
+                                               &info.collision_only_);
+
   // Definition name
-  XmlComponentDefinitionInfo comp_def;
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  ok &= ReadComponentDefinitionInfo(child, false, comp_def);
-  info.definition_name_ = comp_def.name_;
+  const char* definition_name =
+      child->ToElement()->Attribute(kNameTag.c_str());
+  ok &= definition_name != NULL;
+  if (definition_name != NULL)
+    info.definition_name_id_ = names.Intern(definition_name);
 
   // Material (optional)
   child = child->NextSibling();
   if (child != NULL && child->Value() == kMaterialTag) {
-    info.material_name_ = child->ToElement()->Attribute(kNameTag.c_str());
+    const char* material_name =
+        child->ToElement()->Attribute(kNameTag.c_str());
+    if (material_name != NULL)
+      info.material_name_id_ = names.Intern(material_name);
   }
 
   if (child != NULL) {
@@ -795,7 +1048,11 @@ bool CXmlFile::ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
       }
     }
     if (foundLayer) {
-      info.layer_name_ = child->ToElement()->Attribute(kNameTag.c_str());
+      const char* layer_name = child->ToElement()->Attribute(kNameTag.c_str());
+      if (layer_name != NULL)
+        info.layer_name_id_ = names.Intern(layer_name);
+      child->ToElement()->QueryIntAttribute(kIndexTag.c_str(),
+                                            &info.layer_index_);
     }
   }
 
@@ -804,8 +1061,36 @@ bool CXmlFile::ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
   return ok;
 }
 
+// Groups are read breadth first: each list of entities is read in one go,
+// and the groups found in it are queued behind the ones already there. That
+// keeps every range contiguous without copying subtrees around.
 bool CXmlFile::ReadEntities(const tinyxml2::XMLNode* parent_node,
+                            XmlModelInfo& model_info,
                             XmlEntitiesInfo& entities) const {
+  size_t first_group = model_info.groups_.size();
+  std::vector<const tinyxml2::XMLNode*> group_nodes;
+  bool ok = ReadEntityList(parent_node, -1, model_info, entities, group_nodes);
+
+  for (size_t g = first_group; g < model_info.groups_.size(); ++g) {
+    XmlEntitiesInfo group_entities;
+    ok &= ReadEntityList(group_nodes[g - first_group], static_cast<int>(g),
+                         model_info, group_entities, group_nodes);
+    model_info.groups_[g].entities_ = group_entities;
+  }
+
+  return ok;
+}
+
+bool CXmlFile::ReadEntityList(
+    const tinyxml2::XMLNode* parent_node, int parent,
+    XmlModelInfo& model_info,
+    XmlEntitiesInfo& entities,
+    std::vector<const tinyxml2::XMLNode*>& group_nodes) const {
+  entities.first_instance_ = model_info.component_instances_.size();
+  entities.first_group_ = model_info.groups_.size();
+  entities.first_face_ = model_info.faces_.size();
+  entities.first_edge_ = model_info.edges_.size();
+  entities.first_curve_ = model_info.curves_.size();
 
   bool ok = true;
 
@@ -813,34 +1098,440 @@ bool CXmlFile::ReadEntities(const tinyxml2::XMLNode* parent_node,
   while (child != NULL) {
     const char* tag = child->ToElement()->Value();
     if (tag == kComponentInstanceTag) {
-      XmlComponentInstanceInfo instance;
-      ReadComponentInstanceInfo(child, instance);
-      entities.component_instances_.push_back(instance);
+      model_info.component_instances_.push_back(XmlComponentInstanceInfo());
+      ReadComponentInstanceInfo(child, model_info.names_,
+                                model_info.component_instances_.back());
     } else if (tag == kGroupTag) {
-      XmlGroupInfo group;
-      // Recurse into group entities
-      ok &= ReadEntities(child, *group.entities_);
-      // Read the transformation
+      model_info.groups_.push_back(XmlGroupInfo());
+      XmlGroupInfo& group = model_info.groups_.back();
+      group.parent_ = parent;
+      // Export hints (optional)
+      child->ToElement()->QueryBoolAttribute(kOutlineTag.c_str(),
+                                             &group.outline_);
+      child->ToElement()->QueryBoolAttribute(kCollisionOnlyTag.c_str(),
+                                             &group.collision_only_);
+      // Layer (optional)
+      const tinyxml2::XMLElement* layer =
+          child->FirstChildElement(kLayerTag.c_str());
+      if (layer != NULL && layer->Attribute(kNameTag.c_str()) != NULL) {
+        group.layer_name_id_ =
+            model_info.names_.Intern(layer->Attribute(kNameTag.c_str()));
+        layer->QueryIntAttribute(kIndexTag.c_str(), &group.layer_index_);
+      }
+      // Read the transformation, the group entities follow later
       ok &= ReadTransformation(child, group.transform_);
-      entities.groups_.push_back(group);
+      group_nodes.push_back(child);
     } else if (tag == kFaceTag) {
       // Read faces
-      XmlFaceInfo face_info;
-      ok &= ReadFaceInfo(child, face_info);
-      entities.faces_.push_back(face_info);
+      model_info.faces_.push_back(XmlFaceInfo());
+      ok &= ReadFaceInfo(child, model_info.names_, model_info.faces_.back(),
+                         model_info.vertices_);
     } else if (tag == kEdgeTag) {
       // Read edges
-      XmlEdgeInfo edge_info;
-      ok &= ReadEdgeInfo(child, edge_info);
-      entities.edges_.push_back(edge_info);
+      model_info.edges_.push_back(XmlEdgeInfo());
+      ok &= ReadEdgeInfo(child, model_info.names_, model_info.edges_.back());
     } else if (tag == kCurveTag) {
       // Read curves
-      XmlCurveInfo curve_info;
-      ok &= ReadCurveInfo(child, curve_info);
-      entities.curves_.push_back(curve_info);
+      model_info.curves_.push_back(XmlCurveInfo());
+      ok &= ReadCurveInfo(child, model_info.names_,
+                          model_info.curves_.back());
+    }
+    child = child->NextSibling();
+  }
+
+  entities.num_instances_ =
+      model_info.component_instances_.size() - entities.first_instance_;
+  entities.num_groups_ = model_info.groups_.size() - entities.first_group_;
+  entities.num_faces_ = model_info.faces_.size() - entities.first_face_;
+  entities.num_edges_ = model_info.edges_.size() - entities.first_edge_;
+  entities.num_curves_ = model_info.curves_.size() - entities.first_curve_;
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Scenes
+
+// Visibility bits are stored as hex, two digits per byte, with item i in bit
+// (i % 8) of byte (i / 8).
+static std::string EncodeBits(const std::vector<bool>& bits) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve((bits.size() + 7) / 8 * 2);
+  for (size_t i = 0; i < bits.size(); i += 8) {
+    unsigned byte = 0;
+    for (size_t bit = 0; bit < 8 && i + bit < bits.size(); ++bit) {
+      if (bits[i + bit])
+        byte |= 1u << bit;
+    }
+    hex.push_back(kHexDigits[byte >> 4]);
+    hex.push_back(kHexDigits[byte & 0xf]);
+  }
+  return hex;
+}
+
+static int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool DecodeBits(const char* hex, size_t count, std::vector<bool>& bits) {
+  bits.assign(count, false);
+  for (size_t i = 0; i < count; i += 8) {
+    size_t byte_index = i / 8;
+    if (hex[byte_index * 2] == '\0' || hex[byte_index * 2 + 1] == '\0')
+      return false;
+    int high = HexDigitValue(hex[byte_index * 2]);
+    int low = HexDigitValue(hex[byte_index * 2 + 1]);
+    if (high < 0 || low < 0)
+      return false;
+    unsigned byte = static_cast<unsigned>(high * 16 + low);
+    for (size_t bit = 0; bit < 8 && i + bit < count; ++bit) {
+      bits[i + bit] = (byte & (1u << bit)) != 0;
+    }
+  }
+  return true;
+}
+
+static void SetPointAttributes(tinyxml2::XMLElement* elem, double x, double y,
+                               double z) {
+  elem->SetAttribute(kXTag.c_str(), x);
+  elem->SetAttribute(kYTag.c_str(), y);
+  elem->SetAttribute(kZTag.c_str(), z);
+}
+
+void CXmlFile::WriteSceneInfo(const XmlSceneInfo& info) {
+  tinyxml2::XMLElement* elem = WriteStartTag(kSceneTag.c_str());
+  elem->SetAttribute(kNameTag.c_str(), info.name_.c_str());
+
+  // Camera (optional)
+  if (info.has_camera_) {
+    const XmlCameraInfo& camera = info.camera_;
+    tinyxml2::XMLElement* camera_elem = WriteStartTag(kCameraTag.c_str());
+    camera_elem->SetAttribute(kPerspectiveTag.c_str(), camera.is_perspective_);
+    camera_elem->SetAttribute(kFOVTag.c_str(), camera.fov_);
+    camera_elem->SetAttribute(kAspectRatioTag.c_str(), camera.aspect_ratio_);
+    camera_elem->SetAttribute(kHeightTag.c_str(), camera.ortho_height_);
+
+    SetPointAttributes(WriteStartTag(kEyeTag.c_str()),
+                       camera.eye_.x(), camera.eye_.y(), camera.eye_.z());
+    PopParentNode();
+    SetPointAttributes(WriteStartTag(kTargetTag.c_str()),
+                       camera.target_.x(), camera.target_.y(),
+                       camera.target_.z());
+    PopParentNode();
+    SetPointAttributes(WriteStartTag(kUpTag.c_str()),
+                       camera.up_.x(), camera.up_.y(), camera.up_.z());
+    PopParentNode();
+    PopParentNode(); // Camera
+  }
+
+  // Visible outline segments (optional)
+  if (info.has_visible_lines_) {
+    tinyxml2::XMLElement* lines_elem = WriteStartTag(kVisibleLinesTag.c_str());
+    lines_elem->SetAttribute(kCountTag.c_str(),
+        static_cast<unsigned>(info.visible_lines_.size()));
+    lines_elem->SetAttribute(kBitsTag.c_str(),
+                             EncodeBits(info.visible_lines_).c_str());
+    PopParentNode();
+  }
+
+  // Layer visibility (optional)
+  if (info.has_visible_layers_) {
+    tinyxml2::XMLElement* layers_elem =
+        WriteStartTag(kVisibleLayersTag.c_str());
+    layers_elem->SetAttribute(kCountTag.c_str(),
+        static_cast<unsigned>(info.visible_layers_.size()));
+    layers_elem->SetAttribute(kBitsTag.c_str(),
+                              EncodeBits(info.visible_layers_).c_str());
+    PopParentNode();
+  }
+
+  PopParentNode(); // Scene
+}
+
+bool CXmlFile::ReadSceneInfo(const tinyxml2::XMLNode* parent_node,
+                             XmlSceneInfo& info) const {
+  const tinyxml2::XMLElement* elem = parent_node->ToElement();
+  if (elem == NULL || elem->Value() != kSceneTag)
+    return false;
+
+  const char* name = elem->Attribute(kNameTag.c_str());
+  if (name == NULL)
+    return false;
+  info.name_ = name;
+
+  bool ok = true;
+  const tinyxml2::XMLElement* child = elem->FirstChildElement();
+  while (child != NULL) {
+    if (child->Value() == kCameraTag) {
+      XmlCameraInfo& camera = info.camera_;
+      info.has_camera_ = true;
+      child->QueryBoolAttribute(kPerspectiveTag.c_str(),
+                                &camera.is_perspective_);
+      child->QueryDoubleAttribute(kFOVTag.c_str(), &camera.fov_);
+      child->QueryDoubleAttribute(kAspectRatioTag.c_str(),
+                                  &camera.aspect_ratio_);
+      child->QueryDoubleAttribute(kHeightTag.c_str(), &camera.ortho_height_);
+
+      CPoint3d up;
+      const tinyxml2::XMLElement* eye = child->FirstChildElement(kEyeTag.c_str());
+      const tinyxml2::XMLElement* target =
+          child->FirstChildElement(kTargetTag.c_str());
+      const tinyxml2::XMLElement* up_elem =
+          child->FirstChildElement(kUpTag.c_str());
+      ok &= eye != NULL && ReadPoint(eye, camera.eye_);
+      ok &= target != NULL && ReadPoint(target, camera.target_);
+      ok &= up_elem != NULL && ReadPoint(up_elem, up);
+      camera.up_.SetDirection(up.x(), up.y(), up.z());
+    } else if (child->Value() == kVisibleLinesTag) {
+      unsigned count = 0;
+      const char* bits = child->Attribute(kBitsTag.c_str());
+      if (child->QueryUnsignedAttribute(kCountTag.c_str(), &count) ==
+          tinyxml2::XML_NO_ERROR && bits != NULL &&
+          DecodeBits(bits, count, info.visible_lines_)) {
+        info.has_visible_lines_ = true;
+      } else {
+        ok = false;
+      }
+    } else if (child->Value() == kVisibleLayersTag) {
+      unsigned count = 0;
+      const char* bits = child->Attribute(kBitsTag.c_str());
+      if (child->QueryUnsignedAttribute(kCountTag.c_str(), &count) ==
+          tinyxml2::XML_NO_ERROR && bits != NULL &&
+          DecodeBits(bits, count, info.visible_layers_)) {
+        info.has_visible_layers_ = true;
+      } else {
+        ok = false;
+      }
+    }
+    child = child->NextSiblingElement();
+  }
+  return ok;
+}
+
+bool CXmlFile::ReadScenes(const tinyxml2::XMLNode* parent_node,
+                          std::vector<XmlSceneInfo>& scene_infos) const {
+  bool ok = true;
+  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  while (child != NULL) {
+    XmlSceneInfo info;
+    if (ReadSceneInfo(child, info)) {
+      scene_infos.push_back(info);
+    } else {
+      ok = false;
     }
     child = child->NextSibling();
   }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Visibility cells
 
+void CXmlFile::WriteVisibilityCellInfo(const XmlVisibilityCellInfo& info) {
+  tinyxml2::XMLElement* elem = WriteStartTag(kCellTag.c_str());
+  elem->SetAttribute(kCountTag.c_str(),
+      static_cast<unsigned>(info.visible_groups_.size()));
+  elem->SetAttribute(kBitsTag.c_str(),
+                     EncodeBits(info.visible_groups_).c_str());
+
+  SetPointAttributes(WriteStartTag(kMinTag.c_str()),
+                     info.min_.x(), info.min_.y(), info.min_.z());
+  PopParentNode();
+  SetPointAttributes(WriteStartTag(kMaxTag.c_str()),
+                     info.max_.x(), info.max_.y(), info.max_.z());
+  PopParentNode();
+
+  PopParentNode(); // Cell
+}
+
+bool CXmlFile::ReadVisibilityCellInfo(const tinyxml2::XMLNode* parent_node,
+                                      XmlVisibilityCellInfo& info) const {
+  const tinyxml2::XMLElement* elem = parent_node->ToElement();
+  if (elem == NULL || elem->Value() != kCellTag)
+    return false;
+
+  unsigned count = 0;
+  const char* bits = elem->Attribute(kBitsTag.c_str());
+  if (elem->QueryUnsignedAttribute(kCountTag.c_str(), &count) !=
+      tinyxml2::XML_NO_ERROR || bits == NULL ||
+      !DecodeBits(bits, count, info.visible_groups_)) {
+    return false;
+  }
+
+  const tinyxml2::XMLElement* min_elem =
+      elem->FirstChildElement(kMinTag.c_str());
+  const tinyxml2::XMLElement* max_elem =
+      elem->FirstChildElement(kMaxTag.c_str());
+  return min_elem != NULL && ReadPoint(min_elem, info.min_) &&
+         max_elem != NULL && ReadPoint(max_elem, info.max_);
+}
+
+bool CXmlFile::ReadVisibilityCells(const tinyxml2::XMLNode* parent_node,
+    std::vector<XmlVisibilityCellInfo>& cell_infos) const {
+  bool ok = true;
+  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  while (child != NULL) {
+    XmlVisibilityCellInfo info;
+    if (ReadVisibilityCellInfo(child, info)) {
+      cell_infos.push_back(info);
+    } else {
+      ok = false;
+    }
+    child = child->NextSibling();
+  }
   return ok;
 }
+
+//------------------------------------------------------------------------------
+// Sections
+
+void CXmlFile::WriteSectionInfo(const XmlSectionInfo& info) {
+  tinyxml2::XMLElement* elem = WriteStartTag(kSectionTag.c_str());
+  elem->SetAttribute(kOffsetTag.c_str(), info.offset_);
+
+  SetPointAttributes(WriteStartTag(kNormalTag.c_str()),
+                     info.normal_.x(), info.normal_.y(), info.normal_.z());
+  PopParentNode();
+
+  // Same format as the curves in the geometry
+  for (size_t i = 0; i < info.polylines_.size(); ++i) {
+    WriteCurveInfo(info.polylines_[i]);
+  }
+
+  PopParentNode(); // Section
+}
+
+bool CXmlFile::ReadSectionInfo(const tinyxml2::XMLNode* parent_node,
+                               CXmlStringTable& names,
+                               XmlSectionInfo& info) const {
+  const tinyxml2::XMLElement* elem = parent_node->ToElement();
+  if (elem == NULL || elem->Value() != kSectionTag)
+    return false;
+
+  bool ok = elem->QueryDoubleAttribute(kOffsetTag.c_str(), &info.offset_) ==
+            tinyxml2::XML_NO_ERROR;
+  bool has_normal = false;
+  const tinyxml2::XMLElement* child = elem->FirstChildElement();
+  while (child != NULL) {
+    if (child->Value() == kNormalTag) {
+      CPoint3d normal;
+      has_normal = ReadPoint(child, normal);
+      info.normal_.SetDirection(normal.x(), normal.y(), normal.z());
+    } else if (child->Value() == kCurveTag) {
+      XmlCurveInfo curve_info;
+      ok &= ReadCurveInfo(child, names, curve_info);
+      info.polylines_.push_back(curve_info);
+    }
+    child = child->NextSiblingElement();
+  }
+  return ok && has_normal;
+}
+
+bool CXmlFile::ReadSections(const tinyxml2::XMLNode* parent_node,
+                            CXmlStringTable& names,
+                            std::vector<XmlSectionInfo>& section_infos) const {
+  bool ok = true;
+  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  while (child != NULL) {
+    XmlSectionInfo info;
+    if (ReadSectionInfo(child, names, info)) {
+      section_infos.push_back(info);
+    } else {
+      ok = false;
+    }
+    child = child->NextSibling();
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Duplicate and hidden outlines
+
+void CXmlFile::WriteDuplicateOutlines(const std::vector<bool>& duplicates) {
+  WriteOutlineFlags(kDuplicateOutlinesTag, duplicates);
+}
+
+void CXmlFile::WriteHiddenOutlines(const std::vector<bool>& hidden) {
+  WriteOutlineFlags(kHiddenOutlinesTag, hidden);
+}
+
+void CXmlFile::WriteOutlineFlags(const std::string& tag,
+                                 const std::vector<bool>& flags) {
+  tinyxml2::XMLElement* elem = WriteStartTag(tag.c_str());
+  elem->SetAttribute(kCountTag.c_str(), static_cast<unsigned>(flags.size()));
+  elem->SetAttribute(kBitsTag.c_str(), EncodeBits(flags).c_str());
+  PopParentNode();
+}
+
+bool CXmlFile::ReadOutlineFlags(const tinyxml2::XMLNode* parent_node,
+                                std::vector<bool>& flags) const {
+  const tinyxml2::XMLElement* elem = parent_node->ToElement();
+  unsigned count = 0;
+  const char* bits = elem->Attribute(kBitsTag.c_str());
+  return elem->QueryUnsignedAttribute(kCountTag.c_str(), &count) ==
+         tinyxml2::XML_NO_ERROR && bits != NULL &&
+         DecodeBits(bits, count, flags);
+}
+
+//------------------------------------------------------------------------------
+// Geometry written by other processes
+
+// Copies a node and everything below it into document, counting the faces
+// and noting the elements drawn without outlines
+static tinyxml2::XMLNode* CloneNode(const tinyxml2::XMLNode* node,
+                                    tinyxml2::XMLDocument* document,
+                                    size_t& num_faces,
+                                    bool& has_hidden_outlines) {
+  const tinyxml2::XMLElement* elem = node->ToElement();
+  if (elem != NULL) {
+    if (elem->Value() == kFaceTag)
+      ++num_faces;
+    bool outline = true;
+    bool collision_only = false;
+    elem->QueryBoolAttribute(kOutlineTag.c_str(), &outline);
+    elem->QueryBoolAttribute(kCollisionOnlyTag.c_str(), &collision_only);
+    if (!outline || collision_only)
+      has_hidden_outlines = true;
+  }
+  tinyxml2::XMLNode* clone = node->ShallowClone(document);
+  for (const tinyxml2::XMLNode* child = node->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    clone->InsertEndChild(CloneNode(child, document, num_faces,
+                                    has_hidden_outlines));
+  }
+  return clone;
+}
+
+bool CXmlFile::AppendGeometry(const std::vector<std::string>& filenames,
+                              size_t& num_faces, bool& has_hidden_outlines) {
+  tinyxml2::XMLNode* last_child = parent_node_->LastChild();
+  size_t appended_faces = 0;
+  bool appended_hidden_outlines = false;
+  bool ok = true;
+  tinyxml2::XMLDocument shard_doc;
+  for (size_t i = 0; ok && i < filenames.size(); ++i) {
+    const tinyxml2::XMLElement* geometry = NULL;
+    if (shard_doc.LoadFile(filenames[i].c_str()) == tinyxml2::XML_NO_ERROR)
+      geometry = shard_doc.FirstChildElement(kGeometryTag.c_str());
+    ok = geometry != NULL;
+    for (const tinyxml2::XMLNode* child = ok ? geometry->FirstChild() : NULL;
+         child != NULL; child = child->NextSibling()) {
+      parent_node_->InsertEndChild(CloneNode(child, xml_doc_,
+                                             appended_faces,
+                                             appended_hidden_outlines));
+    }
+  }
+
+  if (!ok) {
+    // Take back the shards already appended
+    while (parent_node_->LastChild() != last_child)
+      parent_node_->DeleteChild(parent_node_->LastChild());
+    return false;
+  }
+  num_faces += appended_faces;
+  has_hidden_outlines |= appended_hidden_outlines;
+  return true;
+}
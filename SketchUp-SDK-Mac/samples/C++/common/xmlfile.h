@@ -11,6 +11,7 @@
 #include <slapi/transformation.h>
 
 #include "./xmlgeomutils.h"
+#include "./xmlstringtable.h"
 
 // Forward declarations
 namespace tinyxml2 {
@@ -19,7 +20,9 @@ namespace tinyxml2 {
   class XMLElement;
 }
 
-// Helper data transfer types storing model information.
+// Helper data transfer types storing model information. Layer, material and
+// definition names referenced by entities are ids in the string table of the
+// XmlModelInfo they were read into, or of the CXmlFile they are written to.
 
 struct XmlMaterialInfo {
   XmlMaterialInfo()
@@ -47,10 +50,14 @@ struct XmlLayerInfo {
 };
 
 struct XmlEdgeInfo {
-  XmlEdgeInfo() : has_layer_(false), has_color_(false) {}
+  XmlEdgeInfo()
+    : has_layer_(false), layer_name_id_(0), layer_index_(-1),
+      has_color_(false) {}
 
   bool has_layer_;
-  std::string layer_name_;
+  int layer_name_id_;
+  // Index in the Layers section, -1 if unknown
+  int layer_index_;
   bool has_color_;
   SUColor color_;
   XmlGeomUtils::CPoint3d start_;
@@ -62,66 +69,216 @@ struct XmlCurveInfo {
 };
 
 struct XmlFaceVertex {
+  XmlFaceVertex() : soft_edge_(false), has_edge_color_(false) {}
+
   XmlGeomUtils::CPoint3d vertex_;
   XmlGeomUtils::CPoint3d front_texture_coord_;
   XmlGeomUtils::CPoint3d back_texture_coord_;
+  // Whether the loop side from this vertex to the next one is a soft or
+  // smooth edge, which SketchUp only draws as part of the silhouette
+  bool soft_edge_;
+  // Color of the edge on that side, if it has a material of its own
+  bool has_edge_color_;
+  SUColor edge_color_;
 };
 
 struct XmlFaceInfo {
   XmlFaceInfo()
-    : has_front_texture_(false),
+    : front_mat_name_id_(0),
+      back_mat_name_id_(0),
+      layer_name_id_(0),
+      has_front_texture_(false),
       has_back_texture_(false),
-      has_single_loop_(false) {}
-
-  std::string layer_name_;
-  std::string front_mat_name_;
-  std::string back_mat_name_;
+      has_single_loop_(false),
+      is_inner_loop_(false),
+      layer_index_(-1),
+      first_vertex_(0),
+      num_vertices_(0) {}
+
+  int front_mat_name_id_;
+  int back_mat_name_id_;
+  int layer_name_id_;
   bool has_front_texture_;
   bool has_back_texture_;
   bool has_single_loop_;
-  // if single loop, vertices_ are the points in the loop
-  // if triangles, vertices_ are 3 per triangle
-  std::vector<XmlFaceVertex> vertices_;
+  // Inner loops are written as their own face directly after the face whose
+  // hole they bound.
+  bool is_inner_loop_;
+  // Index in the Layers section, -1 if unknown
+  int layer_index_;
+  // Range in XmlModelInfo::vertices_, or in the list given to
+  // CXmlFile::WriteFaceInfo.
+  // if single loop, the vertices are the points in the loop
+  // if triangles, the vertices are 3 per triangle
+  size_t first_vertex_;
+  size_t num_vertices_;
+};
+
+struct XmlCameraInfo {
+  XmlCameraInfo()
+    : is_perspective_(true), fov_(35.0), aspect_ratio_(0.0),
+      ortho_height_(0.0) {}
+
+  XmlGeomUtils::CPoint3d eye_;
+  XmlGeomUtils::CPoint3d target_;
+  XmlGeomUtils::CVector3d up_;
+  bool is_perspective_;
+  // Vertical field of view in degrees
+  double fov_;
+  // Width / height, 0.0 if the camera follows the viewport
+  double aspect_ratio_;
+  double ortho_height_;
+};
+
+struct XmlSceneInfo {
+  XmlSceneInfo()
+    : has_camera_(false), has_visible_lines_(false),
+      has_visible_layers_(false) {}
+
+  std::string name_;
+  bool has_camera_;
+  XmlCameraInfo camera_;
+  // One flag per outline segment, in the order the segments are produced by
+  // CXmlWorldGeometry, telling whether it is visible from the camera.
+  bool has_visible_lines_;
+  std::vector<bool> visible_lines_;
+  // One flag per layer, in the order of the Layers section, for scenes that
+  // save the layer visibility. An element is shown if its layer and the
+  // layers of all the groups and instances holding it are visible.
+  bool has_visible_layers_;
+  std::vector<bool> visible_layers_;
+};
+
+// A box of navigable space and what can be seen from anywhere inside it
+struct XmlVisibilityCellInfo {
+  XmlGeomUtils::CPoint3d min_;
+  XmlGeomUtils::CPoint3d max_;
+  // One flag per top level group or component instance, in document order,
+  // followed by one for the loose geometry. Covers both the face and the
+  // outline meshes built from them.
+  std::vector<bool> visible_groups_;
 };
 
-struct XmlEntitiesInfo;
-struct XmlComponentDefinitionInfo;
+// The outline where the plane normal_ . p == offset_ cuts the faces, as
+// chained polylines. Closed polylines end where they start.
+struct XmlSectionInfo {
+  XmlSectionInfo() : offset_(0.0) {}
+
+  XmlGeomUtils::CVector3d normal_;
+  double offset_;
+  std::vector<XmlCurveInfo> polylines_;
+};
+
+// The entities of the model, a definition or a group, as ranges in the
+// pools of XmlModelInfo. Each kind of entity of one list is contiguous.
+struct XmlEntitiesInfo {
+  XmlEntitiesInfo()
+    : first_instance_(0), num_instances_(0),
+      first_group_(0), num_groups_(0),
+      first_face_(0), num_faces_(0),
+      first_edge_(0), num_edges_(0),
+      first_curve_(0), num_curves_(0) {}
+
+  size_t first_instance_;
+  size_t num_instances_;
+  size_t first_group_;
+  size_t num_groups_;
+  size_t first_face_;
+  size_t num_faces_;
+  size_t first_edge_;
+  size_t num_edges_;
+  size_t first_curve_;
+  size_t num_curves_;
+};
 
+// A node of the group hierarchy. Groups are stored breadth first, so the
+// groups in one list of entities are contiguous and follow their parent.
 struct XmlGroupInfo {
-  XmlGroupInfo();
-  XmlGroupInfo(const XmlGroupInfo&);
-  ~XmlGroupInfo();
-  const XmlGroupInfo& operator = (const XmlGroupInfo&);
-  
-  XmlEntitiesInfo* entities_;
+  XmlGroupInfo()
+    : parent_(-1), layer_name_id_(0), layer_index_(-1), outline_(true),
+      collision_only_(false) {}
+
+  // Index of the group holding this one in XmlModelInfo::groups_, -1 for
+  // groups directly in the model or a component definition
+  int parent_;
+  XmlEntitiesInfo entities_;
   SUTransformation transform_;
+  int layer_name_id_;
+  // Index in the Layers section, -1 if unknown
+  int layer_index_;
+  // Export hints of the group, already combined with those of its parents.
+  // Without outline the faces in it draw no lines, collision only groups
+  // are meant for colliders and draw neither.
+  bool outline_;
+  bool collision_only_;
 };
 
 struct XmlComponentInstanceInfo {
-  std::string definition_name_;
-  std::string layer_name_;
-  std::string material_name_;
+  XmlComponentInstanceInfo()
+    : definition_name_id_(0), layer_name_id_(0), layer_index_(-1),
+      material_name_id_(0), outline_(true), collision_only_(false) {}
+
+  int definition_name_id_;
+  int layer_name_id_;
+  // Index in the Layers section, -1 if unknown
+  int layer_index_;
+  int material_name_id_;
   SUTransformation transform_;
-};
-
-struct XmlEntitiesInfo {
-  std::vector<XmlComponentInstanceInfo> component_instances_;
-  std::vector<XmlGroupInfo> groups_;
-  std::vector<XmlFaceInfo>  faces_;
-  std::vector<XmlEdgeInfo>  edges_;
-  std::vector<XmlCurveInfo> curves_;
+  // Export hints of the instance, as for groups. They apply to the entities
+  // of its definition.
+  bool outline_;
+  bool collision_only_;
 };
 
 struct XmlComponentDefinitionInfo {
-  std::string name_;
+  XmlComponentDefinitionInfo() : name_id_(0) {}
+
+  int name_id_;
   XmlEntitiesInfo entities_;
 };
 
+// The model as read back from a file. Entities of all the definitions and
+// groups share one pool per kind, XmlEntitiesInfo ranges select from them.
+// The pools are sized before reading, so a model holds a handful of
+// allocations however deep its hierarchy. Definitions read from a package
+// store are not counted in advance, their entities may grow the pools.
+// Model infos can be large and are not copied, use Swap to hand one over.
 struct XmlModelInfo {
+  XmlModelInfo() {}
+
+  void Swap(XmlModelInfo& other);
+
+  // Resolves a name id of an entity
+  const std::string& name(int id) const { return names_.Get(id); }
+
   std::vector<XmlLayerInfo> layers_;
   std::vector<XmlMaterialInfo> materials_;
   std::vector<XmlComponentDefinitionInfo> definitions_;
   XmlEntitiesInfo entities_;
+  std::vector<XmlSceneInfo> scenes_;
+  std::vector<XmlVisibilityCellInfo> visibility_cells_;
+  std::vector<XmlSectionInfo> sections_;
+  // One flag per outline segment, in the order the segments are produced by
+  // CXmlWorldGeometry, set for segments another group already draws. Empty
+  // if the file has no such table.
+  std::vector<bool> duplicate_outlines_;
+  // Same for the segments the export hints turned off, see XmlGroupInfo
+  std::vector<bool> hidden_outlines_;
+
+  // Names referenced by entities
+  CXmlStringTable names_;
+
+  // Entity pools
+  std::vector<XmlComponentInstanceInfo> component_instances_;
+  std::vector<XmlGroupInfo> groups_;
+  std::vector<XmlFaceInfo> faces_;
+  std::vector<XmlFaceVertex> vertices_;
+  std::vector<XmlEdgeInfo> edges_;
+  std::vector<XmlCurveInfo> curves_;
+
+ private:
+  XmlModelInfo(const XmlModelInfo&);
+  void operator = (const XmlModelInfo&);
 };
 
 class CXmlFile {
@@ -129,11 +286,21 @@ class CXmlFile {
   CXmlFile();
   ~CXmlFile();
 
+  // The XML document is created once and reused by every file opened
+  // after closing the previous one. Its node pools keep the memory of the
+  // largest file seen, up to the retained limit.
   bool Open(const std::string& filename, bool create_new_file);
   void Close(bool cancelled);
 
+  // Pool memory kept when a file is closed, all node types together. 0
+  // releases it all. See CXmlOptions::retained_pool_bytes.
+  void set_retained_pool_bytes(size_t bytes) { retained_pool_bytes_ = bytes; }
+
   std::string GetTextureDirectory() const;
 
+  // Names the entities passed to the writers refer to
+  CXmlStringTable& names() { return names_; }
+
   // Converts the XML DOM into XmlModelInfo
   bool GetModelInfo(XmlModelInfo& model_info) const;
 
@@ -141,27 +308,48 @@ class CXmlFile {
   void StartLayers();
   void StartGeometry();
   void StartGroup();
+  // Groups without outline or collision only are flagged, see XmlGroupInfo
+  void StartGroup(const std::string& layer_name, int layer_index,
+                  bool outline = true, bool collision_only = false);
   void StartMaterials();
   void StartComponentDefinitions();
   void StartComponentDefinition(const std::string& name);
+  void StartScenes();
+  void StartVisibilityCells();
+  void StartSections();
   void PopParentNode();
 
   void WriteHeader(int major_ver, int minor_ver, int build_no);
   void WriteLayerInfo(const XmlLayerInfo& info);
   void WriteMaterialInfo(const XmlMaterialInfo& info);
   void WriteEdgeInfo(const XmlEdgeInfo& info);
-  void WriteFaceInfo(const XmlFaceInfo& info);
+  void WriteFaceInfo(const XmlFaceInfo& info,
+                     const std::vector<XmlFaceVertex>& vertices);
   void WriteCurveInfo(const XmlCurveInfo& info);
   void WriteComponentInstanceInfo(const XmlComponentInstanceInfo& info);
   void WriteTransformation(const SUTransformation& transform);
+  void WriteSceneInfo(const XmlSceneInfo& info);
+  void WriteVisibilityCellInfo(const XmlVisibilityCellInfo& info);
+  void WriteSectionInfo(const XmlSectionInfo& info);
+  void WriteDuplicateOutlines(const std::vector<bool>& duplicates);
+  void WriteHiddenOutlines(const std::vector<bool>& hidden);
+
+  // Appends the entities in the Geometry of each file, in order, to the
+  // current node and adds the number of faces to num_faces. Sets
+  // has_hidden_outlines if an entity has Outline="0" or CollisionOnly="1",
+  // and leaves it as it is otherwise. Appends nothing and returns false if
+  // a file cannot be read.
+  bool AppendGeometry(const std::vector<std::string>& filenames,
+                      size_t& num_faces, bool& has_hidden_outlines);
 
  private:
   tinyxml2::XMLElement* WriteStartTag(const char* tag);
   void WriteColor(const SUColor &color);
+  void WriteLayerReference(const std::string& name, int index);
 
   bool ReadHeader();
   bool ReadColor(const tinyxml2::XMLNode* parent_node,
-                 const SUColor& color) const;
+                 SUColor& color) const;
 
   bool ReadLayers(const tinyxml2::XMLNode* parent_node,
                   std::vector<XmlLayerInfo>& layer_infos) const;
@@ -173,21 +361,50 @@ class CXmlFile {
                      std::vector<XmlMaterialInfo>& mat_infos) const;
   bool ReadComponentDefinitionInfo(const tinyxml2::XMLNode* parent_node,
                                    bool readEntities,
+                                   XmlModelInfo& model_info,
                                    XmlComponentDefinitionInfo& info) const;
   bool ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
-                      std::vector<XmlComponentDefinitionInfo>& def_infos) const;
+                                XmlModelInfo& model_info) const;
   bool ReadEntities(const tinyxml2::XMLNode* parent_node,
+                    XmlModelInfo& model_info,
                     XmlEntitiesInfo& entities) const;
+  bool ReadEntityList(const tinyxml2::XMLNode* parent_node, int parent,
+                      XmlModelInfo& model_info,
+                      XmlEntitiesInfo& entities,
+                      std::vector<const tinyxml2::XMLNode*>& group_nodes) const;
   bool ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
+                    CXmlStringTable& names,
                     XmlEdgeInfo& info) const;
   bool ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
-                    XmlFaceInfo& info) const;
+                    CXmlStringTable& names,
+                    XmlFaceInfo& info,
+                    std::vector<XmlFaceVertex>& vertices) const;
   bool ReadCurveInfo(const tinyxml2::XMLNode* parent_node,
+                     CXmlStringTable& names,
                      XmlCurveInfo& info) const;
   bool ReadTransformation(const tinyxml2::XMLNode* parent_node,
                           SUTransformation& transform) const;
   bool ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
+                                 CXmlStringTable& names,
                                  XmlComponentInstanceInfo& info) const;
+  bool ReadScenes(const tinyxml2::XMLNode* parent_node,
+                  std::vector<XmlSceneInfo>& scene_infos) const;
+  bool ReadSceneInfo(const tinyxml2::XMLNode* parent_node,
+                     XmlSceneInfo& info) const;
+  bool ReadVisibilityCells(const tinyxml2::XMLNode* parent_node,
+                      std::vector<XmlVisibilityCellInfo>& cell_infos) const;
+  bool ReadVisibilityCellInfo(const tinyxml2::XMLNode* parent_node,
+                              XmlVisibilityCellInfo& info) const;
+  void WriteOutlineFlags(const std::string& tag,
+                         const std::vector<bool>& flags);
+  bool ReadOutlineFlags(const tinyxml2::XMLNode* parent_node,
+                        std::vector<bool>& flags) const;
+  bool ReadSections(const tinyxml2::XMLNode* parent_node,
+                    CXmlStringTable& names,
+                    std::vector<XmlSectionInfo>& section_infos) const;
+  bool ReadSectionInfo(const tinyxml2::XMLNode* parent_node,
+                       CXmlStringTable& names,
+                       XmlSectionInfo& info) const;
 
  private:
   // Let TinyXML do the xml handling
@@ -197,6 +414,11 @@ class CXmlFile {
   // The path to the file to which we are writing
   std::string filename_;
   bool create_new_file_;
+  bool is_open_;
+  size_t retained_pool_bytes_;
+
+  // Resolves the name ids of written entities
+  CXmlStringTable names_;
 };
 
 #endif // SKPTOXML_COMMON_XMLFILE_H
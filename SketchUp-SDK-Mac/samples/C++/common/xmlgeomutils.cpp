@@ -1,5 +1,7 @@
 // Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
 
+#include <math.h>
+
 #include "./xmlgeomutils.h"
 
 
@@ -106,4 +108,75 @@ bool CVector3d::operator!=(const CVector3d& v) const {
   return !operator==(v);
 }
 
+double CVector3d::Dot(const CVector3d& v) const {
+  return x_ * v.x_ + y_ * v.y_ + z_ * v.z_;
+}
+
+CVector3d CVector3d::Cross(const CVector3d& v) const {
+  return CVector3d(y_ * v.z_ - z_ * v.y_,
+                   z_ * v.x_ - x_ * v.z_,
+                   x_ * v.y_ - y_ * v.x_);
+}
+
+double CVector3d::LengthSquared() const {
+  return Dot(*this);
+}
+
+double CVector3d::Length() const {
+  return sqrt(LengthSquared());
+}
+
+bool CVector3d::Normalize() {
+  double length = Length();
+  if (length <= 0.0)
+    return false;
+  operator/=(length);
+  return true;
+}
+
+// Transformation helpers------------------------------
+// SUTransformation values are column-major: values[col * 4 + row]
+
+SUTransformation IdentityTransform() {
+  SUTransformation transform;
+  for (int i = 0; i < 16; ++i) {
+    transform.values[i] = (i % 5 == 0) ? 1.0 : 0.0;
+  }
+  return transform;
+}
+
+SUTransformation MultiplyTransforms(const SUTransformation& a,
+                                    const SUTransformation& b) {
+  SUTransformation result;
+  for (int col = 0; col < 4; ++col) {
+    for (int row = 0; row < 4; ++row) {
+      double sum = 0.0;
+      for (int k = 0; k < 4; ++k) {
+        sum += a.values[k * 4 + row] * b.values[col * 4 + k];
+      }
+      result.values[col * 4 + row] = sum;
+    }
+  }
+  return result;
+}
+
+CPoint3d TransformPoint(const SUTransformation& t, const CPoint3d& pt) {
+  const double* m = t.values;
+  double x = m[0] * pt.x() + m[4] * pt.y() + m[8] * pt.z() + m[12];
+  double y = m[1] * pt.x() + m[5] * pt.y() + m[9] * pt.z() + m[13];
+  double z = m[2] * pt.x() + m[6] * pt.y() + m[10] * pt.z() + m[14];
+  double w = m[3] * pt.x() + m[7] * pt.y() + m[11] * pt.z() + m[15];
+  if (w != 0.0 && w != 1.0) {
+    return CPoint3d(x / w, y / w, z / w);
+  }
+  return CPoint3d(x, y, z);
+}
+
+CVector3d TransformVector(const SUTransformation& t, const CVector3d& vec) {
+  const double* m = t.values;
+  return CVector3d(m[0] * vec.x() + m[4] * vec.y() + m[8] * vec.z(),
+                   m[1] * vec.x() + m[5] * vec.y() + m[9] * vec.z(),
+                   m[2] * vec.x() + m[6] * vec.y() + m[10] * vec.z());
+}
+
 } // end namespace XmlGeomUtils
@@ -4,6 +4,7 @@
 #define SKPTOXML_COMMON_XMLGEOMUTILS_H
 
 #include <slapi/geometry.h>
+#include <slapi/transformation.h>
 
 // This module defines geometric classes that are useful in processing
 // the objects coming from SketchUp.
@@ -16,6 +17,7 @@ class CVector3d {
 
   CVector3d(): x_(0.0), y_(0.0), z_(0.0) {}
   CVector3d(double x, double y, double z): x_(x), y_(y), z_(z) {}
+  CVector3d(SUVector3D vec) : x_(vec.x), y_(vec.y), z_(vec.z) {}
   ~CVector3d() {}
 
   void SetDirection(double x, double y, double z){x_=x; y_=y; z_=z;}
@@ -41,6 +43,13 @@ class CVector3d {
   bool operator==(const CVector3d& vec) const;
   bool operator!=(const CVector3d& vec) const;
 
+  double Dot(const CVector3d& vec) const;
+  CVector3d Cross(const CVector3d& vec) const;
+  double Length() const;
+  double LengthSquared() const;
+  // Scales the vector to unit length. Returns false for a zero vector.
+  bool Normalize();
+
  protected:
   double x_;
   double y_;
@@ -93,6 +102,22 @@ class CPoint3d {
   double z_;
 };
 
+// Transformation helpers------------------------------
+
+// Returns the identity transformation
+SUTransformation IdentityTransform();
+
+// Returns a * b, i.e. the transformation applying b first and then a
+SUTransformation MultiplyTransforms(const SUTransformation& a,
+                                    const SUTransformation& b);
+
+// Applies the transformation to a point, including translation
+CPoint3d TransformPoint(const SUTransformation& transform, const CPoint3d& pt);
+
+// Applies the rotation/scale part of the transformation to a vector
+CVector3d TransformVector(const SUTransformation& transform,
+                          const CVector3d& vec);
+
 } // end namespace XmlGeomUtils
 
 #endif // SKPTOXML_COMMON_XMLGEOMUTILS_H
@@ -0,0 +1,710 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "./xmlglbwriter.h"
+
+using namespace XmlGeomUtils;
+
+// Guards against component definitions that (indirectly) contain themselves
+static const int kMaxNestingDepth = 64;
+// glTF units are meters
+static const double kMetersPerInch = 0.0254;
+
+static const unsigned int kGlbMagic = 0x46546C67;  // "glTF"
+static const unsigned int kGlbVersion = 2;
+static const unsigned int kJsonChunk = 0x4E4F534A;  // "JSON"
+static const unsigned int kBinChunk = 0x004E4942;   // "BIN"
+
+static const int kModeLines = 1;
+static const int kModeTriangles = 4;
+static const int kFloat = 5126;
+static const int kUnsignedInt = 5125;
+static const int kArrayBuffer = 34962;
+static const int kElementArrayBuffer = 34963;
+
+namespace {
+
+// Newell's method, robust for concave and slightly non-planar loops
+CVector3d LoopNormal(const CPoint3d* points, size_t count) {
+  CVector3d normal;
+  for (size_t i = 0; i < count; ++i) {
+    const CPoint3d& a = points[i];
+    const CPoint3d& b = points[(i + 1) % count];
+    normal += CVector3d((a.y() - b.y()) * (a.z() + b.z()),
+                        (a.z() - b.z()) * (a.x() + b.x()),
+                        (a.x() - b.x()) * (a.y() + b.y()));
+  }
+  normal.Normalize();
+  return normal;
+}
+
+// glTF colors are linear, SketchUp's are sRGB
+double SrgbToLinear(unsigned char value) {
+  double c = value / 255.0;
+  return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+void GetColor(const XmlMaterialInfo& info, double color[4]) {
+  if (info.has_color_) {
+    color[0] = SrgbToLinear(info.color_.red);
+    color[1] = SrgbToLinear(info.color_.green);
+    color[2] = SrgbToLinear(info.color_.blue);
+  } else {
+    color[0] = color[1] = color[2] = 1.0;
+  }
+  color[3] = info.has_alpha_ ? info.alpha_ : 1.0;
+}
+
+// Returns false for the identity, which nodes leave out
+bool GetNodeMatrix(const SUTransformation& transform, double matrix[16]) {
+  // Both are column-major, the translation in 12 to 14
+  double w = transform.values[15];
+  if (w == 0.0)
+    w = 1.0;
+  bool identity = true;
+  for (int i = 0; i < 16; ++i) {
+    matrix[i] = transform.values[i] / w;
+    identity &= matrix[i] == ((i % 5 == 0) ? 1.0 : 0.0);
+  }
+  return !identity;
+}
+
+void AppendNumber(std::string& json, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  json.append(buffer);
+}
+
+void AppendSize(std::string& json, size_t value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%lu", static_cast<unsigned long>(value));
+  json.append(buffer);
+}
+
+void AppendString(std::string& json, const std::string& value) {
+  json.push_back('"');
+  for (size_t i = 0; i < value.size(); ++i) {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\') {
+      json.push_back('\\');
+      json.push_back(c);
+    } else if (c < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      json.append(buffer);
+    } else {
+      json.push_back(c);
+    }
+  }
+  json.push_back('"');
+}
+
+void AppendVector(std::string& json, const double* values, size_t count) {
+  json.push_back('[');
+  for (size_t i = 0; i < count; ++i) {
+    if (i > 0)
+      json.push_back(',');
+    AppendNumber(json, values[i]);
+  }
+  json.push_back(']');
+}
+
+// An accessor of count elements at offset bytes in view
+void AppendAccessor(std::string& json, size_t view, size_t offset,
+                    int component_type, size_t count, const char* type) {
+  if (json.size() > 1)
+    json.push_back(',');
+  json.append("{\"bufferView\":");
+  AppendSize(json, view);
+  json.append(",\"byteOffset\":");
+  AppendSize(json, offset);
+  json.append(",\"componentType\":");
+  AppendSize(json, component_type);
+  json.append(",\"count\":");
+  AppendSize(json, count);
+  json.append(",\"type\":\"");
+  json.append(type);
+  json.push_back('"');
+}
+
+// Positions need their bounds
+void AppendPositionAccessor(std::string& json, size_t view,
+                            const std::vector<float>& positions,
+                            size_t first, size_t count) {
+  AppendAccessor(json, view, first * 3 * sizeof(float), kFloat, count,
+                 "VEC3");
+  double min[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+  double max[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+  for (size_t i = first * 3; i < (first + count) * 3; ++i) {
+    min[i % 3] = std::min(min[i % 3], static_cast<double>(positions[i]));
+    max[i % 3] = std::max(max[i % 3], static_cast<double>(positions[i]));
+  }
+  json.append(",\"min\":");
+  AppendVector(json, min, 3);
+  json.append(",\"max\":");
+  AppendVector(json, max, 3);
+  json.push_back('}');
+}
+
+void AppendBufferView(std::string& json, size_t offset, size_t length,
+                      size_t stride, int target) {
+  if (json.size() > 1)
+    json.push_back(',');
+  json.append("{\"buffer\":0,\"byteOffset\":");
+  AppendSize(json, offset);
+  json.append(",\"byteLength\":");
+  AppendSize(json, length);
+  if (stride > 0) {
+    json.append(",\"byteStride\":");
+    AppendSize(json, stride);
+  }
+  json.append(",\"target\":");
+  AppendSize(json, target);
+  json.push_back('}');
+}
+
+bool WriteUint32(FILE* file, unsigned int value) {
+  // GLB is little endian whatever the host
+  unsigned char bytes[4] = {
+    static_cast<unsigned char>(value & 0xFF),
+    static_cast<unsigned char>((value >> 8) & 0xFF),
+    static_cast<unsigned char>((value >> 16) & 0xFF),
+    static_cast<unsigned char>((value >> 24) & 0xFF) };
+  return fwrite(bytes, 1, 4, file) == 4;
+}
+
+template <typename T>
+bool WriteArray(FILE* file, const std::vector<T>& values) {
+  return values.empty() ||
+         fwrite(&values[0], sizeof(T), values.size(), file) == values.size();
+}
+
+} // end anonymous namespace
+
+CXmlGlbWriter::CXmlGlbWriter(const XmlModelInfo& model_info)
+  : model_info_(model_info),
+    optimize_vertex_cache_(false),
+    line_material_(-1) {
+}
+
+void CXmlGlbWriter::Clear() {
+  nodes_.clear();
+  meshes_.clear();
+  materials_.clear();
+  mesh_indices_.clear();
+  material_indices_.clear();
+  definition_indices_.clear();
+  line_material_ = -1;
+  positions_.clear();
+  normals_.clear();
+  indices_.clear();
+  vertex_cache_ = XmlVertexCacheInfo();
+}
+
+bool CXmlGlbWriter::Write(const std::string& filename) {
+  Clear();
+  for (size_t i = 0; i < model_info_.definitions_.size(); ++i) {
+    definition_indices_.insert(
+        std::make_pair(model_info_.definitions_[i].name_id_, i));
+  }
+
+  // The model is the root node, scaled to meters with Y up
+  AddNode(model_info_.entities_, NULL, "SketchUp", 0);
+  CNode& root = nodes_[0];
+  root.has_matrix_ = true;
+  std::fill(root.matrix_, root.matrix_ + 16, 0.0);
+  root.matrix_[0] = kMetersPerInch;
+  root.matrix_[6] = -kMetersPerInch;
+  root.matrix_[9] = kMetersPerInch;
+  root.matrix_[15] = 1.0;
+
+  std::string json;
+  WriteJson(json);
+  while (json.size() % 4 != 0)
+    json.push_back(' ');
+  size_t bin_length = (positions_.size() + normals_.size()) * sizeof(float) +
+                      indices_.size() * sizeof(unsigned int);
+  size_t total_length = 12 + 8 + json.size();
+  if (bin_length > 0)
+    total_length += 8 + bin_length;
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+  bool ok = WriteUint32(file, kGlbMagic) &&
+            WriteUint32(file, kGlbVersion) &&
+            WriteUint32(file, static_cast<unsigned int>(total_length)) &&
+            WriteUint32(file, static_cast<unsigned int>(json.size())) &&
+            WriteUint32(file, kJsonChunk) &&
+            fwrite(json.data(), 1, json.size(), file) == json.size();
+  // The views are written as they are, the hosts we build for are little
+  // endian like GLB.
+  if (ok && bin_length > 0) {
+    ok = WriteUint32(file, static_cast<unsigned int>(bin_length)) &&
+         WriteUint32(file, kBinChunk) &&
+         WriteArray(file, positions_) &&
+         WriteArray(file, normals_) &&
+         WriteArray(file, indices_);
+  }
+  ok &= fclose(file) == 0;
+  return ok;
+}
+
+size_t CXmlGlbWriter::AddNode(const XmlEntitiesInfo& entities,
+                              const SUTransformation* transform,
+                              const std::string& name, int depth) {
+  size_t index = nodes_.size();
+  nodes_.push_back(CNode());
+  nodes_[index].name_ = name;
+  if (transform != NULL)
+    nodes_[index].has_matrix_ = GetNodeMatrix(*transform,
+                                              nodes_[index].matrix_);
+  nodes_[index].mesh_ = GetMesh(entities);
+  if (depth >= kMaxNestingDepth)
+    return index;
+
+  // Definitions are only present if the exporter wrote them
+  for (size_t i = 0; i < entities.num_instances_; ++i) {
+    const XmlComponentInstanceInfo& instance =
+        model_info_.component_instances_[entities.first_instance_ + i];
+    std::map<int, size_t>::const_iterator it =
+        definition_indices_.find(instance.definition_name_id_);
+    if (it == definition_indices_.end())
+      continue;
+    size_t child = AddNode(model_info_.definitions_[it->second].entities_,
+                           &instance.transform_,
+                           model_info_.name(instance.definition_name_id_),
+                           depth + 1);
+    nodes_[index].children_.push_back(child);
+  }
+
+  for (size_t i = 0; i < entities.num_groups_; ++i) {
+    const XmlGroupInfo& group = model_info_.groups_[entities.first_group_ + i];
+    size_t child = AddNode(group.entities_, &group.transform_, "", depth + 1);
+    nodes_[index].children_.push_back(child);
+  }
+  return index;
+}
+
+int CXmlGlbWriter::GetMesh(const XmlEntitiesInfo& entities) {
+  std::map<const XmlEntitiesInfo*, int>::const_iterator it =
+      mesh_indices_.find(&entities);
+  if (it != mesh_indices_.end())
+    return it->second;
+
+  CMesh mesh;
+  mesh.first_vertex_ = positions_.size() / 3;
+  mesh.first_normal_ = normals_.size() / 3;
+  std::map<int, std::vector<unsigned int> > triangles;
+  std::vector<CPoint3d> line_points;
+  std::vector<unsigned int> lines;
+  AddFaces(entities, mesh, triangles);
+  mesh.num_vertices_ = positions_.size() / 3 - mesh.first_vertex_;
+  if (optimize_vertex_cache_)
+    OptimizeVertexCache(mesh, triangles);
+
+  // Face outlines, then the loose edges and curves
+  for (size_t i = 0; i < entities.num_faces_; ++i) {
+    const XmlFaceInfo& face = model_info_.faces_[entities.first_face_ + i];
+    size_t count = face.num_vertices_;
+    if (!face.has_single_loop_ || count < 2)
+      continue;
+    size_t base = line_points.size();
+    for (size_t k = 0; k < count; ++k) {
+      line_points.push_back(
+          model_info_.vertices_[face.first_vertex_ + k].vertex_);
+      lines.push_back(static_cast<unsigned int>(base + k));
+      lines.push_back(static_cast<unsigned int>(base + (k + 1) % count));
+    }
+  }
+  for (size_t i = 0; i < entities.num_edges_; ++i) {
+    const XmlEdgeInfo& edge = model_info_.edges_[entities.first_edge_ + i];
+    lines.push_back(static_cast<unsigned int>(line_points.size()));
+    line_points.push_back(edge.start_);
+    lines.push_back(static_cast<unsigned int>(line_points.size()));
+    line_points.push_back(edge.end_);
+  }
+  for (size_t i = 0; i < entities.num_curves_; ++i) {
+    const std::vector<XmlEdgeInfo>& edges =
+        model_info_.curves_[entities.first_curve_ + i].edges_;
+    for (size_t j = 0; j < edges.size(); ++j) {
+      lines.push_back(static_cast<unsigned int>(line_points.size()));
+      line_points.push_back(edges[j].start_);
+      lines.push_back(static_cast<unsigned int>(line_points.size()));
+      line_points.push_back(edges[j].end_);
+    }
+  }
+  for (size_t i = 0; i < line_points.size(); ++i) {
+    AddPosition(line_points[i]);
+  }
+  mesh.num_line_vertices_ = line_points.size();
+
+  for (std::map<int, std::vector<unsigned int> >::const_iterator it =
+       triangles.begin(); it != triangles.end(); ++it) {
+    CPrimitive primitive;
+    primitive.material_ = it->first;
+    primitive.first_index_ = indices_.size();
+    primitive.num_indices_ = it->second.size();
+    indices_.insert(indices_.end(), it->second.begin(), it->second.end());
+    mesh.triangles_.push_back(primitive);
+  }
+  mesh.lines_.first_index_ = indices_.size();
+  mesh.lines_.num_indices_ = lines.size();
+  mesh.lines_.material_ = -1;
+  if (!lines.empty()) {
+    if (line_material_ < 0) {
+      double black[4] = { 0.0, 0.0, 0.0, 1.0 };
+      line_material_ = AddMaterial("", "Edges", black, true);
+    }
+    mesh.lines_.material_ = line_material_;
+    indices_.insert(indices_.end(), lines.begin(), lines.end());
+  }
+
+  int index = -1;
+  if (!mesh.triangles_.empty() || !lines.empty()) {
+    index = static_cast<int>(meshes_.size());
+    meshes_.push_back(mesh);
+  }
+  mesh_indices_[&entities] = index;
+  return index;
+}
+
+void CXmlGlbWriter::AddFaces(
+    const XmlEntitiesInfo& entities, CMesh& mesh,
+    std::map<int, std::vector<unsigned int> >& triangles) {
+  // Vertices are not shared between faces, each face has its own normal
+  for (size_t i = 0; i < entities.num_faces_; ++i) {
+    const XmlFaceInfo& face = model_info_.faces_[entities.first_face_ + i];
+    if (face.num_vertices_ == 0)
+      continue;
+    const XmlFaceVertex* vertices = &model_info_.vertices_[0] +
+                                    face.first_vertex_;
+
+    if (!face.has_single_loop_) {
+      // Already triangles, 3 vertices each
+      std::vector<unsigned int>& target = triangles[GetFaceMaterial(face)];
+      for (size_t t = 0; t + 2 < face.num_vertices_; t += 3) {
+        CVector3d normal = (vertices[t + 1].vertex_ - vertices[t].vertex_).Cross(
+            vertices[t + 2].vertex_ - vertices[t].vertex_);
+        if (normal.LengthSquared() <= 0.0)
+          continue;
+        normal.Normalize();
+        for (size_t k = 0; k < 3; ++k) {
+          target.push_back(static_cast<unsigned int>(
+              positions_.size() / 3 - mesh.first_vertex_));
+          AddPosition(vertices[t + k].vertex_);
+          normals_.push_back(static_cast<float>(normal.x()));
+          normals_.push_back(static_cast<float>(normal.y()));
+          normals_.push_back(static_cast<float>(normal.z()));
+        }
+      }
+      continue;
+    }
+
+    // Holes are taken with the face written just before them
+    if (face.is_inner_loop_ || face.num_vertices_ < 3)
+      continue;
+    loop_points_.clear();
+    loop_sizes_.clear();
+    for (size_t j = i; j < entities.num_faces_; ++j) {
+      const XmlFaceInfo& loop = model_info_.faces_[entities.first_face_ + j];
+      if (j > i && (!loop.is_inner_loop_ || !loop.has_single_loop_))
+        break;
+      for (size_t k = 0; k < loop.num_vertices_; ++k) {
+        loop_points_.push_back(
+            model_info_.vertices_[loop.first_vertex_ + k].vertex_);
+      }
+      loop_sizes_.push_back(loop.num_vertices_);
+    }
+
+    loop_triangles_.clear();
+    triangulator_.Triangulate(&loop_points_[0], &loop_sizes_[0],
+                              loop_sizes_.size(), loop_triangles_);
+    if (loop_triangles_.empty())
+      continue;
+
+    CVector3d normal = LoopNormal(&loop_points_[0], loop_sizes_[0]);
+    size_t base = positions_.size() / 3 - mesh.first_vertex_;
+    for (size_t k = 0; k < loop_points_.size(); ++k) {
+      AddPosition(loop_points_[k]);
+      normals_.push_back(static_cast<float>(normal.x()));
+      normals_.push_back(static_cast<float>(normal.y()));
+      normals_.push_back(static_cast<float>(normal.z()));
+    }
+    std::vector<unsigned int>& target = triangles[GetFaceMaterial(face)];
+    for (size_t k = 0; k < loop_triangles_.size(); ++k) {
+      target.push_back(static_cast<unsigned int>(base + loop_triangles_[k]));
+    }
+  }
+}
+
+void CXmlGlbWriter::OptimizeVertexCache(
+    const CMesh& mesh, std::map<int, std::vector<unsigned int> >& triangles) {
+  if (mesh.num_vertices_ == 0)
+    return;
+
+  // The primitives in the order they are written share the vertices
+  std::vector<unsigned int> all_triangles;
+  for (std::map<int, std::vector<unsigned int> >::iterator it =
+       triangles.begin(); it != triangles.end(); ++it) {
+    CXmlVertexCacheOptimizer::OptimizeInChunks(it->second, true,
+                                               vertex_cache_);
+    all_triangles.insert(all_triangles.end(), it->second.begin(),
+                         it->second.end());
+  }
+
+  std::vector<unsigned int> remap;
+  CXmlVertexCacheOptimizer::GetFirstUseOrder(all_triangles,
+                                             mesh.num_vertices_, remap);
+  for (std::map<int, std::vector<unsigned int> >::iterator it =
+       triangles.begin(); it != triangles.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      it->second[i] = remap[it->second[i]];
+    }
+  }
+  float* positions = &positions_[3 * mesh.first_vertex_];
+  float* normals = &normals_[3 * mesh.first_normal_];
+  std::vector<float> old_positions(positions,
+                                   positions + 3 * mesh.num_vertices_);
+  std::vector<float> old_normals(normals, normals + 3 * mesh.num_vertices_);
+  for (size_t v = 0; v < mesh.num_vertices_; ++v) {
+    for (size_t k = 0; k < 3; ++k) {
+      positions[3 * remap[v] + k] = old_positions[3 * v + k];
+      normals[3 * remap[v] + k] = old_normals[3 * v + k];
+    }
+  }
+}
+
+void CXmlGlbWriter::AddPosition(const CPoint3d& point) {
+  positions_.push_back(static_cast<float>(point.x()));
+  positions_.push_back(static_cast<float>(point.y()));
+  positions_.push_back(static_cast<float>(point.z()));
+}
+
+int CXmlGlbWriter::GetFaceMaterial(const XmlFaceInfo& face) {
+  // The front material, else the layer's, as the importer does
+  if (face.front_mat_name_id_ != 0) {
+    const std::string& name = model_info_.name(face.front_mat_name_id_);
+    std::string key = "material:" + name;
+    std::map<std::string, int>::const_iterator it =
+        material_indices_.find(key);
+    if (it != material_indices_.end())
+      return it->second;
+    for (size_t i = 0; i < model_info_.materials_.size(); ++i) {
+      if (model_info_.materials_[i].name_ == name) {
+        double color[4];
+        GetColor(model_info_.materials_[i], color);
+        return AddMaterial(key, name, color, false);
+      }
+    }
+  }
+
+  if (face.layer_index_ >= 0 &&
+      face.layer_index_ < static_cast<int>(model_info_.layers_.size())) {
+    const XmlLayerInfo& layer = model_info_.layers_[face.layer_index_];
+    if (layer.has_material_info_) {
+      std::string key = "layer:" + layer.name_;
+      std::map<std::string, int>::const_iterator it =
+          material_indices_.find(key);
+      if (it != material_indices_.end())
+        return it->second;
+      double color[4];
+      GetColor(layer.material_info_, color);
+      return AddMaterial(key, layer.name_, color, false);
+    }
+  }
+
+  double white[4] = { 1.0, 1.0, 1.0, 1.0 };
+  return AddMaterial("default", "Default", white, false);
+}
+
+int CXmlGlbWriter::AddMaterial(const std::string& key,
+                               const std::string& name,
+                               const double color[4], bool unlit) {
+  std::map<std::string, int>::const_iterator it = material_indices_.find(key);
+  if (it != material_indices_.end())
+    return it->second;
+  CMaterial material;
+  material.name_ = name;
+  std::copy(color, color + 4, material.color_);
+  material.unlit_ = unlit;
+  int index = static_cast<int>(materials_.size());
+  materials_.push_back(material);
+  material_indices_[key] = index;
+  return index;
+}
+
+void CXmlGlbWriter::WriteJson(std::string& json) const {
+  // Views in the order of the binary chunk, left out when empty
+  std::string views = "[";
+  size_t offset = 0;
+  size_t num_views = 0;
+  size_t position_view = 0, normal_view = 0, index_view = 0;
+  if (!positions_.empty()) {
+    position_view = num_views++;
+    AppendBufferView(views, offset, positions_.size() * sizeof(float),
+                     3 * sizeof(float), kArrayBuffer);
+    offset += positions_.size() * sizeof(float);
+  }
+  if (!normals_.empty()) {
+    normal_view = num_views++;
+    AppendBufferView(views, offset, normals_.size() * sizeof(float),
+                     3 * sizeof(float), kArrayBuffer);
+    offset += normals_.size() * sizeof(float);
+  }
+  if (!indices_.empty()) {
+    index_view = num_views++;
+    AppendBufferView(views, offset, indices_.size() * sizeof(unsigned int),
+                     0, kElementArrayBuffer);
+    offset += indices_.size() * sizeof(unsigned int);
+  }
+  views.push_back(']');
+
+  std::string accessors = "[";
+  std::string meshes = "[";
+  size_t num_accessors = 0;
+  for (size_t m = 0; m < meshes_.size(); ++m) {
+    const CMesh& mesh = meshes_[m];
+    if (m > 0)
+      meshes.push_back(',');
+    meshes.append("{\"primitives\":[");
+
+    if (!mesh.triangles_.empty()) {
+      size_t position = num_accessors++;
+      AppendPositionAccessor(accessors, position_view, positions_,
+                             mesh.first_vertex_, mesh.num_vertices_);
+      size_t normal = num_accessors++;
+      AppendAccessor(accessors, normal_view,
+                     mesh.first_normal_ * 3 * sizeof(float), kFloat,
+                     mesh.num_vertices_, "VEC3");
+      accessors.push_back('}');
+      for (size_t p = 0; p < mesh.triangles_.size(); ++p) {
+        const CPrimitive& primitive = mesh.triangles_[p];
+        size_t indices = num_accessors++;
+        AppendAccessor(accessors, index_view,
+                       primitive.first_index_ * sizeof(unsigned int),
+                       kUnsignedInt, primitive.num_indices_, "SCALAR");
+        accessors.push_back('}');
+        if (p > 0)
+          meshes.push_back(',');
+        meshes.append("{\"attributes\":{\"POSITION\":");
+        AppendSize(meshes, position);
+        meshes.append(",\"NORMAL\":");
+        AppendSize(meshes, normal);
+        meshes.append("},\"indices\":");
+        AppendSize(meshes, indices);
+        meshes.append(",\"material\":");
+        AppendSize(meshes, primitive.material_);
+        meshes.append(",\"mode\":");
+        AppendSize(meshes, kModeTriangles);
+        meshes.push_back('}');
+      }
+    }
+
+    if (mesh.lines_.num_indices_ > 0) {
+      size_t position = num_accessors++;
+      AppendPositionAccessor(accessors, position_view, positions_,
+                             mesh.first_vertex_ + mesh.num_vertices_,
+                             mesh.num_line_vertices_);
+      size_t indices = num_accessors++;
+      AppendAccessor(accessors, index_view,
+                     mesh.lines_.first_index_ * sizeof(unsigned int),
+                     kUnsignedInt, mesh.lines_.num_indices_, "SCALAR");
+      accessors.push_back('}');
+      if (!mesh.triangles_.empty())
+        meshes.push_back(',');
+      meshes.append("{\"attributes\":{\"POSITION\":");
+      AppendSize(meshes, position);
+      meshes.append("},\"indices\":");
+      AppendSize(meshes, indices);
+      meshes.append(",\"material\":");
+      AppendSize(meshes, mesh.lines_.material_);
+      meshes.append(",\"mode\":");
+      AppendSize(meshes, kModeLines);
+      meshes.push_back('}');
+    }
+    meshes.append("]}");
+  }
+  accessors.push_back(']');
+  meshes.push_back(']');
+
+  bool unlit = false;
+  std::string materials = "[";
+  for (size_t i = 0; i < materials_.size(); ++i) {
+    const CMaterial& material = materials_[i];
+    if (i > 0)
+      materials.push_back(',');
+    materials.append("{\"name\":");
+    AppendString(materials, material.name_);
+    materials.append(",\"pbrMetallicRoughness\":{\"baseColorFactor\":");
+    AppendVector(materials, material.color_, 4);
+    materials.append(",\"metallicFactor\":0,\"roughnessFactor\":1}");
+    if (material.color_[3] < 1.0)
+      materials.append(",\"alphaMode\":\"BLEND\"");
+    materials.append(",\"doubleSided\":true");
+    if (material.unlit_) {
+      materials.append(",\"extensions\":{\"KHR_materials_unlit\":{}}");
+      unlit = true;
+    }
+    materials.push_back('}');
+  }
+  materials.push_back(']');
+
+  std::string nodes = "[";
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const CNode& node = nodes_[i];
+    if (i > 0)
+      nodes.push_back(',');
+    nodes.push_back('{');
+    nodes.append("\"name\":");
+    AppendString(nodes, node.name_);
+    if (node.has_matrix_) {
+      nodes.append(",\"matrix\":");
+      AppendVector(nodes, node.matrix_, 16);
+    }
+    if (node.mesh_ >= 0) {
+      nodes.append(",\"mesh\":");
+      AppendSize(nodes, node.mesh_);
+    }
+    if (!node.children_.empty()) {
+      nodes.append(",\"children\":[");
+      for (size_t c = 0; c < node.children_.size(); ++c) {
+        if (c > 0)
+          nodes.push_back(',');
+        AppendSize(nodes, node.children_[c]);
+      }
+      nodes.push_back(']');
+    }
+    nodes.push_back('}');
+  }
+  nodes.push_back(']');
+
+  json = "{\"asset\":{\"version\":\"2.0\",";
+  json.append("\"generator\":\"SketchUp XML Exporter\"}");
+  if (unlit) {
+    json.append(",\"extensionsUsed\":[\"KHR_materials_unlit\"]");
+  }
+  json.append(",\"scene\":0,\"scenes\":[{\"nodes\":[0]}]");
+  json.append(",\"nodes\":");
+  json.append(nodes);
+  if (!meshes_.empty()) {
+    json.append(",\"meshes\":");
+    json.append(meshes);
+    json.append(",\"accessors\":");
+    json.append(accessors);
+    json.append(",\"bufferViews\":");
+    json.append(views);
+    json.append(",\"buffers\":[{\"byteLength\":");
+    AppendSize(json, offset);
+    json.append("}]");
+  }
+  if (!materials_.empty()) {
+    json.append(",\"materials\":");
+    json.append(materials);
+  }
+  json.push_back('}');
+}
@@ -0,0 +1,119 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLGLBWRITER_H
+#define SKPTOXML_COMMON_XMLGLBWRITER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "./xmlfile.h"
+#include "./xmltriangulator.h"
+#include "./xmlvertexcache.h"
+
+// CXmlGlbWriter - Writes an XmlModelInfo as binary glTF 2.0 for viewers
+// outside Unity. Groups and component instances become nodes carrying their
+// transformation, and each list of entities becomes one mesh: a triangles
+// primitive per material, faces cut by CXmlTriangulator, and a lines
+// primitive for the face outlines and loose edges. A definition is meshed
+// once and shared by the nodes of all its instances. The vertex and index
+// data fills one binary chunk as three tightly packed views (positions,
+// normals and indices) that can be uploaded as they are. A root node turns
+// SketchUp's inches and Z up into glTF's meters and Y up. With
+// set_optimize_vertex_cache the triangles of each primitive are reordered
+// for the GPU's vertex cache and each mesh's face vertices renumbered in the
+// order they are first used.
+class CXmlGlbWriter {
+ public:
+  explicit CXmlGlbWriter(const XmlModelInfo& model_info);
+
+  // Returns false if the file could not be written
+  bool Write(const std::string& filename);
+
+  // Reorder triangles and vertices of the meshes written
+  void set_optimize_vertex_cache(bool optimize) {
+    optimize_vertex_cache_ = optimize;
+  }
+
+  // Number of meshes in the last file written
+  size_t num_meshes() const { return meshes_.size(); }
+  // Cache misses of the triangles in the last file written
+  const XmlVertexCacheInfo& vertex_cache() const { return vertex_cache_; }
+
+ private:
+  struct CPrimitive {
+    int material_;
+    size_t first_index_;
+    size_t num_indices_;
+  };
+
+  // Triangle vertices have a position and a normal, line vertices a
+  // position only and follow them in positions_.
+  struct CMesh {
+    size_t first_vertex_;
+    size_t first_normal_;
+    size_t num_vertices_;
+    size_t num_line_vertices_;
+    std::vector<CPrimitive> triangles_;
+    CPrimitive lines_;
+  };
+
+  struct CNode {
+    CNode() : has_matrix_(false), mesh_(-1) {}
+
+    std::string name_;
+    bool has_matrix_;
+    double matrix_[16];
+    int mesh_;
+    std::vector<size_t> children_;
+  };
+
+  struct CMaterial {
+    std::string name_;
+    double color_[4];
+    bool unlit_;
+  };
+
+  void Clear();
+  size_t AddNode(const XmlEntitiesInfo& entities,
+                 const SUTransformation* transform,
+                 const std::string& name, int depth);
+  int GetMesh(const XmlEntitiesInfo& entities);
+  void AddFaces(const XmlEntitiesInfo& entities, CMesh& mesh,
+                std::map<int, std::vector<unsigned int> >& triangles);
+  void OptimizeVertexCache(
+      const CMesh& mesh,
+      std::map<int, std::vector<unsigned int> >& triangles);
+  void AddPosition(const XmlGeomUtils::CPoint3d& point);
+  int GetFaceMaterial(const XmlFaceInfo& face);
+  int AddMaterial(const std::string& key, const std::string& name,
+                  const double color[4], bool unlit);
+
+  void WriteJson(std::string& json) const;
+
+ private:
+  const XmlModelInfo& model_info_;
+  CXmlTriangulator triangulator_;
+  bool optimize_vertex_cache_;
+  XmlVertexCacheInfo vertex_cache_;
+
+  std::vector<CNode> nodes_;
+  std::vector<CMesh> meshes_;
+  std::vector<CMaterial> materials_;
+  std::map<const XmlEntitiesInfo*, int> mesh_indices_;
+  std::map<std::string, int> material_indices_;
+  std::map<int, size_t> definition_indices_;
+  int line_material_;
+
+  // Contents of the binary chunk
+  std::vector<float> positions_;
+  std::vector<float> normals_;
+  std::vector<unsigned int> indices_;
+
+  // Scratch for the faces being cut
+  std::vector<XmlGeomUtils::CPoint3d> loop_points_;
+  std::vector<size_t> loop_sizes_;
+  std::vector<size_t> loop_triangles_;
+};
+
+#endif // SKPTOXML_COMMON_XMLGLBWRITER_H
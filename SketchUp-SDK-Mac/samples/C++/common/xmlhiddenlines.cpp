@@ -0,0 +1,192 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <algorithm>
+
+#include "./xmlhiddenlines.h"
+#include "./xmlthreadutils.h"
+
+using namespace XmlGeomUtils;
+
+static const double kPi = 3.14159265358979323846;
+// Used when the camera follows the viewport aspect ratio. Wide enough to be
+// conservative for common displays.
+static const double kDefaultAspectRatio = 16.0 / 9.0;
+// Widens the view a little so lines at the border are kept
+static const double kFrustumMargin = 1.05;
+// Samples per segment
+static const size_t kMinSamples = 2;
+static const size_t kMaxSamples = 64;
+// Keeps the rays off the faces the segment lies on (inches, relative)
+static const double kAbsoluteBias = 1.0e-2;
+static const double kRelativeBias = 1.0e-5;
+static const size_t kSegmentsPerChunk = 256;
+
+namespace {
+
+// Camera frame and view volume, shared by all the worker threads
+struct CViewFrame {
+  CPoint3d eye_;
+  CVector3d forward_;
+  CVector3d right_;
+  CVector3d up_;
+  bool is_perspective_;
+  // Perspective: tangents of the half angles. Orthographic: half extents.
+  double half_width_;
+  double half_height_;
+  // Distance used to start orthographic rays outside of the model
+  double ortho_distance_;
+  double pixels_per_unit_;
+
+  bool Init(const XmlCameraInfo& camera, const CXmlWorldGeometry& geometry,
+            double viewport_height) {
+    eye_ = camera.eye_;
+    forward_ = camera.target_ - camera.eye_;
+    if (!forward_.Normalize())
+      return false;
+    right_ = forward_.Cross(camera.up_);
+    if (!right_.Normalize())
+      return false;
+    up_ = right_.Cross(forward_);
+
+    double aspect = camera.aspect_ratio_ > 0.0 ?
+                    camera.aspect_ratio_ : kDefaultAspectRatio;
+    is_perspective_ = camera.is_perspective_;
+    if (is_perspective_) {
+      half_height_ = tan(camera.fov_ * 0.5 * kPi / 180.0) * kFrustumMargin;
+      pixels_per_unit_ = viewport_height / (2.0 * half_height_);
+    } else {
+      half_height_ = camera.ortho_height_ * 0.5 * kFrustumMargin;
+      pixels_per_unit_ = half_height_ > 0.0 ?
+                         viewport_height / (2.0 * half_height_) : 0.0;
+    }
+    half_width_ = half_height_ * aspect;
+    ortho_distance_ = 2.0 * (geometry.max() - geometry.min()).Length() +
+                      (eye_ - geometry.min()).Length();
+    return half_height_ > 0.0;
+  }
+
+  bool IsInFront(const CPoint3d& pt) const {
+    return !is_perspective_ || (pt - eye_).Dot(forward_) > 0.0;
+  }
+
+  // Computes the screen position of a point in front of the camera, in
+  // units of the view height. Returns false if it is outside of the view.
+  bool Project(const CPoint3d& pt, double& sx, double& sy) const {
+    CVector3d v = pt - eye_;
+    double depth = v.Dot(forward_);
+    sx = v.Dot(right_);
+    sy = v.Dot(up_);
+    if (is_perspective_) {
+      if (depth <= 0.0)
+        return false;
+      sx /= depth;
+      sy /= depth;
+    }
+    return fabs(sx) <= half_width_ && fabs(sy) <= half_height_;
+  }
+
+  bool IsPointVisible(const CXmlPolygonBvh& bvh, const CPoint3d& pt) const {
+    if (is_perspective_) {
+      CVector3d to_point = pt - eye_;
+      double length = to_point.Length();
+      if (length <= kAbsoluteBias)
+        return true;
+      double bias = (kAbsoluteBias + kRelativeBias * length) / length;
+      return !bvh.IsOccluded(eye_, to_point, 0.0, 1.0 - bias);
+    }
+    CPoint3d origin = pt - forward_ * ortho_distance_;
+    double bias = kAbsoluteBias + kRelativeBias * ortho_distance_;
+    return !bvh.IsOccluded(origin, forward_, 0.0, ortho_distance_ - bias);
+  }
+};
+
+class CVisibilityTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CVisibilityTask(const std::vector<XmlWorldSegment>& segments,
+                  const CXmlPolygonBvh& bvh, const CViewFrame& frame,
+                  double pixels_per_sample, std::vector<char>& visible)
+    : segments_(segments), bvh_(bvh), frame_(frame),
+      pixels_per_sample_(pixels_per_sample), visible_(visible) {}
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      visible_[i] = IsSegmentVisible(segments_[i]) ? 1 : 0;
+    }
+  }
+
+ private:
+  size_t NumSamples(const XmlWorldSegment& segment) const {
+    // Endpoints behind a perspective camera give no usable length
+    if (!frame_.IsInFront(segment.start_) || !frame_.IsInFront(segment.end_))
+      return kMaxSamples;
+    double ax = 0.0, ay = 0.0, bx = 0.0, by = 0.0;
+    frame_.Project(segment.start_, ax, ay);
+    frame_.Project(segment.end_, bx, by);
+    double pixels = sqrt((bx - ax) * (bx - ax) + (by - ay) * (by - ay)) *
+                    frame_.pixels_per_unit_;
+    if (!(pixels < kMaxSamples * pixels_per_sample_))
+      return kMaxSamples;
+    size_t samples = static_cast<size_t>(pixels / pixels_per_sample_) + 1;
+    return std::max(kMinSamples, std::min(kMaxSamples, samples));
+  }
+
+  bool IsSegmentVisible(const XmlWorldSegment& segment) const {
+    CVector3d direction = segment.end_ - segment.start_;
+    size_t samples = NumSamples(segment);
+    for (size_t s = 0; s < samples; ++s) {
+      // Samples sit in the middle of equal parts, away from the endpoints
+      // where the segment meets other faces.
+      double t = (s + 0.5) / samples;
+      CPoint3d pt = segment.start_ + direction * t;
+      double sx = 0.0, sy = 0.0;
+      if (frame_.Project(pt, sx, sy) && frame_.IsPointVisible(bvh_, pt))
+        return true;
+    }
+    return false;
+  }
+
+  const std::vector<XmlWorldSegment>& segments_;
+  const CXmlPolygonBvh& bvh_;
+  const CViewFrame& frame_;
+  double pixels_per_sample_;
+  std::vector<char>& visible_;
+};
+
+} // end anonymous namespace
+
+CXmlHiddenLinePass::CXmlHiddenLinePass(const CXmlWorldGeometry& geometry,
+                                       const CXmlPolygonBvh& bvh)
+  : geometry_(geometry),
+    bvh_(bvh),
+    viewport_height_(1080.0),
+    pixels_per_sample_(8.0) {
+}
+
+size_t CXmlHiddenLinePass::Compute(const XmlCameraInfo& camera,
+                                   std::vector<bool>& visible) const {
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  // A camera without a usable view, such as a degenerate one or a zero
+  // ortho height, hides nothing rather than every line of its scene
+  CViewFrame frame;
+  if (!frame.Init(camera, geometry_, viewport_height_)) {
+    visible.assign(segments.size(), true);
+    return segments.size();
+  }
+  visible.assign(segments.size(), false);
+
+  // std::vector<bool> packs bits, so the threads write to bytes
+  std::vector<char> visible_bytes(segments.size(), 0);
+  CVisibilityTask task(segments, bvh_, frame,
+                       std::max(pixels_per_sample_, 1.0), visible_bytes);
+  XmlThreadUtils::RunParallel(task, segments.size(), kSegmentsPerChunk);
+
+  size_t num_visible = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (visible_bytes[i]) {
+      visible[i] = true;
+      ++num_visible;
+    }
+  }
+  return num_visible;
+}
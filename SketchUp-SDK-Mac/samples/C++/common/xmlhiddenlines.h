@@ -0,0 +1,39 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLHIDDENLINES_H
+#define SKPTOXML_COMMON_XMLHIDDENLINES_H
+
+#include <vector>
+
+#include "./xmlfile.h"
+#include "./xmlpolygonbvh.h"
+#include "./xmlworldgeometry.h"
+
+// CXmlHiddenLinePass - Determines which outline segments can be seen from a
+// fixed camera. Each segment is sampled at a density that follows its
+// projected length and a ray is cast from the camera to every sample; the
+// segment is visible if any sample is inside the view and unoccluded.
+// Segments are processed in parallel.
+class CXmlHiddenLinePass {
+ public:
+  CXmlHiddenLinePass(const CXmlWorldGeometry& geometry,
+                     const CXmlPolygonBvh& bvh);
+
+  // Fills visible with one flag per geometry segment and returns the number
+  // of visible segments. All are visible if the camera gives no view.
+  size_t Compute(const XmlCameraInfo& camera,
+                 std::vector<bool>& visible) const;
+
+  // Vertical resolution the sample density is computed for
+  void set_viewport_height(double pixels) { viewport_height_ = pixels; }
+  // Screen space distance between two samples along a segment
+  void set_pixels_per_sample(double pixels) { pixels_per_sample_ = pixels; }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  const CXmlPolygonBvh& bvh_;
+  double viewport_height_;
+  double pixels_per_sample_;
+};
+
+#endif // SKPTOXML_COMMON_XMLHIDDENLINES_H
@@ -0,0 +1,326 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "./xmlmeshfilewriter.h"
+#include "./xmlthreadutils.h"
+
+using namespace XmlGeomUtils;
+
+// Records formatted by one thread before its buffer is written out
+static const size_t kRecordsPerChunk = 16384;
+// Chunks formatted before their buffers are written out and reused
+static const size_t kChunksPerCore = 4;
+
+// Longest OBJ records: "v" and three numbers, "f" and three indices
+static const size_t kMaxNumberLength = 32;
+static const size_t kMaxObjVertexLength = 3 * kMaxNumberLength + 4;
+static const size_t kMaxObjIndexLength = 12;
+
+namespace {
+
+// Formats records [begin, end) of one section of a file
+class CSectionFormatter {
+ public:
+  virtual ~CSectionFormatter() {}
+
+  virtual size_t size() const = 0;
+  virtual void Format(size_t begin, size_t end, std::string& out) const = 0;
+};
+
+class CFormatTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CFormatTask(const CSectionFormatter& formatter, size_t first_record,
+              std::vector<std::string>& buffers)
+    : formatter_(formatter), first_record_(first_record),
+      buffers_(buffers) {}
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      size_t first = first_record_ + i * kRecordsPerChunk;
+      size_t last = std::min(first + kRecordsPerChunk, formatter_.size());
+      buffers_[i].clear();
+      formatter_.Format(first, last, buffers_[i]);
+    }
+  }
+
+ private:
+  const CSectionFormatter& formatter_;
+  size_t first_record_;
+  std::vector<std::string>& buffers_;
+};
+
+bool WriteSection(FILE* file, const CSectionFormatter& formatter,
+                  bool parallel) {
+  int num_threads = parallel ? 0 : 1;
+  size_t chunks_per_wave =
+      parallel ? kChunksPerCore * XmlThreadUtils::GetNumCores() : 1;
+  size_t records_per_wave = chunks_per_wave * kRecordsPerChunk;
+  std::vector<std::string> buffers(chunks_per_wave);
+  bool ok = true;
+  for (size_t first = 0; first < formatter.size() && ok;
+       first += records_per_wave) {
+    size_t records = std::min(records_per_wave, formatter.size() - first);
+    size_t count = (records + kRecordsPerChunk - 1) / kRecordsPerChunk;
+    CFormatTask task(formatter, first, buffers);
+    XmlThreadUtils::RunParallel(task, count, 1, num_threads);
+    for (size_t i = 0; i < count && ok; ++i) {
+      ok = fwrite(buffers[i].data(), 1, buffers[i].size(), file) ==
+           buffers[i].size();
+    }
+  }
+  return ok;
+}
+
+char* FormatUnsigned(unsigned long long value, char* out) {
+  char digits[24];
+  int count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0)
+    *out++ = digits[--count];
+  return out;
+}
+
+// Up to 6 decimals without trailing zeros, a millionth of an inch is below
+// anything SketchUp models. Falls back to printf outside the fixed range.
+char* FormatDouble(double value, char* out) {
+  double magnitude = fabs(value);
+  if (!(magnitude < 1.0e12))
+    return out + snprintf(out, kMaxNumberLength, "%.17g", value);
+  unsigned long long scaled =
+      static_cast<unsigned long long>(magnitude * 1.0e6 + 0.5);
+  if (scaled != 0 && value < 0.0)
+    *out++ = '-';
+  out = FormatUnsigned(scaled / 1000000, out);
+  unsigned int fraction = static_cast<unsigned int>(scaled % 1000000);
+  if (fraction != 0) {
+    *out++ = '.';
+    for (unsigned int divisor = 100000; fraction != 0; divisor /= 10) {
+      *out++ = static_cast<char>('0' + fraction / divisor);
+      fraction %= divisor;
+    }
+  }
+  return out;
+}
+
+// Little endian, as PLY's binary_little_endian and the hosts we build for
+template <typename T>
+char* Pack(T value, char* out) {
+  memcpy(out, &value, sizeof(T));
+  return out + sizeof(T);
+}
+
+class CVertexFormatter : public CSectionFormatter {
+ public:
+  CVertexFormatter(const std::vector<CPoint3d>& points,
+                   const std::vector<unsigned int>& point_order,
+                   const std::vector<CPoint3d>& edge_points, bool binary)
+    : points_(points), point_order_(point_order), edge_points_(edge_points),
+      binary_(binary) {}
+
+  size_t size() const { return points_.size() + edge_points_.size(); }
+
+  void Format(size_t begin, size_t end, std::string& out) const {
+    out.resize((end - begin) * (binary_ ? 3 * sizeof(float) :
+                                          kMaxObjVertexLength));
+    char* start = &out[0];
+    char* cursor = start;
+    for (size_t i = begin; i < end; ++i) {
+      const CPoint3d& point = (i >= points_.size()) ?
+          edge_points_[i - points_.size()] :
+          points_[point_order_.empty() ? i : point_order_[i]];
+      if (binary_) {
+        cursor = Pack(static_cast<float>(point.x()), cursor);
+        cursor = Pack(static_cast<float>(point.y()), cursor);
+        cursor = Pack(static_cast<float>(point.z()), cursor);
+      } else {
+        *cursor++ = 'v';
+        *cursor++ = ' ';
+        cursor = FormatDouble(point.x(), cursor);
+        *cursor++ = ' ';
+        cursor = FormatDouble(point.y(), cursor);
+        *cursor++ = ' ';
+        cursor = FormatDouble(point.z(), cursor);
+        *cursor++ = '\n';
+      }
+    }
+    out.resize(cursor - start);
+  }
+
+ private:
+  const std::vector<CPoint3d>& points_;
+  const std::vector<unsigned int>& point_order_;
+  const std::vector<CPoint3d>& edge_points_;
+  bool binary_;
+};
+
+// Records of a fixed number of vertex indices: OBJ "f" and "l" lines, or
+// PLY faces (with their count) and edges
+class CIndexFormatter : public CSectionFormatter {
+ public:
+  CIndexFormatter(const std::vector<unsigned int>& indices, size_t arity,
+                  char obj_tag, bool binary)
+    : indices_(indices), arity_(arity), obj_tag_(obj_tag), binary_(binary) {}
+
+  size_t size() const { return indices_.size() / arity_; }
+
+  void Format(size_t begin, size_t end, std::string& out) const {
+    // Faces carry their vertex count in PLY, edges do not
+    bool counted = binary_ && obj_tag_ == 'f';
+    out.resize((end - begin) * (binary_ ?
+        arity_ * sizeof(unsigned int) + 1 :
+        (arity_ + 1) * kMaxObjIndexLength));
+    char* start = &out[0];
+    char* cursor = start;
+    for (size_t i = begin; i < end; ++i) {
+      const unsigned int* record = &indices_[i * arity_];
+      if (binary_) {
+        if (counted)
+          *cursor++ = static_cast<char>(arity_);
+        for (size_t k = 0; k < arity_; ++k) {
+          cursor = Pack(record[k], cursor);
+        }
+      } else {
+        // OBJ indices start at 1
+        *cursor++ = obj_tag_;
+        for (size_t k = 0; k < arity_; ++k) {
+          *cursor++ = ' ';
+          cursor = FormatUnsigned(record[k] + 1ULL, cursor);
+        }
+        *cursor++ = '\n';
+      }
+    }
+    out.resize(cursor - start);
+  }
+
+ private:
+  const std::vector<unsigned int>& indices_;
+  size_t arity_;
+  char obj_tag_;
+  bool binary_;
+};
+
+} // end anonymous namespace
+
+CXmlMeshFileWriter::CXmlMeshFileWriter(const CXmlWorldGeometry& geometry)
+  : geometry_(geometry),
+    parallel_(false),
+    optimize_vertex_cache_(false),
+    prepared_(false) {
+}
+
+void CXmlMeshFileWriter::Prepare() {
+  if (prepared_)
+    return;
+  prepared_ = true;
+
+  geometry_.Triangulate(triangles_, parallel_);
+
+  // Loop sides index the face points, stand-alone edges (those without a
+  // face normal) their own
+  const std::vector<XmlWorldLoop>& loops = geometry_.loops();
+  for (size_t l = 0; l < loops.size(); ++l) {
+    const XmlWorldLoop& loop = loops[l];
+    for (size_t i = 0; i < loop.num_points_; ++i) {
+      lines_.push_back(static_cast<unsigned int>(loop.first_point_ + i));
+      lines_.push_back(static_cast<unsigned int>(
+          loop.first_point_ + (i + 1) % loop.num_points_));
+    }
+  }
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  size_t first_edge_point = geometry_.points().size();
+  for (size_t s = 0; s < segments.size(); ++s) {
+    if (segments[s].normal_.LengthSquared() > 0.0)
+      continue;
+    lines_.push_back(static_cast<unsigned int>(
+        first_edge_point + edge_points_.size()));
+    edge_points_.push_back(segments[s].start_);
+    lines_.push_back(static_cast<unsigned int>(
+        first_edge_point + edge_points_.size()));
+    edge_points_.push_back(segments[s].end_);
+  }
+
+  if (optimize_vertex_cache_) {
+    CXmlVertexCacheOptimizer::OptimizeInChunks(triangles_, parallel_,
+                                               vertex_cache_);
+
+    // Face vertices in first use order, the loop sides follow them
+    std::vector<unsigned int> remap;
+    size_t num_points = geometry_.points().size();
+    CXmlVertexCacheOptimizer::GetFirstUseOrder(triangles_, num_points, remap);
+    for (size_t i = 0; i < triangles_.size(); ++i) {
+      triangles_[i] = remap[triangles_[i]];
+    }
+    for (size_t i = 0; i < lines_.size(); ++i) {
+      if (lines_[i] < num_points)
+        lines_[i] = remap[lines_[i]];
+    }
+    point_order_.resize(num_points);
+    for (size_t p = 0; p < num_points; ++p) {
+      point_order_[remap[p]] = static_cast<unsigned int>(p);
+    }
+  }
+}
+
+bool CXmlMeshFileWriter::WriteObj(const std::string& filename) {
+  Prepare();
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  static const char kHeader[] = "# SketchUp XML Exporter, inches\n";
+  bool ok = fwrite(kHeader, 1, sizeof(kHeader) - 1, file) ==
+            sizeof(kHeader) - 1;
+  ok = ok && WriteSection(file, CVertexFormatter(geometry_.points(),
+                                                 point_order_, edge_points_,
+                                                 false),
+                          parallel_);
+  ok = ok && WriteSection(file, CIndexFormatter(triangles_, 3, 'f', false),
+                          parallel_);
+  ok = ok && WriteSection(file, CIndexFormatter(lines_, 2, 'l', false),
+                          parallel_);
+  ok &= fclose(file) == 0;
+  return ok;
+}
+
+bool CXmlMeshFileWriter::WritePly(const std::string& filename) {
+  Prepare();
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  CVertexFormatter vertices(geometry_.points(), point_order_, edge_points_,
+                            true);
+  CIndexFormatter faces(triangles_, 3, 'f', true);
+  CIndexFormatter edges(lines_, 2, 'l', true);
+  char header[512];
+  int length = snprintf(header, sizeof(header),
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "comment SketchUp XML Exporter, inches\n"
+      "element vertex %lu\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n"
+      "element face %lu\n"
+      "property list uchar uint vertex_indices\n"
+      "element edge %lu\n"
+      "property uint vertex1\n"
+      "property uint vertex2\n"
+      "end_header\n",
+      static_cast<unsigned long>(vertices.size()),
+      static_cast<unsigned long>(faces.size()),
+      static_cast<unsigned long>(edges.size()));
+  bool ok = fwrite(header, 1, length, file) == static_cast<size_t>(length);
+  ok = ok && WriteSection(file, vertices, parallel_);
+  ok = ok && WriteSection(file, faces, parallel_);
+  ok = ok && WriteSection(file, edges, parallel_);
+  ok &= fclose(file) == 0;
+  return ok;
+}
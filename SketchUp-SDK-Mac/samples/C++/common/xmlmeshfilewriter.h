@@ -0,0 +1,62 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLMESHFILEWRITER_H
+#define SKPTOXML_COMMON_XMLMESHFILEWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "./xmlvertexcache.h"
+#include "./xmlworldgeometry.h"
+
+// CXmlMeshFileWriter - Writes the faces and outlines of a CXmlWorldGeometry
+// as Wavefront OBJ (f and l elements) or binary PLY (face and edge
+// elements) for tools that read neither the XML nor glTF. Faces are cut into
+// triangles once and shared by both formats. Each section of the file is
+// formatted in chunks of records, numbers with a dedicated formatter rather
+// than printf, and every chunk goes out in one write. In parallel mode the
+// chunks of a wave are formatted on all cores; the bytes written are the
+// same either way. Coordinates stay in world space inches. With
+// set_optimize_vertex_cache the triangles are reordered for the GPU's
+// vertex cache and the face vertices renumbered in the order they are first
+// used, see CXmlVertexCacheOptimizer.
+class CXmlMeshFileWriter {
+ public:
+  explicit CXmlMeshFileWriter(const CXmlWorldGeometry& geometry);
+
+  // Return false if the file could not be written
+  bool WriteObj(const std::string& filename);
+  bool WritePly(const std::string& filename);
+
+  // Triangulate and format on all cores, for large meshes
+  void set_parallel(bool parallel) { parallel_ = parallel; }
+
+  // Reorder triangles and vertices before the first file is written
+  void set_optimize_vertex_cache(bool optimize) {
+    optimize_vertex_cache_ = optimize;
+  }
+
+  size_t num_triangles() const { return triangles_.size() / 3; }
+  const XmlVertexCacheInfo& vertex_cache() const { return vertex_cache_; }
+
+ private:
+  void Prepare();
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  bool parallel_;
+  bool optimize_vertex_cache_;
+  bool prepared_;
+
+  // Stand-alone edges get their own vertices, after geometry_.points()
+  std::vector<XmlGeomUtils::CPoint3d> edge_points_;
+  // 3 vertex indices per triangle, 2 per line
+  std::vector<unsigned int> triangles_;
+  std::vector<unsigned int> lines_;
+  // Index in geometry_.points() of each face vertex written, empty to write
+  // them in their own order
+  std::vector<unsigned int> point_order_;
+  XmlVertexCacheInfo vertex_cache_;
+};
+
+#endif // SKPTOXML_COMMON_XMLMESHFILEWRITER_H
@@ -0,0 +1,379 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "./xmlmeshlets.h"
+#include "./xmlthreadutils.h"
+#include "./xmltriangulator.h"
+
+using namespace XmlGeomUtils;
+
+static const unsigned int kFileVersion = 1;
+// Sizes that fit a 128 thread workgroup with 8 bit local indices
+static const size_t kDefaultMaxVertices = 64;
+static const size_t kDefaultMaxPrimitives = 124;
+static const size_t kMaxLocalIndex = 255;
+// Cones wider than this, about 84 degrees to the axis, never cull
+static const double kMinConeDot = 0.1;
+
+namespace {
+
+template <typename T>
+void Append(T value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendPoint(const CPoint3d& point, std::string& out) {
+  Append(static_cast<float>(point.x()), out);
+  Append(static_cast<float>(point.y()), out);
+  Append(static_cast<float>(point.z()), out);
+}
+
+void AppendVector(const CVector3d& vector, std::string& out) {
+  Append(static_cast<float>(vector.x()), out);
+  Append(static_cast<float>(vector.y()), out);
+  Append(static_cast<float>(vector.z()), out);
+}
+
+// Meshlets of one group. Line meshlets index line_points_ rather than the
+// geometry's points until the groups are joined.
+struct CGroupMeshlets {
+  std::vector<XmlMeshlet> meshlets_;
+  std::vector<unsigned int> meshlet_vertices_;
+  std::vector<unsigned char> primitives_;
+  std::vector<CPoint3d> line_points_;
+};
+
+// Fills one meshlet at a time
+class CMeshletCutter {
+ public:
+  CMeshletCutter(size_t max_vertices, size_t max_primitives,
+                 const std::vector<CPoint3d>& points, int group,
+                 CGroupMeshlets& out)
+    : max_vertices_(max_vertices), max_primitives_(max_primitives),
+      points_(points), group_(group), out_(out), is_lines_(false),
+      num_primitives_(0) {}
+
+  // Adds a primitive of count vertices, the normal of a line may be zero
+  void Add(const unsigned int* vertices, size_t count, bool is_lines,
+           const CVector3d& normal) {
+    if (is_lines != is_lines_)
+      Flush();
+    is_lines_ = is_lines;
+
+    size_t num_new = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (Find(vertices[i]) < 0 &&
+          std::find(vertices, vertices + i, vertices[i]) == vertices + i)
+        ++num_new;
+    }
+    if (vertices_.size() + num_new > max_vertices_ ||
+        num_primitives_ + 1 > max_primitives_)
+      Flush();
+
+    for (size_t i = 0; i < count; ++i) {
+      int local = Find(vertices[i]);
+      if (local < 0) {
+        local = static_cast<int>(vertices_.size());
+        vertices_.push_back(vertices[i]);
+      }
+      primitives_.push_back(static_cast<unsigned char>(local));
+    }
+    normals_.push_back(normal);
+    ++num_primitives_;
+  }
+
+  // Closes the current meshlet
+  void Flush();
+
+ private:
+  int Find(unsigned int vertex) const {
+    for (size_t i = 0; i < vertices_.size(); ++i) {
+      if (vertices_[i] == vertex)
+        return static_cast<int>(i);
+    }
+    return -1;
+  }
+
+  const CPoint3d& GetPoint(unsigned int vertex) const {
+    return is_lines_ ? out_.line_points_[vertex] : points_[vertex];
+  }
+
+ private:
+  size_t max_vertices_;
+  size_t max_primitives_;
+  const std::vector<CPoint3d>& points_;
+  int group_;
+  CGroupMeshlets& out_;
+
+  // The meshlet being filled
+  bool is_lines_;
+  std::vector<unsigned int> vertices_;
+  std::vector<unsigned char> primitives_;
+  std::vector<CVector3d> normals_;
+  size_t num_primitives_;
+};
+
+void CMeshletCutter::Flush() {
+  if (num_primitives_ == 0)
+    return;
+
+  XmlMeshlet meshlet;
+  meshlet.vertex_offset_ =
+      static_cast<unsigned int>(out_.meshlet_vertices_.size());
+  meshlet.primitive_offset_ =
+      static_cast<unsigned int>(out_.primitives_.size());
+  meshlet.vertex_count_ = static_cast<unsigned char>(vertices_.size());
+  meshlet.primitive_count_ = static_cast<unsigned char>(num_primitives_);
+  meshlet.is_lines_ = is_lines_;
+  meshlet.group_ = group_;
+
+  // Sphere around the center of the bounding box
+  CPoint3d min = GetPoint(vertices_[0]);
+  CPoint3d max = min;
+  for (size_t i = 1; i < vertices_.size(); ++i) {
+    const CPoint3d& point = GetPoint(vertices_[i]);
+    min.SetLocation(std::min(min.x(), point.x()),
+                    std::min(min.y(), point.y()),
+                    std::min(min.z(), point.z()));
+    max.SetLocation(std::max(max.x(), point.x()),
+                    std::max(max.y(), point.y()),
+                    std::max(max.z(), point.z()));
+  }
+  meshlet.center_.SetLocation((min.x() + max.x()) / 2.0,
+                              (min.y() + max.y()) / 2.0,
+                              (min.z() + max.z()) / 2.0);
+  double radius_squared = 0.0;
+  for (size_t i = 0; i < vertices_.size(); ++i) {
+    radius_squared = std::max(
+        radius_squared,
+        (GetPoint(vertices_[i]) - meshlet.center_).LengthSquared());
+  }
+  meshlet.radius_ = sqrt(radius_squared);
+
+  // Cone around the average normal
+  CVector3d axis;
+  bool has_normals = true;
+  for (size_t i = 0; i < normals_.size(); ++i) {
+    if (normals_[i].LengthSquared() == 0.0)
+      has_normals = false;
+    axis = axis + normals_[i];
+  }
+  meshlet.cone_cutoff_ = 1.0;
+  if (has_normals && axis.LengthSquared() > 0.0) {
+    axis.Normalize();
+    double min_dot = 1.0;
+    for (size_t i = 0; i < normals_.size(); ++i) {
+      min_dot = std::min(min_dot, axis.Dot(normals_[i]));
+    }
+    meshlet.cone_axis_ = axis;
+    if (min_dot > kMinConeDot)
+      meshlet.cone_cutoff_ = sqrt(1.0 - min_dot * min_dot);
+  }
+
+  out_.meshlets_.push_back(meshlet);
+  out_.meshlet_vertices_.insert(out_.meshlet_vertices_.end(),
+                                vertices_.begin(), vertices_.end());
+  out_.primitives_.insert(out_.primitives_.end(), primitives_.begin(),
+                          primitives_.end());
+  vertices_.clear();
+  primitives_.clear();
+  normals_.clear();
+  num_primitives_ = 0;
+}
+
+// Cuts the groups [begin, end), the last index being the loose geometry
+class CGroupTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CGroupTask(const CXmlWorldGeometry& geometry,
+             const std::vector<std::vector<size_t> >& group_polygons,
+             const std::vector<std::vector<size_t> >& group_segments,
+             size_t max_vertices, size_t max_primitives,
+             std::vector<CGroupMeshlets>& results)
+    : geometry_(geometry), group_polygons_(group_polygons),
+      group_segments_(group_segments), max_vertices_(max_vertices),
+      max_primitives_(max_primitives), results_(results) {}
+
+  void Run(size_t begin, size_t end) {
+    const std::vector<CPoint3d>& points = geometry_.points();
+    const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+    const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+    CXmlTriangulator triangulator;
+    std::vector<size_t> loop_sizes;
+    std::vector<size_t> triangles;
+    for (size_t g = begin; g < end; ++g) {
+      int group = g + 1 < results_.size() ? static_cast<int>(g) : -1;
+      CGroupMeshlets& out = results_[g];
+      CMeshletCutter cutter(max_vertices_, max_primitives_, points, group,
+                            out);
+
+      // Faces
+      for (size_t i = 0; i < group_polygons_[g].size(); ++i) {
+        const XmlWorldPolygon& polygon = polygons[group_polygons_[g][i]];
+        const XmlWorldLoop* loops = &geometry_.loops()[polygon.first_loop_];
+        loop_sizes.clear();
+        for (size_t l = 0; l < polygon.num_loops_; ++l) {
+          loop_sizes.push_back(loops[l].num_points_);
+        }
+        triangles.clear();
+        triangulator.Triangulate(&points[loops[0].first_point_],
+                                 &loop_sizes[0], loop_sizes.size(),
+                                 triangles);
+        for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+          unsigned int triangle[3];
+          for (size_t v = 0; v < 3; ++v) {
+            triangle[v] = static_cast<unsigned int>(
+                loops[0].first_point_ + triangles[t + v]);
+          }
+          cutter.Add(triangle, 3, false, polygon.normal_);
+        }
+      }
+
+      // Outlines, their end points shared within a meshlet where they meet
+      for (size_t i = 0; i < group_segments_[g].size(); ++i) {
+        const XmlWorldSegment& segment = segments[group_segments_[g][i]];
+        unsigned int line[2];
+        line[0] = AddLinePoint(segment.start_, out);
+        line[1] = AddLinePoint(segment.end_, out);
+        cutter.Add(line, 2, true, segment.normal_);
+      }
+      cutter.Flush();
+    }
+  }
+
+ private:
+  // Reuses the point if one of the last few has the same location, which
+  // catches the chains an outline is usually made of
+  static unsigned int AddLinePoint(const CPoint3d& point,
+                                   CGroupMeshlets& out) {
+    size_t first = out.line_points_.size() > 2 ?
+        out.line_points_.size() - 2 : 0;
+    for (size_t i = first; i < out.line_points_.size(); ++i) {
+      const CPoint3d& other = out.line_points_[i];
+      if (other.x() == point.x() && other.y() == point.y() &&
+          other.z() == point.z())
+        return static_cast<unsigned int>(i);
+    }
+    out.line_points_.push_back(point);
+    return static_cast<unsigned int>(out.line_points_.size() - 1);
+  }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  const std::vector<std::vector<size_t> >& group_polygons_;
+  const std::vector<std::vector<size_t> >& group_segments_;
+  size_t max_vertices_;
+  size_t max_primitives_;
+  std::vector<CGroupMeshlets>& results_;
+};
+
+} // end anonymous namespace
+
+CXmlMeshletBuilder::CXmlMeshletBuilder(const CXmlWorldGeometry& geometry)
+  : geometry_(geometry),
+    max_vertices_(kDefaultMaxVertices),
+    max_primitives_(kDefaultMaxPrimitives),
+    parallel_(true) {
+}
+
+void CXmlMeshletBuilder::Build(const std::vector<bool>& duplicates) {
+  const std::vector<CPoint3d>& points = geometry_.points();
+  const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  meshlets_.clear();
+  meshlet_vertices_.clear();
+  primitives_.clear();
+
+  // A triangle needs 3 vertices, a line 2
+  size_t max_vertices = std::min(std::max(max_vertices_, size_t(3)),
+                                 kMaxLocalIndex);
+  size_t max_primitives = std::min(std::max(max_primitives_, size_t(1)),
+                                   kMaxLocalIndex);
+
+  // Document order within each group, the loose geometry last
+  size_t num_groups = static_cast<size_t>(geometry_.num_groups());
+  std::vector<std::vector<size_t> > group_polygons(num_groups + 1);
+  std::vector<std::vector<size_t> > group_segments(num_groups + 1);
+  for (size_t p = 0; p < polygons.size(); ++p) {
+    size_t group = polygons[p].group_ < 0 ? num_groups : polygons[p].group_;
+    group_polygons[group].push_back(p);
+  }
+  for (size_t s = 0; s < segments.size(); ++s) {
+    if (s < duplicates.size() && duplicates[s])
+      continue;
+    size_t group = segments[s].group_ < 0 ? num_groups : segments[s].group_;
+    group_segments[group].push_back(s);
+  }
+
+  std::vector<CGroupMeshlets> results(num_groups + 1);
+  CGroupTask task(geometry_, group_polygons, group_segments, max_vertices,
+                  max_primitives, results);
+  XmlThreadUtils::RunParallel(task, results.size(), 1, parallel_ ? 0 : 1);
+
+  // Join the groups, moving the line points behind the geometry's points
+  vertices_ = points;
+  for (size_t g = 0; g < results.size(); ++g) {
+    const CGroupMeshlets& result = results[g];
+    unsigned int vertex_base =
+        static_cast<unsigned int>(meshlet_vertices_.size());
+    unsigned int primitive_base =
+        static_cast<unsigned int>(primitives_.size());
+    unsigned int line_base = static_cast<unsigned int>(vertices_.size());
+    for (size_t m = 0; m < result.meshlets_.size(); ++m) {
+      XmlMeshlet meshlet = result.meshlets_[m];
+      for (size_t v = meshlet.vertex_offset_;
+           v < meshlet.vertex_offset_ + meshlet.vertex_count_; ++v) {
+        unsigned int vertex = result.meshlet_vertices_[v];
+        meshlet_vertices_.push_back(
+            meshlet.is_lines_ ? line_base + vertex : vertex);
+      }
+      meshlet.vertex_offset_ += vertex_base;
+      meshlet.primitive_offset_ += primitive_base;
+      meshlets_.push_back(meshlet);
+    }
+    primitives_.insert(primitives_.end(), result.primitives_.begin(),
+                       result.primitives_.end());
+    vertices_.insert(vertices_.end(), result.line_points_.begin(),
+                     result.line_points_.end());
+  }
+}
+
+bool CXmlMeshletBuilder::Write(const std::string& filename) const {
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  std::string out("SKPM");
+  Append(kFileVersion, out);
+  Append(static_cast<unsigned int>(vertices_.size()), out);
+  Append(static_cast<unsigned int>(meshlets_.size()), out);
+  Append(static_cast<unsigned int>(meshlet_vertices_.size()), out);
+  Append(static_cast<unsigned int>(primitives_.size()), out);
+  for (size_t v = 0; v < vertices_.size(); ++v) {
+    AppendPoint(vertices_[v], out);
+  }
+  for (size_t m = 0; m < meshlets_.size(); ++m) {
+    const XmlMeshlet& meshlet = meshlets_[m];
+    Append(meshlet.vertex_offset_, out);
+    Append(meshlet.primitive_offset_, out);
+    Append(meshlet.vertex_count_, out);
+    Append(meshlet.primitive_count_, out);
+    Append(static_cast<unsigned char>(meshlet.is_lines_ ? 1 : 0), out);
+    Append(static_cast<unsigned char>(0), out);
+    Append(static_cast<int>(meshlet.group_), out);
+    AppendPoint(meshlet.center_, out);
+    Append(static_cast<float>(meshlet.radius_), out);
+    AppendVector(meshlet.cone_axis_, out);
+    Append(static_cast<float>(meshlet.cone_cutoff_), out);
+  }
+  for (size_t v = 0; v < meshlet_vertices_.size(); ++v) {
+    Append(meshlet_vertices_[v], out);
+  }
+  out.append(primitives_.begin(), primitives_.end());
+
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  ok &= fclose(file) == 0;
+  return ok;
+}
@@ -0,0 +1,99 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLMESHLETS_H
+#define SKPTOXML_COMMON_XMLMESHLETS_H
+
+#include <string>
+#include <vector>
+
+#include "./xmlworldgeometry.h"
+
+// A cluster of triangles or outline segments small enough for one mesh
+// shader workgroup, with the bounds to cull it as a whole.
+struct XmlMeshlet {
+  // Range in CXmlMeshletBuilder::meshlet_vertices() and primitives()
+  unsigned int vertex_offset_;
+  unsigned int primitive_offset_;
+  unsigned char vertex_count_;
+  unsigned char primitive_count_;
+  // Triangles, or lines of 2 vertices
+  bool is_lines_;
+  // Index of the top level group, -1 for loose geometry
+  int group_;
+  // Bounding sphere
+  XmlGeomUtils::CPoint3d center_;
+  double radius_;
+  // Normal cone: the meshlet faces away from a viewer at camera if
+  // (center - camera).Dot(cone_axis) >= cone_cutoff * |center - camera|
+  // + radius. A cutoff of 1 never culls.
+  XmlGeomUtils::CVector3d cone_axis_;
+  double cone_cutoff_;
+};
+
+// CXmlMeshletBuilder - Partitions the faces and outlines of a
+// CXmlWorldGeometry into meshlets for GPU driven rendering. Each top level
+// group is cut separately, on all cores: its faces are triangulated and
+// their triangles, then its outline segments, are added in document order
+// to the current meshlet until the vertex or primitive limit would be
+// exceeded. The groups' meshlets are joined in group order, so the output
+// does not depend on the number of threads. Front faces are assumed for
+// the normal cones, which does not hold for faces seen from the back.
+//
+// Write() stores the buffers, little endian:
+//
+//   "SKPM" uint32 version, num_vertices, num_meshlets,
+//          num_meshlet_vertices, num_primitive_indices
+//   num_vertices times float x, y, z, world space inches
+//   num_meshlets times 48 bytes:
+//     uint32 vertex_offset, primitive_offset
+//     uint8 vertex_count, primitive_count, kind (0 triangles, 1 lines), 0
+//     int32 group
+//     float center[3], radius, cone_axis[3], cone_cutoff
+//   num_meshlet_vertices times uint32 index in the vertices
+//   num_primitive_indices times uint8 index in the meshlet's vertices,
+//   3 per triangle, 2 per line
+//
+// The vertices are the geometry's points followed by the end points of the
+// outline segments.
+class CXmlMeshletBuilder {
+ public:
+  explicit CXmlMeshletBuilder(const CXmlWorldGeometry& geometry);
+
+  // duplicates holds one flag per geometry segment, or is empty. Flagged
+  // segments are left out.
+  void Build(const std::vector<bool>& duplicates);
+
+  // Returns false if the file could not be written
+  bool Write(const std::string& filename) const;
+
+  // Limits per meshlet, at most 255
+  void set_max_vertices(size_t count) { max_vertices_ = count; }
+  void set_max_primitives(size_t count) { max_primitives_ = count; }
+
+  // Cut the groups on all cores
+  void set_parallel(bool parallel) { parallel_ = parallel; }
+
+  const std::vector<XmlGeomUtils::CPoint3d>& vertices() const {
+    return vertices_;
+  }
+  const std::vector<XmlMeshlet>& meshlets() const { return meshlets_; }
+  const std::vector<unsigned int>& meshlet_vertices() const {
+    return meshlet_vertices_;
+  }
+  const std::vector<unsigned char>& primitives() const {
+    return primitives_;
+  }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  size_t max_vertices_;
+  size_t max_primitives_;
+  bool parallel_;
+
+  std::vector<XmlGeomUtils::CPoint3d> vertices_;
+  std::vector<XmlMeshlet> meshlets_;
+  std::vector<unsigned int> meshlet_vertices_;
+  std::vector<unsigned char> primitives_;
+};
+
+#endif // SKPTOXML_COMMON_XMLMESHLETS_H
@@ -0,0 +1,223 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <algorithm>
+
+#include "./xmloutlinededup.h"
+#include "./xmlexternalsort.h"
+
+using namespace XmlGeomUtils;
+
+// Directions closer than this are considered parallel
+static const double kDirectionTolerance = 1.0e-6;
+
+namespace {
+
+// A point snapped to a grid
+struct CPointKey {
+  double x_;
+  double y_;
+  double z_;
+
+  bool operator<(const CPointKey& other) const {
+    if (x_ != other.x_) return x_ < other.x_;
+    if (y_ != other.y_) return y_ < other.y_;
+    return z_ < other.z_;
+  }
+  bool operator==(const CPointKey& other) const {
+    return x_ == other.x_ && y_ == other.y_ && z_ == other.z_;
+  }
+};
+
+CPointKey MakeKey(double x, double y, double z, double step) {
+  CPointKey key = { floor(x / step + 0.5), floor(y / step + 0.5),
+                    floor(z / step + 0.5) };
+  return key;
+}
+
+// A segment by its snapped end points, the smaller one first
+struct CEndPointEntry {
+  CPointKey first_;
+  CPointKey second_;
+  size_t segment_;
+
+  bool operator<(const CEndPointEntry& other) const {
+    if (first_ < other.first_) return true;
+    if (other.first_ < first_) return false;
+    if (second_ < other.second_) return true;
+    if (other.second_ < second_) return false;
+    return segment_ < other.segment_;
+  }
+  bool SameEnds(const CEndPointEntry& other) const {
+    return first_ == other.first_ && second_ == other.second_;
+  }
+};
+
+// A segment as an interval on its supporting line. The line is keyed by its
+// direction and the point closest to the origin.
+struct CLineEntry {
+  CPointKey direction_;
+  CPointKey foot_;
+  double start_;
+  double end_;
+  size_t segment_;
+
+  bool SameLine(const CLineEntry& other) const {
+    return direction_ == other.direction_ && foot_ == other.foot_;
+  }
+};
+
+// Groups entries by line, longest interval first, then in document order
+struct CLineEntryLess {
+  bool operator()(const CLineEntry& a, const CLineEntry& b) const {
+    if (a.direction_ < b.direction_) return true;
+    if (b.direction_ < a.direction_) return false;
+    if (a.foot_ < b.foot_) return true;
+    if (b.foot_ < a.foot_) return false;
+    double length_a = a.end_ - a.start_;
+    double length_b = b.end_ - b.start_;
+    if (length_a != length_b) return length_a > length_b;
+    return a.segment_ < b.segment_;
+  }
+};
+
+struct CIntervalLess {
+  bool operator()(const CLineEntry& a, const CLineEntry& b) const {
+    return a.start_ < b.start_;
+  }
+};
+
+} // end anonymous namespace
+
+CXmlOutlineDeduplicator::CXmlOutlineDeduplicator(
+    const CXmlWorldGeometry& geometry)
+  : geometry_(geometry),
+    tolerance_(1.0e-3),
+    max_sort_bytes_(0),
+    num_spilled_runs_(0) {
+}
+
+size_t CXmlOutlineDeduplicator::Compute(std::vector<bool>& duplicates) {
+  num_spilled_runs_ = 0;
+  duplicates.assign(geometry_.segments().size(), false);
+  RemoveCoincident(duplicates);
+  RemoveCovered(duplicates);
+
+  size_t num_duplicates = 0;
+  for (size_t i = 0; i < duplicates.size(); ++i) {
+    if (duplicates[i])
+      ++num_duplicates;
+  }
+  return num_duplicates;
+}
+
+void CXmlOutlineDeduplicator::RemoveCoincident(
+    std::vector<bool>& duplicates) {
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  CXmlExternalSorter<CEndPointEntry> sorter(max_sort_bytes_);
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const XmlWorldSegment& segment = segments[i];
+    if (!segment.outline_)
+      continue;
+    CEndPointEntry entry;
+    entry.first_ = MakeKey(segment.start_.x(), segment.start_.y(),
+                           segment.start_.z(), tolerance_);
+    entry.second_ = MakeKey(segment.end_.x(), segment.end_.y(),
+                            segment.end_.z(), tolerance_);
+    if (entry.second_ < entry.first_)
+      std::swap(entry.first_, entry.second_);
+    entry.segment_ = i;
+    sorter.Add(entry);
+  }
+  sorter.Finish();
+
+  // Within a run of equal segments, the groups of the kept ones
+  std::vector<int> kept_groups;
+  CEndPointEntry entry;
+  CEndPointEntry previous = CEndPointEntry();
+  for (bool first = true; sorter.Next(entry); first = false) {
+    if (first || !entry.SameEnds(previous))
+      kept_groups.clear();
+    int group = segments[entry.segment_].group_;
+    if (kept_groups.empty() ||
+        std::find(kept_groups.begin(), kept_groups.end(), group) !=
+        kept_groups.end()) {
+      kept_groups.push_back(group);
+    } else {
+      duplicates[entry.segment_] = true;
+    }
+    previous = entry;
+  }
+  num_spilled_runs_ += sorter.num_spilled_runs();
+}
+
+void CXmlOutlineDeduplicator::RemoveCovered(
+    std::vector<bool>& duplicates) {
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  CXmlExternalSorter<CLineEntry, CLineEntryLess> sorter(max_sort_bytes_);
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (duplicates[i] || !segments[i].outline_)
+      continue;
+    const XmlWorldSegment& segment = segments[i];
+    CVector3d direction = segment.end_ - segment.start_;
+    if (direction.Length() <= tolerance_)
+      continue;
+    direction.Normalize();
+
+    // Both orientations of a line share one key
+    if (direction.x() < -kDirectionTolerance ||
+        (fabs(direction.x()) <= kDirectionTolerance &&
+         (direction.y() < -kDirectionTolerance ||
+          (fabs(direction.y()) <= kDirectionTolerance &&
+           direction.z() < 0.0)))) {
+      direction = direction * -1.0;
+    }
+    CVector3d start = segment.start_ - CPoint3d();
+    CVector3d end = segment.end_ - CPoint3d();
+    CVector3d foot = start - direction * direction.Dot(start);
+
+    CLineEntry entry;
+    entry.direction_ = MakeKey(direction.x(), direction.y(), direction.z(),
+                               kDirectionTolerance);
+    entry.foot_ = MakeKey(foot.x(), foot.y(), foot.z(), tolerance_);
+    entry.start_ = direction.Dot(start);
+    entry.end_ = direction.Dot(end);
+    if (entry.end_ < entry.start_)
+      std::swap(entry.start_, entry.end_);
+    entry.segment_ = i;
+    sorter.Add(entry);
+  }
+  sorter.Finish();
+
+  // Longest first, each segment is checked against the kept ones of the
+  // other groups on the same line.
+  std::vector<CLineEntry> kept;
+  std::vector<CLineEntry> cover;
+  CLineEntry entry;
+  CLineEntry previous = CLineEntry();
+  for (bool first = true; sorter.Next(entry); first = false) {
+    if (first || !entry.SameLine(previous))
+      kept.clear();
+    previous = entry;
+    int group = segments[entry.segment_].group_;
+
+    cover.clear();
+    for (size_t k = 0; k < kept.size(); ++k) {
+      if (segments[kept[k].segment_].group_ != group)
+        cover.push_back(kept[k]);
+    }
+    std::sort(cover.begin(), cover.end(), CIntervalLess());
+    double reached = entry.start_;
+    for (size_t k = 0; k < cover.size() && cover[k].start_ <=
+         reached + tolerance_; ++k) {
+      reached = std::max(reached, cover[k].end_);
+    }
+
+    if (!cover.empty() && reached >= entry.end_ - tolerance_) {
+      duplicates[entry.segment_] = true;
+    } else {
+      kept.push_back(entry);
+    }
+  }
+  num_spilled_runs_ += sorter.num_spilled_runs();
+}
@@ -0,0 +1,51 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLOUTLINEDEDUP_H
+#define SKPTOXML_COMMON_XMLOUTLINEDEDUP_H
+
+#include <vector>
+
+#include "./xmlworldgeometry.h"
+
+// CXmlOutlineDeduplicator - Finds outline segments drawn twice because the
+// boundaries of faces in different groups meet, e.g. walls modelled as
+// separate groups. Segments are compared in world space, first by their
+// snapped end points and then along shared lines, so that a segment covered
+// by collinear segments of other groups is found as well. Of a set of
+// coincident segments the one written first is kept. Segments only partly
+// covered are left in place and drawn over each other where they overlap:
+// the readers skip whole segments and have no way to shorten one.
+// Duplicates within one group are left alone, the importer draws those with
+// each face's normal.
+// Segments without outline are neither kept nor flagged. The segments are
+// sorted through a CXmlExternalSorter, with a memory cap the sort spills to
+// temporary files.
+class CXmlOutlineDeduplicator {
+ public:
+  explicit CXmlOutlineDeduplicator(const CXmlWorldGeometry& geometry);
+
+  // Fills duplicates with one flag per geometry segment, set for the
+  // segments readers can skip. Returns the number of flags set.
+  size_t Compute(std::vector<bool>& duplicates);
+
+  // Distance in inches under which points are considered equal
+  void set_tolerance(double inches) { tolerance_ = inches; }
+
+  // Memory for the sorts, 0 for no limit
+  void set_max_sort_bytes(size_t bytes) { max_sort_bytes_ = bytes; }
+
+  // Sorted runs the last Compute wrote to temporary files
+  size_t num_spilled_runs() const { return num_spilled_runs_; }
+
+ private:
+  void RemoveCoincident(std::vector<bool>& duplicates);
+  void RemoveCovered(std::vector<bool>& duplicates);
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  double tolerance_;
+  size_t max_sort_bytes_;
+  size_t num_spilled_runs_;
+};
+
+#endif // SKPTOXML_COMMON_XMLOUTLINEDEDUP_H
@@ -0,0 +1,253 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "./xmlpackage.h"
+#include "./tinyxml2.h"
+#include "./xmlparallelprinter.h"
+
+// Tags of CXmlFile the package rewrites
+static const std::string kCompDefsTag("ComponentDefinitions");
+static const std::string kCompDefTag("ComponentDefinition");
+static const std::string kComponentInstanceTag("ComponentInstance");
+static const std::string kLayerTag("Layer");
+static const std::string kNameTag("Name");
+static const std::string kIndexTag("Index");
+static const std::string kStoreTag("Store");
+
+static const char kStoreDirectory[] = "definitions";
+// Guards against component definitions that (indirectly) contain themselves
+static const int kMaxNestingDepth = 64;
+
+namespace {
+
+bool FileExists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// 64 bit FNV-1a, the terminating zero included so that strings following
+// each other cannot run together
+void HashString(const char* str, uint64_t& hash) {
+  do {
+    hash = (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ULL;
+  } while (*str++ != '\0');
+}
+
+// The definition an instance refers to, NULL for other elements
+tinyxml2::XMLElement* GetReference(tinyxml2::XMLElement* elem) {
+  if (elem->Value() != kComponentInstanceTag)
+    return NULL;
+  tinyxml2::XMLElement* reference = elem->FirstChildElement();
+  return reference != NULL && reference->Value() == kCompDefTag ?
+         reference : NULL;
+}
+
+bool IsReference(const tinyxml2::XMLElement* elem) {
+  const tinyxml2::XMLNode* parent = elem->Parent();
+  return elem->Value() == kCompDefTag && parent != NULL &&
+         parent->ToElement() != NULL &&
+         parent->Value() == kComponentInstanceTag;
+}
+
+// Points the instances below elem to the definitions by id
+void RenameReferences(tinyxml2::XMLElement* elem,
+                      const std::map<std::string, std::string>& ids) {
+  tinyxml2::XMLElement* reference = GetReference(elem);
+  const char* name =
+      reference != NULL ? reference->Attribute(kNameTag.c_str()) : NULL;
+  if (name != NULL) {
+    std::map<std::string, std::string>::const_iterator it = ids.find(name);
+    if (it != ids.end())
+      reference->SetAttribute(kNameTag.c_str(), it->second.c_str());
+  }
+  for (tinyxml2::XMLElement* child = elem->FirstChildElement(); child != NULL;
+       child = child->NextSiblingElement()) {
+    RenameReferences(child, ids);
+  }
+}
+
+// Copies a node and everything below it into document, without the layer
+// indices. CXmlFile::GetModelInfo finds them by name in the Layers section
+// of the model reading the definition.
+tinyxml2::XMLNode* CloneForStore(const tinyxml2::XMLNode* node,
+                                 tinyxml2::XMLDocument* document) {
+  tinyxml2::XMLNode* clone = node->ShallowClone(document);
+  tinyxml2::XMLElement* elem = clone->ToElement();
+  if (elem != NULL && elem->Value() == kLayerTag)
+    elem->DeleteAttribute(kIndexTag.c_str());
+  for (const tinyxml2::XMLNode* child = node->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    clone->InsertEndChild(CloneForStore(child, document));
+  }
+  return clone;
+}
+
+bool SaveDocument(const tinyxml2::XMLDocument& doc,
+                  const std::string& filename) {
+  // Same output as SaveFile, printed on all cores
+  CXmlParallelPrinter printer(doc);
+  if (printer.Save(filename))
+    return true;
+  return const_cast<tinyxml2::XMLDocument&>(doc).SaveFile(filename.c_str()) ==
+         tinyxml2::XML_NO_ERROR;
+}
+
+} // end anonymous namespace
+
+CXmlPackageBuilder::CXmlPackageBuilder(const std::string& directory)
+  : directory_(directory),
+    num_models_(0),
+    num_definitions_(0),
+    num_written_(0) {
+  if (!directory_.empty() && directory_[directory_.size() - 1] != '/' &&
+      directory_[directory_.size() - 1] != '\\')
+    directory_.append("/");
+  store_directory_ = directory_ + kStoreDirectory + "/";
+}
+
+bool CXmlPackageBuilder::AddModel(const std::string& xml_file) {
+  tinyxml2::XMLDocument doc;
+  if (doc.LoadFile(xml_file.c_str()) != tinyxml2::XML_NO_ERROR)
+    return false;
+  ++num_models_;
+
+  tinyxml2::XMLElement* section =
+      doc.FirstChildElement(kCompDefsTag.c_str());
+  if (section == NULL || section->Attribute(kStoreTag.c_str()) != NULL)
+    return true;
+
+  // Definitions by name, in the order of the section
+  DefinitionMap definitions;
+  std::vector<std::string> names;
+  for (const tinyxml2::XMLElement* elem = section->FirstChildElement();
+       elem != NULL; elem = elem->NextSiblingElement()) {
+    const char* name = elem->Attribute(kNameTag.c_str());
+    if (name == NULL || elem->Value() != kCompDefTag)
+      return false;
+    if (definitions.insert(std::make_pair(name, elem)).second)
+      names.push_back(name);
+  }
+
+  IdMap ids;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!GetId(names[i], definitions, 0, ids))
+      return false;
+  }
+
+  // Instances everywhere in the file refer to the ids from now on, the
+  // stored definitions included
+  for (tinyxml2::XMLElement* elem = doc.FirstChildElement(); elem != NULL;
+       elem = elem->NextSiblingElement()) {
+    RenameReferences(elem, ids);
+  }
+  std::set<std::string> used;
+  for (size_t i = 0; i < names.size(); ++i) {
+    const std::string& id = ids[names[i]];
+    if (!used.insert(id).second)
+      continue;
+    if (!StoreDefinition(definitions[names[i]], id))
+      return false;
+  }
+  num_definitions_ += names.size();
+
+  // The section only names the definitions, each once
+  section->DeleteChildren();
+  section->SetAttribute(kStoreTag.c_str(), kStoreDirectory);
+  used.clear();
+  for (size_t i = 0; i < names.size(); ++i) {
+    const std::string& id = ids[names[i]];
+    if (!used.insert(id).second)
+      continue;
+    tinyxml2::XMLElement* stub = doc.NewElement(kCompDefTag.c_str());
+    stub->SetAttribute(kNameTag.c_str(), id.c_str());
+    section->InsertEndChild(stub);
+  }
+  return SaveDocument(doc, xml_file);
+}
+
+bool CXmlPackageBuilder::GetId(const std::string& name,
+                               const DefinitionMap& definitions, int depth,
+                               IdMap& ids) {
+  if (ids.find(name) != ids.end())
+    return true;
+  DefinitionMap::const_iterator it = definitions.find(name);
+  if (it == definitions.end() || depth > kMaxNestingDepth)
+    return false;
+
+  uint64_t hash = 14695981039346656037ULL;
+  if (!HashElement(it->second, definitions, depth, ids, hash))
+    return false;
+  char id[20];
+  sprintf(id, "D%016llx", static_cast<unsigned long long>(hash));
+  ids[name] = id;
+  return true;
+}
+
+bool CXmlPackageBuilder::HashElement(const tinyxml2::XMLElement* elem,
+                                     const DefinitionMap& definitions,
+                                     int depth, IdMap& ids, uint64_t& hash) {
+  HashString(elem->Value(), hash);
+  bool is_layer = elem->Value() == kLayerTag;
+  bool is_definition = elem->Value() == kCompDefTag;
+  for (const tinyxml2::XMLAttribute* attribute = elem->FirstAttribute();
+       attribute != NULL; attribute = attribute->Next()) {
+    if ((is_layer && attribute->Name() == kIndexTag) ||
+        (is_definition && attribute->Name() == kNameTag))
+      continue;
+    HashString(attribute->Name(), hash);
+    HashString(attribute->Value(), hash);
+  }
+
+  // Nested definitions count by content, whatever they are called here.
+  // Those the file does not hold count by name.
+  const char* name = is_definition && IsReference(elem) ?
+      elem->Attribute(kNameTag.c_str()) : NULL;
+  if (name != NULL) {
+    if (definitions.find(name) == definitions.end()) {
+      HashString(name, hash);
+    } else {
+      if (!GetId(name, definitions, depth + 1, ids))
+        return false;
+      HashString(ids[name].c_str(), hash);
+    }
+  }
+
+  for (const tinyxml2::XMLNode* child = elem->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    const tinyxml2::XMLElement* child_elem = child->ToElement();
+    if (child_elem != NULL) {
+      if (!HashElement(child_elem, definitions, depth, ids, hash))
+        return false;
+    } else if (child->ToText() != NULL) {
+      HashString(child->Value(), hash);
+    }
+  }
+  // Closes the element, so that the structure counts and not only the order
+  HashString("/", hash);
+  return true;
+}
+
+bool CXmlPackageBuilder::StoreDefinition(
+    const tinyxml2::XMLElement* definition, const std::string& id) {
+  if (stored_.find(id) != stored_.end())
+    return true;
+  std::string path = store_directory_ + id + ".xml";
+  if (!FileExists(path)) {
+    if (mkdir(store_directory_.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+    tinyxml2::XMLDocument store_doc;
+    tinyxml2::XMLNode* clone = CloneForStore(definition, &store_doc);
+    clone->ToElement()->SetAttribute(kNameTag.c_str(), id.c_str());
+    store_doc.InsertEndChild(clone);
+    if (!SaveDocument(store_doc, path))
+      return false;
+    ++num_written_;
+  }
+  stored_.insert(id);
+  return true;
+}
@@ -0,0 +1,73 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPACKAGE_H
+#define SKPTOXML_COMMON_XMLPACKAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace tinyxml2 {
+  class XMLElement;
+}
+
+// CXmlPackageBuilder - Turns the exports of several models in one directory
+// into a package whose models share a store of component definitions.
+// Projects put together from many .skp files carry the same library
+// components in each of them, in a package each is written once however
+// many models use it and under whatever name.
+//
+// A definition is keyed by the 64 bit FNV-1a hash of its content: its
+// elements and attributes in order, the definitions it nests by their own
+// key, leaving out its name and the layer indices, which depend on the
+// model. Its id is "D" followed by the hash in hex. The store is the
+// "definitions" directory of the package, one <id>.xml per definition.
+// Models keep a ComponentDefinitions section that only names the ids they
+// use, CXmlFile::GetModelInfo loads those from the store, and their
+// instances refer to definitions by id. Definitions already in the store
+// are not written again, so adding models to a package costs only their
+// new content.
+class CXmlPackageBuilder {
+ public:
+  // The directory the models are exported to
+  explicit CXmlPackageBuilder(const std::string& directory);
+
+  // Moves the definitions of an export in the package directory to the
+  // store and rewrites it in place. Models already in a package are left
+  // as they are. Returns false if a file cannot be read or written, the
+  // export is unchanged then.
+  bool AddModel(const std::string& xml_file);
+
+  size_t num_models() const { return num_models_; }
+  // Definitions in the models added, and the different ones among them
+  size_t num_definitions() const { return num_definitions_; }
+  size_t num_unique_definitions() const { return stored_.size(); }
+  // Definitions the models added wrote to the store
+  size_t num_written() const { return num_written_; }
+
+ private:
+  typedef std::map<std::string, const tinyxml2::XMLElement*> DefinitionMap;
+  typedef std::map<std::string, std::string> IdMap;
+
+  bool GetId(const std::string& name, const DefinitionMap& definitions,
+             int depth, IdMap& ids);
+  bool HashElement(const tinyxml2::XMLElement* elem,
+                   const DefinitionMap& definitions, int depth, IdMap& ids,
+                   uint64_t& hash);
+  bool StoreDefinition(const tinyxml2::XMLElement* definition,
+                       const std::string& id);
+
+ private:
+  std::string directory_;
+  std::string store_directory_;
+  // Ids known to be in the store
+  std::set<std::string> stored_;
+  size_t num_models_;
+  size_t num_definitions_;
+  size_t num_written_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPACKAGE_H
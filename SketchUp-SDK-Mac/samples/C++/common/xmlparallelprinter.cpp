@@ -0,0 +1,157 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "./xmlparallelprinter.h"
+#include "./tinyxml2.h"
+#include "./xmlthreadutils.h"
+
+// Child elements of an element, the rough print cost of a run of siblings
+static const size_t kWeightPerPiece = 1024;
+// Pieces printed before their buffers are written out and reused
+static const size_t kPiecesPerCore = 8;
+static const size_t kPiecesPerChunk = 1;
+
+namespace {
+
+// A run of sibling elements printed at the given depth, after prefix_. Runs
+// without elements are plain text.
+struct CPrintPiece {
+  CPrintPiece() : first_(NULL), count_(0), depth_(0) {}
+
+  std::string prefix_;
+  const tinyxml2::XMLElement* first_;
+  size_t count_;
+  int depth_;
+};
+
+size_t CountChildElements(const tinyxml2::XMLElement* elem) {
+  size_t count = 0;
+  for (const tinyxml2::XMLElement* child = elem->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    ++count;
+  }
+  return count;
+}
+
+// Sections are split when the printer would write their start and end tags
+// the same way for any content: no attributes, child elements only.
+bool IsSplittable(const tinyxml2::XMLElement* elem) {
+  if (elem->FirstAttribute() != NULL || elem->FirstChild() == NULL)
+    return false;
+  for (const tinyxml2::XMLNode* child = elem->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    if (child->ToElement() == NULL)
+      return false;
+  }
+  return true;
+}
+
+class CPrintTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CPrintTask(const std::vector<CPrintPiece>& pieces, size_t first_piece,
+             std::vector<std::string>& buffers)
+    : pieces_(pieces), first_piece_(first_piece), buffers_(buffers) {}
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const CPrintPiece& piece = pieces_[first_piece_ + i];
+      std::string& buffer = buffers_[i];
+      buffer = piece.prefix_;
+      if (piece.first_ == NULL)
+        continue;
+
+      tinyxml2::XMLPrinter printer(NULL, false, piece.depth_);
+      const tinyxml2::XMLElement* elem = piece.first_;
+      for (size_t e = 0; e < piece.count_; ++e) {
+        elem->Accept(&printer);
+        elem = elem->NextSiblingElement();
+      }
+      buffer.append(printer.CStr(), printer.CStrSize() - 1);
+    }
+  }
+
+ private:
+  const std::vector<CPrintPiece>& pieces_;
+  size_t first_piece_;
+  std::vector<std::string>& buffers_;
+};
+
+} // end anonymous namespace
+
+CXmlParallelPrinter::CXmlParallelPrinter(const tinyxml2::XMLDocument& doc)
+  : doc_(doc) {
+}
+
+bool CXmlParallelPrinter::Save(const std::string& filename) const {
+  // Mirror what XMLPrinter writes between elements: a line break before
+  // every element but the first, indented by depth, and one after each top
+  // level element.
+  std::vector<CPrintPiece> pieces;
+  bool first_node = true;
+  for (const tinyxml2::XMLNode* node = doc_.FirstChild(); node != NULL;
+       node = node->NextSibling()) {
+    const tinyxml2::XMLElement* elem = node->ToElement();
+    if (elem == NULL)
+      return false;
+
+    std::string separator = first_node ? "" : "\n";
+    first_node = false;
+    if (!IsSplittable(elem)) {
+      CPrintPiece piece;
+      piece.prefix_ = separator;
+      piece.first_ = elem;
+      piece.count_ = 1;
+      pieces.push_back(piece);
+      continue;
+    }
+
+    CPrintPiece start;
+    start.prefix_ = separator + "<" + elem->Name() + ">";
+    pieces.push_back(start);
+
+    const tinyxml2::XMLElement* child = elem->FirstChildElement();
+    while (child != NULL) {
+      CPrintPiece piece;
+      piece.prefix_ = "\n    ";
+      piece.first_ = child;
+      piece.depth_ = 1;
+      size_t weight = 0;
+      while (child != NULL && (piece.count_ == 0 ||
+                               weight < kWeightPerPiece)) {
+        weight += 1 + CountChildElements(child);
+        piece.count_++;
+        child = child->NextSiblingElement();
+      }
+      pieces.push_back(piece);
+    }
+
+    CPrintPiece end;
+    end.prefix_ = std::string("\n</") + elem->Name() + ">\n";
+    pieces.push_back(end);
+  }
+
+  FILE* file = fopen(filename.c_str(), "w");
+  if (file == NULL)
+    return false;
+
+  // Print a wave of pieces at a time to bound the memory held in buffers
+  size_t pieces_per_wave = kPiecesPerCore * XmlThreadUtils::GetNumCores();
+  std::vector<std::string> buffers(pieces_per_wave);
+  bool ok = true;
+  for (size_t first = 0; first < pieces.size() && ok;
+       first += pieces_per_wave) {
+    size_t count = std::min(pieces_per_wave, pieces.size() - first);
+    CPrintTask task(pieces, first, buffers);
+    XmlThreadUtils::RunParallel(task, count, kPiecesPerChunk);
+    for (size_t i = 0; i < count && ok; ++i) {
+      ok = fwrite(buffers[i].data(), 1, buffers[i].size(), file) ==
+           buffers[i].size();
+    }
+  }
+
+  ok &= fclose(file) == 0;
+  return ok;
+}
@@ -0,0 +1,30 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPARALLELPRINTER_H
+#define SKPTOXML_COMMON_XMLPARALLELPRINTER_H
+
+#include <string>
+
+namespace tinyxml2 {
+  class XMLDocument;
+}
+
+// CXmlParallelPrinter - Writes a document the way XMLDocument::SaveFile
+// does, byte for byte, but prints independent subtrees on several threads.
+// Top level sections are split into runs of their child elements (groups,
+// faces, layers...), each run is printed into its own buffer at the depth
+// it has in the document, and the buffers are written out in document
+// order. The document must not change while it is printed.
+class CXmlParallelPrinter {
+ public:
+  explicit CXmlParallelPrinter(const tinyxml2::XMLDocument& doc);
+
+  // Returns false if the file cannot be written, or if the document holds
+  // top level nodes other than elements, which are left to SaveFile.
+  bool Save(const std::string& filename) const;
+
+ private:
+  const tinyxml2::XMLDocument& doc_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPARALLELPRINTER_H
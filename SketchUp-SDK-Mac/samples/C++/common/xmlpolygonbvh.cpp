@@ -0,0 +1,303 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#include "./xmlpolygonbvh.h"
+
+using namespace XmlGeomUtils;
+
+static const size_t kMaxLeafSize = 4;
+static const size_t kMaxStackDepth = 64;
+
+static double Coord(const CPoint3d& pt, int axis) {
+  return axis == 0 ? pt.x() : (axis == 1 ? pt.y() : pt.z());
+}
+
+static double Coord(const CVector3d& vec, int axis) {
+  return axis == 0 ? vec.x() : (axis == 1 ? vec.y() : vec.z());
+}
+
+// Orders polygon indices by their centroid along one axis
+struct CCentroidLess {
+  CCentroidLess(const std::vector<CPoint3d>& centroids, int axis)
+    : centroids_(centroids), axis_(axis) {}
+
+  bool operator()(size_t a, size_t b) const {
+    return Coord(centroids_[a], axis_) < Coord(centroids_[b], axis_);
+  }
+
+  const std::vector<CPoint3d>& centroids_;
+  int axis_;
+};
+
+struct CXmlPolygonBvh::Ray {
+  CPoint3d origin_;
+  CVector3d direction_;
+  double inv_direction_[3];
+  double min_t_;
+  double max_t_;
+};
+
+CXmlPolygonBvh::CXmlPolygonBvh()
+  : geometry_(NULL) {
+}
+
+void CXmlPolygonBvh::Build(const CXmlWorldGeometry& geometry) {
+  geometry_ = &geometry;
+  nodes_.clear();
+  polygon_indices_.clear();
+
+  const std::vector<XmlWorldPolygon>& polygons = geometry.polygons();
+  if (polygons.empty())
+    return;
+
+  std::vector<CPoint3d> centroids(polygons.size());
+  polygon_indices_.resize(polygons.size());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    centroids[i] = (polygons[i].min_ + polygons[i].max_) * 0.5;
+    polygon_indices_[i] = i;
+  }
+
+  nodes_.reserve(2 * polygons.size() / kMaxLeafSize + 1);
+  BuildNode(0, polygons.size(), centroids);
+}
+
+size_t CXmlPolygonBvh::BuildNode(size_t begin, size_t end,
+                                 const std::vector<CPoint3d>& centroids) {
+  const std::vector<XmlWorldPolygon>& polygons = geometry_->polygons();
+
+  size_t node_index = nodes_.size();
+  nodes_.push_back(Node());
+
+  // Bounds of the faces and of their centroids
+  Node node;
+  double centroid_min[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+  double centroid_max[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+  for (int axis = 0; axis < 3; ++axis) {
+    node.min_[axis] = DBL_MAX;
+    node.max_[axis] = -DBL_MAX;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    const XmlWorldPolygon& polygon = polygons[polygon_indices_[i]];
+    const CPoint3d& centroid = centroids[polygon_indices_[i]];
+    for (int axis = 0; axis < 3; ++axis) {
+      node.min_[axis] = std::min(node.min_[axis], Coord(polygon.min_, axis));
+      node.max_[axis] = std::max(node.max_[axis], Coord(polygon.max_, axis));
+      centroid_min[axis] = std::min(centroid_min[axis], Coord(centroid, axis));
+      centroid_max[axis] = std::max(centroid_max[axis], Coord(centroid, axis));
+    }
+  }
+
+  // Split at the median along the widest centroid extent
+  int split_axis = 0;
+  double extent = -1.0;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (centroid_max[axis] - centroid_min[axis] > extent) {
+      extent = centroid_max[axis] - centroid_min[axis];
+      split_axis = axis;
+    }
+  }
+
+  if (end - begin <= kMaxLeafSize || extent <= 0.0) {
+    node.offset_ = begin;
+    node.count_ = end - begin;
+    nodes_[node_index] = node;
+    return node_index;
+  }
+
+  size_t middle = begin + (end - begin) / 2;
+  std::nth_element(polygon_indices_.begin() + begin,
+                   polygon_indices_.begin() + middle,
+                   polygon_indices_.begin() + end,
+                   CCentroidLess(centroids, split_axis));
+
+  BuildNode(begin, middle, centroids);
+  node.offset_ = BuildNode(middle, end, centroids);
+  node.count_ = 0;
+  nodes_[node_index] = node;
+  return node_index;
+}
+
+bool CXmlPolygonBvh::IsOccluded(const CPoint3d& origin,
+                                const CVector3d& direction,
+                                double min_t, double max_t) const {
+  Ray ray;
+  ray.origin_ = origin;
+  ray.direction_ = direction;
+  ray.min_t_ = min_t;
+  ray.max_t_ = max_t;
+  for (int axis = 0; axis < 3; ++axis) {
+    double d = Coord(direction, axis);
+    ray.inv_direction_[axis] = (d != 0.0) ? 1.0 / d : DBL_MAX;
+  }
+  double hit_t = 0.0;
+  size_t hit_polygon = 0;
+  return Traverse(ray, true, hit_t, hit_polygon);
+}
+
+bool CXmlPolygonBvh::Intersect(const CPoint3d& origin,
+                               const CVector3d& direction,
+                               double min_t, double max_t,
+                               double& hit_t, size_t& hit_polygon) const {
+  Ray ray;
+  ray.origin_ = origin;
+  ray.direction_ = direction;
+  ray.min_t_ = min_t;
+  ray.max_t_ = max_t;
+  for (int axis = 0; axis < 3; ++axis) {
+    double d = Coord(direction, axis);
+    ray.inv_direction_[axis] = (d != 0.0) ? 1.0 / d : DBL_MAX;
+  }
+  return Traverse(ray, false, hit_t, hit_polygon);
+}
+
+// Returns true if the box min..max touches the plane normal . p == offset
+static bool BoxTouchesPlane(const double* min, const double* max,
+                            const CVector3d& normal, double offset) {
+  double distance = -offset;
+  double radius = 0.0;
+  for (int axis = 0; axis < 3; ++axis) {
+    double n = Coord(normal, axis);
+    distance += n * 0.5 * (min[axis] + max[axis]);
+    radius += fabs(n) * 0.5 * (max[axis] - min[axis]);
+  }
+  return fabs(distance) <= radius;
+}
+
+void CXmlPolygonBvh::FindPolygons(const CVector3d& normal, double offset,
+                                  std::vector<size_t>& polygons) const {
+  polygons.clear();
+  if (nodes_.empty())
+    return;
+
+  const std::vector<XmlWorldPolygon>& world_polygons = geometry_->polygons();
+  size_t stack[kMaxStackDepth];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const Node& node = nodes_[stack[--stack_size]];
+    if (!BoxTouchesPlane(node.min_, node.max_, normal, offset))
+      continue;
+
+    if (node.count_ > 0) {
+      for (size_t i = 0; i < node.count_; ++i) {
+        size_t polygon = polygon_indices_[node.offset_ + i];
+        const XmlWorldPolygon& info = world_polygons[polygon];
+        double min[3] = { info.min_.x(), info.min_.y(), info.min_.z() };
+        double max[3] = { info.max_.x(), info.max_.y(), info.max_.z() };
+        if (BoxTouchesPlane(min, max, normal, offset))
+          polygons.push_back(polygon);
+      }
+    } else if (stack_size + 2 <= kMaxStackDepth) {
+      size_t node_index = &node - &nodes_[0];
+      stack[stack_size++] = node.offset_;
+      stack[stack_size++] = node_index + 1;
+    }
+  }
+}
+
+bool CXmlPolygonBvh::Traverse(const Ray& ray, bool any_hit, double& hit_t,
+                              size_t& hit_polygon) const {
+  if (nodes_.empty())
+    return false;
+
+  double closest_t = ray.max_t_;
+  bool found = false;
+
+  size_t stack[kMaxStackDepth];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const Node& node = nodes_[stack[--stack_size]];
+
+    // Slab test against the node bounds
+    double t_near = ray.min_t_;
+    double t_far = closest_t;
+    for (int axis = 0; axis < 3 && t_near <= t_far; ++axis) {
+      double o = Coord(ray.origin_, axis);
+      double t0 = (node.min_[axis] - o) * ray.inv_direction_[axis];
+      double t1 = (node.max_[axis] - o) * ray.inv_direction_[axis];
+      if (t0 > t1)
+        std::swap(t0, t1);
+      t_near = std::max(t_near, t0);
+      t_far = std::min(t_far, t1);
+    }
+    if (t_near > t_far)
+      continue;
+
+    if (node.count_ > 0) {
+      for (size_t i = 0; i < node.count_; ++i) {
+        size_t polygon = polygon_indices_[node.offset_ + i];
+        double t = 0.0;
+        if (HitPolygon(ray, polygon, closest_t, t)) {
+          found = true;
+          closest_t = t;
+          hit_polygon = polygon;
+          if (any_hit) {
+            hit_t = t;
+            return true;
+          }
+        }
+      }
+    } else if (stack_size + 2 <= kMaxStackDepth) {
+      size_t node_index = &node - &nodes_[0];
+      stack[stack_size++] = node.offset_;
+      stack[stack_size++] = node_index + 1;
+    }
+  }
+
+  if (found)
+    hit_t = closest_t;
+  return found;
+}
+
+bool CXmlPolygonBvh::HitPolygon(const Ray& ray, size_t polygon_index,
+                                double max_t, double& t) const {
+  const XmlWorldPolygon& polygon = geometry_->polygons()[polygon_index];
+  double denominator = polygon.normal_.Dot(ray.direction_);
+  if (fabs(denominator) < 1.0e-12)
+    return false;
+
+  CVector3d origin = ray.origin_ - CPoint3d();
+  t = (polygon.plane_d_ - polygon.normal_.Dot(origin)) / denominator;
+  if (t <= ray.min_t_ || t >= max_t)
+    return false;
+
+  // Even-odd test in the plane that drops the dominant normal axis
+  CPoint3d hit = ray.origin_ + ray.direction_ * t;
+  int drop_axis = 0;
+  double nx = fabs(polygon.normal_.x());
+  double ny = fabs(polygon.normal_.y());
+  double nz = fabs(polygon.normal_.z());
+  if (ny > nx && ny >= nz) {
+    drop_axis = 1;
+  } else if (nz > nx && nz > ny) {
+    drop_axis = 2;
+  }
+  int u_axis = (drop_axis + 1) % 3;
+  int v_axis = (drop_axis + 2) % 3;
+  double pu = Coord(hit, u_axis);
+  double pv = Coord(hit, v_axis);
+
+  const std::vector<CPoint3d>& points = geometry_->points();
+  const std::vector<XmlWorldLoop>& loops = geometry_->loops();
+  bool inside = false;
+  for (size_t l = 0; l < polygon.num_loops_; ++l) {
+    const XmlWorldLoop& loop = loops[polygon.first_loop_ + l];
+    const CPoint3d* loop_points = &points[loop.first_point_];
+    for (size_t i = 0, j = loop.num_points_ - 1; i < loop.num_points_;
+         j = i++) {
+      double au = Coord(loop_points[i], u_axis);
+      double av = Coord(loop_points[i], v_axis);
+      double bu = Coord(loop_points[j], u_axis);
+      double bv = Coord(loop_points[j], v_axis);
+      if ((av > pv) != (bv > pv) &&
+          pu < au + (pv - av) * (bu - au) / (bv - av)) {
+        inside = !inside;
+      }
+    }
+  }
+  return inside;
+}
@@ -0,0 +1,67 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPOLYGONBVH_H
+#define SKPTOXML_COMMON_XMLPOLYGONBVH_H
+
+#include <vector>
+
+#include "./xmlgeomutils.h"
+#include "./xmlworldgeometry.h"
+
+// CXmlPolygonBvh - A bounding volume hierarchy over the faces of a
+// CXmlWorldGeometry for ray queries. Faces are tested directly as planar
+// polygons with holes, so no triangulation is needed. The geometry must
+// outlive the hierarchy. Queries are const and safe to run concurrently.
+class CXmlPolygonBvh {
+ public:
+  CXmlPolygonBvh();
+
+  void Build(const CXmlWorldGeometry& geometry);
+
+  // Returns true if any face is hit by origin + t * direction for
+  // min_t < t < max_t.
+  bool IsOccluded(const XmlGeomUtils::CPoint3d& origin,
+                  const XmlGeomUtils::CVector3d& direction,
+                  double min_t, double max_t) const;
+
+  // Finds the closest face hit by the ray for min_t < t < max_t. Returns
+  // false if there is none.
+  bool Intersect(const XmlGeomUtils::CPoint3d& origin,
+                 const XmlGeomUtils::CVector3d& direction,
+                 double min_t, double max_t,
+                 double& hit_t, size_t& hit_polygon) const;
+
+  // Collects the faces whose bounds touch the plane normal . p == offset,
+  // in no particular order.
+  void FindPolygons(const XmlGeomUtils::CVector3d& normal, double offset,
+                    std::vector<size_t>& polygons) const;
+
+  size_t num_nodes() const { return nodes_.size(); }
+
+ private:
+  struct Node {
+    double min_[3];
+    double max_[3];
+    // Leaves: first entry in polygon_indices_. Interior nodes: index of the
+    // second child, the first child directly follows its parent.
+    size_t offset_;
+    // Number of polygons in a leaf, 0 for interior nodes
+    size_t count_;
+  };
+
+  struct Ray;
+
+  size_t BuildNode(size_t begin, size_t end,
+                   const std::vector<XmlGeomUtils::CPoint3d>& centroids);
+  bool Traverse(const Ray& ray, bool any_hit, double& hit_t,
+                size_t& hit_polygon) const;
+  bool HitPolygon(const Ray& ray, size_t polygon, double max_t,
+                  double& t) const;
+
+ private:
+  const CXmlWorldGeometry* geometry_;
+  std::vector<Node> nodes_;
+  std::vector<size_t> polygon_indices_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPOLYGONBVH_H
@@ -0,0 +1,67 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <errno.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef __APPLE__
+#include <crt_externs.h>
+#endif
+
+#include "./xmlprocessutils.h"
+
+#ifndef __APPLE__
+extern char** environ;
+#endif
+
+namespace XmlProcessUtils {
+
+namespace {
+
+// Bundles such as the exporter plugin cannot link against environ on Mac
+char** GetEnvironment() {
+#ifdef __APPLE__
+  return *_NSGetEnviron();
+#else
+  return environ;
+#endif
+}
+
+} // end anonymous namespace
+
+bool RunProcesses(const std::vector<std::vector<std::string> >& commands) {
+  bool ok = true;
+  std::vector<pid_t> pids;
+  for (size_t i = 0; i < commands.size(); ++i) {
+    const std::vector<std::string>& command = commands[i];
+    std::vector<char*> argv;
+    for (size_t k = 0; k < command.size(); ++k) {
+      argv.push_back(const_cast<char*>(command[k].c_str()));
+    }
+    argv.push_back(NULL);
+
+    pid_t pid = 0;
+    if (argv.size() > 1 &&
+        posix_spawnp(&pid, argv[0], NULL, NULL, &argv[0],
+                     GetEnvironment()) == 0) {
+      pids.push_back(pid);
+    } else {
+      ok = false;
+    }
+  }
+
+  // Wait for all the started ones, even after a failure
+  for (size_t i = 0; i < pids.size(); ++i) {
+    int status = 0;
+    pid_t result = 0;
+    do {
+      result = waitpid(pids[i], &status, 0);
+    } while (result == -1 && errno == EINTR);
+    ok = ok && result == pids[i] && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+  }
+  return ok;
+}
+
+} // end namespace XmlProcessUtils
@@ -0,0 +1,21 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPROCESSUTILS_H
+#define SKPTOXML_COMMON_XMLPROCESSUTILS_H
+
+#include <string>
+#include <vector>
+
+// Helpers to run work in child processes. Unlike threads these may each load
+// a model with the SketchUp API, every process has its own copy.
+
+namespace XmlProcessUtils {
+
+// Starts one process per command line, the first argument of each naming the
+// executable (looked up in PATH if it has no slash), and waits for all of
+// them. Returns false if one could not be started or did not exit with 0.
+bool RunProcesses(const std::vector<std::vector<std::string> >& commands);
+
+} // end namespace XmlProcessUtils
+
+#endif // SKPTOXML_COMMON_XMLPROCESSUTILS_H
@@ -0,0 +1,248 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "./xmlprogressivewriter.h"
+#include "./xmltriangulator.h"
+
+using namespace XmlGeomUtils;
+
+static const unsigned int kFileVersion = 1;
+// Levels after the first, a 65536th of the largest item is below anything
+// worth a separate pass
+static const int kDefaultMaxLevels = 16;
+
+namespace {
+
+// Little endian, as the hosts we build for
+template <typename T>
+void Append(T value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendPoint(const CPoint3d& point, std::string& out) {
+  Append(static_cast<float>(point.x()), out);
+  Append(static_cast<float>(point.y()), out);
+  Append(static_cast<float>(point.z()), out);
+}
+
+void AppendVector(const CVector3d& vector, std::string& out) {
+  Append(static_cast<float>(vector.x()), out);
+  Append(static_cast<float>(vector.y()), out);
+  Append(static_cast<float>(vector.z()), out);
+}
+
+void ExtendBounds(const CPoint3d& point, CPoint3d& min, CPoint3d& max) {
+  min.SetLocation(std::min(min.x(), point.x()), std::min(min.y(), point.y()),
+                  std::min(min.z(), point.z()));
+  max.SetLocation(std::max(max.x(), point.x()), std::max(max.y(), point.y()),
+                  std::max(max.z(), point.z()));
+}
+
+} // end anonymous namespace
+
+CXmlProgressiveWriter::CXmlProgressiveWriter(
+    const CXmlWorldGeometry& geometry)
+  : geometry_(geometry),
+    max_levels_(kDefaultMaxLevels) {
+}
+
+void CXmlProgressiveWriter::Build(const std::vector<bool>& duplicates) {
+  const std::vector<CPoint3d>& points = geometry_.points();
+  const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  items_.clear();
+  chunks_.clear();
+  items_.reserve(polygons.size() + segments.size());
+
+  // Faces, sized by the area of their triangles
+  CXmlTriangulator triangulator;
+  std::vector<size_t> loop_sizes;
+  std::vector<size_t> triangles;
+  first_triangle_.assign(1, 0);
+  polygon_triangles_.clear();
+  for (size_t p = 0; p < polygons.size(); ++p) {
+    const XmlWorldPolygon& polygon = polygons[p];
+    const XmlWorldLoop* loops = &geometry_.loops()[polygon.first_loop_];
+    loop_sizes.clear();
+    for (size_t l = 0; l < polygon.num_loops_; ++l) {
+      loop_sizes.push_back(loops[l].num_points_);
+    }
+    triangles.clear();
+    const CPoint3d* loop_points = &points[loops[0].first_point_];
+    triangulator.Triangulate(loop_points, &loop_sizes[0], loop_sizes.size(),
+                             triangles);
+    double area = 0.0;
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+      const CPoint3d& a = loop_points[triangles[t]];
+      area += (loop_points[triangles[t + 1]] - a).Cross(
+          loop_points[triangles[t + 2]] - a).Length() / 2.0;
+    }
+    for (size_t t = 0; t < triangles.size(); ++t) {
+      polygon_triangles_.push_back(
+          static_cast<unsigned int>(loops[0].first_point_ + triangles[t]));
+    }
+    first_triangle_.push_back(polygon_triangles_.size());
+
+    CItem item;
+    item.level_ = 0;
+    item.size_ = sqrt(area);
+    item.index_ = p;
+    item.is_segment_ = false;
+    items_.push_back(item);
+  }
+
+  // Outlines, sized by their length
+  for (size_t s = 0; s < segments.size(); ++s) {
+    if (s < duplicates.size() && duplicates[s])
+      continue;
+    CItem item;
+    item.level_ = 0;
+    item.size_ = (segments[s].end_ - segments[s].start_).Length();
+    item.index_ = s;
+    item.is_segment_ = true;
+    items_.push_back(item);
+  }
+
+  // Each level halves the size
+  double largest = 0.0;
+  for (size_t i = 0; i < items_.size(); ++i) {
+    largest = std::max(largest, items_[i].size_);
+  }
+  for (size_t i = 0; i < items_.size(); ++i) {
+    CItem& item = items_[i];
+    if (item.size_ <= 0.0) {
+      item.level_ = max_levels_;
+    } else {
+      double level = floor(log(largest / item.size_) / log(2.0));
+      item.level_ = static_cast<int>(std::min(std::max(level, 0.0),
+                                              double(max_levels_)));
+    }
+  }
+  std::stable_sort(items_.begin(), items_.end());
+
+  for (size_t i = 0; i < items_.size(); ++i) {
+    if (chunks_.empty() || chunks_.back().level_ != items_[i].level_) {
+      CChunk chunk;
+      chunk.level_ = items_[i].level_;
+      chunk.first_item_ = i;
+      chunks_.push_back(chunk);
+    }
+    chunks_.back().end_item_ = i + 1;
+  }
+}
+
+void CXmlProgressiveWriter::FormatChunk(const CChunk& chunk,
+                                        std::string& out) const {
+  const std::vector<CPoint3d>& points = geometry_.points();
+  const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+
+  // Points of the chunk's triangles, numbered in the order they are used
+  std::vector<unsigned int> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<int> triangle_groups;
+  std::vector<int> local_index(points.size(), -1);
+  size_t num_lines = 0;
+  double smallest = DBL_MAX;
+  for (size_t i = chunk.first_item_; i < chunk.end_item_; ++i) {
+    const CItem& item = items_[i];
+    smallest = std::min(smallest, item.size_);
+    if (item.is_segment_) {
+      ++num_lines;
+      continue;
+    }
+    int group = polygons[item.index_].group_;
+    for (size_t t = first_triangle_[item.index_];
+         t < first_triangle_[item.index_ + 1]; ++t) {
+      unsigned int point = polygon_triangles_[t];
+      if (local_index[point] < 0) {
+        local_index[point] = static_cast<int>(vertices.size());
+        vertices.push_back(point);
+      }
+      indices.push_back(static_cast<unsigned int>(local_index[point]));
+      if (t % 3 == 0)
+        triangle_groups.push_back(group);
+    }
+  }
+
+  std::string body;
+  Append(static_cast<unsigned int>(chunk.level_), body);
+  Append(static_cast<float>(smallest), body);
+  Append(static_cast<unsigned int>(vertices.size()), body);
+  Append(static_cast<unsigned int>(triangle_groups.size()), body);
+  Append(static_cast<unsigned int>(num_lines), body);
+  for (size_t v = 0; v < vertices.size(); ++v) {
+    AppendPoint(points[vertices[v]], body);
+  }
+  for (size_t t = 0; t < triangle_groups.size(); ++t) {
+    Append(indices[3 * t], body);
+    Append(indices[3 * t + 1], body);
+    Append(indices[3 * t + 2], body);
+    Append(triangle_groups[t], body);
+  }
+  for (size_t i = chunk.first_item_; i < chunk.end_item_; ++i) {
+    if (!items_[i].is_segment_)
+      continue;
+    const XmlWorldSegment& segment = segments[items_[i].index_];
+    AppendPoint(segment.start_, body);
+    AppendPoint(segment.end_, body);
+    AppendVector(segment.normal_, body);
+    Append(static_cast<int>(segment.group_), body);
+  }
+
+  out.assign("CHNK");
+  Append(static_cast<unsigned int>(body.size()), out);
+  out.append(body);
+}
+
+bool CXmlProgressiveWriter::Write(const std::string& filename) const {
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  // Bounds of the groups, the loose geometry last
+  const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  size_t num_groups = static_cast<size_t>(geometry_.num_groups());
+  std::vector<CPoint3d> mins(num_groups + 1,
+                             CPoint3d(DBL_MAX, DBL_MAX, DBL_MAX));
+  std::vector<CPoint3d> maxs(num_groups + 1,
+                             CPoint3d(-DBL_MAX, -DBL_MAX, -DBL_MAX));
+  for (size_t p = 0; p < polygons.size(); ++p) {
+    size_t group = polygons[p].group_ < 0 ? num_groups : polygons[p].group_;
+    ExtendBounds(polygons[p].min_, mins[group], maxs[group]);
+    ExtendBounds(polygons[p].max_, mins[group], maxs[group]);
+  }
+  for (size_t s = 0; s < segments.size(); ++s) {
+    size_t group = segments[s].group_ < 0 ? num_groups : segments[s].group_;
+    ExtendBounds(segments[s].start_, mins[group], maxs[group]);
+    ExtendBounds(segments[s].end_, mins[group], maxs[group]);
+  }
+
+  std::string header("SKPP");
+  Append(kFileVersion, header);
+  Append(static_cast<unsigned int>(num_groups), header);
+  Append(static_cast<unsigned int>(chunks_.size()), header);
+  for (size_t g = 0; g <= num_groups; ++g) {
+    if (mins[g].x() > maxs[g].x()) {
+      mins[g] = CPoint3d();
+      maxs[g] = CPoint3d();
+    }
+    AppendPoint(mins[g], header);
+    AppendPoint(maxs[g], header);
+  }
+  bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+  // One write per chunk
+  std::string chunk;
+  for (size_t c = 0; c < chunks_.size() && ok; ++c) {
+    FormatChunk(chunks_[c], chunk);
+    ok = fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+  }
+  ok &= fclose(file) == 0;
+  return ok;
+}
@@ -0,0 +1,90 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPROGRESSIVEWRITER_H
+#define SKPTOXML_COMMON_XMLPROGRESSIVEWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "./xmlworldgeometry.h"
+
+// CXmlProgressiveWriter - Writes the faces and outlines of a
+// CXmlWorldGeometry coarse content first, so that a viewer can draw the
+// model after reading the start of the file and refine it as the rest
+// comes in. Every face and outline segment gets a size while the geometry
+// is extracted, the square root of the area for faces and the length for
+// segments, and is sorted into levels: level 0 holds what is at least half
+// as large as the largest item, each further level half the size of the one
+// before, the last level everything smaller. Within a level larger items
+// come first. Segments flagged as duplicates are left out.
+//
+// The file is little endian, coordinates are floats in world space inches:
+//
+//   "SKPP" uint32 version, num_groups, num_chunks
+//   Bounds of the top level groups, then of the loose geometry:
+//     num_groups + 1 times float min[3], max[3]
+//   num_chunks times, one per non-empty level:
+//     "CHNK" uint32 byte size of the rest of the chunk, level
+//     float size of the smallest item in the chunk
+//     uint32 num_vertices, num_triangles, num_lines
+//     num_vertices times float x, y, z
+//     num_triangles times uint32 a, b, c, int32 group
+//     num_lines times float start[3], end[3], normal[3], int32 group
+//
+// Vertex indices are local to the chunk, so each chunk can be drawn once it
+// has been read. Groups are indices in the bounds table, -1 for loose
+// geometry. Stand-alone edges have a zero normal.
+class CXmlProgressiveWriter {
+ public:
+  explicit CXmlProgressiveWriter(const CXmlWorldGeometry& geometry);
+
+  // Sizes, triangulates and sorts the geometry. duplicates holds one flag
+  // per geometry segment, or is empty.
+  void Build(const std::vector<bool>& duplicates);
+
+  // Returns false if the file could not be written
+  bool Write(const std::string& filename) const;
+
+  // Number of levels below the first one, smaller items go in the last
+  void set_max_levels(int levels) { max_levels_ = levels; }
+
+  size_t num_chunks() const { return chunks_.size(); }
+
+ private:
+  // A face or segment with its place in the output order
+  struct CItem {
+    int level_;
+    double size_;
+    // Index in geometry_.polygons(), or in geometry_.segments() with
+    // is_segment_ set
+    size_t index_;
+    bool is_segment_;
+
+    bool operator<(const CItem& other) const {
+      if (level_ != other.level_) return level_ < other.level_;
+      return size_ > other.size_;
+    }
+  };
+
+  // The items [first_item_, end_item_) of one level
+  struct CChunk {
+    int level_;
+    size_t first_item_;
+    size_t end_item_;
+  };
+
+  void FormatChunk(const CChunk& chunk, std::string& out) const;
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  int max_levels_;
+
+  std::vector<CItem> items_;
+  std::vector<CChunk> chunks_;
+  // Triangles of each polygon, as 3 point indices each, in
+  // polygon_triangles_[first_triangle_[p], first_triangle_[p + 1])
+  std::vector<size_t> first_triangle_;
+  std::vector<unsigned int> polygon_triangles_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPROGRESSIVEWRITER_H
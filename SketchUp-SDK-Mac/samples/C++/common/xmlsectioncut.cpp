@@ -0,0 +1,276 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <algorithm>
+#include <utility>
+
+#include "./xmlsectioncut.h"
+#include "./xmlthreadutils.h"
+
+using namespace XmlGeomUtils;
+
+// Faces closer to parallel to the plane than this are not cut
+static const double kParallelTolerance = 1.0e-12;
+// End points closer than this are joined (inches, relative to the model)
+static const double kAbsoluteTolerance = 1.0e-6;
+static const double kRelativeTolerance = 1.0e-7;
+static const size_t kSectionsPerChunk = 1;
+
+namespace {
+
+struct CSegment {
+  CPoint3d start_;
+  CPoint3d end_;
+};
+
+// Where a loop side crosses the plane, ordered along the cut line
+struct CCrossing {
+  double position_;
+  CPoint3d point_;
+
+  bool operator<(const CCrossing& other) const {
+    return position_ < other.position_;
+  }
+};
+
+// A point snapped to the joining tolerance
+struct CPointKey {
+  double x_;
+  double y_;
+  double z_;
+
+  bool operator<(const CPointKey& other) const {
+    if (x_ != other.x_) return x_ < other.x_;
+    if (y_ != other.y_) return y_ < other.y_;
+    return z_ < other.z_;
+  }
+  bool operator==(const CPointKey& other) const {
+    return x_ == other.x_ && y_ == other.y_ && z_ == other.z_;
+  }
+};
+
+bool IsLess(const CPoint3d& a, const CPoint3d& b) {
+  if (a.x() != b.x()) return a.x() < b.x();
+  if (a.y() != b.y()) return a.y() < b.y();
+  return a.z() < b.z();
+}
+
+// Cuts one face, adding the parts of the cut line inside it to segments.
+// Vertices on the plane count as being in front of it so that a face
+// touching the plane with one side yields that side only once.
+void CutPolygon(const CXmlWorldGeometry& geometry, size_t polygon_index,
+                const CVector3d& normal, double offset,
+                std::vector<CCrossing>& crossings,
+                std::vector<CSegment>& segments) {
+  const XmlWorldPolygon& polygon = geometry.polygons()[polygon_index];
+  CVector3d direction = normal.Cross(polygon.normal_);
+  if (direction.LengthSquared() < kParallelTolerance)
+    return;
+  direction.Normalize();
+
+  crossings.clear();
+  for (size_t l = 0; l < polygon.num_loops_; ++l) {
+    const XmlWorldLoop& loop = geometry.loops()[polygon.first_loop_ + l];
+    const CPoint3d* points = &geometry.points()[loop.first_point_];
+    for (size_t i = 0; i < loop.num_points_; ++i) {
+      CPoint3d a = points[i];
+      CPoint3d b = points[(i + 1) % loop.num_points_];
+      double da = normal.Dot(a - CPoint3d()) - offset;
+      double db = normal.Dot(b - CPoint3d()) - offset;
+      if ((da >= 0.0) == (db >= 0.0))
+        continue;
+      // The neighbouring face computes the same point from the same side
+      if (IsLess(b, a)) {
+        std::swap(a, b);
+        std::swap(da, db);
+      }
+      CCrossing crossing;
+      crossing.point_ = a + (b - a) * (da / (da - db));
+      crossing.position_ = direction.Dot(crossing.point_ - CPoint3d());
+      crossings.push_back(crossing);
+    }
+  }
+
+  // Even-odd: the line is inside the face between pairs of crossings
+  std::sort(crossings.begin(), crossings.end());
+  for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+    if (crossings[i].position_ < crossings[i + 1].position_) {
+      CSegment segment;
+      segment.start_ = crossings[i].point_;
+      segment.end_ = crossings[i + 1].point_;
+      segments.push_back(segment);
+    }
+  }
+}
+
+// Joins segments sharing end points into polylines. Chains run between
+// end and branch points first, what is left forms closed loops.
+class CPolylineBuilder {
+ public:
+  CPolylineBuilder(const std::vector<CSegment>& segments, double tolerance)
+    : segments_(segments) {
+    JoinEndPoints(tolerance);
+  }
+
+  void Build(std::vector<XmlCurveInfo>& polylines) {
+    for (size_t v = 0; v < vertex_points_.size(); ++v) {
+      if (Degree(v) != 2) {
+        while (cursors_[v] < offsets_[v + 1])
+          Follow(v, polylines);
+      }
+    }
+    for (size_t v = 0; v < vertex_points_.size(); ++v) {
+      while (cursors_[v] < offsets_[v + 1])
+        Follow(v, polylines);
+    }
+  }
+
+ private:
+  void JoinEndPoints(double tolerance) {
+    size_t num_ends = segments_.size() * 2;
+    std::vector<std::pair<CPointKey, size_t> > keys(num_ends);
+    for (size_t i = 0; i < num_ends; ++i) {
+      const CPoint3d& pt = (i % 2 == 0) ? segments_[i / 2].start_ :
+                                          segments_[i / 2].end_;
+      CPointKey key = { floor(pt.x() / tolerance + 0.5),
+                        floor(pt.y() / tolerance + 0.5),
+                        floor(pt.z() / tolerance + 0.5) };
+      keys[i] = std::make_pair(key, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    end_vertices_.resize(num_ends);
+    for (size_t i = 0; i < num_ends; ++i) {
+      if (i == 0 || !(keys[i].first == keys[i - 1].first)) {
+        size_t end = keys[i].second;
+        vertex_points_.push_back((end % 2 == 0) ? segments_[end / 2].start_ :
+                                                  segments_[end / 2].end_);
+      }
+      end_vertices_[keys[i].second] = vertex_points_.size() - 1;
+    }
+
+    // Segments around each vertex, collapsed ones left out
+    size_t num_vertices = vertex_points_.size();
+    offsets_.assign(num_vertices + 1, 0);
+    for (size_t s = 0; s < segments_.size(); ++s) {
+      if (end_vertices_[s * 2] != end_vertices_[s * 2 + 1]) {
+        offsets_[end_vertices_[s * 2] + 1]++;
+        offsets_[end_vertices_[s * 2 + 1] + 1]++;
+      }
+    }
+    for (size_t v = 0; v < num_vertices; ++v) {
+      offsets_[v + 1] += offsets_[v];
+    }
+    incident_.resize(offsets_[num_vertices]);
+    std::vector<size_t> fill(offsets_.begin(), offsets_.end() - 1);
+    for (size_t s = 0; s < segments_.size(); ++s) {
+      if (end_vertices_[s * 2] != end_vertices_[s * 2 + 1]) {
+        incident_[fill[end_vertices_[s * 2]]++] = s;
+        incident_[fill[end_vertices_[s * 2 + 1]]++] = s;
+      }
+    }
+    cursors_.assign(offsets_.begin(), offsets_.end() - 1);
+    used_.assign(segments_.size(), false);
+  }
+
+  size_t Degree(size_t v) const {
+    return offsets_[v + 1] - offsets_[v];
+  }
+
+  // Returns the next unused segment at v, or false if there is none
+  bool NextSegment(size_t v, size_t& segment) {
+    while (cursors_[v] < offsets_[v + 1]) {
+      segment = incident_[cursors_[v]++];
+      if (!used_[segment])
+        return true;
+    }
+    return false;
+  }
+
+  void Follow(size_t start, std::vector<XmlCurveInfo>& polylines) {
+    XmlCurveInfo polyline;
+    size_t v = start;
+    size_t segment = 0;
+    while (NextSegment(v, segment)) {
+      used_[segment] = true;
+      size_t next = end_vertices_[segment * 2] == v ?
+                    end_vertices_[segment * 2 + 1] : end_vertices_[segment * 2];
+      XmlEdgeInfo edge;
+      edge.start_ = vertex_points_[v];
+      edge.end_ = vertex_points_[next];
+      polyline.edges_.push_back(edge);
+      v = next;
+      if (Degree(v) != 2)
+        break;
+    }
+    if (!polyline.edges_.empty())
+      polylines.push_back(polyline);
+  }
+
+  const std::vector<CSegment>& segments_;
+  std::vector<CPoint3d> vertex_points_;
+  // Vertex of each segment end, start and end interleaved
+  std::vector<size_t> end_vertices_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> incident_;
+  std::vector<size_t> cursors_;
+  std::vector<bool> used_;
+};
+
+class CSectionTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CSectionTask(const CXmlSectionCutter& cutter,
+               std::vector<XmlSectionInfo>& sections)
+    : cutter_(cutter), sections_(sections) {}
+
+  void Run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      cutter_.Cut(sections_[i]);
+    }
+  }
+
+ private:
+  const CXmlSectionCutter& cutter_;
+  std::vector<XmlSectionInfo>& sections_;
+};
+
+} // end anonymous namespace
+
+CXmlSectionCutter::CXmlSectionCutter(const CXmlWorldGeometry& geometry,
+                                     const CXmlPolygonBvh& bvh)
+  : geometry_(geometry),
+    bvh_(bvh) {
+}
+
+void CXmlSectionCutter::Cut(XmlSectionInfo& info) const {
+  info.polylines_.clear();
+  CVector3d normal = info.normal_;
+  double length = normal.Length();
+  if (length <= 0.0)
+    return;
+  normal /= length;
+  double offset = info.offset_ / length;
+
+  // Document order keeps the output stable
+  std::vector<size_t> polygons;
+  bvh_.FindPolygons(normal, offset, polygons);
+  std::sort(polygons.begin(), polygons.end());
+
+  std::vector<CCrossing> crossings;
+  std::vector<CSegment> segments;
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    CutPolygon(geometry_, polygons[i], normal, offset, crossings, segments);
+  }
+  if (segments.empty())
+    return;
+
+  double tolerance = kAbsoluteTolerance + kRelativeTolerance *
+                     (geometry_.max() - geometry_.min()).Length();
+  CPolylineBuilder builder(segments, tolerance);
+  builder.Build(info.polylines_);
+}
+
+void CXmlSectionCutter::CutAll(std::vector<XmlSectionInfo>& sections) const {
+  CSectionTask task(*this, sections);
+  XmlThreadUtils::RunParallel(task, sections.size(), kSectionsPerChunk);
+}
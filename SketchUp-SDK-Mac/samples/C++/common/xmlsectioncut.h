@@ -0,0 +1,34 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLSECTIONCUT_H
+#define SKPTOXML_COMMON_XMLSECTIONCUT_H
+
+#include <vector>
+
+#include "./xmlfile.h"
+#include "./xmlpolygonbvh.h"
+#include "./xmlworldgeometry.h"
+
+// CXmlSectionCutter - Computes section outlines, where a plane cuts the faces
+// of a CXmlWorldGeometry. The hierarchy narrows the search down to the faces
+// straddling the plane, each of them is cut into the segments lying inside
+// it (holes included), and the segments are chained into polylines through
+// their shared end points. Cuts are const and safe to run concurrently.
+class CXmlSectionCutter {
+ public:
+  CXmlSectionCutter(const CXmlWorldGeometry& geometry,
+                    const CXmlPolygonBvh& bvh);
+
+  // Fills info.polylines_ with the cut by the plane of info. The normal does
+  // not need to be unit length.
+  void Cut(XmlSectionInfo& info) const;
+
+  // Cuts all the sections, in parallel
+  void CutAll(std::vector<XmlSectionInfo>& sections) const;
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  const CXmlPolygonBvh& bvh_;
+};
+
+#endif // SKPTOXML_COMMON_XMLSECTIONCUT_H
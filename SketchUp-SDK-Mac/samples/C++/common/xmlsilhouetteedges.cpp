@@ -0,0 +1,175 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "./xmlsilhouetteedges.h"
+#include "./xmlexternalsort.h"
+
+using namespace XmlGeomUtils;
+
+static const unsigned int kFileVersion = 1;
+static const double kDefaultCreaseAngle = 30.0;
+static const double kPi = 3.14159265358979323846;
+
+namespace {
+
+bool PointLess(const CPoint3d& a, const CPoint3d& b) {
+  if (a.x() != b.x()) return a.x() < b.x();
+  if (a.y() != b.y()) return a.y() < b.y();
+  return a.z() < b.z();
+}
+
+bool PointEqual(const CPoint3d& a, const CPoint3d& b) {
+  return a.x() == b.x() && a.y() == b.y() && a.z() == b.z();
+}
+
+// A segment by its end points, the smaller one first. The two sides of an
+// edge are transformed alike, so their end points match exactly.
+struct CSegmentEntry {
+  int group_;
+  CPoint3d low_;
+  CPoint3d high_;
+  size_t segment_;
+
+  bool operator<(const CSegmentEntry& other) const {
+    if (group_ != other.group_) return group_ < other.group_;
+    if (PointLess(low_, other.low_)) return true;
+    if (PointLess(other.low_, low_)) return false;
+    if (PointLess(high_, other.high_)) return true;
+    if (PointLess(other.high_, high_)) return false;
+    return segment_ < other.segment_;
+  }
+  bool SameEdge(const CSegmentEntry& other) const {
+    return group_ == other.group_ && PointEqual(low_, other.low_) &&
+           PointEqual(high_, other.high_);
+  }
+};
+
+struct CFirstSegmentLess {
+  bool operator()(const XmlSilhouetteEdge& a,
+                  const XmlSilhouetteEdge& b) const {
+    return a.first_segment_ < b.first_segment_;
+  }
+};
+
+template <typename T>
+void Append(T value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendPoint(const CPoint3d& point, std::string& out) {
+  Append(static_cast<float>(point.x()), out);
+  Append(static_cast<float>(point.y()), out);
+  Append(static_cast<float>(point.z()), out);
+}
+
+void AppendVector(const CVector3d& vector, std::string& out) {
+  Append(static_cast<float>(vector.x()), out);
+  Append(static_cast<float>(vector.y()), out);
+  Append(static_cast<float>(vector.z()), out);
+}
+
+} // end anonymous namespace
+
+CXmlSilhouetteEdgeWriter::CXmlSilhouetteEdgeWriter(
+    const CXmlWorldGeometry& geometry)
+  : geometry_(geometry),
+    crease_angle_(kDefaultCreaseAngle),
+    max_sort_bytes_(0),
+    num_spilled_runs_(0) {
+}
+
+void CXmlSilhouetteEdgeWriter::Build() {
+  const std::vector<XmlWorldSegment>& segments = geometry_.segments();
+  edges_.clear();
+
+  CXmlExternalSorter<CSegmentEntry> sorter(max_sort_bytes_);
+  for (size_t s = 0; s < segments.size(); ++s) {
+    const XmlWorldSegment& segment = segments[s];
+    if (!segment.outline_ || PointEqual(segment.start_, segment.end_))
+      continue;
+    CSegmentEntry entry;
+    entry.group_ = segment.group_;
+    bool forward = PointLess(segment.start_, segment.end_);
+    entry.low_ = forward ? segment.start_ : segment.end_;
+    entry.high_ = forward ? segment.end_ : segment.start_;
+    entry.segment_ = s;
+    sorter.Add(entry);
+  }
+  sorter.Finish();
+
+  double crease_cos = cos(crease_angle_ * kPi / 180.0);
+  std::vector<size_t> sides;
+  CSegmentEntry entry;
+  bool more = sorter.Next(entry);
+  while (more) {
+    CSegmentEntry first = entry;
+    sides.clear();
+    do {
+      sides.push_back(entry.segment_);
+      more = sorter.Next(entry);
+    } while (more && entry.SameEdge(first));
+
+    // The sides in document order, stand-alone edges have no normal
+    const XmlWorldSegment& segment = segments[sides[0]];
+    XmlSilhouetteEdge edge;
+    edge.start_ = segment.start_;
+    edge.end_ = segment.end_;
+    edge.flags_ = 0;
+    edge.layer_ = (segment.layer_ >= 0 && segment.layer_ < kNoLayer) ?
+        static_cast<unsigned short>(segment.layer_) : kNoLayer;
+    edge.first_segment_ = sides[0];
+    size_t num_faces = 0;
+    for (size_t i = 0; i < sides.size(); ++i) {
+      const XmlWorldSegment& side = segments[sides[i]];
+      if (side.soft_)
+        edge.flags_ |= kSoftFlag;
+      if (side.normal_.LengthSquared() == 0.0)
+        continue;
+      if (num_faces == 0)
+        edge.normal_a_ = side.normal_;
+      else if (num_faces == 1)
+        edge.normal_b_ = side.normal_;
+      ++num_faces;
+    }
+
+    if (num_faces == 0) {
+      edge.flags_ |= kLooseFlag;
+    } else if (num_faces == 1) {
+      edge.flags_ |= kBorderFlag;
+    } else {
+      if (num_faces > 2)
+        edge.flags_ |= kNonManifoldFlag;
+      if (edge.normal_a_.Dot(edge.normal_b_) < crease_cos)
+        edge.flags_ |= kCreaseFlag;
+    }
+    edges_.push_back(edge);
+  }
+  num_spilled_runs_ = sorter.num_spilled_runs();
+  std::sort(edges_.begin(), edges_.end(), CFirstSegmentLess());
+}
+
+bool CXmlSilhouetteEdgeWriter::Write(const std::string& filename) const {
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  std::string out("SKPE");
+  Append(kFileVersion, out);
+  Append(static_cast<unsigned int>(edges_.size()), out);
+  for (size_t e = 0; e < edges_.size(); ++e) {
+    const XmlSilhouetteEdge& edge = edges_[e];
+    AppendPoint(edge.start_, out);
+    AppendPoint(edge.end_, out);
+    AppendVector(edge.normal_a_, out);
+    AppendVector(edge.normal_b_, out);
+    Append(edge.flags_, out);
+    Append(edge.layer_, out);
+  }
+
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  ok &= fclose(file) == 0;
+  return ok;
+}
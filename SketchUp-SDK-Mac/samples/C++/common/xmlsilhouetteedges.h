@@ -0,0 +1,88 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLSILHOUETTEEDGES_H
+#define SKPTOXML_COMMON_XMLSILHOUETTEEDGES_H
+
+#include <string>
+#include <vector>
+
+#include "./xmlworldgeometry.h"
+
+// An edge with the normals of the faces on either side
+struct XmlSilhouetteEdge {
+  XmlGeomUtils::CPoint3d start_;
+  XmlGeomUtils::CPoint3d end_;
+  // Zero where there is no face
+  XmlGeomUtils::CVector3d normal_a_;
+  XmlGeomUtils::CVector3d normal_b_;
+  // Combination of CXmlSilhouetteEdgeWriter::kXxxFlag
+  unsigned short flags_;
+  // Index in the Layers section, kNoLayer if unknown
+  unsigned short layer_;
+  // First segment of the edge in the geometry, for the output order
+  size_t first_segment_;
+};
+
+// CXmlSilhouetteEdgeWriter - Writes each edge of a CXmlWorldGeometry once,
+// with the normals of both faces it bounds, so that a vertex shader can
+// decide every frame whether it is part of the silhouette: an edge is on it
+// where one face turns towards the camera and the other away. The geometry
+// holds one segment per loop side, the two sides of an edge shared by two
+// faces are paired by their end points within a top level group. Segments
+// only partly overlapping stay separate edges. Segments whose outlines the
+// export hints turn off are left out. The pairing sort goes through a
+// CXmlExternalSorter and spills to temporary files under a memory cap.
+//
+// The file is little endian, coordinates are floats in world space inches:
+//
+//   "SKPE" uint32 version, num_edges
+//   num_edges times 52 bytes:
+//     float start[3], end[3], normal_a[3], normal_b[3]
+//     uint16 flags, layer
+//
+// Edges are in the order of their first segment.
+class CXmlSilhouetteEdgeWriter {
+ public:
+  // Faces meet at more than the crease angle
+  static const unsigned short kCreaseFlag = 1;
+  // Soft or smooth in SketchUp, drawn only on the silhouette
+  static const unsigned short kSoftFlag = 2;
+  // Bounds one face only, normal_b is zero
+  static const unsigned short kBorderFlag = 4;
+  // Bounds no face, both normals are zero
+  static const unsigned short kLooseFlag = 8;
+  // Bounds more than two faces, the first two give the normals
+  static const unsigned short kNonManifoldFlag = 16;
+
+  static const unsigned short kNoLayer = 0xffff;
+
+  explicit CXmlSilhouetteEdgeWriter(const CXmlWorldGeometry& geometry);
+
+  // Pairs the segments into edges
+  void Build();
+
+  // Returns false if the file could not be written
+  bool Write(const std::string& filename) const;
+
+  // Angle between the face normals above which an edge is a crease,
+  // 30 degrees unless set
+  void set_crease_angle(double degrees) { crease_angle_ = degrees; }
+
+  // Memory for the pairing sort, 0 for no limit
+  void set_max_sort_bytes(size_t bytes) { max_sort_bytes_ = bytes; }
+
+  // Sorted runs the last Build wrote to temporary files
+  size_t num_spilled_runs() const { return num_spilled_runs_; }
+
+  const std::vector<XmlSilhouetteEdge>& edges() const { return edges_; }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  double crease_angle_;
+  size_t max_sort_bytes_;
+  size_t num_spilled_runs_;
+
+  std::vector<XmlSilhouetteEdge> edges_;
+};
+
+#endif // SKPTOXML_COMMON_XMLSILHOUETTEEDGES_H
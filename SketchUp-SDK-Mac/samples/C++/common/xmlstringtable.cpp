@@ -0,0 +1,79 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <string.h>
+
+#include "./xmlstringtable.h"
+
+static const size_t kInitialSlots = 64;
+
+// FNV-1a
+static size_t HashString(const char* str) {
+  size_t hash = 2166136261u;
+  for (const unsigned char* c = reinterpret_cast<const unsigned char*>(str);
+       *c != '\0'; ++c) {
+    hash = (hash ^ *c) * 16777619u;
+  }
+  return hash;
+}
+
+CXmlStringTable::CXmlStringTable() {
+  Clear();
+}
+
+void CXmlStringTable::Clear() {
+  strings_.clear();
+  hashes_.clear();
+  slots_.assign(kInitialSlots, 0);
+  Intern("");
+}
+
+void CXmlStringTable::Swap(CXmlStringTable& other) {
+  strings_.swap(other.strings_);
+  hashes_.swap(other.hashes_);
+  slots_.swap(other.slots_);
+}
+
+size_t CXmlStringTable::FindSlot(const char* str, size_t hash) const {
+  size_t mask = slots_.size() - 1;
+  size_t slot = hash & mask;
+  while (slots_[slot] != 0) {
+    int id = slots_[slot] - 1;
+    if (hashes_[id] == hash && strcmp(strings_[id].c_str(), str) == 0)
+      break;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+int CXmlStringTable::Find(const char* str) const {
+  size_t slot = FindSlot(str, HashString(str));
+  return slots_[slot] - 1;
+}
+
+int CXmlStringTable::Intern(const char* str) {
+  size_t hash = HashString(str);
+  size_t slot = FindSlot(str, hash);
+  if (slots_[slot] != 0)
+    return slots_[slot] - 1;
+
+  int id = static_cast<int>(strings_.size());
+  strings_.push_back(str);
+  hashes_.push_back(hash);
+  slots_[slot] = id + 1;
+
+  // Keep the load under one half
+  if (strings_.size() * 2 > slots_.size())
+    Grow();
+  return id;
+}
+
+void CXmlStringTable::Grow() {
+  slots_.assign(slots_.size() * 2, 0);
+  size_t mask = slots_.size() - 1;
+  for (size_t id = 0; id < strings_.size(); ++id) {
+    size_t slot = hashes_[id] & mask;
+    while (slots_[slot] != 0)
+      slot = (slot + 1) & mask;
+    slots_[slot] = static_cast<int>(id) + 1;
+  }
+}
@@ -0,0 +1,43 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLSTRINGTABLE_H
+#define SKPTOXML_COMMON_XMLSTRINGTABLE_H
+
+#include <string>
+#include <vector>
+
+// CXmlStringTable - Interns the layer, material and definition names of a
+// model so that every face, edge and instance refers to them by a small id
+// instead of holding its own copy. Ids are dense and stable, id 0 is always
+// the empty string. Lookups hash the characters directly, interning a name
+// already in the table does not allocate.
+class CXmlStringTable {
+ public:
+  CXmlStringTable();
+
+  // Returns the id of str, adding it if needed
+  int Intern(const char* str);
+  int Intern(const std::string& str) { return Intern(str.c_str()); }
+
+  // Returns the id of str, or -1 if it is not in the table
+  int Find(const char* str) const;
+
+  const std::string& Get(int id) const { return strings_[id]; }
+  size_t size() const { return strings_.size(); }
+
+  void Clear();
+  void Swap(CXmlStringTable& other);
+
+ private:
+  size_t FindSlot(const char* str, size_t hash) const;
+  void Grow();
+
+ private:
+  std::vector<std::string> strings_;
+  std::vector<size_t> hashes_;
+  // Open addressing, each slot holds an id + 1, 0 for free slots. The size
+  // is a power of two.
+  std::vector<int> slots_;
+};
+
+#endif // SKPTOXML_COMMON_XMLSTRINGTABLE_H
@@ -0,0 +1,92 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "./xmlthreadutils.h"
+
+namespace XmlThreadUtils {
+
+namespace {
+
+// Shared state of one RunParallel call. Chunks are handed out under a mutex,
+// the grain size keeps the locking cost negligible.
+struct CWorkQueue {
+  CParallelTask* task_;
+  size_t count_;
+  size_t grain_size_;
+  size_t next_;
+  pthread_mutex_t mutex_;
+
+  bool NextChunk(size_t& begin, size_t& end) {
+    pthread_mutex_lock(&mutex_);
+    begin = next_;
+    end = (count_ - next_ > grain_size_) ? next_ + grain_size_ : count_;
+    next_ = end;
+    pthread_mutex_unlock(&mutex_);
+    return begin < end;
+  }
+};
+
+void* WorkerMain(void* param) {
+  CWorkQueue* queue = static_cast<CWorkQueue*>(param);
+  size_t begin = 0;
+  size_t end = 0;
+  while (queue->NextChunk(begin, end)) {
+    queue->task_->Run(begin, end);
+  }
+  return NULL;
+}
+
+} // end anonymous namespace
+
+int GetNumCores() {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? static_cast<int>(cores) : 1;
+}
+
+void RunParallel(CParallelTask& task, size_t count, size_t grain_size,
+                 int num_threads) {
+  if (count == 0)
+    return;
+  if (grain_size == 0)
+    grain_size = 1;
+  if (num_threads <= 0)
+    num_threads = GetNumCores();
+
+  size_t num_chunks = (count + grain_size - 1) / grain_size;
+  if (num_chunks < static_cast<size_t>(num_threads))
+    num_threads = static_cast<int>(num_chunks);
+
+  if (num_threads <= 1) {
+    task.Run(0, count);
+    return;
+  }
+
+  CWorkQueue queue;
+  queue.task_ = &task;
+  queue.count_ = count;
+  queue.grain_size_ = grain_size;
+  queue.next_ = 0;
+  pthread_mutex_init(&queue.mutex_, NULL);
+
+  // The calling thread works too
+  std::vector<pthread_t> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, WorkerMain, &queue) == 0) {
+      threads.push_back(thread);
+    }
+  }
+  WorkerMain(&queue);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&queue.mutex_);
+}
+
+} // end namespace XmlThreadUtils
@@ -0,0 +1,34 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLTHREADUTILS_H
+#define SKPTOXML_COMMON_XMLTHREADUTILS_H
+
+#include <stddef.h>
+
+// Minimal thread pool helpers for the offline processing passes. These never
+// call into the SketchUp API, which must only be used from the calling thread.
+
+namespace XmlThreadUtils {
+
+// A unit of work that can be split into independent index ranges.
+class CParallelTask {
+ public:
+  virtual ~CParallelTask() {}
+
+  // Processes items [begin, end). Called concurrently from several threads
+  // with disjoint ranges.
+  virtual void Run(size_t begin, size_t end) = 0;
+};
+
+// Number of hardware threads, at least 1
+int GetNumCores();
+
+// Splits [0, count) into chunks of at most grain_size items and hands them
+// out to num_threads threads (0 means one per core). Returns once every
+// chunk has been processed. Runs inline if only one thread is needed.
+void RunParallel(CParallelTask& task, size_t count, size_t grain_size,
+                 int num_threads = 0);
+
+} // end namespace XmlThreadUtils
+
+#endif // SKPTOXML_COMMON_XMLTHREADUTILS_H
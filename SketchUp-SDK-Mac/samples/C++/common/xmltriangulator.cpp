@@ -0,0 +1,275 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+
+#include "./xmltriangulator.h"
+
+using namespace XmlGeomUtils;
+
+namespace {
+
+// Holes are bridged rightmost first, so that later bridges cannot cross
+// earlier ones.
+struct CHoleOrder {
+  size_t first_;
+  size_t count_;
+  double max_x_;
+
+  bool operator<(const CHoleOrder& other) const {
+    return max_x_ > other.max_x_;
+  }
+};
+
+} // end anonymous namespace
+
+bool CXmlTriangulator::Triangulate(const CPoint3d* points,
+                                   const size_t* loop_sizes,
+                                   size_t num_loops,
+                                   std::vector<size_t>& triangles) {
+  if (num_loops == 0 || loop_sizes[0] < 3)
+    return false;
+  size_t num_points = 0;
+  for (size_t l = 0; l < num_loops; ++l) {
+    num_points += loop_sizes[l];
+  }
+  if (!Project(points, loop_sizes[0], num_points))
+    return false;
+
+  polygon_.clear();
+  for (size_t i = 0; i < loop_sizes[0]; ++i) {
+    polygon_.push_back(i);
+  }
+
+  std::vector<CHoleOrder> holes;
+  size_t first = loop_sizes[0];
+  for (size_t l = 1; l < num_loops; ++l) {
+    if (loop_sizes[l] >= 3) {
+      CHoleOrder hole;
+      hole.first_ = first;
+      hole.count_ = loop_sizes[l];
+      hole.max_x_ = -DBL_MAX;
+      for (size_t i = 0; i < hole.count_; ++i) {
+        hole.max_x_ = std::max(hole.max_x_, xs_[first + i]);
+      }
+      holes.push_back(hole);
+    }
+    first += loop_sizes[l];
+  }
+  std::sort(holes.begin(), holes.end());
+
+  bool ok = true;
+  for (size_t h = 0; h < holes.size(); ++h) {
+    ok &= BridgeHole(holes[h].first_, holes[h].count_);
+  }
+  ok &= ClipEars(triangles);
+  return ok;
+}
+
+bool CXmlTriangulator::Project(const CPoint3d* points, size_t outer_size,
+                               size_t num_points) {
+  // Newell's normal of the outer loop
+  CVector3d normal;
+  for (size_t i = 0; i < outer_size; ++i) {
+    const CPoint3d& a = points[i];
+    const CPoint3d& b = points[(i + 1) % outer_size];
+    normal += CVector3d((a.y() - b.y()) * (a.z() + b.z()),
+                        (a.z() - b.z()) * (a.x() + b.x()),
+                        (a.x() - b.x()) * (a.y() + b.y()));
+  }
+  if (normal.LengthSquared() <= 0.0)
+    return false;
+
+  // Drop the dominant axis, negating u when the normal points down it so
+  // that the outer loop runs counterclockwise
+  xs_.resize(num_points);
+  ys_.resize(num_points);
+  double nx = fabs(normal.x()), ny = fabs(normal.y()), nz = fabs(normal.z());
+  for (size_t i = 0; i < num_points; ++i) {
+    const CPoint3d& p = points[i];
+    if (nz >= nx && nz >= ny) {
+      xs_[i] = normal.z() > 0.0 ? p.x() : -p.x();
+      ys_[i] = p.y();
+    } else if (ny >= nx) {
+      xs_[i] = normal.y() > 0.0 ? p.z() : -p.z();
+      ys_[i] = p.x();
+    } else {
+      xs_[i] = normal.x() > 0.0 ? p.y() : -p.y();
+      ys_[i] = p.z();
+    }
+  }
+  return true;
+}
+
+double CXmlTriangulator::Cross(size_t a, size_t b, size_t c) const {
+  return (xs_[b] - xs_[a]) * (ys_[c] - ys_[a]) -
+         (ys_[b] - ys_[a]) * (xs_[c] - xs_[a]);
+}
+
+bool CXmlTriangulator::BridgeHole(size_t first, size_t count) {
+  // Holes run clockwise against the outer loop
+  double area = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    size_t a = first + i;
+    size_t b = first + (i + 1) % count;
+    area += xs_[a] * ys_[b] - xs_[b] * ys_[a];
+  }
+  bool reverse = area > 0.0;
+
+  // The rightmost hole vertex sees the polygon along +x
+  size_t m = first;
+  for (size_t i = 1; i < count; ++i) {
+    if (xs_[first + i] > xs_[m])
+      m = first + i;
+  }
+  double mx = xs_[m], my = ys_[m];
+
+  size_t num_nodes = polygon_.size();
+  size_t edge = num_nodes;
+  double best_x = DBL_MAX;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    size_t a = polygon_[i];
+    size_t b = polygon_[(i + 1) % num_nodes];
+    if ((ys_[a] > my) == (ys_[b] > my) || ys_[a] == ys_[b])
+      continue;
+    double x = xs_[a] + (my - ys_[a]) * (xs_[b] - xs_[a]) / (ys_[b] - ys_[a]);
+    if (x >= mx && x < best_x) {
+      best_x = x;
+      edge = i;
+    }
+  }
+  if (edge == num_nodes)
+    return false;
+
+  // The end of the hit edge furthest along the ray, unless a reflex vertex
+  // inside the triangle it forms with the ray blocks the view
+  size_t target = xs_[polygon_[edge]] > xs_[polygon_[(edge + 1) % num_nodes]] ?
+                  edge : (edge + 1) % num_nodes;
+  size_t p = polygon_[target];
+  if (best_x != xs_[p] || my != ys_[p]) {
+    double best_tan = DBL_MAX;
+    double best_dist = DBL_MAX;
+    for (size_t i = 0; i < num_nodes; ++i) {
+      size_t v = polygon_[i];
+      size_t prev = polygon_[(i + num_nodes - 1) % num_nodes];
+      size_t next = polygon_[(i + 1) % num_nodes];
+      if (i == target || xs_[v] < mx || Cross(prev, v, next) > 0.0)
+        continue;
+      // Inside the triangle m, (best_x, my), p, edges included
+      double dy = ys_[v] - my;
+      double py = ys_[p] - my;
+      if ((py >= 0.0) ? (dy < 0.0 || dy > py) : (dy > 0.0 || dy < py))
+        continue;
+      double t = (py != 0.0) ? dy / py : 0.0;
+      double edge_x = best_x + t * (xs_[p] - best_x);
+      if (xs_[v] > edge_x)
+        continue;
+      double dx = xs_[v] - mx;
+      double tangent = dx > 0.0 ? fabs(dy) / dx : DBL_MAX;
+      double dist = dx * dx + dy * dy;
+      if (tangent < best_tan || (tangent == best_tan && dist < best_dist)) {
+        best_tan = tangent;
+        best_dist = dist;
+        target = i;
+      }
+    }
+  }
+
+  // target, m, the hole around back to m, target again
+  merged_.clear();
+  merged_.insert(merged_.end(), polygon_.begin(),
+                 polygon_.begin() + target + 1);
+  for (size_t i = 0; i <= count; ++i) {
+    size_t offset = m - first;
+    size_t k = reverse ? (offset + count - i % count) % count :
+                         (offset + i) % count;
+    merged_.push_back(first + k);
+  }
+  merged_.insert(merged_.end(), polygon_.begin() + target, polygon_.end());
+  polygon_.swap(merged_);
+  return true;
+}
+
+bool CXmlTriangulator::IsEar(size_t node) const {
+  size_t a = polygon_[prev_[node]];
+  size_t b = polygon_[node];
+  size_t c = polygon_[next_[node]];
+  for (size_t n = next_[next_[node]]; n != prev_[node]; n = next_[n]) {
+    if (!reflex_[n])
+      continue;
+    size_t p = polygon_[n];
+    // Bridges repeat points, those touch the ear without being inside
+    if ((xs_[p] == xs_[a] && ys_[p] == ys_[a]) ||
+        (xs_[p] == xs_[b] && ys_[p] == ys_[b]) ||
+        (xs_[p] == xs_[c] && ys_[p] == ys_[c])) {
+      continue;
+    }
+    if (Cross(a, b, p) >= 0.0 && Cross(b, c, p) >= 0.0 &&
+        Cross(c, a, p) >= 0.0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CXmlTriangulator::ClipEars(std::vector<size_t>& triangles) {
+  size_t count = polygon_.size();
+  prev_.resize(count);
+  next_.resize(count);
+  reflex_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    prev_[i] = (i + count - 1) % count;
+    next_[i] = (i + 1) % count;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    reflex_[i] = Cross(polygon_[prev_[i]], polygon_[i],
+                       polygon_[next_[i]]) <= 0.0;
+  }
+
+  bool ok = true;
+  size_t node = 0;
+  size_t misses = 0;
+  while (count > 3) {
+    double area = Cross(polygon_[prev_[node]], polygon_[node],
+                        polygon_[next_[node]]);
+    bool clip = area > 0.0 && IsEar(node);
+    bool degenerate = area == 0.0;
+    if (!clip && !degenerate && misses > count) {
+      // No ear left, the loops overlap or are not planar enough
+      clip = true;
+      ok = false;
+    }
+    if (!clip && !degenerate) {
+      node = next_[node];
+      ++misses;
+      continue;
+    }
+
+    if (clip) {
+      triangles.push_back(polygon_[prev_[node]]);
+      triangles.push_back(polygon_[node]);
+      triangles.push_back(polygon_[next_[node]]);
+    }
+    size_t before = prev_[node];
+    size_t after = next_[node];
+    next_[before] = after;
+    prev_[after] = before;
+    --count;
+    reflex_[before] = Cross(polygon_[prev_[before]], polygon_[before],
+                            polygon_[after]) <= 0.0;
+    reflex_[after] = Cross(polygon_[before], polygon_[after],
+                           polygon_[next_[after]]) <= 0.0;
+    node = before;
+    misses = 0;
+  }
+
+  if (Cross(polygon_[prev_[node]], polygon_[node],
+            polygon_[next_[node]]) != 0.0) {
+    triangles.push_back(polygon_[prev_[node]]);
+    triangles.push_back(polygon_[node]);
+    triangles.push_back(polygon_[next_[node]]);
+  }
+  return ok;
+}
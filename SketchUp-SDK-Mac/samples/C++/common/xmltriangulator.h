@@ -0,0 +1,49 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLTRIANGULATOR_H
+#define SKPTOXML_COMMON_XMLTRIANGULATOR_H
+
+#include <vector>
+
+#include "./xmlgeomutils.h"
+
+// CXmlTriangulator - Splits planar faces, holes included, into triangles by
+// ear clipping. The face is projected onto the axis plane it is most
+// parallel to, each hole is joined to the outer loop by a bridge edge
+// towards a vertex visible from it, and ears are cut off the resulting
+// simple polygon. Only reflex vertices can lie inside an ear, so those are
+// the only ones tested. The scratch buffers are kept between calls, use one
+// triangulator per thread.
+class CXmlTriangulator {
+ public:
+  CXmlTriangulator() {}
+
+  // points holds the loops one after the other, the outer loop first, with
+  // loop_sizes[i] points in loop i. Appends 3 point indices per triangle,
+  // wound like the outer loop. Returns false if the face is degenerate or
+  // had to be cut without proper ears; what could be cut is still added.
+  bool Triangulate(const XmlGeomUtils::CPoint3d* points,
+                   const size_t* loop_sizes, size_t num_loops,
+                   std::vector<size_t>& triangles);
+
+ private:
+  bool Project(const XmlGeomUtils::CPoint3d* points, size_t outer_size,
+               size_t num_points);
+  double Cross(size_t a, size_t b, size_t c) const;
+  bool BridgeHole(size_t first, size_t count);
+  bool IsEar(size_t node) const;
+  bool ClipEars(std::vector<size_t>& triangles);
+
+ private:
+  // Projected points
+  std::vector<double> xs_;
+  std::vector<double> ys_;
+  // The polygon being cut, as point indices, then as a ring of nodes
+  std::vector<size_t> polygon_;
+  std::vector<size_t> prev_;
+  std::vector<size_t> next_;
+  std::vector<bool> reflex_;
+  std::vector<size_t> merged_;
+};
+
+#endif // SKPTOXML_COMMON_XMLTRIANGULATOR_H
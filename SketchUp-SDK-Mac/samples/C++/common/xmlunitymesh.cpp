@@ -0,0 +1,267 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <float.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "./xmlunitymesh.h"
+
+using namespace XmlGeomUtils;
+
+// Unity units are meters
+static const double kMetersPerInch = 0.0254;
+// Defaults of ModelPostProcessor.cs
+static const double kDefaultLineWidth = 0.06;
+static const double kDefaultUvScale = 1.0;
+
+// Meshes with more vertices need 32 bit indices
+static const size_t kMaxShortIndexVertices = 65535;
+// Mesh channels: position, normal, color and uv0, as a bitmask of Unity's
+// kShaderChannel values
+static const int kCurrentChannels = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3);
+// Layer of the segments without one, the largest 16 bit index
+static const float kNoLayer = 65535.0f;
+
+namespace {
+
+// Writes bytes as hex through a buffer, Unity keeps buffers as raw bytes in
+// lower case hex
+class CHexWriter {
+ public:
+  explicit CHexWriter(FILE* file) : file_(file), used_(0), ok_(true) {}
+
+  void Write(const void* data, size_t bytes) {
+    static const char kDigits[] = "0123456789abcdef";
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+      if (used_ + 2 > sizeof(buffer_))
+        Flush();
+      buffer_[used_++] = kDigits[in[i] >> 4];
+      buffer_[used_++] = kDigits[in[i] & 0xF];
+    }
+  }
+
+  bool Flush() {
+    ok_ = ok_ && fwrite(buffer_, 1, used_, file_) == used_;
+    used_ = 0;
+    return ok_;
+  }
+
+ private:
+  FILE* file_;
+  char buffer_[65536];
+  size_t used_;
+  bool ok_;
+};
+
+void WriteVector(FILE* file, const char* indent, const char* name,
+                 const double value[3]) {
+  fprintf(file, "%s%s: {x: %.9g, y: %.9g, z: %.9g}\n", indent, name,
+          value[0], value[1], value[2]);
+}
+
+void WriteBounds(FILE* file, const char* indent, const double center[3],
+                 const double extent[3]) {
+  WriteVector(file, indent, "m_Center", center);
+  WriteVector(file, indent, "m_Extent", extent);
+}
+
+void WritePackedFloats(FILE* file, const char* name) {
+  fprintf(file, "    %s:\n"
+                "      m_NumItems: 0\n"
+                "      m_Range: 0\n"
+                "      m_Start: 0\n"
+                "      m_Data: \n"
+                "      m_BitSize: 0\n", name);
+}
+
+void WritePackedInts(FILE* file, const char* name) {
+  fprintf(file, "    %s:\n"
+                "      m_NumItems: 0\n"
+                "      m_Data: \n"
+                "      m_BitSize: 0\n", name);
+}
+
+} // end anonymous namespace
+
+CXmlUnityLineMesh::CXmlUnityLineMesh()
+  : line_width_(kDefaultLineWidth),
+    uv_scale_(kDefaultUvScale) {
+}
+
+void CXmlUnityLineMesh::Build(const CXmlWorldGeometry& geometry,
+                              const std::vector<bool>& duplicates) {
+  vertices_.clear();
+  const std::vector<XmlWorldSegment>& segments = geometry.segments();
+  double w = line_width_ / 2.0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const XmlWorldSegment& segment = segments[i];
+    if (segment.normal_.LengthSquared() <= 0.0 ||
+        (i < duplicates.size() && duplicates[i])) {
+      continue;
+    }
+    CPoint3d s = CPoint3d() + (segment.start_ - CPoint3d()) * kMetersPerInch;
+    CPoint3d e = CPoint3d() + (segment.end_ - CPoint3d()) * kMetersPerInch;
+    CVector3d side = (e - s).Cross(segment.normal_);
+    if (!side.Normalize())
+      continue;
+
+    CPoint3d quad[4] = { s + side * -w, s + side * w,
+                         e + side * -w, e + side * w };
+    // RecalculateNormals, both triangles of the quad share theirs
+    CVector3d normal = (quad[1] - quad[0]).Cross(quad[2] - quad[0]);
+    normal.Normalize();
+    double v = (quad[2] - quad[0]).Length() * uv_scale_;
+    double uvs[4][2] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 0.0, v }, { 1.0, v } };
+    float layer = (segment.layer_ >= 0 && segment.layer_ < kNoLayer) ?
+        static_cast<float>(segment.layer_) : kNoLayer;
+    for (int k = 0; k < 4; ++k) {
+      CVertex vertex;
+      vertex.position_[0] = static_cast<float>(quad[k].x());
+      vertex.position_[1] = static_cast<float>(quad[k].y());
+      vertex.position_[2] = static_cast<float>(quad[k].z());
+      vertex.normal_[0] = static_cast<float>(normal.x());
+      vertex.normal_[1] = static_cast<float>(normal.y());
+      vertex.normal_[2] = static_cast<float>(normal.z());
+      vertex.color_[0] = segment.color_.red;
+      vertex.color_[1] = segment.color_.green;
+      vertex.color_[2] = segment.color_.blue;
+      vertex.color_[3] = segment.color_.alpha;
+      vertex.uv_[0] = static_cast<float>(uvs[k][0]);
+      vertex.uv_[1] = static_cast<float>(uvs[k][1]);
+      vertex.uv_[2] = layer;
+      vertices_.push_back(vertex);
+    }
+  }
+}
+
+bool CXmlUnityLineMesh::WriteAsset(const std::string& filename,
+                                   const std::string& name) const {
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  size_t num_vertices = vertices_.size();
+  size_t num_indices = num_quads() * 6;
+  bool long_indices = num_vertices > kMaxShortIndexVertices;
+  double min[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+  double max[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+  for (size_t i = 0; i < num_vertices; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      min[k] = std::min(min[k], static_cast<double>(vertices_[i].position_[k]));
+      max[k] = std::max(max[k], static_cast<double>(vertices_[i].position_[k]));
+    }
+  }
+  double center[3] = { 0.0, 0.0, 0.0 };
+  double extent[3] = { 0.0, 0.0, 0.0 };
+  if (num_vertices > 0) {
+    for (int k = 0; k < 3; ++k) {
+      center[k] = (min[k] + max[k]) / 2.0;
+      extent[k] = (max[k] - min[k]) / 2.0;
+    }
+  }
+
+  fprintf(file, "%%YAML 1.1\n"
+                "%%TAG !u! tag:unity3d.com,2011:\n"
+                "--- !u!43 &4300000\n"
+                "Mesh:\n"
+                "  m_ObjectHideFlags: 0\n"
+                "  m_PrefabParentObject: {fileID: 0}\n"
+                "  m_PrefabInternal: {fileID: 0}\n"
+                "  m_Name: %s\n"
+                "  serializedVersion: 9\n"
+                "  m_SubMeshes:\n"
+                "  - serializedVersion: 2\n"
+                "    firstByte: 0\n"
+                "    indexCount: %lu\n"
+                "    topology: 0\n"
+                "    baseVertex: 0\n"
+                "    firstVertex: 0\n"
+                "    vertexCount: %lu\n"
+                "    localAABB:\n",
+          name.c_str(), static_cast<unsigned long>(num_indices),
+          static_cast<unsigned long>(num_vertices));
+  WriteBounds(file, "      ", center, extent);
+  fprintf(file, "  m_Shapes:\n"
+                "    vertices: []\n"
+                "    shapes: []\n"
+                "    channels: []\n"
+                "    fullWeights: []\n"
+                "  m_BindPose: []\n"
+                "  m_BoneNameHashes: \n"
+                "  m_RootBoneNameHash: 0\n"
+                "  m_MeshCompression: 0\n"
+                "  m_IsReadable: 1\n"
+                "  m_KeepVertices: 1\n"
+                "  m_KeepIndices: 1\n"
+                "  m_IndexFormat: %d\n"
+                "  m_IndexBuffer: ", long_indices ? 1 : 0);
+
+  // Quads as in AddLine: 0 1 2, 1 3 2. Quads share no vertices, so this
+  // order already transforms each vertex once and is left to the vertex
+  // cache as it is.
+  CHexWriter hex(file);
+  static const unsigned int kQuadIndices[6] = { 0, 1, 2, 1, 3, 2 };
+  for (size_t q = 0; q < num_quads(); ++q) {
+    for (int k = 0; k < 6; ++k) {
+      unsigned int index = static_cast<unsigned int>(q * 4 + kQuadIndices[k]);
+      if (long_indices) {
+        hex.Write(&index, sizeof(index));
+      } else {
+        unsigned short short_index = static_cast<unsigned short>(index);
+        hex.Write(&short_index, sizeof(short_index));
+      }
+    }
+  }
+  hex.Flush();
+
+  fprintf(file, "\n"
+                "  m_Skin: []\n"
+                "  m_VertexData:\n"
+                "    m_CurrentChannels: %d\n"
+                "    m_VertexCount: %lu\n"
+                "    m_Channels:\n",
+          kCurrentChannels, static_cast<unsigned long>(num_vertices));
+  // vertex, normal, color, uv0 to uv3, tangent. Colors are 4 bytes
+  // (format 2), the rest floats (format 0).
+  static const int kChannelOffsets[8] = { 0, 12, 24, 28, 0, 0, 0, 0 };
+  static const int kChannelFormats[8] = { 0, 0, 2, 0, 0, 0, 0, 0 };
+  static const int kChannelDimensions[8] = { 3, 3, 4, 3, 0, 0, 0, 0 };
+  for (int c = 0; c < 8; ++c) {
+    fprintf(file, "    - stream: 0\n"
+                  "      offset: %d\n"
+                  "      format: %d\n"
+                  "      dimension: %d\n",
+            kChannelOffsets[c], kChannelFormats[c], kChannelDimensions[c]);
+  }
+  fprintf(file, "    m_DataSize: %lu\n"
+                "    _typelessdata: ",
+          static_cast<unsigned long>(num_vertices * sizeof(CVertex)));
+  // Little endian floats, as on the hosts we build for
+  if (num_vertices > 0)
+    hex.Write(&vertices_[0], num_vertices * sizeof(CVertex));
+  hex.Flush();
+
+  fprintf(file, "\n  m_CompressedMesh:\n");
+  WritePackedFloats(file, "m_Vertices");
+  WritePackedFloats(file, "m_UV");
+  WritePackedFloats(file, "m_Normals");
+  WritePackedFloats(file, "m_Tangents");
+  WritePackedInts(file, "m_Weights");
+  WritePackedInts(file, "m_NormalSigns");
+  WritePackedInts(file, "m_TangentSigns");
+  WritePackedFloats(file, "m_FloatColors");
+  WritePackedInts(file, "m_BoneIndices");
+  WritePackedInts(file, "m_Triangles");
+  fprintf(file, "    m_UVInfo: 0\n"
+                "  m_LocalAABB:\n");
+  WriteBounds(file, "    ", center, extent);
+  fprintf(file, "  m_MeshUsageFlags: 0\n"
+                "  m_BakedConvexCollisionMesh: \n"
+                "  m_BakedTriangleCollisionMesh: \n"
+                "  m_MeshOptimized: 0\n");
+
+  bool ok = hex.Flush() && !ferror(file);
+  ok &= fclose(file) == 0;
+  return ok;
+}
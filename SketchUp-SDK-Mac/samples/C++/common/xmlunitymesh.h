@@ -0,0 +1,55 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLUNITYMESH_H
+#define SKPTOXML_COMMON_XMLUNITYMESH_H
+
+#include <string>
+#include <vector>
+
+#include "./xmlworldgeometry.h"
+
+// CXmlUnityLineMesh - Builds the outline mesh ModelPostProcessor.cs makes on
+// import, one quad per face outline segment lying in the plane of the face,
+// and writes it as a Unity mesh asset the importer only has to reference.
+// Vertices, normals and uvs follow MakeQuad, AddLine and RecalculateNormals:
+// meters in SketchUp's axes (the lines object carries the change of axes)
+// and v running along the line. Each vertex also carries its edge's color
+// (RGBA8 in the colors channel) and layer (uv0.z, the index in the Layers
+// section, 65535 if unknown), so that the outlines of the whole model draw
+// with one shared material whose shader colors them and drops the layers
+// that are hidden. The asset is in Unity's text serialization (2017.3 and
+// later) with the vertex and index buffers hex encoded.
+class CXmlUnityLineMesh {
+ public:
+  CXmlUnityLineMesh();
+
+  // Adds a quad per segment of a face, leaving out the stand-alone edges,
+  // zero length segments and the flagged duplicates (may be empty)
+  void Build(const CXmlWorldGeometry& geometry,
+             const std::vector<bool>& duplicates);
+
+  // Returns false if the file could not be written
+  bool WriteAsset(const std::string& filename, const std::string& name) const;
+
+  // ModelPostProcessor.lineWidth, in meters
+  void set_line_width(double meters) { line_width_ = meters; }
+  // ModelPostProcessor.scale, uv length per meter of line
+  void set_uv_scale(double scale) { uv_scale_ = scale; }
+
+  size_t num_quads() const { return vertices_.size() / 4; }
+
+ private:
+  // Unity's stream layout: position, normal, color, uv0
+  struct CVertex {
+    float position_[3];
+    float normal_[3];
+    unsigned char color_[4];
+    float uv_[3];
+  };
+
+  std::vector<CVertex> vertices_;
+  double line_width_;
+  double uv_scale_;
+};
+
+#endif // SKPTOXML_COMMON_XMLUNITYMESH_H
@@ -0,0 +1,268 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <math.h>
+#include <algorithm>
+
+#include "./xmlvertexcache.h"
+#include "./xmlthreadutils.h"
+
+// Simulated LRU cache of the reordering, larger than the hardware's so
+// that the order also suits GPUs with bigger caches
+static const size_t kCacheSize = 32;
+// FIFO cache the misses are counted with
+static const size_t kFifoSize = 16;
+// Forsyth's weights. The last three vertices used score a little lower so
+// that strips do not just continue along the newest edge.
+static const float kLastTriangleScore = 0.75f;
+static const float kCacheDecayPower = 1.5f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+// Vertices used by more triangles get the score of this many
+static const size_t kMaxValence = 32;
+// Triangles reordered as one piece by OptimizeInChunks
+static const size_t kTrianglesPerChunk = 16384;
+// Chunks with at most one miss in this many above loading each vertex once
+// are not worth reordering. The hub of a fan with more than 16 triangles
+// falls out of the cache whatever the order.
+static const size_t kExtraMissesFraction = 8;
+
+static const unsigned int kUnused = static_cast<unsigned int>(-1);
+
+namespace {
+
+void GetIndexRange(const unsigned int* indices, size_t num_indices,
+                   unsigned int& min_index, unsigned int& max_index) {
+  min_index = indices[0];
+  max_index = indices[0];
+  for (size_t i = 1; i < num_indices; ++i) {
+    min_index = std::min(min_index, indices[i]);
+    max_index = std::max(max_index, indices[i]);
+  }
+}
+
+class COptimizeTask : public XmlThreadUtils::CParallelTask {
+ public:
+  COptimizeTask(std::vector<unsigned int>& triangles,
+                std::vector<XmlVertexCacheInfo>& infos)
+    : triangles_(triangles), infos_(infos) {}
+
+  void Run(size_t begin, size_t end) {
+    CXmlVertexCacheOptimizer optimizer;
+    for (size_t c = begin; c < end; ++c) {
+      size_t first = c * kTrianglesPerChunk * 3;
+      size_t count = std::min(kTrianglesPerChunk * 3,
+                              triangles_.size() / 3 * 3 - first);
+      unsigned int* indices = &triangles_[first];
+      XmlVertexCacheInfo& info = infos_[c];
+      info.triangles_ = count / 3;
+      size_t num_vertices = 0;
+      info.misses_before_ = CXmlVertexCacheOptimizer::CountCacheMisses(
+          indices, count, &num_vertices);
+      info.misses_after_ = info.misses_before_;
+      if (info.misses_before_ >
+          num_vertices + num_vertices / kExtraMissesFraction) {
+        optimizer.Optimize(indices, count);
+        info.misses_after_ =
+            CXmlVertexCacheOptimizer::CountCacheMisses(indices, count);
+      }
+    }
+  }
+
+ private:
+  std::vector<unsigned int>& triangles_;
+  std::vector<XmlVertexCacheInfo>& infos_;
+};
+
+} // end anonymous namespace
+
+void CXmlVertexCacheOptimizer::Optimize(unsigned int* indices,
+                                        size_t num_indices) {
+  size_t num_triangles = num_indices / 3;
+  if (num_triangles < 2)
+    return;
+
+  if (position_scores_.empty()) {
+    for (size_t i = 0; i < kCacheSize; ++i) {
+      position_scores_.push_back(i < 3 ? kLastTriangleScore :
+          static_cast<float>(pow(1.0 - double(i - 3) / (kCacheSize - 3),
+                                 double(kCacheDecayPower))));
+    }
+    valence_scores_.push_back(0.0f);
+    for (size_t i = 1; i <= kMaxValence; ++i) {
+      valence_scores_.push_back(static_cast<float>(
+          kValenceBoostScale * pow(double(i), -double(kValenceBoostPower))));
+    }
+  }
+
+  // Triangles around each vertex
+  unsigned int min_index;
+  unsigned int max_index;
+  GetIndexRange(indices, num_triangles * 3, min_index, max_index);
+  size_t num_vertices = max_index - min_index + 1;
+  live_triangles_.assign(num_vertices, 0);
+  for (size_t i = 0; i < num_triangles * 3; ++i) {
+    ++live_triangles_[indices[i] - min_index];
+  }
+  first_triangle_.assign(num_vertices + 1, 0);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    first_triangle_[v + 1] = first_triangle_[v] + live_triangles_[v];
+  }
+  vertex_triangles_.resize(num_triangles * 3);
+  live_triangles_.assign(num_vertices, 0);
+  for (size_t i = 0; i < num_triangles * 3; ++i) {
+    size_t v = indices[i] - min_index;
+    vertex_triangles_[first_triangle_[v] + live_triangles_[v]++] =
+        static_cast<unsigned int>(i / 3);
+  }
+
+  vertex_score_.assign(num_vertices, 0.0f);
+  triangle_score_.assign(num_triangles, 0.0f);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    UpdateVertex(v, -1);
+  }
+
+  // Start with the best triangle, ties going to the first
+  long best = 0;
+  for (size_t t = 1; t < num_triangles; ++t) {
+    if (triangle_score_[t] > triangle_score_[best])
+      best = static_cast<long>(t);
+  }
+
+  drawn_.assign(num_triangles, false);
+  output_.resize(num_triangles * 3);
+  std::vector<size_t> cache;
+  std::vector<size_t> next_cache;
+  size_t next_undrawn = 0;
+  for (size_t n = 0; n < num_triangles; ++n) {
+    if (best < 0) {
+      while (drawn_[next_undrawn])
+        ++next_undrawn;
+      best = static_cast<long>(next_undrawn);
+    }
+    const unsigned int* triangle = &indices[best * 3];
+    drawn_[best] = true;
+    next_cache.clear();
+    for (size_t k = 0; k < 3; ++k) {
+      output_[n * 3 + k] = triangle[k];
+
+      // No longer live around its vertices
+      size_t v = triangle[k] - min_index;
+      unsigned int* around = &vertex_triangles_[first_triangle_[v]];
+      unsigned int* end = around + live_triangles_[v];
+      unsigned int* found = std::find(around, end, best);
+      if (found != end) {
+        std::swap(*found, *(end - 1));
+        --live_triangles_[v];
+      }
+      if (std::find(next_cache.begin(), next_cache.end(), v) ==
+          next_cache.end())
+        next_cache.push_back(v);
+    }
+
+    // The triangle's vertices move to the front of the cache
+    size_t num_front = next_cache.size();
+    for (size_t i = 0; i < cache.size(); ++i) {
+      if (std::find(next_cache.begin(), next_cache.begin() + num_front,
+                    cache[i]) == next_cache.begin() + num_front)
+        next_cache.push_back(cache[i]);
+    }
+    for (size_t i = 0; i < next_cache.size(); ++i) {
+      UpdateVertex(next_cache[i], i < kCacheSize ? static_cast<int>(i) : -1);
+    }
+    if (next_cache.size() > kCacheSize)
+      next_cache.resize(kCacheSize);
+    cache.swap(next_cache);
+
+    // The best triangle around the cache
+    best = -1;
+    float best_score = -1.0f;
+    for (size_t i = 0; i < cache.size(); ++i) {
+      size_t v = cache[i];
+      for (size_t j = first_triangle_[v];
+           j < first_triangle_[v] + live_triangles_[v]; ++j) {
+        unsigned int t = vertex_triangles_[j];
+        if (triangle_score_[t] > best_score) {
+          best = t;
+          best_score = triangle_score_[t];
+        }
+      }
+    }
+  }
+  std::copy(output_.begin(), output_.end(), indices);
+}
+
+void CXmlVertexCacheOptimizer::UpdateVertex(size_t vertex,
+                                            int cache_position) {
+  size_t live = live_triangles_[vertex];
+  float score = 0.0f;
+  if (live > 0) {
+    if (cache_position >= 0)
+      score = position_scores_[cache_position];
+    score += valence_scores_[std::min(live, kMaxValence)];
+  }
+  float delta = score - vertex_score_[vertex];
+  vertex_score_[vertex] = score;
+  for (size_t j = first_triangle_[vertex];
+       j < first_triangle_[vertex] + live; ++j) {
+    triangle_score_[vertex_triangles_[j]] += delta;
+  }
+}
+
+size_t CXmlVertexCacheOptimizer::CountCacheMisses(const unsigned int* indices,
+                                                  size_t num_indices,
+                                                  size_t* num_vertices) {
+  if (num_vertices != NULL)
+    *num_vertices = 0;
+  if (num_indices == 0)
+    return 0;
+  unsigned int min_index;
+  unsigned int max_index;
+  GetIndexRange(indices, num_indices, min_index, max_index);
+
+  // A vertex is in the cache if fewer than kFifoSize misses followed its own
+  std::vector<size_t> loaded_at(max_index - min_index + 1, 0);
+  size_t time = kFifoSize + 1;
+  size_t misses = 0;
+  size_t used = 0;
+  for (size_t i = 0; i < num_indices; ++i) {
+    size_t& loaded = loaded_at[indices[i] - min_index];
+    if (loaded == 0)
+      ++used;
+    if (time - loaded > kFifoSize) {
+      loaded = time++;
+      ++misses;
+    }
+  }
+  if (num_vertices != NULL)
+    *num_vertices = used;
+  return misses;
+}
+
+void CXmlVertexCacheOptimizer::OptimizeInChunks(
+    std::vector<unsigned int>& triangles, bool parallel,
+    XmlVertexCacheInfo& info) {
+  size_t num_triangles = triangles.size() / 3;
+  size_t num_chunks = (num_triangles + kTrianglesPerChunk - 1) /
+                      kTrianglesPerChunk;
+  std::vector<XmlVertexCacheInfo> infos(num_chunks);
+  COptimizeTask task(triangles, infos);
+  XmlThreadUtils::RunParallel(task, num_chunks, 1, parallel ? 0 : 1);
+  for (size_t c = 0; c < num_chunks; ++c) {
+    info.Add(infos[c]);
+  }
+}
+
+void CXmlVertexCacheOptimizer::GetFirstUseOrder(
+    const std::vector<unsigned int>& indices, size_t num_vertices,
+    std::vector<unsigned int>& remap) {
+  remap.assign(num_vertices, kUnused);
+  unsigned int next = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    if (indices[i] < num_vertices && remap[indices[i]] == kUnused)
+      remap[indices[i]] = next++;
+  }
+  for (size_t v = 0; v < num_vertices; ++v) {
+    if (remap[v] == kUnused)
+      remap[v] = next++;
+  }
+}
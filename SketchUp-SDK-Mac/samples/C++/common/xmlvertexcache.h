@@ -0,0 +1,90 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLVERTEXCACHE_H
+#define SKPTOXML_COMMON_XMLVERTEXCACHE_H
+
+#include <stddef.h>
+#include <vector>
+
+// Vertex cache misses of an index buffer, before and after reordering. The
+// average cache miss ratio (ACMR) is misses per triangle: 3 without any
+// reuse, 0.5 for a large regular grid drawn in the best order.
+struct XmlVertexCacheInfo {
+  XmlVertexCacheInfo()
+    : triangles_(0), misses_before_(0), misses_after_(0) {}
+
+  size_t triangles_;
+  size_t misses_before_;
+  size_t misses_after_;
+
+  void Add(const XmlVertexCacheInfo& other) {
+    triangles_ += other.triangles_;
+    misses_before_ += other.misses_before_;
+    misses_after_ += other.misses_after_;
+  }
+};
+
+// CXmlVertexCacheOptimizer - Reorders triangles so that GPUs transform fewer
+// vertices, using Tom Forsyth's linear-speed algorithm: vertices are scored
+// by their place in a simulated LRU cache and by how many triangles still
+// use them, and the next triangle is the best scored one around the cache.
+// When none is left there, it continues with the first triangle not drawn
+// yet. Indices may span any range, scratch memory grows with the range of
+// vertex indices used, not with the whole buffer. Keeps its scratch memory
+// between calls, use one per thread. The outline buffers are not passed
+// through it. The Unity line quads have vertices of their own. A line
+// meshlet does share end points between consecutive lines, but it indexes
+// at most 64 local vertices by default, which are transformed once per
+// meshlet whatever the order of its lines.
+class CXmlVertexCacheOptimizer {
+ public:
+  CXmlVertexCacheOptimizer() {}
+
+  // Reorders the triangles, 3 indices each, in place. The winding of each
+  // triangle is kept.
+  void Optimize(unsigned int* indices, size_t num_indices);
+
+  // Misses of a FIFO cache of 16 vertices, as most hardware has. Sets
+  // num_vertices, if given, to the number of different vertices used, the
+  // fewest misses possible.
+  static size_t CountCacheMisses(const unsigned int* indices,
+                                 size_t num_indices,
+                                 size_t* num_vertices = NULL);
+
+  // Optimizes triangles in chunks of whole triangles, on all cores if
+  // parallel is set, and adds the triangles and cache misses to info.
+  // Chunks are reordered separately so the result does not depend on the
+  // number of threads; misses are counted per chunk. Chunks that load each
+  // vertex about once already are left as they are. That is common, as
+  // SketchUp faces do not share vertices and their triangles come in fans.
+  static void OptimizeInChunks(std::vector<unsigned int>& triangles,
+                               bool parallel, XmlVertexCacheInfo& info);
+
+  // Numbers vertices [0, num_vertices) in the order indices first use
+  // them, remap[old] being the new index. Vertices not used keep their
+  // order after those used.
+  static void GetFirstUseOrder(const std::vector<unsigned int>& indices,
+                               size_t num_vertices,
+                               std::vector<unsigned int>& remap);
+
+ private:
+  void UpdateVertex(size_t vertex, int cache_position);
+
+ private:
+  // Per vertex, relative to the smallest index
+  std::vector<size_t> first_triangle_;
+  std::vector<unsigned int> live_triangles_;
+  std::vector<float> vertex_score_;
+  // Triangles still to draw around each vertex, in
+  // vertex_triangles_[first_triangle_[v], first_triangle_[v] + live)
+  std::vector<unsigned int> vertex_triangles_;
+  // Score of a vertex by cache position and by live triangles
+  std::vector<float> position_scores_;
+  std::vector<float> valence_scores_;
+  // Per triangle
+  std::vector<float> triangle_score_;
+  std::vector<bool> drawn_;
+  std::vector<unsigned int> output_;
+};
+
+#endif // SKPTOXML_COMMON_XMLVERTEXCACHE_H
@@ -0,0 +1,287 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <float.h>
+#include <algorithm>
+
+#include "./xmlworldgeometry.h"
+#include "./xmlthreadutils.h"
+#include "./xmltriangulator.h"
+
+using namespace XmlGeomUtils;
+
+// Guards against component definitions that (indirectly) contain themselves
+static const int kMaxNestingDepth = 64;
+static const size_t kPolygonsPerChunk = 256;
+// SketchUp draws edges without a material black
+static const SUColor kDefaultEdgeColor = { 0, 0, 0, 255 };
+
+// Newell's method, robust for concave and slightly non-planar loops
+static CVector3d LoopNormal(const CPoint3d* points, size_t count) {
+  CVector3d normal;
+  for (size_t i = 0; i < count; ++i) {
+    const CPoint3d& a = points[i];
+    const CPoint3d& b = points[(i + 1) % count];
+    normal += CVector3d((a.y() - b.y()) * (a.z() + b.z()),
+                        (a.z() - b.z()) * (a.x() + b.x()),
+                        (a.x() - b.x()) * (a.y() + b.y()));
+  }
+  normal.Normalize();
+  return normal;
+}
+
+namespace {
+
+class CTriangulateTask : public XmlThreadUtils::CParallelTask {
+ public:
+  CTriangulateTask(const CXmlWorldGeometry& geometry,
+                   std::vector<std::vector<unsigned int> >& chunks)
+    : geometry_(geometry), chunks_(chunks) {}
+
+  void Run(size_t begin, size_t end) {
+    // Triangulators keep scratch memory, one per range
+    CXmlTriangulator triangulator;
+    std::vector<size_t> loop_sizes;
+    std::vector<size_t> triangles;
+    const std::vector<XmlWorldPolygon>& polygons = geometry_.polygons();
+    for (size_t c = begin; c < end; ++c) {
+      size_t last = std::min((c + 1) * kPolygonsPerChunk, polygons.size());
+      for (size_t p = c * kPolygonsPerChunk; p < last; ++p) {
+        // The loops of a polygon, and their points, are contiguous
+        const XmlWorldPolygon& polygon = polygons[p];
+        const XmlWorldLoop* loops = &geometry_.loops()[polygon.first_loop_];
+        loop_sizes.clear();
+        for (size_t l = 0; l < polygon.num_loops_; ++l) {
+          loop_sizes.push_back(loops[l].num_points_);
+        }
+        triangles.clear();
+        triangulator.Triangulate(&geometry_.points()[loops[0].first_point_],
+                                 &loop_sizes[0], loop_sizes.size(),
+                                 triangles);
+        for (size_t t = 0; t < triangles.size(); ++t) {
+          chunks_[c].push_back(
+              static_cast<unsigned int>(loops[0].first_point_ + triangles[t]));
+        }
+      }
+    }
+  }
+
+ private:
+  const CXmlWorldGeometry& geometry_;
+  std::vector<std::vector<unsigned int> >& chunks_;
+};
+
+} // end anonymous namespace
+
+CXmlWorldGeometry::CXmlWorldGeometry()
+  : num_groups_(0),
+    outlines_(true) {
+}
+
+void CXmlWorldGeometry::Build(const XmlModelInfo& model_info) {
+  points_.clear();
+  loops_.clear();
+  polygons_.clear();
+  segments_.clear();
+  num_groups_ = 0;
+  outlines_ = true;
+  min_.SetLocation(DBL_MAX, DBL_MAX, DBL_MAX);
+  max_.SetLocation(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+
+  // The first definition of a name is the one instances use
+  definition_indices_.clear();
+  for (size_t i = 0; i < model_info.definitions_.size(); ++i) {
+    definition_indices_.insert(
+        std::make_pair(model_info.definitions_[i].name_id_, i));
+  }
+
+  AddEntities(model_info, model_info.entities_, IdentityTransform(), -1, 0);
+
+  if (min_.x() > max_.x()) {
+    min_ = CPoint3d();
+    max_ = CPoint3d();
+  }
+}
+
+void CXmlWorldGeometry::AddEntities(const XmlModelInfo& model_info,
+                                    const XmlEntitiesInfo& entities,
+                                    const SUTransformation& transform,
+                                    int group, int depth) {
+  if (depth > kMaxNestingDepth)
+    return;
+
+  // Same order as the exporter writes them
+  for (size_t i = 0; i < entities.num_instances_; ++i) {
+    int child_group = (depth == 0) ? num_groups_++ : group;
+    AddComponentInstance(
+        model_info,
+        model_info.component_instances_[entities.first_instance_ + i],
+        transform, child_group, depth);
+  }
+
+  for (size_t i = 0; i < entities.num_groups_; ++i) {
+    const XmlGroupInfo& group_info =
+        model_info.groups_[entities.first_group_ + i];
+    int child_group = (depth == 0) ? num_groups_++ : group;
+    SUTransformation child_transform =
+        MultiplyTransforms(transform, group_info.transform_);
+    bool outlines = outlines_;
+    outlines_ = outlines && group_info.outline_ &&
+                !group_info.collision_only_;
+    AddEntities(model_info, group_info.entities_, child_transform,
+                child_group, depth + 1);
+    outlines_ = outlines;
+  }
+
+  for (size_t i = 0; i < entities.num_faces_; ++i) {
+    AddFace(model_info, model_info.faces_[entities.first_face_ + i],
+            transform, group);
+  }
+
+  for (size_t i = 0; i < entities.num_edges_; ++i) {
+    AddEdge(model_info.edges_[entities.first_edge_ + i], transform, group);
+  }
+
+  for (size_t i = 0; i < entities.num_curves_; ++i) {
+    const std::vector<XmlEdgeInfo>& edges =
+        model_info.curves_[entities.first_curve_ + i].edges_;
+    for (size_t j = 0; j < edges.size(); ++j) {
+      AddEdge(edges[j], transform, group);
+    }
+  }
+}
+
+void CXmlWorldGeometry::AddComponentInstance(
+    const XmlModelInfo& model_info,
+    const XmlComponentInstanceInfo& instance,
+    const SUTransformation& transform,
+    int group, int depth) {
+  // Definitions are only present if the exporter wrote them
+  std::map<int, size_t>::const_iterator it =
+      definition_indices_.find(instance.definition_name_id_);
+  if (it == definition_indices_.end())
+    return;
+  const XmlComponentDefinitionInfo& definition =
+      model_info.definitions_[it->second];
+  SUTransformation child_transform =
+      MultiplyTransforms(transform, instance.transform_);
+  bool outlines = outlines_;
+  outlines_ = outlines && instance.outline_ && !instance.collision_only_;
+  AddEntities(model_info, definition.entities_, child_transform, group,
+              depth + 1);
+  outlines_ = outlines;
+}
+
+void CXmlWorldGeometry::AddPoint(const CPoint3d& point) {
+  points_.push_back(point);
+  ExtendBounds(point);
+}
+
+void CXmlWorldGeometry::ExtendBounds(const CPoint3d& point) {
+  min_.SetLocation(std::min(min_.x(), point.x()),
+                   std::min(min_.y(), point.y()),
+                   std::min(min_.z(), point.z()));
+  max_.SetLocation(std::max(max_.x(), point.x()),
+                   std::max(max_.y(), point.y()),
+                   std::max(max_.z(), point.z()));
+}
+
+void CXmlWorldGeometry::AddFace(const XmlModelInfo& model_info,
+                                const XmlFaceInfo& face,
+                                const SUTransformation& transform,
+                                int group) {
+  size_t count = face.num_vertices_;
+  if (!face.has_single_loop_ || count < 2)
+    return;
+
+  XmlWorldLoop loop;
+  loop.first_point_ = points_.size();
+  loop.num_points_ = count;
+  for (size_t i = 0; i < count; ++i) {
+    AddPoint(TransformPoint(
+        transform, model_info.vertices_[face.first_vertex_ + i].vertex_));
+  }
+  const CPoint3d* points = &points_[loop.first_point_];
+  CVector3d normal = LoopNormal(points, count);
+
+  // Outline, one segment per side of the loop
+  for (size_t i = 0; i < count; ++i) {
+    const XmlFaceVertex& vertex = model_info.vertices_[face.first_vertex_ + i];
+    XmlWorldSegment segment;
+    segment.start_ = points[i];
+    segment.end_ = points[(i + 1) % count];
+    segment.normal_ = normal;
+    segment.group_ = group;
+    segment.layer_ = face.layer_index_;
+    segment.soft_ = vertex.soft_edge_;
+    segment.color_ =
+        vertex.has_edge_color_ ? vertex.edge_color_ : kDefaultEdgeColor;
+    segment.outline_ = outlines_;
+    segments_.push_back(segment);
+  }
+
+  if (count < 3)
+    return;
+
+  // Holes extend the face written just before them
+  if (face.is_inner_loop_ && !polygons_.empty() &&
+      polygons_.back().first_loop_ + polygons_.back().num_loops_ ==
+      loops_.size()) {
+    loops_.push_back(loop);
+    polygons_.back().num_loops_++;
+    return;
+  }
+
+  XmlWorldPolygon polygon;
+  polygon.first_loop_ = loops_.size();
+  polygon.num_loops_ = 1;
+  polygon.normal_ = normal;
+  polygon.plane_d_ = normal.Dot(points[0] - CPoint3d());
+  polygon.min_ = points[0];
+  polygon.max_ = points[0];
+  for (size_t i = 1; i < count; ++i) {
+    const CPoint3d& p = points[i];
+    polygon.min_.SetLocation(std::min(polygon.min_.x(), p.x()),
+                             std::min(polygon.min_.y(), p.y()),
+                             std::min(polygon.min_.z(), p.z()));
+    polygon.max_.SetLocation(std::max(polygon.max_.x(), p.x()),
+                             std::max(polygon.max_.y(), p.y()),
+                             std::max(polygon.max_.z(), p.z()));
+  }
+  polygon.group_ = group;
+  loops_.push_back(loop);
+  polygons_.push_back(polygon);
+}
+
+void CXmlWorldGeometry::AddEdge(const XmlEdgeInfo& edge,
+                                const SUTransformation& transform,
+                                int group) {
+  XmlWorldSegment segment;
+  segment.start_ = TransformPoint(transform, edge.start_);
+  segment.end_ = TransformPoint(transform, edge.end_);
+  segment.group_ = group;
+  segment.layer_ = edge.layer_index_;
+  segment.soft_ = false;
+  segment.color_ = edge.has_color_ ? edge.color_ : kDefaultEdgeColor;
+  segment.outline_ = outlines_;
+  ExtendBounds(segment.start_);
+  ExtendBounds(segment.end_);
+  segments_.push_back(segment);
+}
+
+void CXmlWorldGeometry::Triangulate(std::vector<unsigned int>& triangles,
+                                    bool parallel) const {
+  size_t num_chunks = (polygons_.size() + kPolygonsPerChunk - 1) /
+                      kPolygonsPerChunk;
+  std::vector<std::vector<unsigned int> > chunks(num_chunks);
+  CTriangulateTask task(*this, chunks);
+  XmlThreadUtils::RunParallel(task, num_chunks, 1, parallel ? 0 : 1);
+  size_t num_indices = 0;
+  for (size_t c = 0; c < num_chunks; ++c) {
+    num_indices += chunks[c].size();
+  }
+  triangles.clear();
+  triangles.reserve(num_indices);
+  for (size_t c = 0; c < num_chunks; ++c) {
+    triangles.insert(triangles.end(), chunks[c].begin(), chunks[c].end());
+  }
+}
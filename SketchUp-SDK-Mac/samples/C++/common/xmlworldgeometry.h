@@ -0,0 +1,107 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLWORLDGEOMETRY_H
+#define SKPTOXML_COMMON_XMLWORLDGEOMETRY_H
+
+#include <map>
+#include <vector>
+
+#include "./xmlfile.h"
+#include "./xmlgeomutils.h"
+
+// A range of points in CXmlWorldGeometry::points() forming a closed loop.
+struct XmlWorldLoop {
+  size_t first_point_;
+  size_t num_points_;
+};
+
+// A planar face in world space. The first loop is the outer boundary, the
+// following ones are its holes.
+struct XmlWorldPolygon {
+  size_t first_loop_;
+  size_t num_loops_;
+  XmlGeomUtils::CVector3d normal_;
+  // Plane offset: normal_.Dot(p) == plane_d_ for points on the face
+  double plane_d_;
+  XmlGeomUtils::CPoint3d min_;
+  XmlGeomUtils::CPoint3d max_;
+  // Index of the top level group or component instance holding the face,
+  // -1 for loose geometry.
+  int group_;
+};
+
+// An outline segment in world space. Loop segments carry the normal of the
+// face they bound, stand-alone edges a zero normal.
+struct XmlWorldSegment {
+  XmlGeomUtils::CPoint3d start_;
+  XmlGeomUtils::CPoint3d end_;
+  XmlGeomUtils::CVector3d normal_;
+  int group_;
+  // Index in the Layers section of the face or edge, -1 if unknown
+  int layer_;
+  // Soft or smooth edge, drawn only where it is part of the silhouette
+  bool soft_;
+  // Color of the edge's material, opaque black if it has none
+  SUColor color_;
+  // False in groups whose export hints turn the outlines off. Such segments
+  // keep their place in the order but are not drawn.
+  bool outline_;
+};
+
+// CXmlWorldGeometry - Flattens the group hierarchy of an XmlModelInfo into
+// world space faces and outline segments for the offline processing passes.
+// Outline segments are produced in document order, one per loop side, which
+// is the order the Unity importer builds its lines in.
+class CXmlWorldGeometry {
+ public:
+  CXmlWorldGeometry();
+
+  void Build(const XmlModelInfo& model_info);
+
+  const std::vector<XmlGeomUtils::CPoint3d>& points() const { return points_; }
+  const std::vector<XmlWorldLoop>& loops() const { return loops_; }
+  const std::vector<XmlWorldPolygon>& polygons() const { return polygons_; }
+  const std::vector<XmlWorldSegment>& segments() const { return segments_; }
+
+  // Number of top level groups and component instances
+  int num_groups() const { return num_groups_; }
+
+  // Bounds of all the points
+  const XmlGeomUtils::CPoint3d& min() const { return min_; }
+  const XmlGeomUtils::CPoint3d& max() const { return max_; }
+
+  // Cuts the polygons into triangles, 3 indices in points() each, in
+  // polygon order. The parallel version gives the same triangles.
+  void Triangulate(std::vector<unsigned int>& triangles, bool parallel) const;
+
+ private:
+  void AddEntities(const XmlModelInfo& model_info,
+                   const XmlEntitiesInfo& entities,
+                   const SUTransformation& transform,
+                   int group, int depth);
+  void AddComponentInstance(const XmlModelInfo& model_info,
+                            const XmlComponentInstanceInfo& instance,
+                            const SUTransformation& transform,
+                            int group, int depth);
+  void AddFace(const XmlModelInfo& model_info, const XmlFaceInfo& face,
+               const SUTransformation& transform, int group);
+  void AddEdge(const XmlEdgeInfo& edge, const SUTransformation& transform,
+               int group);
+  void AddPoint(const XmlGeomUtils::CPoint3d& point);
+  void ExtendBounds(const XmlGeomUtils::CPoint3d& point);
+
+ private:
+  std::vector<XmlGeomUtils::CPoint3d> points_;
+  std::vector<XmlWorldLoop> loops_;
+  std::vector<XmlWorldPolygon> polygons_;
+  std::vector<XmlWorldSegment> segments_;
+  int num_groups_;
+  // Index in XmlModelInfo::definitions_ of each definition name
+  std::map<int, size_t> definition_indices_;
+  // Whether the group being added draws outlines
+  bool outlines_;
+  XmlGeomUtils::CPoint3d min_;
+  XmlGeomUtils::CPoint3d max_;
+};
+
+#endif // SKPTOXML_COMMON_XMLWORLDGEOMETRY_H
@@ -0,0 +1,183 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+// Command line front end of the XML exporter, for exports outside SketchUp
+// and as the worker process of sharded exports.
+//
+//   skptoxml [-shards N] [-nofaces] [-layers] [-scenelayers] [-detail N]
+//            [-dedup] [-cells] [-sections] [-glb] [-unitylines]
+//            [-progressive] [-meshlets] [-silhouettes] [-memory MB]
+//            model.skp model.xml
+//   skptoxml -shard FIRST COUNT [-nofaces] [-layers] [-detail N]
+//            model.skp part.xml
+//   skptoxml -package DIR [options] model.skp...
+//
+// -shards splits the geometry over N processes running this program again, 0
+// starts one per core. -shard is what those processes are given. -layers writes
+// the layers and the layer of each face and group, -scenelayers also the layers
+// each scene shows. -detail leaves out the groups and components whose "Detail"
+// hint is above N. -dedup flags the outlines drawn twice where groups meet, see
+// CXmlOutlineDeduplicator. -cells adds the visibility cells, see
+// CXmlCellVisibilityPass. -sections adds the outlines of the model's section
+// planes. -glb writes model.glb, see CXmlGlbWriter. -unitylines writes the
+// Unity outline mesh to the model's LinesMeshDirectory, see CXmlUnityLineMesh.
+// -progressive writes model.progressive.bin, see CXmlProgressiveWriter.
+// -meshlets writes model.meshlets.bin, see CXmlMeshletBuilder. -silhouettes
+// writes model.edges.bin, see CXmlSilhouetteEdgeWriter. -memory caps the memory
+// the outline passes sort in, larger sorts spill to temporary files. -package
+// exports each model to DIR/model.xml and moves the component definitions to a
+// store they share, see CXmlPackageBuilder.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "../plugin/xmlplugin.h"
+#include "../../common/xmlpackage.h"
+#include "../../common/xmlthreadutils.h"
+
+// The plugin without its dialogs, the summary goes to the standard output
+class CXmlExporterTool : public CXmlExporterPlugin {
+ public:
+  using CXmlExporterPlugin::ShowSummaryDialog;
+
+  void ShowOptionsDialog(bool) {}
+  void ShowSummaryDialog(const std::string& summary) {
+    printf("%s", summary.c_str());
+  }
+};
+
+static int PrintUsage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-shards N] [-nofaces] [-layers] [-scenelayers] "
+          "[-detail N] [-dedup] [-cells] [-sections] [-glb] [-unitylines] "
+          "[-progressive] [-meshlets] [-silhouettes] [-memory MB] "
+          "[-poolmemory MB] model.skp model.xml\n"
+          "       %s -shard FIRST COUNT [-nofaces] [-layers] [-detail N] "
+          "model.skp part.xml\n"
+          "       %s -package DIR [options] model.skp...\n",
+          program, program, program);
+  return 2;
+}
+
+// DIR/model.xml for DIR and path/model.skp
+static std::string GetPackagePath(const std::string& directory,
+                                  const std::string& skp_file) {
+  std::string name = skp_file;
+  size_t slash = name.find_last_of("/\\");
+  if (slash != std::string::npos)
+    name.erase(0, slash + 1);
+  size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos)
+    name.erase(dot);
+  std::string path = directory;
+  if (!path.empty() && path[path.size() - 1] != '/' &&
+      path[path.size() - 1] != '\\')
+    path.append("/");
+  return path + name + ".xml";
+}
+
+static int ExportPackage(CXmlExporterTool& tool, const char* program,
+                         const std::string& directory, char* skp_files[],
+                         int num_files) {
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "%s: could not create %s\n", program, directory.c_str());
+    return 1;
+  }
+  // The package stores the definitions the models are exported with
+  tool.SetExportComponentDefinitions(true);
+  CXmlPackageBuilder package(directory);
+  int failed = 0;
+  for (int i = 0; i < num_files; ++i) {
+    std::string xml_file = GetPackagePath(directory, skp_files[i]);
+    if (!tool.ConvertFromSkp(skp_files[i], xml_file, NULL, NULL) ||
+        !package.AddModel(xml_file)) {
+      fprintf(stderr, "%s: could not export %s\n", program, skp_files[i]);
+      ++failed;
+    }
+  }
+  printf("Package:\t%lu models, %lu definitions, %lu unique, %lu new\n",
+         static_cast<unsigned long>(package.num_models()),
+         static_cast<unsigned long>(package.num_definitions()),
+         static_cast<unsigned long>(package.num_unique_definitions()),
+         static_cast<unsigned long>(package.num_written()));
+  return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+  CXmlExporterTool tool;
+  size_t num_shards = 1;
+  size_t shard_first_item = 0;
+  size_t shard_num_items = 0;
+  std::string package_dir;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+    if (strcmp(argv[arg], "-shards") == 0 && arg + 1 < argc) {
+      num_shards = strtoul(argv[++arg], NULL, 10);
+      if (num_shards == 0)
+        num_shards = XmlThreadUtils::GetNumCores();
+    } else if (strcmp(argv[arg], "-shard") == 0 && arg + 2 < argc) {
+      shard_first_item = strtoul(argv[++arg], NULL, 10);
+      shard_num_items = strtoul(argv[++arg], NULL, 10);
+      if (shard_num_items == 0)
+        return PrintUsage(argv[0]);
+    } else if (strcmp(argv[arg], "-package") == 0 && arg + 1 < argc) {
+      package_dir = argv[++arg];
+    } else if (strcmp(argv[arg], "-nofaces") == 0) {
+      tool.SetExportFaces(false);
+    } else if (strcmp(argv[arg], "-layers") == 0) {
+      tool.SetExportLayers(true);
+    } else if (strcmp(argv[arg], "-nolayers") == 0) {
+      tool.SetExportLayers(false);
+    } else if (strcmp(argv[arg], "-scenelayers") == 0) {
+      tool.SetExportLayers(true);
+      tool.SetExportSceneLayers(true);
+    } else if (strcmp(argv[arg], "-detail") == 0 && arg + 1 < argc) {
+      tool.SetMaxDetail(atoi(argv[++arg]));
+    } else if (strcmp(argv[arg], "-dedup") == 0) {
+      tool.SetDedupOutlines(true);
+    } else if (strcmp(argv[arg], "-cells") == 0) {
+      tool.SetExportVisibilityCells(true);
+    } else if (strcmp(argv[arg], "-sections") == 0) {
+      tool.SetExportSections(true);
+    } else if (strcmp(argv[arg], "-glb") == 0) {
+      tool.SetExportGlb(true);
+    } else if (strcmp(argv[arg], "-unitylines") == 0) {
+      tool.SetExportUnityLines(true);
+    } else if (strcmp(argv[arg], "-progressive") == 0) {
+      tool.SetExportProgressive(true);
+    } else if (strcmp(argv[arg], "-meshlets") == 0) {
+      tool.SetExportMeshlets(true);
+    } else if (strcmp(argv[arg], "-silhouettes") == 0) {
+      tool.SetExportSilhouetteEdges(true);
+    } else if (strcmp(argv[arg], "-memory") == 0 && arg + 1 < argc) {
+      tool.SetMaxSortBytes(strtoul(argv[++arg], NULL, 10) << 20);
+    } else if (strcmp(argv[arg], "-poolmemory") == 0 && arg + 1 < argc) {
+      tool.SetRetainedPoolBytes(strtoul(argv[++arg], NULL, 10) << 20);
+    } else {
+      return PrintUsage(argv[0]);
+    }
+  }
+  if (!package_dir.empty() && argc > arg && shard_num_items == 0) {
+    tool.SetShards(num_shards, argv[0]);
+    return ExportPackage(tool, argv[0], package_dir, argv + arg, argc - arg);
+  }
+  if (argc - arg != 2 || !package_dir.empty())
+    return PrintUsage(argv[0]);
+
+  // The workers are this program again
+  tool.SetShards(num_shards, argv[0]);
+  tool.SetShard(shard_first_item, shard_num_items);
+
+  bool converted = tool.ConvertFromSkp(argv[arg], argv[arg + 1], NULL, NULL);
+  if (!converted) {
+    fprintf(stderr, "%s: could not export %s\n", argv[0], argv[arg]);
+  } else if (shard_num_items == 0) {
+    tool.ShowSummaryDialog();
+  }
+  return converted ? 0 : 1;
+}
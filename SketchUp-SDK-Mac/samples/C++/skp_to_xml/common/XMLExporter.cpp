@@ -1,16 +1,33 @@
 // Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
 
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <cassert>
 
 #include "./xmlexporter.h"
 #include "./xmltexturehelper.h"
+#include "../../common/xmlcellvisibility.h"
 #include "../../common/xmlgeomutils.h"
+#include "../../common/xmlglbwriter.h"
+#include "../../common/xmlhiddenlines.h"
+#include "../../common/xmlmeshfilewriter.h"
+#include "../../common/xmlmeshlets.h"
+#include "../../common/xmloutlinededup.h"
+#include "../../common/xmlprocessutils.h"
+#include "../../common/xmlprogressivewriter.h"
+#include "../../common/xmlsectioncut.h"
+#include "../../common/xmlsilhouetteedges.h"
+#include "../../common/xmlunitymesh.h"
 #include "../../common/utils.h"
 
 #include <slapi/import_export/pluginprogresscallback.h>
 #include <slapi/initialize.h>
+#include <slapi/model/attribute_dictionary.h>
+#include <slapi/model/camera.h>
 #include <slapi/model/component_definition.h>
 #include <slapi/model/component_instance.h>
 #include <slapi/model/drawing_element.h>
@@ -24,13 +41,40 @@
 #include <slapi/model/material.h>
 #include <slapi/model/mesh_helper.h>
 #include <slapi/model/model.h>
+#include <slapi/model/scene.h>
 #include <slapi/model/texture.h>
 #include <slapi/model/texture_writer.h>
+#include <slapi/model/typed_value.h>
 #include <slapi/model/uv_helper.h>
 #include <slapi/model/vertex.h>
 
 using namespace XmlGeomUtils;
 
+// Model attribute dictionary holding data the SDK does not expose. It is
+// filled in by the SaveToUnity.rb script before exporting.
+static const char* kExporterDictionary = "SkpToXML";
+// Flat list of section planes, a b c d for each with a*x + b*y + c*z + d = 0
+static const char* kSectionPlanesKey = "SectionPlanes";
+// Scene attribute with the names of the layers the scene hides. Only set for
+// scenes that save the layer visibility.
+static const char* kHiddenLayersKey = "HiddenLayers";
+// Directory of the Unity project the outline mesh assets are written to,
+// ModelPostProcessor.savePath
+static const char* kLinesMeshDirectoryKey = "LinesMeshDirectory";
+// Export hints on groups, component instances and definitions, see
+// XmlExportHints
+static const char* kExportHintKey = "Export";
+static const char* kOutlineHintKey = "Outline";
+static const char* kCollisionOnlyHintKey = "CollisionOnly";
+static const char* kDetailHintKey = "Detail";
+
+// Smallest change of the geometry progress, in percent, that is reported to
+// the progress callback
+static const double kGeometryProgressStep = 0.25;
+// Share of the progress range the geometry is written in
+static const double kGeometryProgressStart = 60.0;
+static const double kGeometryProgressRange = 10.0;
+
 // A simple SUStringRef wrapper class which makes usage simpler from C++.
 class CSUString {
  public:
@@ -65,6 +109,34 @@ private:
   SUStringRef su_str_;
 };
 
+// A simple SUTypedValueRef wrapper class which makes usage simpler from C++.
+class CSUTypedValue {
+ public:
+  CSUTypedValue() {
+    SUSetInvalid(su_value_);
+    SUTypedValueCreate(&su_value_);
+  }
+
+  ~CSUTypedValue() {
+    SUTypedValueRelease(&su_value_);
+  }
+
+  operator SUTypedValueRef*() {
+    return &su_value_;
+  }
+
+  SUTypedValueRef value() const {
+    return su_value_;
+  }
+
+private:
+  // Disallow copying for simplicity
+  CSUTypedValue(const CSUTypedValue& copy);
+  CSUTypedValue& operator= (const CSUTypedValue& copy);
+
+  SUTypedValueRef su_value_;
+};
+
 // Utility function to get a material's name
 static std::string GetMaterialName(SUMaterialRef material) {
   CSUString name;
@@ -79,6 +151,254 @@ static std::string GetLayerName(SULayerRef layer) {
   return name.utf8();
 }
 
+// Utility function to get a scene's name
+static std::string GetSceneName(SUSceneRef scene) {
+  CSUString name;
+  SU_CALL(SUSceneGetName(scene, name));
+  return name.utf8();
+}
+
+// Utility function to read a value from the exporter's model attribute
+// dictionary. Returns false if the key is not set.
+static bool GetExporterAttribute(SUModelRef model, const char* key,
+                                 CSUTypedValue& value) {
+  SUAttributeDictionaryRef dictionary = SU_INVALID;
+  return SUModelGetAttributeDictionary(model, kExporterDictionary,
+                                       &dictionary) == SU_ERROR_NONE &&
+         SUAttributeDictionaryGetValue(dictionary, key, value) ==
+         SU_ERROR_NONE;
+}
+
+// Utility function to get the names of the layers a scene hides. Returns
+// false if the scene does not save the layer visibility.
+static bool GetSceneHiddenLayers(SUSceneRef scene,
+                                 std::set<std::string>& hidden_layers) {
+  SUAttributeDictionaryRef dictionary = SU_INVALID;
+  CSUTypedValue names;
+  size_t num_names = 0;
+  if (SUEntityGetAttributeDictionary(SUSceneToEntity(scene),
+                                     kExporterDictionary, &dictionary) !=
+      SU_ERROR_NONE ||
+      SUAttributeDictionaryGetValue(dictionary, kHiddenLayersKey, names) !=
+      SU_ERROR_NONE ||
+      SUTypedValueGetNumArrayItems(names.value(), &num_names) !=
+      SU_ERROR_NONE) {
+    return false;
+  }
+
+  hidden_layers.clear();
+  if (num_names > 0) {
+    std::vector<SUTypedValueRef> values(num_names);
+    SU_CALL(SUTypedValueGetArrayItems(names.value(), num_names, &values[0],
+                                      &num_names));
+    for (size_t i = 0; i < num_names; ++i) {
+      CSUString name;
+      if (SUTypedValueGetString(values[i], name) == SU_ERROR_NONE)
+        hidden_layers.insert(name.utf8());
+    }
+  }
+  return true;
+}
+
+// Utility function to get a number stored by Ruby, which may have been
+// written as an integer
+static bool GetTypedValueDouble(SUTypedValueRef value, double& number) {
+  SUTypedValueType type = SUTypedValueType_Empty;
+  if (SUTypedValueGetType(value, &type) != SU_ERROR_NONE)
+    return false;
+  switch (type) {
+    case SUTypedValueType_Double:
+      return SUTypedValueGetDouble(value, &number) == SU_ERROR_NONE;
+    case SUTypedValueType_Float: {
+      float float_value = 0.0f;
+      if (SUTypedValueGetFloat(value, &float_value) != SU_ERROR_NONE)
+        return false;
+      number = float_value;
+      return true;
+    }
+    case SUTypedValueType_Int32: {
+      int32_t int_value = 0;
+      if (SUTypedValueGetInt32(value, &int_value) != SU_ERROR_NONE)
+        return false;
+      number = int_value;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// Utility function to get the path of a file written next to the XML file,
+// with its extension replaced
+static std::string GetSiblingPath(const std::string& xml_file,
+                                  const char* extension) {
+  std::string path = xml_file;
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of("/\\");
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    path.erase(dot);
+  return path.append(extension);
+}
+
+// Utility function to flag the loop sides that are soft or smooth edges and,
+// if kReadColors is set, to give them the color of the edge's material.
+// Side i runs from vertices[i] to the next vertex. Loops list their edges
+// in that order, which is checked before it is relied on.
+template <bool kReadColors>
+static void ReadLoopEdges(SULoopRef loop,
+                          const std::vector<SUVertexRef>& vertices,
+                          std::vector<XmlFaceVertex>& face_vertices) {
+  size_t count = vertices.size();
+  std::vector<SUEdgeRef> edges(count);
+  if (count == 0 ||
+      SULoopGetEdges(loop, count, &edges[0], &count) != SU_ERROR_NONE)
+    return;
+  for (size_t i = 0; i < count; ++i) {
+    bool soft = false;
+    bool smooth = false;
+    SUEdgeGetSoft(edges[i], &soft);
+    SUEdgeGetSmooth(edges[i], &smooth);
+    SUMaterialRef material = SU_INVALID;
+    SUColor color = { 0, 0, 0, 255 };
+    bool has_color = kReadColors &&
+        SUDrawingElementGetMaterial(SUEdgeToDrawingElement(edges[i]),
+                                    &material) == SU_ERROR_NONE &&
+        !SUIsInvalid(material) &&
+        SUEdgeGetColor(edges[i], &color) == SU_ERROR_NONE;
+    if (!soft && !smooth && !has_color)
+      continue;
+    SUVertexRef start = SU_INVALID;
+    SUVertexRef end = SU_INVALID;
+    if (SUEdgeGetStartVertex(edges[i], &start) != SU_ERROR_NONE ||
+        SUEdgeGetEndVertex(edges[i], &end) != SU_ERROR_NONE)
+      continue;
+    for (size_t k = 0; k < vertices.size(); ++k) {
+      size_t side = (i + k) % vertices.size();
+      const SUVertexRef& a = vertices[side];
+      const SUVertexRef& b = vertices[(side + 1) % vertices.size()];
+      if ((SUAreEqual(a, start) && SUAreEqual(b, end)) ||
+          (SUAreEqual(a, end) && SUAreEqual(b, start))) {
+        XmlFaceVertex& vertex = face_vertices[side];
+        vertex.soft_edge_ = soft || smooth;
+        vertex.has_edge_color_ = has_color;
+        vertex.edge_color_ = color;
+        break;
+      }
+    }
+  }
+}
+
+// Utility function to read the export hints an entity sets. Keys it does not
+// set keep their value.
+static void ReadExportHints(SUEntityRef entity, XmlExportHints& hints) {
+  SUAttributeDictionaryRef dictionary = SU_INVALID;
+  if (SUEntityGetAttributeDictionary(entity, kExporterDictionary,
+                                     &dictionary) != SU_ERROR_NONE) {
+    return;
+  }
+  CSUTypedValue value;
+  bool flag = false;
+  if (SUAttributeDictionaryGetValue(dictionary, kExportHintKey, value) ==
+      SU_ERROR_NONE &&
+      SUTypedValueGetBool(value.value(), &flag) == SU_ERROR_NONE) {
+    hints.export_ = flag;
+  }
+  if (SUAttributeDictionaryGetValue(dictionary, kOutlineHintKey, value) ==
+      SU_ERROR_NONE &&
+      SUTypedValueGetBool(value.value(), &flag) == SU_ERROR_NONE) {
+    hints.outline_ = flag;
+  }
+  if (SUAttributeDictionaryGetValue(dictionary, kCollisionOnlyHintKey,
+                                    value) == SU_ERROR_NONE &&
+      SUTypedValueGetBool(value.value(), &flag) == SU_ERROR_NONE) {
+    hints.collision_only_ = flag;
+  }
+  double detail = 0.0;
+  if (SUAttributeDictionaryGetValue(dictionary, kDetailHintKey, value) ==
+      SU_ERROR_NONE && GetTypedValueDouble(value.value(), detail)) {
+    hints.detail_ = static_cast<int>(detail);
+  }
+}
+
+// Utility function to count the faces of a list of entities and the groups in
+// it. Component instances are written as references and are not counted.
+static size_t CountFaces(SUEntitiesRef entities) {
+  size_t num_faces = 0;
+  SU_CALL(SUEntitiesGetNumFaces(entities, &num_faces));
+  size_t num_groups = 0;
+  SU_CALL(SUEntitiesGetNumGroups(entities, &num_groups));
+  if (num_groups > 0) {
+    std::vector<SUGroupRef> groups(num_groups);
+    SU_CALL(SUEntitiesGetGroups(entities, num_groups, &groups[0], &num_groups));
+    for (size_t g = 0; g < num_groups; g++) {
+      SUEntitiesRef group_entities = SU_INVALID;
+      SU_CALL(SUGroupGetEntities(groups[g], &group_entities));
+      num_faces += CountFaces(group_entities);
+    }
+  }
+  return num_faces;
+}
+
+// Utility function to estimate the cost of writing each top level item of
+// the model, in the order of CXmlOptions::set_shard
+static void GetGeometryItemCosts(SUEntitiesRef entities,
+                                 std::vector<size_t>& costs) {
+  costs.clear();
+  size_t num_instances = 0;
+  SU_CALL(SUEntitiesGetNumInstances(entities, &num_instances));
+  costs.assign(num_instances, 1);
+
+  size_t num_groups = 0;
+  SU_CALL(SUEntitiesGetNumGroups(entities, &num_groups));
+  if (num_groups > 0) {
+    std::vector<SUGroupRef> groups(num_groups);
+    SU_CALL(SUEntitiesGetGroups(entities, num_groups, &groups[0], &num_groups));
+    for (size_t g = 0; g < num_groups; g++) {
+      SUEntitiesRef group_entities = SU_INVALID;
+      SU_CALL(SUGroupGetEntities(groups[g], &group_entities));
+      costs.push_back(1 + CountFaces(group_entities));
+    }
+  }
+
+  // The loose geometry is the last item
+  size_t num_faces = 0;
+  SU_CALL(SUEntitiesGetNumFaces(entities, &num_faces));
+  costs.push_back(1 + num_faces);
+}
+
+// Utility function to split items into at most num_parts runs of about the
+// same cost. Fills bounds with the first item of each run followed by the
+// number of items. Runs are contiguous so that writing them one after the
+// other keeps the item order.
+static void PartitionItems(const std::vector<size_t>& costs, size_t num_parts,
+                           std::vector<size_t>& bounds) {
+  double total = 0.0;
+  for (size_t i = 0; i < costs.size(); ++i) {
+    total += static_cast<double>(costs[i]);
+  }
+
+  // A run ends before the first item whose middle is past the run's share
+  bounds.assign(1, 0);
+  double sum = 0.0;
+  for (size_t i = 0; i < costs.size(); ++i) {
+    double cost = static_cast<double>(costs[i]);
+    size_t part = bounds.size();
+    if (part < num_parts && i > bounds.back() &&
+        sum + cost / 2.0 >= total * part / num_parts) {
+      bounds.push_back(i);
+    }
+    sum += cost;
+  }
+  bounds.push_back(costs.size());
+}
+
+// Utility function to format a number as a command line argument
+static std::string GetNumberArgument(size_t number) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%lu", static_cast<unsigned long>(number));
+  return buffer;
+}
+
 // Utility function to get a component definition's name
 static std::string GetComponentDefinitionName(
     SUComponentDefinitionRef comp_def) {
@@ -87,7 +407,15 @@ static std::string GetComponentDefinitionName(
   return name.utf8();
 }
 
-CXmlExporter::CXmlExporter() {
+CXmlExporter::CXmlExporter()
+  : write_entities_(NULL),
+    progress_callback_(NULL),
+    geometry_faces_(0),
+    geometry_faces_written_(0),
+    geometry_percent_(0.0),
+    has_hidden_outlines_(false),
+    model_read_(false),
+    world_geometry_built_(false) {
   SUSetInvalid(model_);
   SUSetInvalid(texture_writer_);
 }
@@ -114,11 +442,26 @@ bool CXmlExporter::Convert(const std::string& src_file,
     const std::string& dst_file,
     SketchUpPluginProgressCallback* progress_callback) {
   bool exported = false;
+  progress_callback_ = progress_callback;
   try {
     // Initialize the SDK
     SUInitialize();
 
-    // Create the model from the src_file
+    // Create the model from the src_file. The exporter may be reused for
+    // several files, start from a clean state.
+    stats_ = CXmlExportStats();
+    model_read_ = false;
+    world_geometry_built_ = false;
+    skipped_outlines_.clear();
+    definition_hints_.clear();
+    hints_ = XmlExportHints();
+    has_hidden_outlines_ = false;
+    layer_names_.clear();
+    layer_indices_.clear();
+    geometry_faces_ = 0;
+    geometry_faces_written_ = 0;
+    geometry_percent_ = kGeometryProgressStart;
+    SelectTraversal();
     SUSetInvalid(model_);
     SU_CALL(SUModelCreateFromFile(&model_, src_file.c_str()));
 
@@ -127,14 +470,13 @@ bool CXmlExporter::Convert(const std::string& src_file,
     SU_CALL(SUTextureWriterCreate(&texture_writer_));
 
     // Open the xml file for creation
-    if (!file_.Open(dst_file, true)) {
-      ReleaseModelObjects();
-      return exported;
-    }
+    if (!file_.Open(dst_file, true))
+      throw std::exception();
 
-    // Write textures
+    // Write textures, shard workers leave them to the coordinator
     HandleProgress(progress_callback, 0.0, "Writing Texture Files...");
-    WriteTextureFiles();
+    if (!options_.is_shard())
+      WriteTextureFiles();
 
     // Write file header
     int major_ver = 0, minor_ver = 0, build_no = 0;
@@ -145,17 +487,14 @@ bool CXmlExporter::Convert(const std::string& src_file,
     HandleProgress(progress_callback, 10.0, "Writing Layers...");
     WriteLayers();
 
-    // Materials
-    HandleProgress(progress_callback, 20.0, "Writing Materials...");
-    WriteMaterials();
-
-    // Component definitions
-//    HandleProgress(progress_callback, 40.0, "Writing Definitions...");
-//    WriteComponentDefinitions();
-
-    // Geometry
-    HandleProgress(progress_callback, 60.0, "Writing Geometry...");
-    WriteGeometry();
+    // Shard workers only add their part of the geometry, the layers are
+    // there for the layer indices
+    if (options_.is_shard()) {
+      HandleProgress(progress_callback, 60.0, "Writing Geometry...");
+      WriteGeometry(src_file, dst_file);
+    } else {
+      WriteModel(src_file, dst_file);
+    }
 
     file_.Close(IsCancelled(progress_callback));
 
@@ -166,10 +505,66 @@ bool CXmlExporter::Convert(const std::string& src_file,
     file_.Close(true);
   }
   ReleaseModelObjects();
+  progress_callback_ = NULL;
 
   return exported;
 }
 
+void CXmlExporter::WriteModel(const std::string& src_file,
+                              const std::string& dst_file) {
+  // Materials
+  HandleProgress(progress_callback_, 20.0, "Writing Materials...");
+  WriteMaterials();
+
+  // Component definitions
+  HandleProgress(progress_callback_, 40.0, "Writing Definitions...");
+  WriteComponentDefinitions();
+
+  // Geometry
+  HandleProgress(progress_callback_, 60.0, "Writing Geometry...");
+  WriteGeometry(src_file, dst_file);
+
+  // Outlines drawn twice where groups meet
+  HandleProgress(progress_callback_, 70.0, "Finding Duplicate Outlines...");
+  WriteDuplicateOutlines();
+
+  // Scenes
+  HandleProgress(progress_callback_, 80.0, "Writing Scenes...");
+  WriteScenes();
+
+  // Sections
+  HandleProgress(progress_callback_, 85.0, "Writing Sections...");
+  WriteSections();
+
+  // Visibility cells
+  HandleProgress(progress_callback_, 90.0, "Computing Visibility Cells...");
+  WriteVisibilityCells();
+
+  // Binary glTF
+  HandleProgress(progress_callback_, 95.0, "Writing glTF...");
+  WriteGlb(dst_file);
+
+  // OBJ and PLY
+  HandleProgress(progress_callback_, 97.0, "Writing Mesh Files...");
+  WriteMeshFiles(dst_file);
+
+  // Progressive geometry
+  HandleProgress(progress_callback_, 97.5, "Writing Progressive File...");
+  WriteProgressive(dst_file);
+
+  // Meshlets
+  HandleProgress(progress_callback_, 98.0, "Writing Meshlets...");
+  WriteMeshlets(dst_file);
+
+  // Edges for GPU silhouettes
+  HandleProgress(progress_callback_, 98.5, "Writing Silhouette Edges...");
+  WriteSilhouetteEdges(dst_file);
+
+  // Unity outline mesh
+  HandleProgress(progress_callback_, 99.0, "Writing Unity Lines...");
+  WriteUnityLines(dst_file);
+}
+
 void CXmlExporter::WriteTextureFiles() {
   if (options_.export_materials()) {
     // Load the textures into the texture writer
@@ -294,6 +689,15 @@ void CXmlExporter::WriteLayer(SULayerRef layer) {
 
   stats_.AddLayer();
   file_.WriteLayerInfo(info);
+
+  // Elements refer to the layer by its position in the Layers section
+  layer_indices_[info.name_] = static_cast<int>(layer_names_.size());
+  layer_names_.push_back(info.name_);
+}
+
+int CXmlExporter::GetLayerIndex(const std::string& name) const {
+  std::map<std::string, int>::const_iterator it = layer_indices_.find(name);
+  return it != layer_indices_.end() ? it->second : -1;
 }
 
 void CXmlExporter::WriteMaterials() {
@@ -338,18 +742,399 @@ void CXmlExporter::WriteMaterial(SUMaterialRef material) {
   file_.WriteMaterialInfo(info);
 }
 
-void CXmlExporter::WriteGeometry() {
+void CXmlExporter::WriteGeometry(const std::string& src_file,
+                                 const std::string& xml_file) {
   if (options_.export_faces() || options_.export_edges()) {
     // Write entities
     SUEntitiesRef model_entities;
     SU_CALL(SUModelGetEntities(model_, &model_entities));
     file_.StartGeometry();
-    WriteEntities(model_entities);
+    geometry_faces_ = 0;
+    geometry_faces_written_ = 0;
+    geometry_percent_ = kGeometryProgressStart;
+    if (options_.is_shard()) {
+      size_t first_item = options_.shard_first_item();
+      WriteEntities(model_entities, first_item,
+                    first_item + options_.shard_num_items());
+    } else if (!WriteShardedGeometry(model_entities, src_file, xml_file)) {
+      // Only worth the extra walk when someone watches the progress
+      if (progress_callback_ != NULL && options_.export_faces())
+        geometry_faces_ = CountFaces(model_entities);
+      WriteEntities(model_entities);
+    }
     file_.PopParentNode();
   }
 }
 
+bool CXmlExporter::WriteShardedGeometry(SUEntitiesRef entities,
+                                        const std::string& src_file,
+                                        const std::string& xml_file) {
+  if (options_.num_shards() < 2 || options_.shard_worker().empty())
+    return false;
+
+  std::vector<size_t> costs;
+  GetGeometryItemCosts(entities, costs);
+  std::vector<size_t> bounds;
+  PartitionItems(costs, options_.num_shards(), bounds);
+  size_t num_shards = bounds.size() - 1;
+  if (num_shards < 2)
+    return false;
+
+  // Each worker loads the model on its own and writes its shard next to the
+  // XML file
+  std::vector<std::vector<std::string> > commands(num_shards);
+  std::vector<std::string> shard_files(num_shards);
+  for (size_t s = 0; s < num_shards; ++s) {
+    shard_files[s] = GetSiblingPath(
+        xml_file, (".shard" + GetNumberArgument(s) + ".xml").c_str());
+    std::vector<std::string>& command = commands[s];
+    command.push_back(options_.shard_worker());
+    command.push_back("-shard");
+    command.push_back(GetNumberArgument(bounds[s]));
+    command.push_back(GetNumberArgument(bounds[s + 1] - bounds[s]));
+    if (!options_.export_faces())
+      command.push_back("-nofaces");
+    if (options_.export_layers())
+      command.push_back("-layers");
+    if (options_.max_detail() >= 0) {
+      command.push_back("-detail");
+      command.push_back(GetNumberArgument(options_.max_detail()));
+    }
+    command.push_back(src_file);
+    command.push_back(shard_files[s]);
+  }
+
+  size_t num_faces = 0;
+  bool ok = XmlProcessUtils::RunProcesses(commands) &&
+            file_.AppendGeometry(shard_files, num_faces,
+                                 has_hidden_outlines_);
+  for (size_t s = 0; s < num_shards; ++s) {
+    remove(shard_files[s].c_str());
+  }
+  if (ok)
+    stats_.AddFaces(num_faces);
+  return ok;
+}
+
+static XmlCameraInfo GetCameraInfo(SUCameraRef camera) {
+  XmlCameraInfo info;
+
+  SUPoint3D eye, target;
+  SUVector3D up;
+  SU_CALL(SUCameraGetOrientation(camera, &eye, &target, &up));
+  info.eye_ = CPoint3d(eye);
+  info.target_ = CPoint3d(target);
+  info.up_ = CVector3d(up);
+
+  bool is_perspective = true;
+  SU_CALL(SUCameraGetPerspective(camera, &is_perspective));
+  info.is_perspective_ = is_perspective;
+  if (is_perspective) {
+    SU_CALL(SUCameraGetPerspectiveFrustumFOV(camera, &info.fov_));
+  } else {
+    SU_CALL(SUCameraGetOrthographicFrustumHeight(camera, &info.ortho_height_));
+  }
+
+  // Fails if the camera follows the viewport aspect ratio
+  double aspect_ratio = 0.0;
+  if (SUCameraGetAspectRatio(camera, &aspect_ratio) == SU_ERROR_NONE)
+    info.aspect_ratio_ = aspect_ratio;
+
+  return info;
+}
+
+void CXmlExporter::WriteScenes() {
+  bool export_layers = options_.export_scene_layers() &&
+                       options_.export_layers();
+  if (!options_.export_cameras() && !export_layers)
+    return;
+
+  size_t num_scenes = 0;
+  SU_CALL(SUModelGetNumScenes(model_, &num_scenes));
+  if (num_scenes == 0)
+    return;
+
+  std::vector<SUSceneRef> scenes(num_scenes);
+  SU_CALL(SUModelGetScenes(model_, num_scenes, &scenes[0], &num_scenes));
+
+  std::vector<XmlSceneInfo> scene_infos(num_scenes);
+  for (size_t i = 0; i < num_scenes; ++i) {
+    XmlSceneInfo& info = scene_infos[i];
+    info.name_ = GetSceneName(scenes[i]);
+
+    bool use_camera = false;
+    SU_CALL(SUSceneGetUseCamera(scenes[i], &use_camera));
+    SUCameraRef camera = SU_INVALID;
+    if (options_.export_cameras() && use_camera &&
+        SUSceneGetCamera(scenes[i], &camera) == SU_ERROR_NONE) {
+      info.has_camera_ = true;
+      info.camera_ = GetCameraInfo(camera);
+    }
+
+    // Layer visibility, one flag per exported layer
+    std::set<std::string> hidden_layers;
+    if (export_layers && GetSceneHiddenLayers(scenes[i], hidden_layers)) {
+      info.has_visible_layers_ = true;
+      info.visible_layers_.resize(layer_names_.size());
+      for (size_t layer = 0; layer < layer_names_.size(); ++layer) {
+        info.visible_layers_[layer] =
+            hidden_layers.find(layer_names_[layer]) == hidden_layers.end();
+      }
+    }
+  }
+
+  if (options_.export_visible_lines() && options_.export_faces()) {
+    ComputeVisibleLines(scene_infos);
+  }
+
+  file_.StartScenes();
+  for (size_t i = 0; i < scene_infos.size(); ++i) {
+    file_.WriteSceneInfo(scene_infos[i]);
+    stats_.AddScene();
+  }
+  file_.PopParentNode();
+}
+
+void CXmlExporter::WriteDuplicateOutlines() {
+  if ((!options_.dedup_outlines() && !has_hidden_outlines_) ||
+      !options_.export_faces()) {
+    return;
+  }
+
+  BuildWorldGeometry();
+  const std::vector<XmlWorldSegment>& segments = world_geometry_.segments();
+  std::vector<bool> duplicates;
+  size_t num_duplicates = 0;
+  if (options_.dedup_outlines()) {
+    CXmlOutlineDeduplicator deduplicator(world_geometry_);
+    deduplicator.set_max_sort_bytes(options_.max_sort_bytes());
+    num_duplicates = deduplicator.Compute(duplicates);
+    stats_.AddSpilledSortRuns(deduplicator.num_spilled_runs());
+  }
+  if (num_duplicates > 0) {
+    file_.WriteDuplicateOutlines(duplicates);
+    stats_.AddDuplicateOutlines(num_duplicates);
+  }
+
+  // The outlines the export hints turned off have a table of their own.
+  // The other outputs skip both.
+  std::vector<bool> hidden(segments.size(), false);
+  size_t num_hidden = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (!segments[i].outline_) {
+      hidden[i] = true;
+      ++num_hidden;
+    }
+  }
+  if (num_hidden > 0)
+    file_.WriteHiddenOutlines(hidden);
+
+  if (num_duplicates == 0 && num_hidden == 0)
+    return;
+  duplicates.resize(segments.size(), false);
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (hidden[i])
+      duplicates[i] = true;
+  }
+  skipped_outlines_.swap(duplicates);
+}
+
+void CXmlExporter::WriteSections() {
+  if (!options_.export_sections() || !options_.export_faces())
+    return;
+
+  CSUTypedValue planes;
+  size_t num_values = 0;
+  if (!GetExporterAttribute(model_, kSectionPlanesKey, planes) ||
+      SUTypedValueGetNumArrayItems(planes.value(), &num_values) !=
+      SU_ERROR_NONE || num_values < 4) {
+    return;
+  }
+  std::vector<SUTypedValueRef> values(num_values);
+  SU_CALL(SUTypedValueGetArrayItems(planes.value(), num_values, &values[0],
+                                    &num_values));
+
+  std::vector<XmlSectionInfo> sections;
+  for (size_t i = 0; i + 3 < num_values; i += 4) {
+    double plane[4];
+    bool ok = true;
+    for (size_t j = 0; j < 4; ++j) {
+      ok &= GetTypedValueDouble(values[i + j], plane[j]);
+    }
+    if (ok) {
+      XmlSectionInfo info;
+      info.normal_.SetDirection(plane[0], plane[1], plane[2]);
+      info.offset_ = -plane[3];
+      sections.push_back(info);
+    }
+  }
+  if (sections.empty())
+    return;
+
+  BuildWorldGeometry();
+  CXmlSectionCutter cutter(world_geometry_, world_bvh_);
+  cutter.CutAll(sections);
+
+  file_.StartSections();
+  for (size_t i = 0; i < sections.size(); ++i) {
+    file_.WriteSectionInfo(sections[i]);
+    stats_.AddSection();
+  }
+  file_.PopParentNode();
+}
+
+void CXmlExporter::ComputeVisibleLines(std::vector<XmlSceneInfo>& scenes) {
+  BuildWorldGeometry();
+  CXmlHiddenLinePass pass(world_geometry_, world_bvh_);
+  for (size_t i = 0; i < scenes.size(); ++i) {
+    XmlSceneInfo& info = scenes[i];
+    if (info.has_camera_) {
+      info.has_visible_lines_ = true;
+      stats_.AddVisibleLines(pass.Compute(info.camera_, info.visible_lines_));
+    }
+  }
+}
+
+void CXmlExporter::WriteVisibilityCells() {
+  if (!options_.export_visibility_cells() || !options_.export_faces())
+    return;
+
+  BuildWorldGeometry();
+  CXmlCellVisibilityPass pass(world_geometry_, world_bvh_);
+  std::vector<XmlVisibilityCellInfo> cells;
+  if (pass.Compute(cells) == 0)
+    return;
+
+  file_.StartVisibilityCells();
+  for (size_t i = 0; i < cells.size(); ++i) {
+    file_.WriteVisibilityCellInfo(cells[i]);
+    stats_.AddVisibilityCell();
+  }
+  file_.PopParentNode();
+}
+
+void CXmlExporter::WriteGlb(const std::string& xml_file) {
+  if (!options_.export_glb())
+    return;
+
+  ReadBackModel();
+  CXmlGlbWriter writer(model_info_);
+  writer.set_optimize_vertex_cache(options_.optimize_vertex_cache());
+  if (writer.Write(GetSiblingPath(xml_file, ".glb"))) {
+    stats_.set_glb_meshes(writer.num_meshes());
+    AddVertexCacheStats(writer.vertex_cache());
+  }
+}
+
+void CXmlExporter::WriteMeshFiles(const std::string& xml_file) {
+  if (!options_.export_obj() && !options_.export_ply())
+    return;
+
+  BuildWorldGeometry();
+  CXmlMeshFileWriter writer(world_geometry_);
+  writer.set_parallel(true);
+  writer.set_optimize_vertex_cache(options_.optimize_vertex_cache());
+  if (options_.export_obj())
+    writer.WriteObj(GetSiblingPath(xml_file, ".obj"));
+  if (options_.export_ply())
+    writer.WritePly(GetSiblingPath(xml_file, ".ply"));
+  AddVertexCacheStats(writer.vertex_cache());
+}
+
+void CXmlExporter::AddVertexCacheStats(const XmlVertexCacheInfo& info) {
+  stats_.AddVertexCacheMisses(info.triangles_, info.misses_before_,
+                              info.misses_after_);
+}
+
+void CXmlExporter::WriteProgressive(const std::string& xml_file) {
+  if (!options_.export_progressive() || !options_.export_faces())
+    return;
+
+  BuildWorldGeometry();
+  CXmlProgressiveWriter writer(world_geometry_);
+  writer.Build(skipped_outlines_);
+  if (writer.Write(GetSiblingPath(xml_file, ".progressive.bin")))
+    stats_.set_progressive_chunks(writer.num_chunks());
+}
+
+void CXmlExporter::WriteMeshlets(const std::string& xml_file) {
+  if (!options_.export_meshlets() || !options_.export_faces())
+    return;
+
+  BuildWorldGeometry();
+  CXmlMeshletBuilder builder(world_geometry_);
+  builder.Build(skipped_outlines_);
+  if (builder.Write(GetSiblingPath(xml_file, ".meshlets.bin")))
+    stats_.set_meshlets(builder.meshlets().size());
+}
+
+void CXmlExporter::WriteSilhouetteEdges(const std::string& xml_file) {
+  if (!options_.export_silhouette_edges() || !options_.export_faces())
+    return;
+
+  BuildWorldGeometry();
+  CXmlSilhouetteEdgeWriter writer(world_geometry_);
+  writer.set_max_sort_bytes(options_.max_sort_bytes());
+  writer.Build();
+  stats_.AddSpilledSortRuns(writer.num_spilled_runs());
+  if (writer.Write(GetSiblingPath(xml_file, ".edges.bin")))
+    stats_.set_silhouette_edges(writer.edges().size());
+}
+
+void CXmlExporter::WriteUnityLines(const std::string& xml_file) {
+  if (!options_.export_unity_lines() || !options_.export_faces())
+    return;
+
+  CSUTypedValue value;
+  CSUString directory;
+  if (!GetExporterAttribute(model_, kLinesMeshDirectoryKey, value) ||
+      SUTypedValueGetString(value.value(), directory) != SU_ERROR_NONE) {
+    return;
+  }
+  std::string path = directory.utf8().c_str();
+  if (path.empty())
+    return;
+  if (path[path.size() - 1] != '/' && path[path.size() - 1] != '\\')
+    path.append("/");
+
+  // The names ModelPostProcessor gives the lines object and its mesh
+  std::string base = GetSiblingPath(xml_file, "");
+  size_t slash = base.find_last_of("/\\");
+  if (slash != std::string::npos)
+    base.erase(0, slash + 1);
+
+  BuildWorldGeometry();
+  CXmlUnityLineMesh mesh;
+  mesh.Build(world_geometry_, skipped_outlines_);
+  if (mesh.num_quads() > 0 &&
+      mesh.WriteAsset(path + base + "_Lines_newLines.asset", "Lines_" + base))
+    stats_.set_unity_line_quads(mesh.num_quads());
+}
+
+void CXmlExporter::ReadBackModel() {
+  if (model_read_)
+    return;
+
+  // Work from what has been written so that the segment and group order
+  // matches what readers of the file see.
+  file_.GetModelInfo(model_info_);
+  model_read_ = true;
+}
+
+void CXmlExporter::BuildWorldGeometry() {
+  if (world_geometry_built_)
+    return;
+
+  ReadBackModel();
+  world_geometry_.Build(model_info_);
+  world_bvh_.Build(world_geometry_);
+  world_geometry_built_ = true;
+}
+
 void CXmlExporter::WriteComponentDefinitions() {
+  if (!options_.export_component_definitions())
+    return;
+
   size_t num_comp_defs = 0;
   SU_CALL(SUModelGetNumComponentDefinitions(model_, &num_comp_defs));
   if (num_comp_defs > 0) {
@@ -378,7 +1163,36 @@ void CXmlExporter::WriteComponentDefinition(SUComponentDefinitionRef comp_def) {
   file_.PopParentNode();
 }
 
-void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
+void CXmlExporter::WriteEntities(SUEntitiesRef entities, size_t first_item,
+                                 size_t end_item) {
+  (this->*write_entities_)(entities, first_item, end_item);
+}
+
+void CXmlExporter::SelectTraversal() {
+  // By faces, layers and materials. Full exports, the geometry without
+  // materials and the outlines alone are the usual ones.
+  static const WriteEntitiesFunc kTraversals[8] = {
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<false, false, false> >,
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<false, false, true> >,
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<false, true, false> >,
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<false, true, true> >,
+    // Outlines
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<true, false, false> >,
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<true, false, true> >,
+    // Geometry without materials
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<true, true, false> >,
+    // Full
+    &CXmlExporter::TraverseEntities<XmlTraversalPolicy<true, true, true> >
+  };
+  int index = (options_.export_faces() ? 4 : 0) +
+              (options_.export_layers() ? 2 : 0) +
+              (options_.export_materials() ? 1 : 0);
+  write_entities_ = kTraversals[index];
+}
+
+template <typename Policy>
+void CXmlExporter::TraverseEntities(SUEntitiesRef entities, size_t first_item,
+                                    size_t end_item) {
   // Component instances
   size_t num_instances = 0;
   SU_CALL(SUEntitiesGetNumInstances(entities, &num_instances));
@@ -387,27 +1201,44 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
     SU_CALL(SUEntitiesGetInstances(entities, num_instances,
                                    &instances[0], &num_instances));
     for (size_t c = 0; c < num_instances; c++) {
+      if (c < first_item || c >= end_item)
+        continue;
       SUComponentInstanceRef instance = instances[c];
       SUComponentDefinitionRef definition = SU_INVALID;
       SU_CALL(SUComponentInstanceGetDefinition(instance, &definition));
+      XmlExportHints hints = GetExportHints(
+          SUComponentInstanceToEntity(instance), definition);
+      if (IsPruned(hints))
+        continue;
 
       XmlComponentInstanceInfo instance_info;
+      instance_info.outline_ = hints.outline_ && !hints.collision_only_;
+      instance_info.collision_only_ = hints.collision_only_;
+      has_hidden_outlines_ |= !instance_info.outline_;
       
       // Layer
       SULayerRef layer = SU_INVALID;
-      SUDrawingElementGetLayer(SUComponentInstanceToDrawingElement(instance),
-                               &layer);
-      if (!SUIsInvalid(layer))
-        instance_info.layer_name_ = GetLayerName(layer);
+      if (Policy::kExportLayers &&
+          SUDrawingElementGetLayer(
+              SUComponentInstanceToDrawingElement(instance), &layer) ==
+          SU_ERROR_NONE && !SUIsInvalid(layer)) {
+        std::string layer_name = GetLayerName(layer);
+        instance_info.layer_name_id_ = file_.names().Intern(layer_name);
+        instance_info.layer_index_ = GetLayerIndex(layer_name);
+      }
 
       // Material
       SUMaterialRef material = SU_INVALID;
-      SUDrawingElementGetMaterial(SUComponentInstanceToDrawingElement(instance),
-                                  &material);
-      if (!SUIsInvalid(material))
-        instance_info.material_name_ = GetMaterialName(material);
+      if (Policy::kExportMaterials &&
+          SUDrawingElementGetMaterial(
+              SUComponentInstanceToDrawingElement(instance), &material) ==
+          SU_ERROR_NONE && !SUIsInvalid(material)) {
+        instance_info.material_name_id_ =
+            file_.names().Intern(GetMaterialName(material));
+      }
 
-      instance_info.definition_name_ = GetComponentDefinitionName(definition);
+      instance_info.definition_name_id_ =
+          file_.names().Intern(GetComponentDefinitionName(definition));
       SU_CALL(SUComponentInstanceGetTransform(instance,
                                               &instance_info.transform_));
       file_.WriteComponentInstanceInfo(instance_info);
@@ -421,15 +1252,41 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
     std::vector<SUGroupRef> groups(num_groups);
     SU_CALL(SUEntitiesGetGroups(entities, num_groups, &groups[0], &num_groups));
     for (size_t g = 0; g < num_groups; g++) {
+      size_t item = num_instances + g;
+      if (item < first_item || item >= end_item)
+        continue;
+      CheckCancelled();
       SUGroupRef group = groups[g];
       SUComponentDefinitionRef group_component = SU_INVALID;
       SUEntitiesRef group_entities = SU_INVALID;
       SU_CALL(SUGroupGetEntities(group, &group_entities));
+      // Older SketchUp versions have no group definitions, only the group's
+      // own hints count there
+      SUGroupGetDefinition(group, &group_component);
+      XmlExportHints hints = GetExportHints(SUGroupToEntity(group),
+                                            group_component);
+      if (IsPruned(hints))
+        continue;
+      XmlExportHints parent_hints = hints_;
+      hints_ = hints;
       inheritance_manager_.PushElement(group);
-      file_.StartGroup();
+
+      // Layer
+      std::string layer_name;
+      SULayerRef layer = SU_INVALID;
+      if (Policy::kExportLayers &&
+          SUDrawingElementGetLayer(SUGroupToDrawingElement(group), &layer) ==
+          SU_ERROR_NONE && !SUIsInvalid(layer)) {
+        layer_name = GetLayerName(layer);
+      }
+      bool outline = hints_.outline_ && !hints_.collision_only_;
+      has_hidden_outlines_ |= !outline;
+      file_.StartGroup(layer_name,
+                       Policy::kExportLayers ? GetLayerIndex(layer_name) : -1,
+                       outline, hints_.collision_only_);
 
       // Write entities
-      WriteEntities(group_entities);
+      TraverseEntities<Policy>(group_entities);
 
       // Write transformation
       SUTransformation transform;
@@ -438,20 +1295,28 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
 
       file_.PopParentNode();
       inheritance_manager_.PopElement();
+      hints_ = parent_hints;
     }
   }
 
+  // The loose geometry is the item after the groups
+  size_t loose_item = num_instances + num_groups;
+  if (loose_item < first_item || loose_item >= end_item)
+    return;
+
   // Faces
-  if (options_.export_faces()) {
+  if (Policy::kExportFaces) {
     size_t num_faces = 0;
     SU_CALL(SUEntitiesGetNumFaces(entities, &num_faces));
     if (num_faces > 0) {
       std::vector<SUFaceRef> faces(num_faces);
       SU_CALL(SUEntitiesGetFaces(entities, num_faces, &faces[0], &num_faces));
       for (size_t i = 0; i < num_faces; i++) {
+        CheckCancelled();
         inheritance_manager_.PushElement(faces[i]);
-        WriteFace(faces[i]);
+        WriteFace<Policy>(faces[i]);
         inheritance_manager_.PopElement();
+        StepGeometryProgress();
       }
     }
   }
@@ -467,7 +1332,7 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
 //                                 &edges[0], &num_edges));
 //      for (size_t i = 0; i < num_edges; i++) {
 //        inheritance_manager_.PushElement(edges[i]);
-//        WriteEdge(edges[i]);
+//        WriteEdge<Policy>(edges[i]);
 //        inheritance_manager_.PopElement();
 //      }
 //    }
@@ -482,20 +1347,87 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
 //      SU_CALL(SUEntitiesGetCurves(entities, num_curves,
 //                                  &curves[0], &num_curves));
 //      for (size_t i = 0; i < num_curves; i++) {
-//        WriteCurve(curves[i]);
+//        WriteCurve<Policy>(curves[i]);
 //      }
 //    }
 //  //}
 }
 
+XmlExportHints CXmlExporter::GetExportHints(
+    SUEntityRef entity, SUComponentDefinitionRef definition) {
+  XmlExportHints hints;
+  if (!SUIsInvalid(definition)) {
+    std::map<const void*, XmlExportHints>::iterator it =
+        definition_hints_.find(definition.ptr);
+    if (it == definition_hints_.end()) {
+      XmlExportHints definition_hints;
+      ReadExportHints(SUComponentDefinitionToEntity(definition),
+                      definition_hints);
+      it = definition_hints_.insert(
+          std::make_pair(definition.ptr, definition_hints)).first;
+    }
+    hints = it->second;
+  }
+  ReadExportHints(entity, hints);
+
+  // Subtrees only lose outlines and detail
+  hints.outline_ = hints.outline_ && hints_.outline_;
+  hints.collision_only_ = hints.collision_only_ || hints_.collision_only_;
+  hints.detail_ = std::max(hints.detail_, hints_.detail_);
+  return hints;
+}
+
+bool CXmlExporter::IsPruned(const XmlExportHints& hints) {
+  if (hints.export_ &&
+      (options_.max_detail() < 0 || hints.detail_ <= options_.max_detail())) {
+    return false;
+  }
+  stats_.AddPrunedEntity();
+  return true;
+}
+
+void CXmlExporter::CheckCancelled() {
+  if (IsCancelled(progress_callback_))
+    throw std::exception();
+}
+
+void CXmlExporter::StepGeometryProgress() {
+  if (progress_callback_ == NULL)
+    return;
+  ++geometry_faces_written_;
+  if (geometry_faces_ == 0)
+    return;
+  double percent = kGeometryProgressStart + kGeometryProgressRange *
+      geometry_faces_written_ / geometry_faces_;
+  if (percent - geometry_percent_ >= kGeometryProgressStep) {
+    geometry_percent_ = percent;
+    progress_callback_->SetPercentDone(percent);
+  }
+}
+
+template <typename Policy>
 void CXmlExporter::WriteFace(SUFaceRef face) {
   if (SUIsInvalid(face))
     return;
 
+  // Layer, shared by the outer and inner loops. Name 0 is the empty name.
+  int layer_name_id = 0;
+  int layer_index = -1;
+  SULayerRef layer = SU_INVALID;
+  if (Policy::kExportLayers &&
+      SUDrawingElementGetLayer(SUFaceToDrawingElement(face), &layer) ==
+      SU_ERROR_NONE && !SUIsInvalid(layer)) {
+    std::string layer_name = GetLayerName(layer);
+    layer_name_id = file_.names().Intern(layer_name);
+    layer_index = GetLayerIndex(layer_name);
+  }
 
   //outer loop
+    std::vector<XmlFaceVertex> face_vertices;
     XmlFaceInfo info;
     info.has_single_loop_ = true;
+    info.layer_name_id_ = layer_name_id;
+    info.layer_index_ = layer_index;
     SULoopRef outer_loop = SU_INVALID;
     SU_CALL(SUFaceGetOuterLoop(face, &outer_loop));
     size_t num_vertices;
@@ -511,11 +1443,14 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
             SU_CALL(SUVertexGetPosition(vertex_ref, &su_point));
             vertex_info.vertex_ = CPoint3d(su_point);
             
-            info.vertices_.push_back(vertex_info);
+            face_vertices.push_back(vertex_info);
         }
+        ReadLoopEdges<Policy::kExportMaterials>(outer_loop, vertices,
+                                                face_vertices);
     }
+    info.num_vertices_ = face_vertices.size();
     stats_.AddFace();
-    file_.WriteFaceInfo(info);
+    file_.WriteFaceInfo(info, face_vertices);
     
    
     
@@ -531,7 +1466,11 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
         {
             XmlFaceInfo info;
             info.has_single_loop_ = true;
+            info.is_inner_loop_ = true;
+            info.layer_name_id_ = layer_name_id;
+            info.layer_index_ = layer_index;
             SULoopRef inner_loop = loops[i];
+            face_vertices.clear();
             size_t num_vertices;
             SU_CALL(SULoopGetNumVertices(inner_loop, &num_vertices));
             if (num_vertices > 0) {
@@ -545,30 +1484,36 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
                     SU_CALL(SUVertexGetPosition(vertex_ref, &su_point));
                     vertex_info.vertex_ = CPoint3d(su_point);
                     
-                    info.vertices_.push_back(vertex_info);
+                    face_vertices.push_back(vertex_info);
                 }
+                ReadLoopEdges<Policy::kExportMaterials>(inner_loop, vertices,
+                                                        face_vertices);
             }
+            info.num_vertices_ = face_vertices.size();
             stats_.AddFace();
-            file_.WriteFaceInfo(info);
+            file_.WriteFaceInfo(info, face_vertices);
         }
     }
 }
 
-XmlEdgeInfo CXmlExporter::GetEdgeInfo(SUEdgeRef edge) const {
+template <typename Policy>
+XmlEdgeInfo CXmlExporter::GetEdgeInfo(SUEdgeRef edge) {
   XmlEdgeInfo info;
   info.has_layer_ = false;
-  if (options_.export_layers()) {
+  if (Policy::kExportLayers) {
     info.has_layer_ = true;
     SULayerRef layer = inheritance_manager_.GetCurrentLayer();
     if (!SUIsInvalid(layer)) {
       SU_CALL(SUDrawingElementGetLayer(SUEdgeToDrawingElement(edge), &layer));
-      info.layer_name_ = GetLayerName(layer);
+      std::string layer_name = GetLayerName(layer);
+      info.layer_name_id_ = file_.names().Intern(layer_name);
+      info.layer_index_ = GetLayerIndex(layer_name);
     }
   }
 
   // Edge color
   info.has_color_ = false;
-  if (options_.export_materials()) {
+  if (Policy::kExportMaterials) {
     info.color_ = inheritance_manager_.GetCurrentEdgeColor();
     info.has_color_ = true;
   }
@@ -589,15 +1534,17 @@ XmlEdgeInfo CXmlExporter::GetEdgeInfo(SUEdgeRef edge) const {
   return info;
 }
 
+template <typename Policy>
 void CXmlExporter::WriteEdge(SUEdgeRef edge) {
   if (SUIsInvalid(edge))
     return;
 
-  XmlEdgeInfo info = GetEdgeInfo(edge);
+  XmlEdgeInfo info = GetEdgeInfo<Policy>(edge);
   file_.WriteEdgeInfo(info);
   stats_.AddEdge();
 }
 
+template <typename Policy>
 void CXmlExporter::WriteCurve(SUCurveRef curve) {
   if (SUIsInvalid(curve))
     return;
@@ -608,7 +1555,7 @@ void CXmlExporter::WriteCurve(SUCurveRef curve) {
   std::vector<SUEdgeRef> edges(num_edges);
   SU_CALL(SUCurveGetEdges(curve, num_edges, &edges[0], &num_edges));
   for (size_t i = 0; i < num_edges; ++i) {
-    XmlEdgeInfo edge_info = GetEdgeInfo(edges[i]);
+    XmlEdgeInfo edge_info = GetEdgeInfo<Policy>(edges[i]);
     info.edges_.push_back(edge_info);
   }
   file_.WriteCurveInfo(info);
@@ -3,14 +3,51 @@
 #ifndef SKPTOXML_COMMON_XMLEXPORTER_H
 #define SKPTOXML_COMMON_XMLEXPORTER_H
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "./xmlinheritancemanager.h"
 #include "./xmloptions.h"
 #include "./xmlstats.h"
 #include "../../common/xmlfile.h"
+#include "../../common/xmlpolygonbvh.h"
+#include "../../common/xmlvertexcache.h"
+#include "../../common/xmlworldgeometry.h"
 
 #include <slapi/import_export/pluginprogresscallback.h>
 #include <slapi/model/defs.h>
 
+// Export hints, keys of the exporter's attribute dictionary on groups,
+// component instances and component definitions. The keys an instance or
+// group sets override those of its definition, and a subtree inherits the
+// outline, collision and detail hints of its parents.
+struct XmlExportHints {
+  XmlExportHints()
+    : export_(true), outline_(true), collision_only_(false), detail_(0) {}
+
+  // "Export", false leaves the subtree out
+  bool export_;
+  // "Outline", false writes the faces without outlines
+  bool outline_;
+  // "CollisionOnly", the subtree is only meant for colliders and draws no
+  // outlines
+  bool collision_only_;
+  // "Detail", subtrees above CXmlOptions::max_detail are left out
+  int detail_;
+};
+
+// Options the geometry traversal tests for every face and edge, as
+// constants. CXmlExporter instantiates its traversal for each combination
+// and picks the one matching its options once per export, so that the
+// compiler drops the layer and material lookups an export turns off.
+template <bool kFaces, bool kLayers, bool kMaterials>
+struct XmlTraversalPolicy {
+  static const bool kExportFaces = kFaces;
+  static const bool kExportLayers = kLayers;
+  static const bool kExportMaterials = kMaterials;
+};
+
 class CXmlExporter {
  public:
   CXmlExporter();
@@ -22,7 +59,10 @@ class CXmlExporter {
                SketchUpPluginProgressCallback* callback);
 
   // Set user options
-  void SetOptions(const CXmlOptions& options) { options_ = options; }
+  void SetOptions(const CXmlOptions& options) {
+    options_ = options;
+    file_.set_retained_pool_bytes(options.retained_pool_bytes());
+  }
 
   // Get stats
   const CXmlExportStats& stats() const { return stats_; }
@@ -31,11 +71,16 @@ private:
   // Clean up slapi objects
   void ReleaseModelObjects();
 
+  // Everything after the layers, for exports that are not shard workers
+  void WriteModel(const std::string& src_file, const std::string& dst_file);
+
   // Write texture files to the destination directory
   void WriteTextureFiles();
 
   void WriteLayers();
   void WriteLayer(SULayerRef layer);
+  // Position of the layer in the Layers section, -1 if it was not written
+  int GetLayerIndex(const std::string& name) const;
 
   void WriteMaterials();
   void WriteMaterial(SUMaterialRef material);
@@ -43,16 +88,87 @@ private:
   void WriteComponentDefinitions();
   void WriteComponentDefinition(SUComponentDefinitionRef comp_def);
 
-  void WriteGeometry();
-  void WriteEntities(SUEntitiesRef entities);
+  void WriteScenes();
+  void ComputeVisibleLines(std::vector<XmlSceneInfo>& scenes);
+
+  void WriteDuplicateOutlines();
+  void WriteSections();
+  void WriteVisibilityCells();
+
+  // Binary glTF next to the XML file, built from the model read back
+  void WriteGlb(const std::string& xml_file);
+
+  // OBJ and PLY files next to the XML file, from the world geometry
+  void WriteMeshFiles(const std::string& xml_file);
+  void AddVertexCacheStats(const XmlVertexCacheInfo& info);
+
+  // Progressive geometry file next to the XML file
+  void WriteProgressive(const std::string& xml_file);
+
+  // Meshlet buffers next to the XML file
+  void WriteMeshlets(const std::string& xml_file);
+
+  // Edges with both face normals next to the XML file
+  void WriteSilhouetteEdges(const std::string& xml_file);
+
+  // Unity mesh asset of the outlines, named after the XML file
+  void WriteUnityLines(const std::string& xml_file);
+
+  // Reads the geometry written so far back into model_info_, once per export
+  void ReadBackModel();
+
+  // Builds world_geometry_ and world_bvh_ from the geometry written so far,
+  // once per export.
+  void BuildWorldGeometry();
+
+  void WriteGeometry(const std::string& src_file, const std::string& xml_file);
+  // Has shard worker processes write the top level items and appends their
+  // output in order. Returns false, having written nothing, if sharding is
+  // off or a worker failed.
+  bool WriteShardedGeometry(SUEntitiesRef entities,
+                            const std::string& src_file,
+                            const std::string& xml_file);
+  // Writes the top level items [first_item, end_item) of entities, see
+  // CXmlOptions::set_shard, through the traversal SelectTraversal picked
+  void WriteEntities(SUEntitiesRef entities, size_t first_item = 0,
+                     size_t end_item = static_cast<size_t>(-1));
+  // Points write_entities_ to the traversal for options_
+  void SelectTraversal();
+
+  // The traversal, Policy is a XmlTraversalPolicy
+  template <typename Policy>
+  void TraverseEntities(SUEntitiesRef entities, size_t first_item = 0,
+                        size_t end_item = static_cast<size_t>(-1));
+  template <typename Policy>
   void WriteFace(SUFaceRef face);
+  template <typename Policy>
   void WriteEdge(SUEdgeRef edge);
+  template <typename Policy>
   void WriteCurve(SUCurveRef curve);
-
-  XmlEdgeInfo GetEdgeInfo(SUEdgeRef edge) const;
+  template <typename Policy>
+  XmlEdgeInfo GetEdgeInfo(SUEdgeRef edge);
+
+  // Hints of a group or component instance of definition, combined with
+  // those of the subtree being written
+  XmlExportHints GetExportHints(SUEntityRef entity,
+                                SUComponentDefinitionRef definition);
+  // Whether a subtree with these hints is left out, counted in the stats
+  bool IsPruned(const XmlExportHints& hints);
+
+  // Throws to the top level handler once the export has been cancelled,
+  // checked for every group and face written
+  void CheckCancelled();
+  // Counts a written face and reports the geometry progress once it moved on
+  // by a step
+  void StepGeometryProgress();
 
 private:
+  typedef void (CXmlExporter::*WriteEntitiesFunc)(SUEntitiesRef, size_t,
+                                                  size_t);
+
   CXmlOptions options_;
+  // Instantiation of TraverseEntities for options_
+  WriteEntitiesFunc write_entities_;
 
   // Export statistics. Filled in by this exporters class and used later by
   // the platform specific plugin classes to populate the results dialog.
@@ -62,11 +178,40 @@ private:
   SUModelRef model_;
   SUTextureWriterRef texture_writer_;
 
+  // Progress callback of the running conversion, NULL if none
+  SketchUpPluginProgressCallback* progress_callback_;
+  // Faces to write and written by WriteEntities, and the percent last
+  // reported for them
+  size_t geometry_faces_;
+  size_t geometry_faces_written_;
+  double geometry_percent_;
+
   // Stack
   CInheritanceManager inheritance_manager_;
 
   // File & stats
   CXmlFile file_;
+
+  // Export hints of the component definitions, read once per definition
+  std::map<const void*, XmlExportHints> definition_hints_;
+  // Hints of the subtree being written
+  XmlExportHints hints_;
+  // Whether groups were written without outlines
+  bool has_hidden_outlines_;
+
+  // Names of the written layers, in order, and their indices
+  std::vector<std::string> layer_names_;
+  std::map<std::string, int> layer_indices_;
+
+  // Geometry read back from file_ for the offline processing passes
+  bool model_read_;
+  XmlModelInfo model_info_;
+  bool world_geometry_built_;
+  CXmlWorldGeometry world_geometry_;
+  CXmlPolygonBvh world_bvh_;
+  // Flags of the outline segments written as duplicates or hidden by the
+  // export hints, which the other outputs leave out. Empty if none.
+  std::vector<bool> skipped_outlines_;
 };
 
 #endif // SKPTOXML_COMMON_XMLEXPORTER_H
@@ -3,6 +3,9 @@
 #ifndef SKPTOXML_COMMON_XMLOPTIONS_H
 #define SKPTOXML_COMMON_XMLOPTIONS_H
 
+#include <stddef.h>
+#include <string>
+
 class CXmlOptions {
  public:
   CXmlOptions(void) {
@@ -12,6 +15,27 @@ class CXmlOptions {
    export_materials_by_layer_ = false;
    export_layers_ = true;
    export_options_ = false;
+   export_cameras_ = false;
+   export_visible_lines_ = false;
+   export_visibility_cells_ = false;
+   export_sections_ = false;
+   export_scene_layers_ = false;
+   dedup_outlines_ = false;
+   export_glb_ = false;
+   export_obj_ = false;
+   export_ply_ = false;
+   export_unity_lines_ = false;
+   export_progressive_ = false;
+   export_meshlets_ = false;
+   export_silhouette_edges_ = false;
+   export_component_definitions_ = false;
+   optimize_vertex_cache_ = true;
+   num_shards_ = 1;
+   shard_first_item_ = 0;
+   shard_num_items_ = 0;
+   max_detail_ = -1;
+   max_sort_bytes_ = 0;
+   retained_pool_bytes_ = 64 * 1024 * 1024;
   }
 
   virtual ~CXmlOptions(void) {}
@@ -38,6 +62,128 @@ class CXmlOptions {
   inline bool export_options() const { return export_options_; }
   inline void set_export_options(bool value) { export_options_ = value; }
 
+  inline bool export_cameras() const { return export_cameras_; }
+  inline void set_export_cameras(bool value) { export_cameras_ = value; }
+
+  // Per scene visibility of the outline segments, needs cameras and faces
+  inline bool export_visible_lines() const { return export_visible_lines_; }
+  inline void set_export_visible_lines(bool value) {
+      export_visible_lines_ = value;
+  }
+
+  // Potentially visible groups per navigable cell, needs faces
+  inline bool export_visibility_cells() const {
+      return export_visibility_cells_;
+  }
+  inline void set_export_visibility_cells(bool value) {
+      export_visibility_cells_ = value;
+  }
+
+  // Section outlines for the planes stored by SaveToUnity.rb, needs faces
+  inline bool export_sections() const { return export_sections_; }
+  inline void set_export_sections(bool value) { export_sections_ = value; }
+
+  // Per scene layer visibility stored by SaveToUnity.rb, needs layers
+  inline bool export_scene_layers() const { return export_scene_layers_; }
+  inline void set_export_scene_layers(bool value) {
+      export_scene_layers_ = value;
+  }
+
+  // Flag outline segments that coincide with those of other groups
+  inline bool dedup_outlines() const { return dedup_outlines_; }
+  inline void set_dedup_outlines(bool value) { dedup_outlines_ = value; }
+
+  // Binary glTF copy of the model next to the XML file
+  inline bool export_glb() const { return export_glb_; }
+  inline void set_export_glb(bool value) { export_glb_ = value; }
+
+  // World space OBJ and binary PLY copies of the faces and outlines
+  inline bool export_obj() const { return export_obj_; }
+  inline void set_export_obj(bool value) { export_obj_ = value; }
+  inline bool export_ply() const { return export_ply_; }
+  inline void set_export_ply(bool value) { export_ply_ = value; }
+
+  // Unity mesh asset of the outlines, written to the directory SaveToUnity.rb
+  // sets on the model
+  inline bool export_unity_lines() const { return export_unity_lines_; }
+  inline void set_export_unity_lines(bool value) {
+    export_unity_lines_ = value;
+  }
+
+  // Faces and outlines sorted coarse content first, see CXmlProgressiveWriter
+  inline bool export_progressive() const { return export_progressive_; }
+  inline void set_export_progressive(bool value) {
+    export_progressive_ = value;
+  }
+
+  // Faces and outlines cut into meshlets, see CXmlMeshletBuilder
+  inline bool export_meshlets() const { return export_meshlets_; }
+  inline void set_export_meshlets(bool value) { export_meshlets_ = value; }
+
+  // Each edge once with the normals of both its faces, for outlines drawn
+  // by the GPU, see CXmlSilhouetteEdgeWriter
+  inline bool export_silhouette_edges() const {
+    return export_silhouette_edges_;
+  }
+  inline void set_export_silhouette_edges(bool value) {
+    export_silhouette_edges_ = value;
+  }
+
+  // Component definitions section, which the instances in the geometry
+  // refer to. The world geometry, glTF and outline passes expand the
+  // instances through it, and CXmlPackageBuilder moves it to its store.
+  inline bool export_component_definitions() const {
+    return export_component_definitions_;
+  }
+  inline void set_export_component_definitions(bool value) {
+    export_component_definitions_ = value;
+  }
+
+  // Reorders the triangles of the glTF, OBJ and PLY files for the GPU's
+  // vertex cache, see CXmlVertexCacheOptimizer. On unless turned off.
+  inline bool optimize_vertex_cache() const { return optimize_vertex_cache_; }
+  inline void set_optimize_vertex_cache(bool value) {
+    optimize_vertex_cache_ = value;
+  }
+
+  // Splits the geometry over this many processes running shard_worker, which
+  // is called with -shard (see skp_to_xml/cli). 1 writes it in this process.
+  inline size_t num_shards() const { return num_shards_; }
+  inline void set_num_shards(size_t value) { num_shards_ = value; }
+  inline const std::string& shard_worker() const { return shard_worker_; }
+  inline void set_shard_worker(const std::string& value) {
+    shard_worker_ = value;
+  }
+
+  // Makes this export a shard worker, writing only the layers and the top
+  // level items [first_item, first_item + num_items) of the geometry. Items
+  // are the component instances, then the groups, then the loose geometry.
+  inline bool is_shard() const { return shard_num_items_ > 0; }
+  inline size_t shard_first_item() const { return shard_first_item_; }
+  inline size_t shard_num_items() const { return shard_num_items_; }
+  inline void set_shard(size_t first_item, size_t num_items) {
+    shard_first_item_ = first_item;
+    shard_num_items_ = num_items;
+  }
+
+  // Highest "Detail" export hint written, groups and component instances
+  // above it are left out. -1 writes every level.
+  inline int max_detail() const { return max_detail_; }
+  inline void set_max_detail(int value) { max_detail_ = value; }
+
+  // Memory the offline passes may sort in, bytes. Sorts needing more spill
+  // to temporary files, see CXmlExternalSorter. 0 keeps them in memory.
+  inline size_t max_sort_bytes() const { return max_sort_bytes_; }
+  inline void set_max_sort_bytes(size_t value) { max_sort_bytes_ = value; }
+
+  // XML node pool memory kept for the next export once the file is written,
+  // bytes. Saves reallocating it in batch exports, at the cost of holding it
+  // while idle. 0 releases it all.
+  inline size_t retained_pool_bytes() const { return retained_pool_bytes_; }
+  inline void set_retained_pool_bytes(size_t value) {
+    retained_pool_bytes_ = value;
+  }
+
  private:
   bool export_materials_;
   bool export_faces_;
@@ -45,6 +191,28 @@ class CXmlOptions {
   bool export_materials_by_layer_;
   bool export_layers_;
   bool export_options_;
+  bool export_cameras_;
+  bool export_visible_lines_;
+  bool export_visibility_cells_;
+  bool export_sections_;
+  bool export_scene_layers_;
+  bool dedup_outlines_;
+  bool export_glb_;
+  bool export_obj_;
+  bool export_ply_;
+  bool export_unity_lines_;
+  bool export_progressive_;
+  bool export_meshlets_;
+  bool export_silhouette_edges_;
+  bool export_component_definitions_;
+  bool optimize_vertex_cache_;
+  size_t num_shards_;
+  std::string shard_worker_;
+  size_t shard_first_item_;
+  size_t shard_num_items_;
+  int max_detail_;
+  size_t max_sort_bytes_;
+  size_t retained_pool_bytes_;
 };
 
 #endif // SKPTOXML_COMMON_XMLOPTIONS_H
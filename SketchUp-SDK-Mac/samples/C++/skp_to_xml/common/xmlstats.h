@@ -13,19 +13,74 @@ class CXmlExportStats {
     edges_ = 0;
     layers_ = 0;
     options_ = 0;
+    scenes_ = 0;
+    visible_lines_ = 0;
+    visibility_cells_ = 0;
+    sections_ = 0;
+    duplicate_outlines_ = 0;
+    glb_meshes_ = 0;
+    unity_line_quads_ = 0;
+    pruned_entities_ = 0;
+    progressive_chunks_ = 0;
+    meshlets_ = 0;
+    silhouette_edges_ = 0;
+    spilled_sort_runs_ = 0;
+    vertex_cache_triangles_ = 0;
+    vertex_cache_misses_before_ = 0;
+    vertex_cache_misses_after_ = 0;
   }
 
   inline void set_textures(size_t num) { textures_ = num; }
   inline void AddEdge() { edges_++; }
   inline void AddFace() { faces_++; }
+  inline void AddFaces(size_t num) { faces_ += num; }
   inline void AddLayer() { layers_++; }
   inline void AddOption() { options_++; }
+  inline void AddScene() { scenes_++; }
+  inline void AddVisibleLines(size_t num) { visible_lines_ += num; }
+  inline void AddVisibilityCell() { visibility_cells_++; }
+  inline void AddSection() { sections_++; }
+  inline void AddDuplicateOutlines(size_t num) {
+    duplicate_outlines_ += num;
+  }
+  inline void set_glb_meshes(size_t num) { glb_meshes_ = num; }
+  inline void set_unity_line_quads(size_t num) { unity_line_quads_ = num; }
+  inline void AddPrunedEntity() { pruned_entities_++; }
+  inline void set_progressive_chunks(size_t num) { progressive_chunks_ = num; }
+  inline void set_meshlets(size_t num) { meshlets_ = num; }
+  inline void set_silhouette_edges(size_t num) { silhouette_edges_ = num; }
+  inline void AddSpilledSortRuns(size_t num) { spilled_sort_runs_ += num; }
+  inline void AddVertexCacheMisses(size_t triangles, size_t before,
+                                   size_t after) {
+    vertex_cache_triangles_ += triangles;
+    vertex_cache_misses_before_ += before;
+    vertex_cache_misses_after_ += after;
+  }
 
   size_t textures() const { return textures_; }
   size_t faces() const { return faces_; }
   size_t edges() const { return edges_; }
   size_t layers() const { return layers_; }
   size_t options() const { return options_; }
+  size_t scenes() const { return scenes_; }
+  size_t visible_lines() const { return visible_lines_; }
+  size_t visibility_cells() const { return visibility_cells_; }
+  size_t sections() const { return sections_; }
+  size_t duplicate_outlines() const { return duplicate_outlines_; }
+  size_t glb_meshes() const { return glb_meshes_; }
+  size_t unity_line_quads() const { return unity_line_quads_; }
+  size_t pruned_entities() const { return pruned_entities_; }
+  size_t progressive_chunks() const { return progressive_chunks_; }
+  size_t meshlets() const { return meshlets_; }
+  size_t silhouette_edges() const { return silhouette_edges_; }
+  size_t spilled_sort_runs() const { return spilled_sort_runs_; }
+  size_t vertex_cache_triangles() const { return vertex_cache_triangles_; }
+  size_t vertex_cache_misses_before() const {
+    return vertex_cache_misses_before_;
+  }
+  size_t vertex_cache_misses_after() const {
+    return vertex_cache_misses_after_;
+  }
 
  protected:
   size_t textures_;
@@ -33,6 +88,21 @@ class CXmlExportStats {
   size_t edges_;
   size_t layers_;
   size_t options_;
+  size_t scenes_;
+  size_t visible_lines_;
+  size_t visibility_cells_;
+  size_t sections_;
+  size_t duplicate_outlines_;
+  size_t glb_meshes_;
+  size_t unity_line_quads_;
+  size_t pruned_entities_;
+  size_t progressive_chunks_;
+  size_t meshlets_;
+  size_t silhouette_edges_;
+  size_t spilled_sort_runs_;
+  size_t vertex_cache_triangles_;
+  size_t vertex_cache_misses_before_;
+  size_t vertex_cache_misses_after_;
 };
 
 #endif // SKPTOXML_COMMON_XMLSTATS_H
@@ -22,6 +22,12 @@ class CXmlExporterPluginMac;
   IBOutlet NSButton* exportSelectionSetCheck;
   IBOutlet NSPanel* summaryPanel;
   IBOutlet NSTextView* summaryText;
+
+  // Progress of a background export, built in code and polled by the timer
+  NSPanel* progressPanel;
+  NSProgressIndicator* progressBar;
+  NSTextField* progressText;
+  NSTimer* progressTimer;
   
   // Delegates most everything to our shared c++ plugin class.
   CXmlExporterPluginMac* plugin_;
@@ -39,4 +45,11 @@ class CXmlExporterPluginMac;
 // Used to properly close a model dialog
 - (IBAction)closePanel:(id)sender;
 
+// Shows the progress of a background export until it finishes, then the
+// summary
+- (void)startProgress;
+
+// Cancels the background export
+- (IBAction)cancelExport:(id)sender;
+
 @end
@@ -3,11 +3,19 @@
 #import "SkpToXMLPlugin.h"
 #import "../plugin/xmlplugin.h"
 
+// Rate at which the progress of a background export is shown, in seconds
+static const NSTimeInterval kProgressInterval = 0.1;
+
 // Our shared base class has just everything we need except the UI.  This
 // connector lets us delegate the UI back to our obj-c plugin.
 class CXmlExporterPluginMac : public CXmlExporterPlugin {
 public:
   CXmlExporterPluginMac(SkpToXMLPlugin*& p) : plugin_(p) {
+    // The exporter reads its own copy of the file through the C API, which
+    // SketchUp does not use for the open model, and a second export is
+    // refused while the job runs. So the worker is the only thread in the
+    // C API, and the host stays responsive.
+    SetExportInBackground(true);
   }
   void ShowOptionsDialog(bool model_has_selection) {
     [plugin_ showOptionsDialog:model_has_selection];
@@ -15,6 +23,12 @@ public:
   void ShowSummaryDialog(const std::string& summary) {
     [plugin_ showSummaryDialog:summary];
   }
+  bool SupportsBackgroundExport() const {
+    return true;
+  }
+  void OnBackgroundExportStarted() {
+    [plugin_ startProgress];
+  }
   SkpToXMLPlugin* plugin_;
 };
 
@@ -51,6 +65,9 @@ public:
   if (summaryPanel) {
     [summaryPanel release];
   }
+  if (progressPanel) {
+    [progressPanel release];
+  }
 
   [super dealloc];
 }
@@ -146,4 +163,81 @@ public:
   [summaryPanel orderOut:self];
 }
 
+- (void)loadProgressPanel {
+  if (progressPanel) return;
+
+  progressPanel = [[NSPanel alloc]
+      initWithContentRect:NSMakeRect(0, 0, 360, 100)
+                styleMask:NSTitledWindowMask
+                  backing:NSBackingStoreBuffered
+                    defer:YES];
+  [progressPanel setTitle:@"XML Export"];
+  [progressPanel setHidesOnDeactivate:NO];
+  [progressPanel setReleasedWhenClosed:NO];
+  NSView* content = [progressPanel contentView];
+
+  progressText = [[[NSTextField alloc]
+      initWithFrame:NSMakeRect(20, 64, 320, 17)] autorelease];
+  [progressText setEditable:NO];
+  [progressText setBordered:NO];
+  [progressText setDrawsBackground:NO];
+  [content addSubview:progressText];
+
+  progressBar = [[[NSProgressIndicator alloc]
+      initWithFrame:NSMakeRect(20, 44, 320, 20)] autorelease];
+  [progressBar setIndeterminate:NO];
+  [progressBar setMinValue:0.0];
+  [progressBar setMaxValue:100.0];
+  [content addSubview:progressBar];
+
+  NSButton* cancelButton = [[[NSButton alloc]
+      initWithFrame:NSMakeRect(250, 8, 96, 32)] autorelease];
+  [cancelButton setTitle:@"Cancel"];
+  [cancelButton setBezelStyle:NSRoundedBezelStyle];
+  [cancelButton setTarget:self];
+  [cancelButton setAction:@selector(cancelExport:)];
+  [content addSubview:cancelButton];
+}
+
+- (void)startProgress {
+  [self loadProgressPanel];
+  [progressText setStringValue:@""];
+  [progressBar setDoubleValue:0.0];
+  [progressPanel center];
+  [progressPanel orderFront:self];
+
+  // The export runs on its own thread, the timer only samples its state so
+  // the UI is updated at a fixed rate however often it reports. Common
+  // modes keep it firing while menus track or dialogs are modal.
+  progressTimer = [NSTimer timerWithTimeInterval:kProgressInterval
+                                          target:self
+                                        selector:@selector(updateProgress:)
+                                        userInfo:nil
+                                         repeats:YES];
+  [[NSRunLoop currentRunLoop] addTimer:progressTimer
+                               forMode:NSRunLoopCommonModes];
+}
+
+- (void)updateProgress:(NSTimer*)timer {
+  double percent = 0.0;
+  std::string message;
+  if (plugin_->PollBackgroundExport(percent, message)) {
+    [progressBar setDoubleValue:percent];
+    [progressText setStringValue:
+        [NSString stringWithUTF8String:message.c_str()]];
+    return;
+  }
+
+  // Finished, show how it went
+  [progressTimer invalidate];
+  progressTimer = nil;
+  [progressPanel orderOut:self];
+  plugin_->ShowSummaryDialog();
+}
+
+- (IBAction)cancelExport:(id)sender {
+  plugin_->CancelBackgroundExport();
+  [progressText setStringValue:@"Cancelling..."];
+}
+
 @end
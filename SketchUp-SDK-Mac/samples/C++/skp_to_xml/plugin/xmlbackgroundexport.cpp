@@ -0,0 +1,158 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include "./xmlbackgroundexport.h"
+#include "../common/xmlexporter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+
+namespace {
+
+// SketchUp hands the exporter a file that is only guaranteed to exist until
+// ConvertFromSkp returns, the worker converts a copy. It is created in the
+// temporary directory, so that a copy left behind by a host that quit does
+// not end up in the user's output folder.
+bool CreateInputCopyPath(std::string& path) {
+  const char* directory = getenv("TMPDIR");
+  path = (directory != NULL && directory[0] != '\0') ? directory : "/tmp";
+  if (path[path.size() - 1] != '/')
+    path.append("/");
+  path.append("skptoxml.XXXXXX.skp");
+  int fd = mkstemps(&path[0], 4);
+  if (fd < 0)
+    return false;
+  close(fd);
+  return true;
+}
+
+bool CopyFile(const std::string& from, const std::string& to) {
+  std::ifstream in(from.c_str(), std::ios::binary);
+  if (!in)
+    return false;
+  std::ofstream out(to.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+  out << in.rdbuf();
+  out.close();
+  return !out.fail();
+}
+
+} // end anonymous namespace
+
+CXmlBackgroundExport::CXmlBackgroundExport()
+  : exporter_(NULL),
+    converted_(false),
+    busy_(false),
+    done_(0),
+    cancelled_(0),
+    percent_(0.0),
+    step_size_(0.0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+CXmlBackgroundExport::~CXmlBackgroundExport() {
+  if (busy_) {
+    Cancel();
+    Finish();
+  }
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool CXmlBackgroundExport::Start(CXmlExporter& exporter,
+                                 const std::string& input_skp,
+                                 const std::string& output_xml) {
+  if (busy_)
+    return false;
+
+  std::string input_copy;
+  if (!CreateInputCopyPath(input_copy))
+    return false;
+  if (!CopyFile(input_skp, input_copy)) {
+    remove(input_copy.c_str());
+    return false;
+  }
+
+  exporter_ = &exporter;
+  input_skp_ = input_copy;
+  output_xml_ = output_xml;
+  converted_ = false;
+  done_ = 0;
+  cancelled_ = 0;
+  percent_ = 0.0;
+  step_size_ = 0.0;
+  message_.clear();
+  if (pthread_create(&thread_, NULL, WorkerMain, this) != 0) {
+    remove(input_copy.c_str());
+    return false;
+  }
+  busy_ = true;
+  return true;
+}
+
+bool CXmlBackgroundExport::IsDone() const {
+  return __sync_fetch_and_add(const_cast<volatile int*>(&done_), 0) != 0;
+}
+
+void CXmlBackgroundExport::GetProgress(double& percent,
+                                       std::string& message) const {
+  pthread_mutex_lock(&mutex_);
+  percent = percent_;
+  message = message_;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlBackgroundExport::Cancel() {
+  __sync_fetch_and_or(&cancelled_, 1);
+}
+
+bool CXmlBackgroundExport::Finish() {
+  if (!busy_)
+    return false;
+  pthread_join(thread_, NULL);
+  busy_ = false;
+  exporter_ = NULL;
+  return converted_;
+}
+
+bool CXmlBackgroundExport::HasBeenCancelled() {
+  return __sync_fetch_and_add(&cancelled_, 0) != 0;
+}
+
+void CXmlBackgroundExport::SetPercentDone(double percent) {
+  pthread_mutex_lock(&mutex_);
+  percent_ = percent;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlBackgroundExport::SetStepSize(double percent) {
+  pthread_mutex_lock(&mutex_);
+  step_size_ = percent;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlBackgroundExport::Step() {
+  pthread_mutex_lock(&mutex_);
+  percent_ += step_size_;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlBackgroundExport::SetProgressMessage(const std::string& message) {
+  pthread_mutex_lock(&mutex_);
+  message_ = message;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void* CXmlBackgroundExport::WorkerMain(void* param) {
+  CXmlBackgroundExport* job = static_cast<CXmlBackgroundExport*>(param);
+  try {
+    job->converted_ = job->exporter_->Convert(job->input_skp_,
+                                              job->output_xml_, job);
+  } catch (...) {
+    job->converted_ = false;
+  }
+  remove(job->input_skp_.c_str());
+  __sync_fetch_and_or(&job->done_, 1);
+  return NULL;
+}
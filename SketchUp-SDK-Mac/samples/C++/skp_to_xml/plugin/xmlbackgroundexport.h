@@ -0,0 +1,76 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_PLUGIN_XMLBACKGROUNDEXPORT_H
+#define SKPTOXML_PLUGIN_XMLBACKGROUNDEXPORT_H
+
+#include <pthread.h>
+#include <string>
+
+#include <slapi/import_export/pluginprogresscallback.h>
+
+class CXmlExporter;
+
+// Runs one export on a worker thread so that SketchUp stays responsive. The
+// worker reports to this object through the progress callback interface and
+// the UI thread samples the latest state whenever its timer fires, so the
+// worker never waits for the UI. Cancelling sets a flag the exporter reads
+// while it walks the model. The worker is the only thread using the SketchUp
+// API while the job runs, on a model it loads from a copy of the input.
+class CXmlBackgroundExport : public SketchUpPluginProgressCallback {
+ public:
+  CXmlBackgroundExport();
+  // Cancels a running job and waits for it
+  ~CXmlBackgroundExport();
+
+  // Copies input_skp and starts converting the copy to output_xml with
+  // exporter, which must not be used elsewhere until Finish() returned.
+  // Returns false if a job is already running or could not be started.
+  bool Start(CXmlExporter& exporter, const std::string& input_skp,
+             const std::string& output_xml);
+
+  // Whether a job was started and not finished yet
+  bool IsBusy() const { return busy_; }
+  // Whether the worker is done and Finish() will not block
+  bool IsDone() const;
+
+  // Latest progress reported by the worker
+  void GetProgress(double& percent, std::string& message) const;
+
+  // Asks the worker to stop. Safe from any thread.
+  void Cancel();
+
+  // Waits for the worker. Returns whether the export succeeded.
+  bool Finish();
+
+  // Whether the finished job was cancelled
+  bool was_cancelled() const { return cancelled_ != 0; }
+
+  // SketchUpPluginProgressCallback, called by the worker
+  bool HasBeenCancelled();
+  void SetPercentDone(double percent);
+  void SetStepSize(double percent);
+  void Step();
+  void SetProgressMessage(const std::string& message);
+
+ private:
+  static void* WorkerMain(void* param);
+
+  CXmlExporter* exporter_;
+  std::string input_skp_;
+  std::string output_xml_;
+  bool converted_;
+
+  pthread_t thread_;
+  bool busy_;
+  // Written with atomic builtins, read without taking the mutex
+  volatile int done_;
+  volatile int cancelled_;
+
+  // Guards the progress below
+  mutable pthread_mutex_t mutex_;
+  double percent_;
+  double step_size_;
+  std::string message_;
+};
+
+#endif // SKPTOXML_PLUGIN_XMLBACKGROUNDEXPORT_H
@@ -16,6 +16,29 @@ CXmlExporterPlugin::CXmlExporterPlugin() {
   m_bExportLayers = false;
   m_bExportOptions = true;
   m_bExportSelectionSet = false;
+  m_bExportCameras = false;
+  m_bExportVisibleLines = true;
+  m_bDedupOutlines = false;
+  m_bExportSceneLayers = false;
+  m_bExportSections = false;
+  m_bExportVisibilityCells = false;
+  m_bExportGlb = false;
+  m_bExportObj = false;
+  m_bExportPly = false;
+  m_bExportUnityLines = false;
+  m_bExportProgressive = false;
+  m_bExportMeshlets = false;
+  m_bExportSilhouetteEdges = false;
+  m_bExportComponentDefinitions = false;
+  m_bOptimizeVertexCache = true;
+  m_bExportInBackground = false;
+  m_nMaxDetail = -1;
+  m_nMaxSortBytes = 0;
+  // The exporter lives as long as SketchUp, keep little of its XML memory
+  m_nRetainedPoolBytes = 4 * 1024 * 1024;
+  m_nShards = 1;
+  m_nShardFirstItem = 0;
+  m_nShardItems = 0;
 }
 
 std::string CXmlExporterPlugin::GetDescription(int index) const {
@@ -30,34 +53,56 @@ static void GetNumberString(size_t number, char* numberString, int length) {
 #endif
 }
 
-bool CXmlExporterPlugin::ConvertFromSkp(const std::string& input_skp,
-    const std::string& output_xml,
-    SketchUpPluginProgressCallback* callback,
-    void* reserved) {
-  bool converted = false;
-  m_summary.clear();
-  CXmlExporter exporter;
-  try {
-    // Set the user preferences on the exporter
-    CXmlOptions options;
-    options.set_export_materials(m_bExportMaterials);
-    options.set_export_faces(m_bExportFaces);
-    options.set_export_edges(m_bExportEdges);
-    options.set_export_materials_by_layer(m_bExportMaterialsByLayer);
-    options.set_export_layers(m_bExportLayers);
-    options.set_export_options(m_bExportOptions);
-    exporter.SetOptions(options);
+// Cache misses per triangle before and after reordering
+static void GetAcmrString(const CXmlExportStats& stats, char* acmrString,
+                          int length) {
+  double triangles = static_cast<double>(stats.vertex_cache_triangles());
+  double before = stats.vertex_cache_misses_before() / triangles;
+  double after = stats.vertex_cache_misses_after() / triangles;
+#ifdef _WINDOWS
+  _snprintf_s(acmrString, length, _TRUNCATE, "%.2f -> %.2f\n", before,
+              after);
+#else
+  snprintf(acmrString, length, "%.2f -> %.2f\n", before, after);
+#endif
+}
 
-    // Convert
-    converted = exporter.Convert(input_skp, output_xml, callback);
-  } catch (...) {
-    converted = false;
-  }
+CXmlOptions CXmlExporterPlugin::GetOptions() const {
+  CXmlOptions options;
+  options.set_export_materials(m_bExportMaterials);
+  options.set_export_faces(m_bExportFaces);
+  options.set_export_edges(m_bExportEdges);
+  options.set_export_materials_by_layer(m_bExportMaterialsByLayer);
+  options.set_export_layers(m_bExportLayers);
+  options.set_export_options(m_bExportOptions);
+  options.set_export_cameras(m_bExportCameras);
+  options.set_export_visible_lines(m_bExportVisibleLines);
+  options.set_dedup_outlines(m_bDedupOutlines);
+  options.set_export_scene_layers(m_bExportSceneLayers);
+  options.set_export_sections(m_bExportSections);
+  options.set_export_visibility_cells(m_bExportVisibilityCells);
+  options.set_export_glb(m_bExportGlb);
+  options.set_export_obj(m_bExportObj);
+  options.set_export_ply(m_bExportPly);
+  options.set_export_unity_lines(m_bExportUnityLines);
+  options.set_export_progressive(m_bExportProgressive);
+  options.set_export_meshlets(m_bExportMeshlets);
+  options.set_export_silhouette_edges(m_bExportSilhouetteEdges);
+  options.set_export_component_definitions(m_bExportComponentDefinitions);
+  options.set_optimize_vertex_cache(m_bOptimizeVertexCache);
+  options.set_num_shards(m_nShards);
+  options.set_shard_worker(m_shardWorker);
+  options.set_shard(m_nShardFirstItem, m_nShardItems);
+  options.set_max_detail(m_nMaxDetail);
+  options.set_max_sort_bytes(m_nMaxSortBytes);
+  options.set_retained_pool_bytes(m_nRetainedPoolBytes);
+  return options;
+}
 
+std::string CXmlExporterPlugin::GetSummary(const CXmlExportStats& stats) {
   std::string summary;
   int length = 32;
   char numberString[32];
-  const CXmlExportStats& stats = exporter.stats();
   summary.append("XML Entities Exported:\n\n");
   std::string countString;
   if (stats.faces() > 0) {
@@ -80,11 +125,136 @@ bool CXmlExporterPlugin::ConvertFromSkp(const std::string& input_skp,
     summary.append("\tLayers:\t\t");
     summary.append(numberString);
   }
-  m_summary = summary;
+  if (stats.duplicate_outlines() > 0) {
+    GetNumberString(stats.duplicate_outlines(), &numberString[0], length);
+    summary.append("\tDuplicate Lines Removed:\t");
+    summary.append(numberString);
+  }
+  if (stats.scenes() > 0) {
+    GetNumberString(stats.scenes(), &numberString[0], length);
+    summary.append("\tScenes:\t\t");
+    summary.append(numberString);
+  }
+  if (stats.visible_lines() > 0) {
+    GetNumberString(stats.visible_lines(), &numberString[0], length);
+    summary.append("\tVisible Lines:\t");
+    summary.append(numberString);
+  }
+  if (stats.sections() > 0) {
+    GetNumberString(stats.sections(), &numberString[0], length);
+    summary.append("\tSections:\t\t");
+    summary.append(numberString);
+  }
+  if (stats.visibility_cells() > 0) {
+    GetNumberString(stats.visibility_cells(), &numberString[0], length);
+    summary.append("\tVisibility Cells:\t");
+    summary.append(numberString);
+  }
+  if (stats.glb_meshes() > 0) {
+    GetNumberString(stats.glb_meshes(), &numberString[0], length);
+    summary.append("\tglTF Meshes:\t");
+    summary.append(numberString);
+  }
+  if (stats.unity_line_quads() > 0) {
+    GetNumberString(stats.unity_line_quads(), &numberString[0], length);
+    summary.append("\tUnity Line Quads:\t");
+    summary.append(numberString);
+  }
+  if (stats.progressive_chunks() > 0) {
+    GetNumberString(stats.progressive_chunks(), &numberString[0], length);
+    summary.append("\tProgressive Chunks:\t");
+    summary.append(numberString);
+  }
+  if (stats.meshlets() > 0) {
+    GetNumberString(stats.meshlets(), &numberString[0], length);
+    summary.append("\tMeshlets:\t");
+    summary.append(numberString);
+  }
+  if (stats.silhouette_edges() > 0) {
+    GetNumberString(stats.silhouette_edges(), &numberString[0], length);
+    summary.append("\tSilhouette Edges:\t");
+    summary.append(numberString);
+  }
+  if (stats.spilled_sort_runs() > 0) {
+    GetNumberString(stats.spilled_sort_runs(), &numberString[0], length);
+    summary.append("\tSpilled Sort Runs:\t");
+    summary.append(numberString);
+  }
+  if (stats.vertex_cache_triangles() > 0) {
+    GetAcmrString(stats, &numberString[0], length);
+    summary.append("\tVertex Cache ACMR:\t");
+    summary.append(numberString);
+  }
+  if (stats.pruned_entities() > 0) {
+    GetNumberString(stats.pruned_entities(), &numberString[0], length);
+    summary.append("\tLeft Out by Hints:\t");
+    summary.append(numberString);
+  }
+  return summary;
+}
+
+bool CXmlExporterPlugin::ConvertFromSkp(const std::string& input_skp,
+    const std::string& output_xml,
+    SketchUpPluginProgressCallback* callback,
+    void* reserved) {
+  bool converted = false;
+  m_summary.clear();
+  // Where the platform can poll it the export runs in the background and
+  // the summary waits for PollBackgroundExport to see it finish. Exports in
+  // place if the job cannot be started.
+  if (m_bExportInBackground && SupportsBackgroundExport()) {
+    if (m_job.IsBusy()) {
+      m_summary = "The previous export is still running.\n";
+      return false;
+    }
+    m_exporter.SetOptions(GetOptions());
+    if (m_job.Start(m_exporter, input_skp, output_xml)) {
+      OnBackgroundExportStarted();
+      return true;
+    }
+  }
+
+  // The exporter lives as long as the plugin so that batch exports reuse
+  // its XML document memory.
+  CXmlExporter& exporter = m_exporter;
+  try {
+    // Set the user preferences on the exporter
+    exporter.SetOptions(GetOptions());
+
+    // Convert
+    converted = exporter.Convert(input_skp, output_xml, callback);
+  } catch (...) {
+    converted = false;
+  }
+
+  m_summary = GetSummary(exporter.stats());
 
   return converted; 
 }
 
+bool CXmlExporterPlugin::PollBackgroundExport(double& percent,
+                                              std::string& message) {
+  if (!m_job.IsBusy())
+    return false;
+  if (!m_job.IsDone()) {
+    m_job.GetProgress(percent, message);
+    return true;
+  }
+
+  bool converted = m_job.Finish();
+  m_summary.clear();
+  if (!converted) {
+    m_summary = m_job.was_cancelled() ? "Export cancelled.\n\n"
+                                      : "Export failed.\n\n";
+  }
+  m_summary.append(GetSummary(m_exporter.stats()));
+  return false;
+}
+
+void CXmlExporterPlugin::CancelBackgroundExport() {
+  m_job.Cancel();
+}
+
 void CXmlExporterPlugin::ShowSummaryDialog() {
   if (!m_summary.empty()) {
     ShowSummaryDialog(m_summary);
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <slapi/import_export/modelexporterplugin.h>
+#include "./xmlbackgroundexport.h"
 #include "../common/xmlexporter.h"
 
 // This is the shared portion of the xml exporter plugin interface.
@@ -43,6 +44,13 @@ class CXmlExporterPlugin : public SketchUpModelExporterInterface {
                       void* reserved);
   virtual void ShowSummaryDialog();
 
+  // Background export. While a job started by ConvertFromSkp runs, the
+  // platform polls it from a UI timer. Returns true with the latest progress
+  // while it runs; once it finished, stores the summary for
+  // ShowSummaryDialog() and returns false.
+  bool PollBackgroundExport(double& percent, std::string& message);
+  void CancelBackgroundExport();
+
   // User Preference accessors
   bool ExportMaterials() { return m_bExportMaterials; }
   void SetExportMaterials(bool bSet) { m_bExportMaterials = bSet; }
@@ -52,6 +60,48 @@ class CXmlExporterPlugin : public SketchUpModelExporterInterface {
   void SetExportEdges(bool bSet) { m_bExportEdges = bSet; }
   bool ExportCameras() { return m_bExportCameras; }
   void SetExportCameras(bool bSet) { m_bExportCameras = bSet; }
+  bool ExportVisibleLines() { return m_bExportVisibleLines; }
+  void SetExportVisibleLines(bool bSet) { m_bExportVisibleLines = bSet; }
+  bool DedupOutlines() { return m_bDedupOutlines; }
+  void SetDedupOutlines(bool bSet) { m_bDedupOutlines = bSet; }
+  bool ExportSceneLayers() { return m_bExportSceneLayers; }
+  void SetExportSceneLayers(bool bSet) { m_bExportSceneLayers = bSet; }
+  bool ExportSections() { return m_bExportSections; }
+  void SetExportSections(bool bSet) { m_bExportSections = bSet; }
+  bool ExportVisibilityCells() { return m_bExportVisibilityCells; }
+  void SetExportVisibilityCells(bool bSet) {
+    m_bExportVisibilityCells = bSet;
+  }
+  bool ExportGlb() { return m_bExportGlb; }
+  void SetExportGlb(bool bSet) { m_bExportGlb = bSet; }
+  bool ExportObj() { return m_bExportObj; }
+  void SetExportObj(bool bSet) { m_bExportObj = bSet; }
+  bool ExportPly() { return m_bExportPly; }
+  void SetExportPly(bool bSet) { m_bExportPly = bSet; }
+  bool ExportUnityLines() { return m_bExportUnityLines; }
+  void SetExportUnityLines(bool bSet) { m_bExportUnityLines = bSet; }
+  bool ExportProgressive() { return m_bExportProgressive; }
+  void SetExportProgressive(bool bSet) { m_bExportProgressive = bSet; }
+  bool ExportMeshlets() { return m_bExportMeshlets; }
+  void SetExportMeshlets(bool bSet) { m_bExportMeshlets = bSet; }
+  bool ExportSilhouetteEdges() { return m_bExportSilhouetteEdges; }
+  void SetExportSilhouetteEdges(bool bSet) {
+    m_bExportSilhouetteEdges = bSet;
+  }
+  bool ExportComponentDefinitions() { return m_bExportComponentDefinitions; }
+  void SetExportComponentDefinitions(bool bSet) {
+    m_bExportComponentDefinitions = bSet;
+  }
+  bool OptimizeVertexCache() { return m_bOptimizeVertexCache; }
+  void SetOptimizeVertexCache(bool bSet) { m_bOptimizeVertexCache = bSet; }
+  int MaxDetail() { return m_nMaxDetail; }
+  void SetMaxDetail(int nDetail) { m_nMaxDetail = nDetail; }
+  size_t MaxSortBytes() { return m_nMaxSortBytes; }
+  void SetMaxSortBytes(size_t nBytes) { m_nMaxSortBytes = nBytes; }
+  size_t RetainedPoolBytes() { return m_nRetainedPoolBytes; }
+  void SetRetainedPoolBytes(size_t nBytes) { m_nRetainedPoolBytes = nBytes; }
+  bool ExportInBackground() { return m_bExportInBackground; }
+  void SetExportInBackground(bool bSet) { m_bExportInBackground = bSet; }
   bool ExportMaterialsByLayer() { return m_bExportMaterialsByLayer; }
   void SetExportMaterialsByLayer(bool bSet) {
     m_bExportMaterialsByLayer = bSet;
@@ -63,24 +113,66 @@ class CXmlExporterPlugin : public SketchUpModelExporterInterface {
   bool ExportSelectionSet() { return m_bExportSelectionSet; }
   void SetExportSelectionSet(bool bSet) { m_bExportSelectionSet = bSet; }
 
+  // Sharded export, see CXmlOptions
+  void SetShards(size_t nShards, const std::string& worker) {
+    m_nShards = nShards;
+    m_shardWorker = worker;
+  }
+  void SetShard(size_t nFirstItem, size_t nItems) {
+    m_nShardFirstItem = nFirstItem;
+    m_nShardItems = nItems;
+  }
+
  protected:
   virtual void ShowSummaryDialog(const std::string& summary) = 0;
 
+  // Platforms that poll background exports override these. The second is
+  // called on the UI thread right after a job started.
+  virtual bool SupportsBackgroundExport() const { return false; }
+  virtual void OnBackgroundExportStarted() {}
+
   // User preference values
   bool m_bExportMaterials;
   bool m_bExportFaces;
   bool m_bExportEdges;
   bool m_bExportCameras;
+  bool m_bExportVisibleLines;
+  bool m_bDedupOutlines;
+  bool m_bExportSceneLayers;
+  bool m_bExportSections;
+  bool m_bExportVisibilityCells;
+  bool m_bExportGlb;
+  bool m_bExportObj;
+  bool m_bExportPly;
+  bool m_bExportUnityLines;
+  bool m_bExportProgressive;
+  bool m_bExportMeshlets;
+  bool m_bExportSilhouetteEdges;
+  bool m_bExportComponentDefinitions;
+  bool m_bOptimizeVertexCache;
+  bool m_bExportInBackground;
+  int m_nMaxDetail;
+  size_t m_nMaxSortBytes;
+  size_t m_nRetainedPoolBytes;
   bool m_bExportMaterialsByLayer;
   bool m_bExportLayers;
   bool m_bExportOptions;
   bool m_bExportSelectionSet;
+  size_t m_nShards;
+  std::string m_shardWorker;
+  size_t m_nShardFirstItem;
+  size_t m_nShardItems;
   // Summary information saved by the ConvertFromSkp method and used by the
   // ShowSummaryDialog method.
   std::string m_summary;
 
  private:
+  CXmlOptions GetOptions() const;
+  static std::string GetSummary(const CXmlExportStats& stats);
+
   CXmlExporter m_exporter;
+  // Declared after the exporter so that a running job is stopped first
+  CXmlBackgroundExport m_job;
 };
 
 #endif  // SKPTOXML_PLUGIN_XMLPLUGIN_H_
@@ -0,0 +1,121 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "./xmltest.h"
+#include "../common/xmlexternalsort.h"
+
+namespace {
+
+// A record with a key to sort by and the order it was added in
+struct Record {
+  unsigned int key;
+  unsigned int order;
+};
+
+struct RecordLess {
+  bool operator()(const Record& a, const Record& b) const {
+    return a.key < b.key;
+  }
+};
+
+// Fixed pseudo random keys, many of them equal
+std::vector<int> MakeKeys(size_t count, unsigned int range) {
+  std::vector<int> keys;
+  unsigned int state = 2013;
+  for (size_t i = 0; i < count; ++i) {
+    state = state * 1103515245 + 12345;
+    keys.push_back(static_cast<int>((state >> 8) % range));
+  }
+  return keys;
+}
+
+template <typename Less>
+std::vector<int> Sort(const std::vector<int>& keys, size_t max_bytes,
+                      size_t& num_spilled_runs) {
+  CXmlExternalSorter<int, Less> sorter(max_bytes);
+  for (size_t i = 0; i < keys.size(); ++i)
+    sorter.Add(keys[i]);
+  sorter.Finish();
+  std::vector<int> sorted;
+  int key = 0;
+  while (sorter.Next(key))
+    sorted.push_back(key);
+  num_spilled_runs = sorter.num_spilled_runs();
+  return sorted;
+}
+
+void TestInMemory() {
+  std::vector<int> keys = MakeKeys(10000, 1000);
+  std::vector<int> expected = keys;
+  std::sort(expected.begin(), expected.end());
+  size_t num_spilled_runs = 1;
+  CHECK(Sort<std::less<int> >(keys, 0, num_spilled_runs) == expected);
+  CHECK(num_spilled_runs == 0);
+
+  // Fits under the cap
+  CHECK(Sort<std::less<int> >(keys, sizeof(int) * keys.size() * 2,
+                              num_spilled_runs) == expected);
+  CHECK(num_spilled_runs == 0);
+
+  // Nothing added
+  CHECK(Sort<std::less<int> >(std::vector<int>(), 1,
+                              num_spilled_runs).empty());
+}
+
+void TestSpilled() {
+  // Runs are at least 1024 records, this spills 9 of them
+  std::vector<int> keys = MakeKeys(10000, 1000);
+  std::vector<int> expected = keys;
+  std::sort(expected.begin(), expected.end(), std::greater<int>());
+  size_t num_spilled_runs = 0;
+  CHECK(Sort<std::greater<int> >(keys, 1, num_spilled_runs) == expected);
+  CHECK(num_spilled_runs == 9);
+}
+
+void TestMergedRuns() {
+  // More than 64 runs, which are merged into one on the way
+  std::vector<int> keys = MakeKeys(100 * 1024 + 17, 50000);
+  std::vector<int> expected = keys;
+  std::sort(expected.begin(), expected.end());
+  size_t num_spilled_runs = 0;
+  CHECK(Sort<std::less<int> >(keys, 1, num_spilled_runs) == expected);
+  CHECK(num_spilled_runs > 100);
+}
+
+void TestEqualRecords() {
+  // Equal keys come out in the order of the runs they were spilled in
+  std::vector<int> keys = MakeKeys(80 * 1024, 16);
+  CXmlExternalSorter<Record, RecordLess> sorter(1);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    Record record = { static_cast<unsigned int>(keys[i]),
+                      static_cast<unsigned int>(i) };
+    sorter.Add(record);
+  }
+  sorter.Finish();
+  Record record = { 0, 0 };
+  Record last = { 0, 0 };
+  size_t count = 0;
+  while (sorter.Next(record)) {
+    if (count > 0) {
+      CHECK(last.key <= record.key);
+      if (last.key == record.key)
+        CHECK(last.order / 1024 <= record.order / 1024);
+    }
+    last = record;
+    ++count;
+  }
+  CHECK(count == keys.size());
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestInMemory();
+  TestSpilled();
+  TestMergedRuns();
+  TestEqualRecords();
+  return XML_TEST_RESULT();
+}
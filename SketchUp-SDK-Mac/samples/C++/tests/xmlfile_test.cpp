@@ -0,0 +1,297 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "./xmltest.h"
+#include "../common/xmlfile.h"
+
+namespace {
+
+// Writes the faces, edges and curves of a list of entities. Each face is
+// a square, the first corner of the k-th one written at (k, 0).
+class CEntityWriter {
+ public:
+  explicit CEntityWriter(CXmlFile& file) : file_(file), num_faces_(0) {}
+
+  void WriteFace(bool inner_loop) {
+    XmlModelInfo square;
+    XmlTest::AddSquare(square, static_cast<double>(num_faces_), 0, 0, 1);
+    XmlFaceInfo face = square.faces_[0];
+    face.is_inner_loop_ = inner_loop;
+    file_.WriteFaceInfo(face, square.vertices_);
+    ++num_faces_;
+  }
+
+  void WriteEdge(const char* layer, int layer_index) {
+    file_.WriteEdgeInfo(MakeEdge(layer, layer_index));
+  }
+
+  void WriteCurve(size_t num_edges) {
+    XmlCurveInfo curve;
+    for (size_t i = 0; i < num_edges; ++i)
+      curve.edges_.push_back(MakeEdge(NULL, -1));
+    file_.WriteCurveInfo(curve);
+  }
+
+  void WriteInstance(const char* definition, const char* layer,
+                     int layer_index) {
+    XmlComponentInstanceInfo instance;
+    instance.definition_name_id_ = file_.names().Intern(definition);
+    instance.layer_name_id_ = file_.names().Intern(layer);
+    instance.layer_index_ = layer_index;
+    instance.transform_ = XmlTest::Translation(0, 0, 1);
+    file_.WriteComponentInstanceInfo(instance);
+  }
+
+  // Ends a group started with StartGroup, moved by (x, 0, 0)
+  void EndGroup(double x) {
+    file_.WriteTransformation(XmlTest::Translation(x, 0, 0));
+    file_.PopParentNode();
+  }
+
+ private:
+  XmlEdgeInfo MakeEdge(const char* layer, int layer_index) {
+    XmlEdgeInfo edge;
+    if (layer != NULL) {
+      edge.has_layer_ = true;
+      edge.layer_name_id_ = file_.names().Intern(layer);
+      edge.layer_index_ = layer_index;
+    }
+    edge.start_ = XmlGeomUtils::CPoint3d(0, 0, 0);
+    edge.end_ = XmlGeomUtils::CPoint3d(0, 0, 1);
+    return edge;
+  }
+
+  CXmlFile& file_;
+  size_t num_faces_;
+};
+
+std::vector<bool> MakeFlags(size_t count, size_t every) {
+  std::vector<bool> flags(count, false);
+  for (size_t i = 0; i < count; i += every)
+    flags[i] = true;
+  return flags;
+}
+
+// Writes a definition holding a group, and a model whose groups nest two
+// levels deep:
+//
+//   Window: face, edge, group (face)
+//   Geometry: instance of Window, face, edge, curve of 2 edges,
+//     group A (face, inner loop, group A1 (edge, curve), group A2
+//       (instance)),
+//     group B (face)
+bool WriteModel(const std::string& path) {
+  CXmlFile file;
+  if (!file.Open(path, true))
+    return false;
+  CEntityWriter writer(file);
+  file.WriteHeader(8, 0, 0);
+
+  file.StartLayers();
+  const char* const layers[2] = { "Layer0", "Wall" };
+  for (int i = 0; i < 2; ++i) {
+    XmlLayerInfo layer;
+    layer.name_ = layers[i];
+    file.WriteLayerInfo(layer);
+  }
+  file.PopParentNode();
+
+  file.StartComponentDefinitions();
+  file.StartComponentDefinition("Window");
+  writer.WriteFace(false);
+  writer.WriteEdge(NULL, -1);
+  file.StartGroup();
+  writer.WriteFace(false);
+  writer.EndGroup(1);
+  file.PopParentNode();
+  file.PopParentNode();
+
+  file.StartGeometry();
+  writer.WriteInstance("Window", "Wall", 1);
+  file.StartGroup("Wall", 1, false, false);
+  writer.WriteFace(false);
+  writer.WriteFace(true);
+  file.StartGroup();
+  writer.WriteEdge("Wall", 1);
+  writer.WriteCurve(3);
+  writer.EndGroup(2);
+  file.StartGroup("Layer0", 0, true, true);
+  writer.WriteInstance("Window", "Layer0", 0);
+  writer.EndGroup(3);
+  writer.EndGroup(4);
+  file.StartGroup();
+  writer.WriteFace(false);
+  writer.EndGroup(5);
+  writer.WriteFace(false);
+  writer.WriteEdge(NULL, -1);
+  writer.WriteCurve(2);
+  file.PopParentNode();
+
+  file.WriteDuplicateOutlines(MakeFlags(21, 4));
+  file.WriteHiddenOutlines(MakeFlags(21, 3));
+  file.Close(false);
+  return true;
+}
+
+bool SameRange(size_t first, size_t num, size_t expected_first,
+               size_t expected_num) {
+  return first == expected_first && num == expected_num;
+}
+
+// Checks every range of entities against its expected
+// { instances, groups, faces, edges, curves } as first, num pairs
+bool SameEntities(const XmlEntitiesInfo& entities, const size_t ranges[10]) {
+  return SameRange(entities.first_instance_, entities.num_instances_,
+                   ranges[0], ranges[1]) &&
+         SameRange(entities.first_group_, entities.num_groups_,
+                   ranges[2], ranges[3]) &&
+         SameRange(entities.first_face_, entities.num_faces_,
+                   ranges[4], ranges[5]) &&
+         SameRange(entities.first_edge_, entities.num_edges_,
+                   ranges[6], ranges[7]) &&
+         SameRange(entities.first_curve_, entities.num_curves_,
+                   ranges[8], ranges[9]);
+}
+
+void TestRoundTrip() {
+  std::string directory = XmlTest::MakeTempDirectory();
+  CHECK(!directory.empty());
+  std::string path = directory + "/model.xml";
+  CHECK(WriteModel(path));
+
+  XmlModelInfo model;
+  CXmlFile file;
+  CHECK(file.Open(path, false));
+  CHECK(file.GetModelInfo(model));
+  file.Close(true);
+
+  // The pools were sized once, before reading
+  CHECK(model.component_instances_.size() == 2);
+  CHECK(model.groups_.size() == 5);
+  CHECK(model.faces_.size() == 6);
+  CHECK(model.vertices_.size() == 24);
+  CHECK(model.edges_.size() == 3);
+  CHECK(model.curves_.size() == 2);
+  CHECK(model.component_instances_.capacity() == 2);
+  CHECK(model.groups_.capacity() == 5);
+  CHECK(model.faces_.capacity() == 6);
+  CHECK(model.vertices_.capacity() == 24);
+  CHECK(model.edges_.capacity() == 3);
+  CHECK(model.curves_.capacity() == 2);
+
+  // The definition comes first, its group is not below any other
+  CHECK(model.definitions_.size() == 1);
+  CHECK(model.name(model.definitions_[0].name_id_) == "Window");
+  const size_t window[10] = { 0, 0, 0, 1, 0, 1, 0, 1, 0, 0 };
+  CHECK(SameEntities(model.definitions_[0].entities_, window));
+  const size_t window_group[10] = { 0, 0, 1, 0, 1, 1, 1, 0, 0, 0 };
+  CHECK(SameEntities(model.groups_[0].entities_, window_group));
+  CHECK(model.groups_[0].parent_ == -1);
+
+  // The geometry, then its groups breadth first: A, B, A1, A2
+  const size_t geometry[10] = { 0, 1, 1, 2, 2, 1, 1, 1, 0, 1 };
+  CHECK(SameEntities(model.entities_, geometry));
+  const size_t group_a[10] = { 1, 0, 3, 2, 3, 2, 2, 0, 1, 0 };
+  CHECK(SameEntities(model.groups_[1].entities_, group_a));
+  const size_t group_b[10] = { 1, 0, 5, 0, 5, 1, 2, 0, 1, 0 };
+  CHECK(SameEntities(model.groups_[2].entities_, group_b));
+  const size_t group_a1[10] = { 1, 0, 5, 0, 6, 0, 2, 1, 1, 1 };
+  CHECK(SameEntities(model.groups_[3].entities_, group_a1));
+  const size_t group_a2[10] = { 1, 1, 5, 0, 6, 0, 3, 0, 2, 0 };
+  CHECK(SameEntities(model.groups_[4].entities_, group_a2));
+  CHECK(model.groups_[1].parent_ == -1);
+  CHECK(model.groups_[2].parent_ == -1);
+  CHECK(model.groups_[3].parent_ == 1);
+  CHECK(model.groups_[4].parent_ == 1);
+
+  // Groups keep their own transformation, layer and hints
+  CHECK(model.groups_[0].transform_.values[12] == 1);
+  CHECK(model.groups_[1].transform_.values[12] == 4);
+  CHECK(model.groups_[2].transform_.values[12] == 5);
+  CHECK(model.groups_[3].transform_.values[12] == 2);
+  CHECK(model.groups_[4].transform_.values[12] == 3);
+  CHECK(model.name(model.groups_[1].layer_name_id_) == "Wall");
+  CHECK(model.groups_[1].layer_index_ == 1);
+  CHECK(!model.groups_[1].outline_ && !model.groups_[1].collision_only_);
+  CHECK(model.groups_[4].collision_only_);
+  CHECK(model.groups_[4].layer_index_ == 0);
+  CHECK(model.groups_[3].layer_name_id_ == 0);
+
+  // Faces in the order written, each with its own 4 vertices
+  const double face_x[6] = { 0, 1, 5, 2, 3, 4 };
+  for (size_t f = 0; f < model.faces_.size(); ++f) {
+    const XmlFaceInfo& face = model.faces_[f];
+    CHECK(face.has_single_loop_);
+    CHECK(face.first_vertex_ == 4 * f && face.num_vertices_ == 4);
+    CHECK(face.is_inner_loop_ == (f == 4));
+    CHECK(model.vertices_[face.first_vertex_].vertex_.x() == face_x[f]);
+  }
+
+  // Instances refer to the definition by name
+  for (size_t i = 0; i < model.component_instances_.size(); ++i) {
+    const XmlComponentInstanceInfo& instance = model.component_instances_[i];
+    CHECK(instance.definition_name_id_ == model.definitions_[0].name_id_);
+    CHECK(instance.transform_.values[14] == 1);
+  }
+  CHECK(model.component_instances_[0].layer_index_ == 1);
+  CHECK(model.component_instances_[1].layer_index_ == 0);
+
+  CHECK(model.edges_[2].has_layer_ && model.edges_[2].layer_index_ == 1);
+  CHECK(!model.edges_[1].has_layer_);
+  CHECK(model.curves_[0].edges_.size() == 2);
+  CHECK(model.curves_[1].edges_.size() == 3);
+
+  // The outline tables
+  CHECK(model.duplicate_outlines_ == MakeFlags(21, 4));
+  CHECK(model.hidden_outlines_ == MakeFlags(21, 3));
+
+  // Swap hands everything over
+  XmlModelInfo other;
+  other.Swap(model);
+  CHECK(model.groups_.empty() && model.faces_.empty() &&
+        model.definitions_.empty() && model.hidden_outlines_.empty());
+  CHECK(other.groups_.size() == 5 && other.faces_.size() == 6);
+  CHECK(SameEntities(other.entities_, geometry));
+  CHECK(other.name(other.definitions_[0].name_id_) == "Window");
+  CHECK(other.duplicate_outlines_ == MakeFlags(21, 4));
+
+  remove(path.c_str());
+  rmdir(directory.c_str());
+}
+
+void TestOutlineTables() {
+  // Models without the tables read back empty ones
+  std::string directory = XmlTest::MakeTempDirectory();
+  CHECK(!directory.empty());
+  std::string path = directory + "/empty.xml";
+  CXmlFile file;
+  CHECK(file.Open(path, true));
+  file.WriteHeader(8, 0, 0);
+  file.StartGeometry();
+  file.PopParentNode();
+  file.Close(false);
+
+  XmlModelInfo model;
+  model.duplicate_outlines_.assign(3, true);
+  CHECK(file.Open(path, false));
+  CHECK(file.GetModelInfo(model));
+  file.Close(true);
+  CHECK(model.duplicate_outlines_.empty());
+  CHECK(model.hidden_outlines_.empty());
+
+  remove(path.c_str());
+  rmdir(directory.c_str());
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestRoundTrip();
+  TestOutlineTables();
+  return XML_TEST_RESULT();
+}
@@ -0,0 +1,141 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include "./xmltest.h"
+#include "../common/xmloutlinededup.h"
+#include "../common/xmlworldgeometry.h"
+
+namespace {
+
+// Appends top level groups of one square each
+void AddGroups(XmlModelInfo& model, const double squares[][3],
+               size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    XmlGroupInfo group;
+    group.transform_ = XmlGeomUtils::IdentityTransform();
+    group.entities_.first_face_ = XmlTest::AddSquare(
+        model, squares[i][0], squares[i][1], 0, squares[i][2]);
+    group.entities_.num_faces_ = 1;
+    model.groups_.push_back(group);
+  }
+  model.entities_.num_groups_ = model.groups_.size();
+}
+
+size_t Compute(const CXmlWorldGeometry& geometry,
+               std::vector<bool>& duplicates) {
+  CXmlOutlineDeduplicator deduplicator(geometry);
+  return deduplicator.Compute(duplicates);
+}
+
+void TestSharedSides() {
+  // a and b share the side x = 1, c's top side runs along both their
+  // bottom sides
+  const double squares[3][3] = { { 0, 0, 1 }, { 1, 0, 1 }, { 0, -2, 2 } };
+  XmlModelInfo model;
+  AddGroups(model, squares, 3);
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+
+  // Of the coincident sides the first written is kept, b's left side goes.
+  // Along a line the longest side is kept, c's top side covers the bottom
+  // sides of a and b.
+  std::vector<bool> duplicates;
+  CHECK(Compute(geometry, duplicates) == 3);
+  CHECK(duplicates.size() == 12);
+  for (size_t i = 0; i < duplicates.size(); ++i) {
+    CHECK(duplicates[i] == (i == 0 || i == 4 || i == 7));
+  }
+}
+
+void TestPartialOverlap() {
+  // b's bottom side overlaps half of a's top side, both are kept
+  const double partial[2][3] = { { 0, 0, 2 }, { 1, 2, 2 } };
+  XmlModelInfo model;
+  AddGroups(model, partial, 2);
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+  std::vector<bool> duplicates;
+  CHECK(Compute(geometry, duplicates) == 0);
+
+  // c's top side overlaps half of the bottom sides of a and b, which
+  // together cover it. b's left side coincides with a's right side.
+  const double covered[3][3] = { { 0, 0, 2 }, { 2, 0, 2 }, { 1, -2, 2 } };
+  XmlModelInfo covered_model;
+  AddGroups(covered_model, covered, 3);
+  CXmlWorldGeometry covered_geometry;
+  covered_geometry.Build(covered_model);
+  CHECK(Compute(covered_geometry, duplicates) == 2);
+  CHECK(duplicates.size() == 12);
+  for (size_t i = 0; i < duplicates.size(); ++i) {
+    CHECK(duplicates[i] == (i == 7 || i == 10));
+  }
+}
+
+void TestSpilledSort() {
+  // A grid of squares, each a group. Every inner side is drawn twice.
+  const size_t kSize = 40;
+  XmlModelInfo model;
+  for (size_t y = 0; y < kSize; ++y) {
+    for (size_t x = 0; x < kSize; ++x) {
+      const double square[1][3] = {
+        { static_cast<double>(x), static_cast<double>(y), 1 }
+      };
+      AddGroups(model, square, 1);
+    }
+  }
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+
+  std::vector<bool> duplicates;
+  CHECK(Compute(geometry, duplicates) == 2 * kSize * (kSize - 1));
+
+  // Runs of the smallest size, the results do not change
+  CXmlOutlineDeduplicator deduplicator(geometry);
+  deduplicator.set_max_sort_bytes(1);
+  std::vector<bool> spilled;
+  CHECK(deduplicator.Compute(spilled) == 2 * kSize * (kSize - 1));
+  CHECK(deduplicator.num_spilled_runs() > 0);
+  CHECK(spilled == duplicates);
+}
+
+void TestSameGroup() {
+  // Two faces of one group sharing a side are both drawn
+  XmlModelInfo model;
+  XmlGroupInfo group;
+  group.transform_ = XmlGeomUtils::IdentityTransform();
+  group.entities_.first_face_ = XmlTest::AddSquare(model, 0, 0, 0, 1);
+  XmlTest::AddSquare(model, 1, 0, 0, 1);
+  group.entities_.num_faces_ = 2;
+  model.groups_.push_back(group);
+  model.entities_.num_groups_ = 1;
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+
+  std::vector<bool> duplicates;
+  CHECK(Compute(geometry, duplicates) == 0);
+}
+
+void TestHiddenOutlines() {
+  // A group without outlines neither keeps a side nor loses one
+  const double squares[3][3] = { { 0, 0, 1 }, { 1, 0, 1 }, { 1, 0, 1 } };
+  XmlModelInfo model;
+  AddGroups(model, squares, 3);
+  model.groups_[1].outline_ = false;
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+
+  std::vector<bool> duplicates;
+  CHECK(Compute(geometry, duplicates) == 1);
+  CHECK(duplicates.size() == 12);
+  CHECK(!duplicates[7] && duplicates[11]);
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestSharedSides();
+  TestPartialOverlap();
+  TestSpilledSort();
+  TestSameGroup();
+  TestHiddenOutlines();
+  return XML_TEST_RESULT();
+}
@@ -0,0 +1,117 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "./xmltest.h"
+#include "../common/xmlfile.h"
+#include "../common/xmlpackage.h"
+
+namespace {
+
+// Writes a model with the given layers and one instance of the definition
+// "Door", whose face is on the layer "Wall"
+bool WriteModel(const std::string& path, const char* const layers[],
+                int num_layers) {
+  CXmlFile file;
+  if (!file.Open(path, true))
+    return false;
+  file.WriteHeader(8, 0, 0);
+
+  int wall_index = -1;
+  file.StartLayers();
+  for (int i = 0; i < num_layers; ++i) {
+    XmlLayerInfo layer;
+    layer.name_ = layers[i];
+    layer.is_visible_ = true;
+    file.WriteLayerInfo(layer);
+    if (layer.name_ == "Wall")
+      wall_index = i;
+  }
+  file.PopParentNode();
+
+  XmlModelInfo square;
+  XmlTest::AddSquare(square, 0, 0, 0, 1);
+  XmlFaceInfo face = square.faces_[0];
+  face.layer_name_id_ = file.names().Intern("Wall");
+  face.layer_index_ = wall_index;
+  file.StartComponentDefinitions();
+  file.StartComponentDefinition("Door");
+  file.WriteFaceInfo(face, square.vertices_);
+  file.PopParentNode();
+  file.PopParentNode();
+
+  XmlComponentInstanceInfo instance;
+  instance.definition_name_id_ = file.names().Intern("Door");
+  instance.layer_name_id_ = file.names().Intern("Wall");
+  instance.layer_index_ = wall_index;
+  instance.transform_ = XmlTest::Translation(5, 0, 0);
+  file.StartGeometry();
+  file.WriteComponentInstanceInfo(instance);
+  file.PopParentNode();
+
+  file.Close(false);
+  return true;
+}
+
+bool ReadModel(const std::string& path, XmlModelInfo& model) {
+  CXmlFile file;
+  bool ok = file.Open(path, false) && file.GetModelInfo(model);
+  file.Close(true);
+  return ok;
+}
+
+void TestStoredLayers() {
+  // The definition is the same in both models, its layer is not
+  std::string directory = XmlTest::MakeTempDirectory();
+  CHECK(!directory.empty());
+  const char* const first_layers[2] = { "Layer0", "Wall" };
+  const char* const second_layers[3] = { "Layer0", "Roof", "Wall" };
+  std::string first = directory + "/first.xml";
+  std::string second = directory + "/second.xml";
+  CHECK(WriteModel(first, first_layers, 2));
+  CHECK(WriteModel(second, second_layers, 3));
+
+  CXmlPackageBuilder package(directory);
+  CHECK(package.AddModel(first));
+  CHECK(package.AddModel(second));
+  CHECK(package.num_models() == 2);
+  CHECK(package.num_definitions() == 2);
+  CHECK(package.num_unique_definitions() == 1);
+  CHECK(package.num_written() == 1);
+
+  // Each model finds the layer of the stored face in its own Layers
+  XmlModelInfo model;
+  CHECK(ReadModel(first, model));
+  CHECK(model.definitions_.size() == 1 && model.faces_.size() == 1);
+  CHECK(model.faces_[0].layer_index_ == 1);
+  CHECK(model.name(model.faces_[0].layer_name_id_) == "Wall");
+  CHECK(model.component_instances_.size() == 1);
+  CHECK(model.component_instances_[0].layer_index_ == 1);
+  CHECK(ReadModel(second, model));
+  CHECK(model.faces_.size() == 1 && model.faces_[0].layer_index_ == 2);
+  CHECK(model.component_instances_[0].layer_index_ == 2);
+
+  // The model of a package points its instances at the stored definition
+  CHECK(model.definitions_.size() == 1 &&
+        model.component_instances_[0].definition_name_id_ ==
+        model.definitions_[0].name_id_);
+
+  std::string stored = directory + "/definitions/" +
+                       model.name(model.definitions_[0].name_id_) + ".xml";
+  CHECK(remove(stored.c_str()) == 0);
+  rmdir((directory + "/definitions").c_str());
+  remove(first.c_str());
+  remove(second.c_str());
+  rmdir(directory.c_str());
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestStoredLayers();
+  return XML_TEST_RESULT();
+}
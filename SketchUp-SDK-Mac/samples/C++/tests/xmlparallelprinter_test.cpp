@@ -0,0 +1,93 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "./xmltest.h"
+#include "../common/tinyxml2.h"
+#include "../common/xmlparallelprinter.h"
+
+namespace {
+
+// Sections like those of an export, large enough to be split into runs,
+// with attributes and text that need escaping
+void BuildDocument(tinyxml2::XMLDocument& doc) {
+  tinyxml2::XMLElement* header = doc.NewElement("SkpToXML");
+  header->SetAttribute("xmlversion", 3);
+  doc.InsertEndChild(header);
+
+  tinyxml2::XMLElement* layers = doc.NewElement("Layers");
+  doc.InsertEndChild(layers);
+  for (int i = 0; i < 50; ++i) {
+    tinyxml2::XMLElement* layer = doc.NewElement("Layer");
+    layer->SetAttribute("Name", i % 2 ? "Walls & \"Doors\"" : "<Glass>");
+    layers->InsertEndChild(layer);
+  }
+
+  tinyxml2::XMLElement* geometry = doc.NewElement("Geometry");
+  doc.InsertEndChild(geometry);
+  for (int g = 0; g < 400; ++g) {
+    tinyxml2::XMLElement* group = doc.NewElement("Group");
+    geometry->InsertEndChild(group);
+    for (int f = 0; f < 5; ++f) {
+      tinyxml2::XMLElement* face = doc.NewElement("Face");
+      group->InsertEndChild(face);
+      for (int v = 0; v < 4; ++v) {
+        tinyxml2::XMLElement* vertex = doc.NewElement("Vertex");
+        vertex->SetAttribute("x", g + 0.25 * v);
+        vertex->SetAttribute("y", f * 1.5);
+        face->InsertEndChild(vertex);
+      }
+    }
+    tinyxml2::XMLElement* name = doc.NewElement("Name");
+    name->InsertEndChild(doc.NewText("a < b"));
+    group->InsertEndChild(name);
+  }
+  doc.InsertEndChild(doc.NewElement("Scenes"));
+}
+
+void TestSameAsSaveFile(const std::string& directory) {
+  tinyxml2::XMLDocument doc;
+  BuildDocument(doc);
+  std::string expected_file = directory + "/expected.xml";
+  std::string printed_file = directory + "/printed.xml";
+  CHECK(doc.SaveFile(expected_file.c_str()) == tinyxml2::XML_NO_ERROR);
+  CXmlParallelPrinter printer(doc);
+  CHECK(printer.Save(printed_file));
+
+  std::string expected = XmlTest::ReadFile(expected_file);
+  CHECK(expected.size() > 100000);
+  CHECK(XmlTest::ReadFile(printed_file) == expected);
+  remove(expected_file.c_str());
+  remove(printed_file.c_str());
+}
+
+void TestUnsupported(const std::string& directory) {
+  // Top level nodes other than elements are left to SaveFile
+  tinyxml2::XMLDocument doc;
+  doc.InsertEndChild(doc.NewDeclaration());
+  doc.InsertEndChild(doc.NewElement("Geometry"));
+  std::string file = directory + "/declaration.xml";
+  CHECK(!CXmlParallelPrinter(doc).Save(file));
+  remove(file.c_str());
+
+  // Files that cannot be written
+  tinyxml2::XMLDocument empty;
+  empty.InsertEndChild(empty.NewElement("Geometry"));
+  CHECK(!CXmlParallelPrinter(empty).Save(directory + "/missing/a.xml"));
+}
+
+} // end anonymous namespace
+
+int main() {
+  std::string directory = XmlTest::MakeTempDirectory();
+  CHECK(!directory.empty());
+  if (directory.empty())
+    return XML_TEST_RESULT();
+  TestSameAsSaveFile(directory);
+  TestUnsupported(directory);
+  rmdir(directory.c_str());
+  return XML_TEST_RESULT();
+}
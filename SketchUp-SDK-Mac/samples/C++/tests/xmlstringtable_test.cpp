@@ -0,0 +1,66 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+
+#include <string>
+
+#include "./xmltest.h"
+#include "../common/xmlstringtable.h"
+
+namespace {
+
+void TestIntern() {
+  CXmlStringTable names;
+  CHECK(names.size() == 1);
+  CHECK(names.Intern("") == 0);
+  CHECK(names.Get(0).empty());
+
+  int wall = names.Intern("Wall");
+  int glass = names.Intern(std::string("Glass"));
+  CHECK(wall == 1 && glass == 2);
+  CHECK(names.Intern("Wall") == wall);
+  CHECK(names.Find("Glass") == glass);
+  CHECK(names.Find("Roof") == -1);
+  CHECK(names.Get(wall) == "Wall");
+  CHECK(names.size() == 3);
+}
+
+void TestGrow() {
+  // Enough names to grow the slots several times, the ids stay put
+  CXmlStringTable names;
+  char name[32];
+  for (int i = 0; i < 5000; ++i) {
+    sprintf(name, "Layer%d", i);
+    CHECK(names.Intern(name) == i + 1);
+  }
+  CHECK(names.size() == 5001);
+  for (int i = 0; i < 5000; i += 7) {
+    sprintf(name, "Layer%d", i);
+    CHECK(names.Find(name) == i + 1);
+    CHECK(names.Get(i + 1) == name);
+  }
+}
+
+void TestClearAndSwap() {
+  CXmlStringTable a;
+  CXmlStringTable b;
+  a.Intern("Door");
+  b.Intern("Window");
+  b.Intern("Frame");
+  a.Swap(b);
+  CHECK(a.size() == 3 && a.Find("Frame") == 2 && a.Find("Door") == -1);
+  CHECK(b.size() == 2 && b.Find("Door") == 1);
+
+  a.Clear();
+  CHECK(a.size() == 1 && a.Find("") == 0 && a.Find("Window") == -1);
+  CHECK(a.Intern("Window") == 1);
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestIntern();
+  TestGrow();
+  TestClearAndSwap();
+  return XML_TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_TESTS_XMLTEST_H
+#define SKPTOXML_TESTS_XMLTEST_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "../common/xmlfile.h"
+#include "../common/xmlgeomutils.h"
+
+// Minimal support for the self-checking tests of the common modules. Each
+// test is a program of its own, CHECK reports a failed condition and goes
+// on, and main returns XML_TEST_RESULT(), which is 0 if nothing failed.
+
+static int g_xml_test_failures = 0;
+
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,    \
+              #condition);                                                \
+      ++g_xml_test_failures;                                              \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(fabs((a) - (b)) <= (tolerance))
+
+#define XML_TEST_RESULT() (g_xml_test_failures == 0 ? 0 : 1)
+
+namespace XmlTest {
+
+// Appends a square face of the given side in the plane z, its first corner
+// at (x, y), counter-clockwise seen from +z. Returns its index in faces_.
+// The caller points the entities of the model or of a group at it.
+inline size_t AddSquare(XmlModelInfo& model, double x, double y, double z,
+                        double side) {
+  XmlFaceInfo face;
+  face.has_single_loop_ = true;
+  face.first_vertex_ = model.vertices_.size();
+  face.num_vertices_ = 4;
+  const double corners[4][2] = {
+    { x, y }, { x + side, y }, { x + side, y + side }, { x, y + side }
+  };
+  for (size_t i = 0; i < 4; ++i) {
+    XmlFaceVertex vertex;
+    vertex.vertex_ =
+        XmlGeomUtils::CPoint3d(corners[i][0], corners[i][1], z);
+    model.vertices_.push_back(vertex);
+  }
+  model.faces_.push_back(face);
+  return model.faces_.size() - 1;
+}
+
+// A transformation moving by (x, y, z)
+inline SUTransformation Translation(double x, double y, double z) {
+  SUTransformation transform = XmlGeomUtils::IdentityTransform();
+  transform.values[12] = x;
+  transform.values[13] = y;
+  transform.values[14] = z;
+  return transform;
+}
+
+// Creates an empty directory for the files of a test, "" on failure
+inline std::string MakeTempDirectory() {
+  const char* tmpdir = getenv("TMPDIR");
+  std::string path = std::string(tmpdir != NULL ? tmpdir : "/tmp") +
+                     "/skptoxml_test.XXXXXX";
+  return mkdtemp(&path[0]) != NULL ? path : std::string();
+}
+
+// The whole content of a file, "" if it cannot be read
+inline std::string ReadFile(const std::string& path) {
+  std::string content;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+    return content;
+  char buffer[4096];
+  size_t count = 0;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    content.append(buffer, count);
+  fclose(file);
+  return content;
+}
+
+} // end namespace XmlTest
+
+#endif // SKPTOXML_TESTS_XMLTEST_H
@@ -0,0 +1,104 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <vector>
+
+#include "./xmltest.h"
+#include "../common/xmltriangulator.h"
+
+using XmlGeomUtils::CPoint3d;
+
+namespace {
+
+// Signed area of the triangles in the plane z = 0, positive when they run
+// counter-clockwise seen from +z. Also checks that each is well formed.
+double TriangleArea(const std::vector<CPoint3d>& points,
+                    const std::vector<size_t>& triangles) {
+  CHECK(triangles.size() % 3 == 0);
+  double area = 0.0;
+  for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+    CHECK(triangles[i] < points.size() && triangles[i + 1] < points.size() &&
+          triangles[i + 2] < points.size());
+    const CPoint3d& a = points[triangles[i]];
+    const CPoint3d& b = points[triangles[i + 1]];
+    const CPoint3d& c = points[triangles[i + 2]];
+    double cross = (b.x() - a.x()) * (c.y() - a.y()) -
+                   (b.y() - a.y()) * (c.x() - a.x());
+    CHECK(cross > 0.0);
+    area += cross / 2.0;
+  }
+  return area;
+}
+
+std::vector<CPoint3d> MakeLoop(const double (*xy)[2], size_t count) {
+  std::vector<CPoint3d> points;
+  for (size_t i = 0; i < count; ++i) {
+    points.push_back(CPoint3d(xy[i][0], xy[i][1], 0.0));
+  }
+  return points;
+}
+
+void TestConvex() {
+  const double square[4][2] = { { 0, 0 }, { 2, 0 }, { 2, 2 }, { 0, 2 } };
+  std::vector<CPoint3d> points = MakeLoop(square, 4);
+  size_t loop_sizes[1] = { 4 };
+  CXmlTriangulator triangulator;
+  std::vector<size_t> triangles;
+  CHECK(triangulator.Triangulate(&points[0], loop_sizes, 1, triangles));
+  CHECK(triangles.size() == 6);
+  CHECK_NEAR(TriangleArea(points, triangles), 4.0, 1e-9);
+}
+
+void TestConcave() {
+  // An L, its reflex corner at (1, 1)
+  const double l_shape[6][2] = {
+    { 0, 0 }, { 2, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 2 }
+  };
+  std::vector<CPoint3d> points = MakeLoop(l_shape, 6);
+  size_t loop_sizes[1] = { 6 };
+  CXmlTriangulator triangulator;
+  std::vector<size_t> triangles;
+  CHECK(triangulator.Triangulate(&points[0], loop_sizes, 1, triangles));
+  CHECK(triangles.size() == 12);
+  CHECK_NEAR(TriangleArea(points, triangles), 3.0, 1e-9);
+}
+
+void TestHoles() {
+  // A square with two square holes, which wind the other way
+  const double loops[12][2] = {
+    { 0, 0 }, { 6, 0 }, { 6, 4 }, { 0, 4 },
+    { 1, 1 }, { 1, 3 }, { 2, 3 }, { 2, 1 },
+    { 4, 1 }, { 4, 3 }, { 5, 3 }, { 5, 1 }
+  };
+  std::vector<CPoint3d> points = MakeLoop(loops, 12);
+  size_t loop_sizes[3] = { 4, 4, 4 };
+  CXmlTriangulator triangulator;
+  std::vector<size_t> triangles;
+  CHECK(triangulator.Triangulate(&points[0], loop_sizes, 3, triangles));
+  // Two bridges make the polygon 16 points long
+  CHECK(triangles.size() == 3 * 14);
+  CHECK_NEAR(TriangleArea(points, triangles), 24.0 - 2.0 - 2.0, 1e-9);
+
+  // The triangulator is reused, the scratch buffers start over
+  std::vector<size_t> again;
+  CHECK(triangulator.Triangulate(&points[0], loop_sizes, 3, again));
+  CHECK(again == triangles);
+}
+
+void TestDegenerate() {
+  const double line[3][2] = { { 0, 0 }, { 1, 0 }, { 2, 0 } };
+  std::vector<CPoint3d> points = MakeLoop(line, 3);
+  size_t loop_sizes[1] = { 3 };
+  CXmlTriangulator triangulator;
+  std::vector<size_t> triangles;
+  CHECK(!triangulator.Triangulate(&points[0], loop_sizes, 1, triangles));
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestConvex();
+  TestConcave();
+  TestHoles();
+  TestDegenerate();
+  return XML_TEST_RESULT();
+}
@@ -0,0 +1,143 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <vector>
+
+#include "./xmltest.h"
+#include "../common/xmlvertexcache.h"
+
+namespace {
+
+// Triangles of a grid of size x size vertices, in a scrambled order that
+// the cache has little use of
+std::vector<unsigned int> ScrambledGrid(unsigned int size) {
+  std::vector<unsigned int> indices;
+  for (unsigned int y = 0; y + 1 < size; ++y) {
+    for (unsigned int x = 0; x + 1 < size; ++x) {
+      unsigned int v = y * size + x;
+      indices.push_back(v);
+      indices.push_back(v + 1);
+      indices.push_back(v + size + 1);
+      indices.push_back(v);
+      indices.push_back(v + size + 1);
+      indices.push_back(v + size);
+    }
+  }
+  // Swaps whole triangles with a fixed linear congruential sequence
+  size_t num_triangles = indices.size() / 3;
+  unsigned int state = 12345;
+  for (size_t i = num_triangles - 1; i > 0; --i) {
+    state = state * 1103515245 + 12345;
+    size_t j = (state >> 8) % (i + 1);
+    for (size_t k = 0; k < 3; ++k)
+      std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+  }
+  return indices;
+}
+
+// Triangles rotated to start at their smallest index, which keeps their
+// winding, then sorted
+std::vector<unsigned int> Canonical(const std::vector<unsigned int>& indices) {
+  std::vector<std::vector<unsigned int> > triangles;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    std::vector<unsigned int> triangle(indices.begin() + i,
+                                       indices.begin() + i + 3);
+    std::rotate(triangle.begin(),
+                std::min_element(triangle.begin(), triangle.end()),
+                triangle.end());
+    triangles.push_back(triangle);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  std::vector<unsigned int> result;
+  for (size_t i = 0; i < triangles.size(); ++i)
+    result.insert(result.end(), triangles[i].begin(), triangles[i].end());
+  return result;
+}
+
+void TestCountCacheMisses() {
+  // Two triangles sharing an edge load 4 vertices
+  unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+  size_t num_vertices = 0;
+  CHECK(CXmlVertexCacheOptimizer::CountCacheMisses(quad, 6,
+                                                   &num_vertices) == 4);
+  CHECK(num_vertices == 4);
+  CHECK(CXmlVertexCacheOptimizer::CountCacheMisses(quad, 0) == 0);
+}
+
+void TestOptimize() {
+  std::vector<unsigned int> indices = ScrambledGrid(32);
+  std::vector<unsigned int> optimized = indices;
+  size_t before = CXmlVertexCacheOptimizer::CountCacheMisses(
+      &indices[0], indices.size());
+  CXmlVertexCacheOptimizer optimizer;
+  optimizer.Optimize(&optimized[0], optimized.size());
+  size_t num_vertices = 0;
+  size_t after = CXmlVertexCacheOptimizer::CountCacheMisses(
+      &optimized[0], optimized.size(), &num_vertices);
+  CHECK(Canonical(optimized) == Canonical(indices));
+  CHECK(num_vertices == 32 * 32);
+  // About 3 misses per triangle before, well under 1 after
+  size_t num_triangles = indices.size() / 3;
+  CHECK(before > 2 * num_triangles);
+  CHECK(after < num_triangles);
+  CHECK(after >= num_vertices);
+
+  // Indices need not start at 0
+  std::vector<unsigned int> offset = indices;
+  for (size_t i = 0; i < offset.size(); ++i)
+    offset[i] += 100000;
+  optimizer.Optimize(&offset[0], offset.size());
+  for (size_t i = 0; i < offset.size(); ++i)
+    offset[i] -= 100000;
+  CHECK(offset == optimized);
+}
+
+void TestOptimizeInChunks() {
+  // Large enough for more than one chunk
+  std::vector<unsigned int> serial = ScrambledGrid(120);
+  std::vector<unsigned int> parallel = serial;
+  std::vector<unsigned int> original = serial;
+  XmlVertexCacheInfo serial_info;
+  XmlVertexCacheInfo parallel_info;
+  CXmlVertexCacheOptimizer::OptimizeInChunks(serial, false, serial_info);
+  CXmlVertexCacheOptimizer::OptimizeInChunks(parallel, true, parallel_info);
+  CHECK(serial == parallel);
+  CHECK(serial_info.triangles_ == original.size() / 3);
+  CHECK(parallel_info.triangles_ == serial_info.triangles_);
+  CHECK(parallel_info.misses_after_ == serial_info.misses_after_);
+  CHECK(serial_info.misses_after_ < serial_info.misses_before_);
+  CHECK(Canonical(serial) == Canonical(original));
+
+  // Triangles already in a good order are left as they are
+  unsigned int fan[9] = { 0, 1, 2, 0, 2, 3, 0, 3, 4 };
+  std::vector<unsigned int> kept(fan, fan + 9);
+  XmlVertexCacheInfo kept_info;
+  CXmlVertexCacheOptimizer::OptimizeInChunks(kept, true, kept_info);
+  CHECK(kept == std::vector<unsigned int>(fan, fan + 9));
+  CHECK(kept_info.misses_before_ == kept_info.misses_after_);
+}
+
+void TestGetFirstUseOrder() {
+  unsigned int used[6] = { 3, 1, 4, 1, 4, 0 };
+  std::vector<unsigned int> indices(used, used + 6);
+  std::vector<unsigned int> remap;
+  CXmlVertexCacheOptimizer::GetFirstUseOrder(indices, 6, remap);
+  CHECK(remap.size() == 6);
+  CHECK(remap[3] == 0);
+  CHECK(remap[1] == 1);
+  CHECK(remap[4] == 2);
+  CHECK(remap[0] == 3);
+  // Not used, after the others in their order
+  CHECK(remap[2] == 4);
+  CHECK(remap[5] == 5);
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestCountCacheMisses();
+  TestOptimize();
+  TestOptimizeInChunks();
+  TestGetFirstUseOrder();
+  return XML_TEST_RESULT();
+}
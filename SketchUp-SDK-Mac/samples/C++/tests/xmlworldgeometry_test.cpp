@@ -0,0 +1,118 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+// Flattening of groups and component instances, and the hidden line pass
+// run on the result.
+
+#include "./xmltest.h"
+#include "../common/xmlhiddenlines.h"
+#include "../common/xmlpolygonbvh.h"
+#include "../common/xmlworldgeometry.h"
+
+using XmlGeomUtils::CPoint3d;
+using XmlGeomUtils::CVector3d;
+
+namespace {
+
+// A loose square, a group holding a square moved by (10, 0, 0) without
+// outlines, and an instance of a definition holding one square, moved by
+// (0, 10, 0). In the pools the definition comes first, then the group.
+void BuildModel(XmlModelInfo& model) {
+  model.definitions_.resize(1);
+  XmlComponentDefinitionInfo& definition = model.definitions_[0];
+  definition.name_id_ = model.names_.Intern("Chair");
+  definition.entities_.first_face_ = XmlTest::AddSquare(model, 0, 0, 0, 1);
+  definition.entities_.num_faces_ = 1;
+
+  model.groups_.resize(1);
+  XmlGroupInfo& group = model.groups_[0];
+  group.transform_ = XmlTest::Translation(10, 0, 0);
+  group.outline_ = false;
+  group.entities_.first_face_ = XmlTest::AddSquare(model, 0, 0, 0, 1);
+  group.entities_.num_faces_ = 1;
+
+  model.component_instances_.resize(1);
+  XmlComponentInstanceInfo& instance = model.component_instances_[0];
+  instance.definition_name_id_ = model.names_.Intern("Chair");
+  instance.transform_ = XmlTest::Translation(0, 10, 0);
+
+  model.entities_.num_instances_ = 1;
+  model.entities_.num_groups_ = 1;
+  model.entities_.first_face_ = XmlTest::AddSquare(model, 0, 0, 0, 2);
+  model.entities_.num_faces_ = 1;
+}
+
+void TestFlatten() {
+  XmlModelInfo model;
+  BuildModel(model);
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+
+  // Instances, then groups, then the loose faces, a segment per side
+  const std::vector<XmlWorldSegment>& segments = geometry.segments();
+  CHECK(segments.size() == 12);
+  CHECK(geometry.polygons().size() == 3);
+  CHECK(geometry.num_groups() == 2);
+  if (segments.size() != 12)
+    return;
+  CHECK(segments[0].group_ == 0 && segments[4].group_ == 1 &&
+        segments[8].group_ == -1);
+  CHECK_NEAR(segments[0].start_.y(), 10.0, 1e-9);
+  CHECK_NEAR(segments[4].start_.x(), 10.0, 1e-9);
+  CHECK(segments[0].outline_ && !segments[4].outline_ &&
+        segments[8].outline_);
+  CHECK_NEAR(geometry.min().x(), 0.0, 1e-9);
+  CHECK_NEAR(geometry.max().x(), 11.0, 1e-9);
+  CHECK_NEAR(geometry.max().y(), 11.0, 1e-9);
+
+  // Instances of a definition the file does not hold add nothing
+  model.component_instances_[0].definition_name_id_ =
+      model.names_.Intern("Table");
+  geometry.Build(model);
+  CHECK(geometry.segments().size() == 8);
+}
+
+void TestHiddenLines() {
+  // A square hides an equal one 5 inches behind it
+  XmlModelInfo model;
+  model.entities_.first_face_ = XmlTest::AddSquare(model, 0, 0, 0, 1);
+  XmlTest::AddSquare(model, 0, 0, -5, 1);
+  model.entities_.num_faces_ = 2;
+  CXmlWorldGeometry geometry;
+  geometry.Build(model);
+  CXmlPolygonBvh bvh;
+  bvh.Build(geometry);
+
+  XmlCameraInfo camera;
+  camera.eye_ = CPoint3d(0.5, 0.5, 10);
+  camera.target_ = CPoint3d(0.5, 0.5, 0);
+  camera.up_ = CVector3d(0, 1, 0);
+  CXmlHiddenLinePass pass(geometry, bvh);
+  std::vector<bool> visible;
+  CHECK(pass.Compute(camera, visible) == 4);
+  CHECK(visible.size() == 8);
+  for (size_t i = 0; i < visible.size(); ++i) {
+    CHECK(visible[i] == (i < 4));
+  }
+
+  // From below the far square is the one in front
+  camera.eye_ = CPoint3d(0.5, 0.5, -15);
+  CHECK(pass.Compute(camera, visible) == 4);
+  CHECK(!visible[0] && visible[4]);
+
+  // A camera without a view hides nothing
+  camera.target_ = camera.eye_;
+  CHECK(pass.Compute(camera, visible) == 8);
+  camera.eye_ = CPoint3d(0.5, 0.5, 10);
+  camera.target_ = CPoint3d(0.5, 0.5, 0);
+  camera.is_perspective_ = false;
+  camera.ortho_height_ = 0.0;
+  CHECK(pass.Compute(camera, visible) == 8);
+}
+
+} // end anonymous namespace
+
+int main() {
+  TestFlatten();
+  TestHiddenLines();
+  return XML_TEST_RESULT();
+}
@@ -0,0 +1,208 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <vector>
+
+#include "./xmlloader.h"
+#include "../common/xmlfile.h"
+#include "../common/xmlworldgeometry.h"
+
+using namespace XmlGeomUtils;
+
+// Layer of the segments without one, the largest 16 bit index
+static const unsigned short kNoLayer = 0xffff;
+
+// Everything is extracted on open, the XML document and the model info are
+// released before returning the handle.
+struct XmlLoaderModel {
+  CXmlWorldGeometry geometry_;
+  // One per point of geometry_
+  std::vector<CVector3d> normals_;
+  std::vector<unsigned int> triangles_;
+  std::vector<bool> duplicates_;
+  std::vector<SUTransformation> group_transforms_;
+};
+
+namespace {
+
+int CopyCount(size_t count, int capacity) {
+  if (capacity < 0)
+    return -1;
+  return static_cast<int>(std::min(count, static_cast<size_t>(capacity)));
+}
+
+float* CopyPoint(const CPoint3d& point, float* out) {
+  out[0] = static_cast<float>(point.x());
+  out[1] = static_cast<float>(point.y());
+  out[2] = static_cast<float>(point.z());
+  return out + 3;
+}
+
+float* CopyVector(const CVector3d& vector, float* out) {
+  out[0] = static_cast<float>(vector.x());
+  out[1] = static_cast<float>(vector.y());
+  out[2] = static_cast<float>(vector.z());
+  return out + 3;
+}
+
+} // end anonymous namespace
+
+XmlLoaderModel* XmlLoaderOpen(const char* filename) {
+  if (filename == NULL)
+    return NULL;
+  XmlLoaderModel* model = NULL;
+  try {
+    XmlModelInfo model_info;
+    {
+      CXmlFile file;
+      if (!file.Open(filename, false) || !file.GetModelInfo(model_info))
+        return NULL;
+    }
+
+    model = new XmlLoaderModel;
+    CXmlWorldGeometry& geometry = model->geometry_;
+    geometry.Build(model_info);
+    geometry.Triangulate(model->triangles_, true);
+    model->normals_.resize(geometry.points().size());
+    for (size_t p = 0; p < geometry.polygons().size(); ++p) {
+      const XmlWorldPolygon& polygon = geometry.polygons()[p];
+      for (size_t l = 0; l < polygon.num_loops_; ++l) {
+        const XmlWorldLoop& loop = geometry.loops()[polygon.first_loop_ + l];
+        std::fill(model->normals_.begin() + loop.first_point_,
+                  model->normals_.begin() + loop.first_point_ +
+                  loop.num_points_, polygon.normal_);
+      }
+    }
+    model->duplicates_ = model_info.duplicate_outlines_;
+
+    // Same numbering as CXmlWorldGeometry gives the top level groups
+    const XmlEntitiesInfo& entities = model_info.entities_;
+    for (size_t i = 0; i < entities.num_instances_; ++i) {
+      model->group_transforms_.push_back(
+          model_info.component_instances_[entities.first_instance_ + i]
+              .transform_);
+    }
+    for (size_t i = 0; i < entities.num_groups_; ++i) {
+      model->group_transforms_.push_back(
+          model_info.groups_[entities.first_group_ + i].transform_);
+    }
+  } catch (...) {
+    delete model;
+    return NULL;
+  }
+  return model;
+}
+
+void XmlLoaderClose(XmlLoaderModel* model) {
+  delete model;
+}
+
+int XmlLoaderGetVertexCount(const XmlLoaderModel* model) {
+  return model != NULL ?
+         static_cast<int>(model->geometry_.points().size()) : -1;
+}
+
+int XmlLoaderGetVertices(const XmlLoaderModel* model, float* positions,
+                         float* normals, int capacity) {
+  if (model == NULL)
+    return -1;
+  const std::vector<CPoint3d>& points = model->geometry_.points();
+  int count = CopyCount(points.size(), capacity);
+  for (int i = 0; i < count; ++i) {
+    if (positions != NULL)
+      positions = CopyPoint(points[i], positions);
+    if (normals != NULL)
+      normals = CopyVector(model->normals_[i], normals);
+  }
+  return count;
+}
+
+int XmlLoaderGetIndexCount(const XmlLoaderModel* model) {
+  return model != NULL ? static_cast<int>(model->triangles_.size()) : -1;
+}
+
+int XmlLoaderGetIndices(const XmlLoaderModel* model, int* indices,
+                        int capacity) {
+  if (model == NULL || indices == NULL)
+    return -1;
+  int count = CopyCount(model->triangles_.size(), capacity);
+  for (int i = 0; i < count; ++i) {
+    indices[i] = static_cast<int>(model->triangles_[i]);
+  }
+  return count;
+}
+
+int XmlLoaderGetSegmentCount(const XmlLoaderModel* model) {
+  return model != NULL ?
+         static_cast<int>(model->geometry_.segments().size()) : -1;
+}
+
+int XmlLoaderGetSegments(const XmlLoaderModel* model, float* points,
+                         float* normals, int* groups,
+                         unsigned char* duplicates, int capacity) {
+  if (model == NULL)
+    return -1;
+  const std::vector<XmlWorldSegment>& segments = model->geometry_.segments();
+  int count = CopyCount(segments.size(), capacity);
+  for (int i = 0; i < count; ++i) {
+    const XmlWorldSegment& segment = segments[i];
+    if (points != NULL) {
+      points = CopyPoint(segment.start_, points);
+      points = CopyPoint(segment.end_, points);
+    }
+    if (normals != NULL)
+      normals = CopyVector(segment.normal_, normals);
+    if (groups != NULL)
+      groups[i] = segment.group_;
+    // Files without the table have no duplicates, segments the export
+    // hints turned off are skipped all the same
+    if (duplicates != NULL) {
+      duplicates[i] = !segment.outline_ ||
+                      (static_cast<size_t>(i) < model->duplicates_.size() &&
+                       model->duplicates_[i]);
+    }
+  }
+  return count;
+}
+
+int XmlLoaderGetSegmentStyles(const XmlLoaderModel* model,
+                              unsigned char* colors, unsigned short* layers,
+                              int capacity) {
+  if (model == NULL)
+    return -1;
+  const std::vector<XmlWorldSegment>& segments = model->geometry_.segments();
+  int count = CopyCount(segments.size(), capacity);
+  for (int i = 0; i < count; ++i) {
+    const XmlWorldSegment& segment = segments[i];
+    if (colors != NULL) {
+      *colors++ = segment.color_.red;
+      *colors++ = segment.color_.green;
+      *colors++ = segment.color_.blue;
+      *colors++ = segment.color_.alpha;
+    }
+    if (layers != NULL) {
+      layers[i] = (segment.layer_ >= 0 && segment.layer_ < kNoLayer) ?
+                  static_cast<unsigned short>(segment.layer_) : kNoLayer;
+    }
+  }
+  return count;
+}
+
+int XmlLoaderGetGroupCount(const XmlLoaderModel* model) {
+  return model != NULL ?
+         static_cast<int>(model->group_transforms_.size()) : -1;
+}
+
+int XmlLoaderGetGroupTransforms(const XmlLoaderModel* model, float* matrices,
+                                int capacity) {
+  if (model == NULL || matrices == NULL)
+    return -1;
+  int count = CopyCount(model->group_transforms_.size(), capacity);
+  for (int i = 0; i < count; ++i) {
+    const SUTransformation& transform = model->group_transforms_[i];
+    for (int k = 0; k < 16; ++k) {
+      *matrices++ = static_cast<float>(transform.values[k]);
+    }
+  }
+  return count;
+}
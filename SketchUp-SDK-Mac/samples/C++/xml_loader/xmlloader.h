@@ -0,0 +1,71 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_LOADER_XMLLOADER_H
+#define SKPTOXML_LOADER_XMLLOADER_H
+
+// C interface of the XmlLoader library, which reads exports with CXmlFile so
+// that the Unity editor can load them through P/Invoke instead of walking
+// the XML itself. A model is opened once, sized with the count functions
+// and copied out into arrays the caller allocates. Points and normals take 3
+// floats each, in world space inches, and transformations 16 floats,
+// column-major. The copy functions take the capacity of the arrays in
+// elements (vertices, indices, segments, groups) and return the number of
+// elements written, -1 on error. Models are independent, each may be used
+// from its own thread.
+
+#if defined(_WIN32)
+#define XML_LOADER_EXPORT __declspec(dllexport)
+#else
+#define XML_LOADER_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct XmlLoaderModel XmlLoaderModel;
+
+// Returns NULL if the file cannot be read
+XML_LOADER_EXPORT XmlLoaderModel* XmlLoaderOpen(const char* filename);
+XML_LOADER_EXPORT void XmlLoaderClose(XmlLoaderModel* model);
+
+// Faces, cut into triangles. Vertices carry the normal of their face.
+XML_LOADER_EXPORT int XmlLoaderGetVertexCount(const XmlLoaderModel* model);
+XML_LOADER_EXPORT int XmlLoaderGetVertices(const XmlLoaderModel* model,
+                                           float* positions, float* normals,
+                                           int capacity);
+XML_LOADER_EXPORT int XmlLoaderGetIndexCount(const XmlLoaderModel* model);
+XML_LOADER_EXPORT int XmlLoaderGetIndices(const XmlLoaderModel* model,
+                                          int* indices, int capacity);
+
+// Outline segments, one per loop side and edge in document order, the order
+// of the DuplicateOutlines flags and the scenes' visible lines. Each has 2
+// points, the normal of its face (zero for stand-alone edges), the index of
+// its top level group (-1 for loose geometry) and whether another group
+// already draws it. Arrays that are not needed may be NULL.
+XML_LOADER_EXPORT int XmlLoaderGetSegmentCount(const XmlLoaderModel* model);
+XML_LOADER_EXPORT int XmlLoaderGetSegments(const XmlLoaderModel* model,
+                                           float* points, float* normals,
+                                           int* groups,
+                                           unsigned char* duplicates,
+                                           int capacity);
+
+// Per segment, the color of its edge as 4 bytes RGBA and its layer, the
+// index in the Layers section (65535 if unknown), to pack into the vertices
+// of a single outline mesh. Arrays that are not needed may be NULL.
+XML_LOADER_EXPORT int XmlLoaderGetSegmentStyles(const XmlLoaderModel* model,
+                                                unsigned char* colors,
+                                                unsigned short* layers,
+                                                int capacity);
+
+// Top level component instances then groups, as indexed by the segments
+XML_LOADER_EXPORT int XmlLoaderGetGroupCount(const XmlLoaderModel* model);
+XML_LOADER_EXPORT int XmlLoaderGetGroupTransforms(const XmlLoaderModel* model,
+                                                  float* matrices,
+                                                  int capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKPTOXML_LOADER_XMLLOADER_H
@@ -0,0 +1,81 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <string.h>
+
+#include <vector>
+
+#include "./xmlconverterbackend.h"
+#include "../common/xmlfile.h"
+#include "../common/xmlglbwriter.h"
+#include "../common/xmlprocessutils.h"
+
+namespace {
+
+// Case insensitive check of the extension, dot included
+bool HasExtension(const std::string& path, const char* extension) {
+  size_t length = strlen(extension);
+  return path.size() > length &&
+         strcasecmp(path.c_str() + path.size() - length, extension) == 0;
+}
+
+std::string ReplaceExtension(const std::string& path, const char* extension) {
+  std::string result = path;
+  size_t dot = result.find_last_of('.');
+  size_t slash = result.find_last_of('/');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    result.erase(dot);
+  return result.append(extension);
+}
+
+} // end anonymous namespace
+
+bool CXmlToolBackend::Accepts(const std::string& path) const {
+  return HasExtension(path, ".skp");
+}
+
+std::string CXmlToolBackend::GetOutputPath(const std::string& input) const {
+  return ReplaceExtension(input, ".xml");
+}
+
+bool CXmlToolBackend::Convert(const std::string& input,
+                              const std::string& output,
+                              std::string& error) {
+  std::vector<std::vector<std::string> > commands(1);
+  commands[0].push_back(tool_);
+  commands[0].push_back(input);
+  commands[0].push_back(output);
+  if (!XmlProcessUtils::RunProcesses(commands)) {
+    error = tool_ + " failed";
+    return false;
+  }
+  return true;
+}
+
+bool CXmlSnapshotBackend::Accepts(const std::string& path) const {
+  return HasExtension(path, ".xml");
+}
+
+std::string CXmlSnapshotBackend::GetOutputPath(
+    const std::string& input) const {
+  return ReplaceExtension(input, ".glb");
+}
+
+bool CXmlSnapshotBackend::Convert(const std::string& input,
+                                  const std::string& output,
+                                  std::string& error) {
+  CXmlFile file;
+  XmlModelInfo model_info;
+  bool ok = file.Open(input, false) && file.GetModelInfo(model_info);
+  file.Close(true);
+  if (!ok) {
+    error = "not an exporter XML file";
+    return false;
+  }
+
+  CXmlGlbWriter writer(model_info);
+  if (!writer.Write(output)) {
+    error = "cannot write " + output;
+    return false;
+  }
+  return true;
+}
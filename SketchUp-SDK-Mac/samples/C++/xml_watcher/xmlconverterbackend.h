@@ -0,0 +1,55 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_WATCHER_XMLCONVERTERBACKEND_H
+#define SKPTOXML_WATCHER_XMLCONVERTERBACKEND_H
+
+#include <string>
+
+// CXmlConverterBackend - What the watch service runs on a settled file. It
+// picks the files it converts and where their output goes, and is called
+// from several worker threads at once.
+class CXmlConverterBackend {
+ public:
+  virtual ~CXmlConverterBackend() {}
+
+  // Whether the file at path is an input of this backend
+  virtual bool Accepts(const std::string& path) const = 0;
+
+  // Where the output of input is written
+  virtual std::string GetOutputPath(const std::string& input) const = 0;
+
+  // Converts input into output. Returns false and describes the failure in
+  // error if it could not.
+  virtual bool Convert(const std::string& input, const std::string& output,
+                       std::string& error) = 0;
+};
+
+// CXmlToolBackend - Exports .skp files to XML with the command line
+// exporter (skp_to_xml/cli), one process per file so that conversions
+// never share the SketchUp API.
+class CXmlToolBackend : public CXmlConverterBackend {
+ public:
+  explicit CXmlToolBackend(const std::string& tool) : tool_(tool) {}
+
+  bool Accepts(const std::string& path) const;
+  std::string GetOutputPath(const std::string& input) const;
+  bool Convert(const std::string& input, const std::string& output,
+               std::string& error);
+
+ private:
+  std::string tool_;
+};
+
+// CXmlSnapshotBackend - Stand-in for machines without the SketchUp SDK.
+// Reads XML snapshots written by the exporter and writes their binary glTF
+// next to them, which goes through the same reading and writing code as a
+// real export's later passes.
+class CXmlSnapshotBackend : public CXmlConverterBackend {
+ public:
+  bool Accepts(const std::string& path) const;
+  std::string GetOutputPath(const std::string& input) const;
+  bool Convert(const std::string& input, const std::string& output,
+               std::string& error);
+};
+
+#endif // SKPTOXML_WATCHER_XMLCONVERTERBACKEND_H
@@ -0,0 +1,261 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+
+#include "./xmldirwatcher.h"
+
+// Default time between two scans when polling
+static const int kDefaultPollIntervalMs = 1000;
+
+namespace {
+
+bool IsHidden(const char* name) {
+  return name[0] == '.';
+}
+
+std::string JoinPath(const std::string& directory, const char* name) {
+  if (!directory.empty() && directory[directory.size() - 1] == '/')
+    return directory + name;
+  return directory + "/" + name;
+}
+
+double NowSeconds() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec * 1.0e-6;
+}
+
+} // end anonymous namespace
+
+CXmlDirectoryWatcher::CXmlDirectoryWatcher()
+  : poll_interval_ms_(kDefaultPollIntervalMs),
+    fd_(-1),
+    last_scan_(0.0) {
+}
+
+CXmlDirectoryWatcher::~CXmlDirectoryWatcher() {
+  Close();
+}
+
+bool CXmlDirectoryWatcher::Open(const std::string& root) {
+  Close();
+  struct stat info;
+  if (stat(root.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    return false;
+  root_ = root;
+
+#ifdef __linux__
+  fd_ = inotify_init();
+  if (fd_ < 0)
+    return false;
+  AddDirectory(root_, NULL);
+  if (directories_.empty()) {
+    Close();
+    return false;
+  }
+#else
+  ScanFiles(root_, stamps_);
+  last_scan_ = NowSeconds();
+#endif
+  return true;
+}
+
+void CXmlDirectoryWatcher::Close() {
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+  directories_.clear();
+  stamps_.clear();
+}
+
+void CXmlDirectoryWatcher::ListFiles(const std::string& root,
+                                     std::vector<std::string>& paths) {
+  DIR* dir = opendir(root.c_str());
+  if (dir == NULL)
+    return;
+  std::vector<std::string> subdirectories;
+  struct dirent* entry = NULL;
+  while ((entry = readdir(dir)) != NULL) {
+    if (IsHidden(entry->d_name))
+      continue;
+    std::string path = JoinPath(root, entry->d_name);
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+      continue;
+    if (S_ISDIR(info.st_mode)) {
+      subdirectories.push_back(path);
+    } else if (S_ISREG(info.st_mode)) {
+      paths.push_back(path);
+    }
+  }
+  closedir(dir);
+  for (size_t i = 0; i < subdirectories.size(); ++i) {
+    ListFiles(subdirectories[i], paths);
+  }
+}
+
+void CXmlDirectoryWatcher::ScanFiles(
+    const std::string& root, std::map<std::string, CFileStamp>& stamps) {
+  std::vector<std::string> paths;
+  ListFiles(root, paths);
+  stamps.clear();
+  for (size_t i = 0; i < paths.size(); ++i) {
+    struct stat info;
+    if (stat(paths[i].c_str(), &info) != 0)
+      continue;
+    CFileStamp stamp;
+    stamp.size_ = info.st_size;
+#ifdef __APPLE__
+    stamp.mtime_ = info.st_mtimespec.tv_sec;
+    stamp.mtime_nsec_ = info.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime_ = info.st_mtim.tv_sec;
+    stamp.mtime_nsec_ = info.st_mtim.tv_nsec;
+#endif
+    stamps[paths[i]] = stamp;
+  }
+}
+
+#ifdef __linux__
+
+// Watches path and the directories below it. The files already in them are
+// appended to paths, if given, for directories that appear while watching.
+void CXmlDirectoryWatcher::AddDirectory(const std::string& path,
+                                        std::vector<std::string>* paths) {
+  static const uint32_t kMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                                IN_DELETE_SELF | IN_MOVE_SELF;
+  int wd = inotify_add_watch(fd_, path.c_str(), kMask);
+  if (wd < 0)
+    return;
+  directories_[wd] = path;
+
+  DIR* dir = opendir(path.c_str());
+  if (dir == NULL)
+    return;
+  std::vector<std::string> subdirectories;
+  struct dirent* entry = NULL;
+  while ((entry = readdir(dir)) != NULL) {
+    if (IsHidden(entry->d_name))
+      continue;
+    std::string child = JoinPath(path, entry->d_name);
+    struct stat info;
+    if (stat(child.c_str(), &info) != 0)
+      continue;
+    if (S_ISDIR(info.st_mode)) {
+      subdirectories.push_back(child);
+    } else if (S_ISREG(info.st_mode) && paths != NULL) {
+      paths->push_back(child);
+    }
+  }
+  closedir(dir);
+  for (size_t i = 0; i < subdirectories.size(); ++i) {
+    AddDirectory(subdirectories[i], paths);
+  }
+}
+
+bool CXmlDirectoryWatcher::Wait(int timeout_ms,
+                                std::vector<std::string>& paths) {
+  if (fd_ < 0)
+    return false;
+  struct pollfd descriptor = { fd_, POLLIN, 0 };
+  int ready = poll(&descriptor, 1, timeout_ms);
+  if (ready < 0)
+    return errno == EINTR;
+  if (ready == 0)
+    return true;
+
+  // Events are aligned on their header, the buffer holds many
+  char buffer[64 * 1024]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length = read(fd_, buffer, sizeof(buffer));
+  if (length < 0)
+    return errno == EINTR || errno == EAGAIN;
+
+  bool overflow = false;
+  for (char* p = buffer; p < buffer + length;) {
+    const struct inotify_event* event =
+        reinterpret_cast<const struct inotify_event*>(p);
+    p += sizeof(struct inotify_event) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW) {
+      overflow = true;
+      continue;
+    }
+    std::map<int, std::string>::iterator directory =
+        directories_.find(event->wd);
+    if (event->mask & IN_IGNORED) {
+      if (directory != directories_.end())
+        directories_.erase(directory);
+      continue;
+    }
+    if (directory == directories_.end() || event->len == 0 ||
+        IsHidden(event->name)) {
+      continue;
+    }
+
+    std::string path = JoinPath(directory->second, event->name);
+    if (event->mask & IN_ISDIR) {
+      if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        AddDirectory(path, &paths);
+    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      paths.push_back(path);
+    }
+  }
+
+  // Events were dropped, so report every file again and watch the
+  // directories that may have been created meanwhile. Watching a directory
+  // twice keeps its watch.
+  if (overflow && !directories_.empty())
+    AddDirectory(root_, &paths);
+
+  // The root itself went away
+  return !directories_.empty();
+}
+
+#else
+
+void CXmlDirectoryWatcher::AddDirectory(const std::string& path,
+                                        std::vector<std::string>* paths) {
+}
+
+bool CXmlDirectoryWatcher::Wait(int timeout_ms,
+                                std::vector<std::string>& paths) {
+  // Scans at most once per poll interval
+  double due = last_scan_ + poll_interval_ms_ * 1.0e-3;
+  double sleep_ms = std::min(static_cast<double>(timeout_ms),
+                             (due - NowSeconds()) * 1.0e3);
+  if (sleep_ms > 0.0)
+    usleep(static_cast<useconds_t>(sleep_ms * 1.0e3));
+  if (NowSeconds() < due)
+    return true;
+
+  struct stat info;
+  if (stat(root_.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    return false;
+
+  std::map<std::string, CFileStamp> stamps;
+  ScanFiles(root_, stamps);
+  std::map<std::string, CFileStamp>::const_iterator it = stamps.begin();
+  for (; it != stamps.end(); ++it) {
+    std::map<std::string, CFileStamp>::const_iterator previous =
+        stamps_.find(it->first);
+    if (previous == stamps_.end() || previous->second != it->second)
+      paths.push_back(it->first);
+  }
+  stamps_.swap(stamps);
+  last_scan_ = NowSeconds();
+  return true;
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_WATCHER_XMLDIRWATCHER_H
+#define SKPTOXML_WATCHER_XMLDIRWATCHER_H
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// CXmlDirectoryWatcher - Reports the files written in a directory tree. On
+// Linux it uses inotify, with a watch on every directory, and picks up the
+// directories created later. Elsewhere it compares the modification times
+// and sizes of the files every poll interval. A file may be reported several
+// times while it is being written, callers wait for it to settle.
+class CXmlDirectoryWatcher {
+ public:
+  CXmlDirectoryWatcher();
+  ~CXmlDirectoryWatcher();
+
+  // Starts watching root and everything below it. Returns false if root
+  // cannot be watched.
+  bool Open(const std::string& root);
+  void Close();
+
+  // Waits up to timeout_ms for changes and appends the paths of the files
+  // written, created or moved in, possibly more than once. Returns false if
+  // the watch was lost.
+  bool Wait(int timeout_ms, std::vector<std::string>& paths);
+
+  // Appends the regular files below root, hidden ones excepted
+  static void ListFiles(const std::string& root,
+                        std::vector<std::string>& paths);
+
+  // Time between two scans when polling
+  void set_poll_interval_ms(int ms) { poll_interval_ms_ = ms; }
+
+ private:
+  // Size and modification time, to tell changed files when polling
+  struct CFileStamp {
+    off_t size_;
+    time_t mtime_;
+    long mtime_nsec_;
+
+    bool operator!=(const CFileStamp& other) const {
+      return size_ != other.size_ || mtime_ != other.mtime_ ||
+             mtime_nsec_ != other.mtime_nsec_;
+    }
+  };
+
+  void AddDirectory(const std::string& path, std::vector<std::string>* paths);
+  static void ScanFiles(const std::string& root,
+                        std::map<std::string, CFileStamp>& stamps);
+
+ private:
+  std::string root_;
+  int poll_interval_ms_;
+  // inotify descriptor and the directory of each watch, -1 when polling
+  int fd_;
+  std::map<int, std::string> directories_;
+  // Files seen by the last scan when polling, and when it ran
+  std::map<std::string, CFileStamp> stamps_;
+  double last_scan_;
+};
+
+#endif // SKPTOXML_WATCHER_XMLDIRWATCHER_H
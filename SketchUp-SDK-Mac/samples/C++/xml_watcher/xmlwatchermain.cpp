@@ -0,0 +1,93 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+// Watch folder service: converts the models saved under a directory as they
+// settle, see CXmlWatchService.
+//
+//   skptoxmlwatch [-jobs N] [-queue N] [-debounce MS] [-status FILE]
+//                 [-tool PATH | -snapshots] DIR
+//
+// -tool names the command line exporter (skptoxml in the PATH by default).
+// -snapshots converts the XML files under DIR to glTF instead, to try the
+// service out where the SketchUp SDK is not available.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "./xmlconverterbackend.h"
+#include "./xmlwatchservice.h"
+
+static CXmlWatchService* g_service = NULL;
+
+static void HandleSignal(int) {
+  if (g_service != NULL)
+    g_service->Stop();
+}
+
+static int PrintUsage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-jobs N] [-queue N] [-debounce MS] [-status FILE]\n"
+          "       [-tool PATH | -snapshots] DIR\n", program);
+  return 2;
+}
+
+int main(int argc, char* argv[]) {
+  int num_workers = 2;
+  size_t queue_capacity = 16;
+  int debounce_ms = 2000;
+  std::string status_file;
+  std::string tool("skptoxml");
+  bool snapshots = false;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+    bool has_value = arg + 1 < argc;
+    if (strcmp(argv[arg], "-jobs") == 0 && has_value) {
+      num_workers = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-queue") == 0 && has_value) {
+      queue_capacity = strtoul(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "-debounce") == 0 && has_value) {
+      debounce_ms = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-status") == 0 && has_value) {
+      status_file = argv[++arg];
+    } else if (strcmp(argv[arg], "-tool") == 0 && has_value) {
+      tool = argv[++arg];
+    } else if (strcmp(argv[arg], "-snapshots") == 0) {
+      snapshots = true;
+    } else {
+      return PrintUsage(argv[0]);
+    }
+  }
+  if (argc - arg != 1 || num_workers < 1 || queue_capacity < 1 ||
+      debounce_ms < 0) {
+    return PrintUsage(argv[0]);
+  }
+
+  CXmlToolBackend tool_backend(tool);
+  CXmlSnapshotBackend snapshot_backend;
+  CXmlConverterBackend& backend = snapshots ?
+      static_cast<CXmlConverterBackend&>(snapshot_backend) :
+      static_cast<CXmlConverterBackend&>(tool_backend);
+
+  CXmlWatchService service(backend);
+  service.set_num_workers(num_workers);
+  service.set_queue_capacity(queue_capacity);
+  service.set_debounce_ms(debounce_ms);
+  if (!status_file.empty())
+    service.set_status_file(status_file);
+
+  g_service = &service;
+  signal(SIGINT, HandleSignal);
+  signal(SIGTERM, HandleSignal);
+  bool ok = service.Run(argv[arg]);
+  g_service = NULL;
+
+  if (!ok) {
+    fprintf(stderr, "%s: cannot watch %s\n", argv[0], argv[arg]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,391 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "./xmlwatchservice.h"
+#include "./xmldirwatcher.h"
+
+// Longest wait for file changes, so that Stop and freed queue slots are
+// noticed in time
+static const int kMaxWaitMs = 250;
+// Status file updates while nothing else happens, for the settling counts
+static const double kStatusInterval = 1.0;
+// Results listed in the status file
+static const size_t kMaxRecentResults = 32;
+
+static const int kDefaultNumWorkers = 2;
+static const size_t kDefaultQueueCapacity = 16;
+static const int kDefaultDebounceMs = 2000;
+
+namespace {
+
+double NowSeconds() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec * 1.0e-6;
+}
+
+bool FileExists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// 64 bit FNV-1a of the file contents
+bool HashFile(const std::string& path, uint64_t& hash) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+    return false;
+  hash = 14695981039346656037ULL;
+  unsigned char buffer[64 * 1024];
+  size_t length = 0;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    for (size_t i = 0; i < length; ++i) {
+      hash = (hash ^ buffer[i]) * 1099511628211ULL;
+    }
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+void AppendJsonString(std::string& json, const std::string& value) {
+  json += '"';
+  for (size_t i = 0; i < value.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(value[i]);
+    if (c == '"' || c == '\\') {
+      json += '\\';
+      json += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      json += escaped;
+    } else {
+      json += static_cast<char>(c);
+    }
+  }
+  json += '"';
+}
+
+// Appends separator, then the key and the value as "key": value
+void AppendJsonNumber(std::string& json, const char* separator,
+                      const char* key, double value, const char* format) {
+  char number[64];
+  snprintf(number, sizeof(number), format, value);
+  json += separator;
+  json += '"';
+  json += key;
+  json += "\": ";
+  json += number;
+}
+
+// Writes through a temporary file so that readers never see half of it
+bool ReplaceFile(const std::string& path, const std::string& contents) {
+  std::string temporary = path + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if (file == NULL)
+    return false;
+  bool ok = fwrite(contents.data(), 1, contents.size(), file) ==
+            contents.size();
+  ok &= fclose(file) == 0;
+  return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+} // end anonymous namespace
+
+CXmlWatchService::CXmlWatchService(CXmlConverterBackend& backend)
+  : backend_(backend),
+    num_workers_(kDefaultNumWorkers),
+    queue_capacity_(kDefaultQueueCapacity),
+    debounce_ms_(kDefaultDebounceMs),
+    stop_(0),
+    stopping_(false),
+    cache_dirty_(false),
+    status_dirty_(false),
+    num_converted_(0),
+    num_skipped_(0),
+    num_failed_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+}
+
+CXmlWatchService::~CXmlWatchService() {
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool CXmlWatchService::Run(const std::string& root) {
+  CXmlDirectoryWatcher watcher;
+  if (!watcher.Open(root))
+    return false;
+  if (status_file_.empty())
+    status_file_ = root + "/.skptoxml_status.json";
+  if (cache_file_.empty())
+    cache_file_ = root + "/.skptoxml_cache";
+  LoadCache();
+
+  stop_ = 0;
+  stopping_ = false;
+  std::vector<pthread_t> threads;
+  for (int i = 0; i < std::max(num_workers_, 1); ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, WorkerMain, this) == 0)
+      threads.push_back(thread);
+  }
+
+  // The files already there are due at once, the cache skips the ones
+  // converted before
+  double now = NowSeconds();
+  std::vector<std::string> paths;
+  CXmlDirectoryWatcher::ListFiles(root, paths);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (backend_.Accepts(paths[i]))
+      pending_[paths[i]] = now - debounce_ms_ * 1.0e-3;
+  }
+
+  bool watching = !threads.empty();
+  double last_status = 0.0;
+  while (watching && !stop_) {
+    now = NowSeconds();
+    double next = Schedule(now);
+    pthread_mutex_lock(&mutex_);
+    bool status_dirty = status_dirty_;
+    bool cache_dirty = cache_dirty_;
+    pthread_mutex_unlock(&mutex_);
+    if (status_dirty || now - last_status >= kStatusInterval) {
+      if (cache_dirty)
+        SaveCache();
+      WriteStatus(root, now);
+      last_status = now;
+    }
+
+    int timeout_ms = kMaxWaitMs;
+    if (next >= 0.0)
+      timeout_ms = std::min(timeout_ms, static_cast<int>(next * 1.0e3) + 1);
+    paths.clear();
+    watching = watcher.Wait(timeout_ms, paths);
+    now = NowSeconds();
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (backend_.Accepts(paths[i]))
+        pending_[paths[i]] = now;
+    }
+  }
+
+  // Conversions under way finish, the queued ones are left for next time
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  queue_.clear();
+  busy_.clear();
+  SaveCache();
+  WriteStatus(root, NowSeconds());
+  return watching;
+}
+
+double CXmlWatchService::Schedule(double now) {
+  double debounce = debounce_ms_ * 1.0e-3;
+  double next = -1.0;
+  pthread_mutex_lock(&mutex_);
+  std::map<std::string, double>::iterator it = pending_.begin();
+  while (it != pending_.end()) {
+    double settles = it->second + debounce - now;
+    // A file changed again while busy waits for the conversion to end
+    if (settles > 0.0 || queue_.size() >= queue_capacity_ ||
+        busy_.count(it->first) != 0) {
+      if (settles > 0.0 && (next < 0.0 || settles < next))
+        next = settles;
+      ++it;
+      continue;
+    }
+    CJob job;
+    job.path_ = it->first;
+    job.queued_ = now;
+    queue_.push_back(job);
+    busy_.insert(it->first);
+    pending_.erase(it++);
+    status_dirty_ = true;
+    pthread_cond_signal(&cond_);
+  }
+  pthread_mutex_unlock(&mutex_);
+  return next;
+}
+
+void* CXmlWatchService::WorkerMain(void* param) {
+  static_cast<CXmlWatchService*>(param)->RunWorker();
+  return NULL;
+}
+
+void CXmlWatchService::RunWorker() {
+  pthread_mutex_lock(&mutex_);
+  for (;;) {
+    while (queue_.empty() && !stopping_) {
+      pthread_cond_wait(&cond_, &mutex_);
+    }
+    if (stopping_)
+      break;
+    CJob job = queue_.front();
+    queue_.pop_front();
+    pthread_mutex_unlock(&mutex_);
+    ProcessJob(job);
+    pthread_mutex_lock(&mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlWatchService::ProcessJob(const CJob& job) {
+  CResult result;
+  result.path_ = job.path_;
+  result.skipped_ = false;
+  result.ok_ = false;
+  double started = NowSeconds();
+  result.wait_ = started - job.queued_;
+
+  std::string output = backend_.GetOutputPath(job.path_);
+  uint64_t hash = 0;
+  bool hashed = HashFile(job.path_, hash);
+  bool cached = false;
+  if (hashed) {
+    pthread_mutex_lock(&mutex_);
+    std::map<std::string, uint64_t>::const_iterator it =
+        hashes_.find(job.path_);
+    cached = it != hashes_.end() && it->second == hash;
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  if (!hashed) {
+    result.error_ = "cannot read the file";
+  } else if (cached && FileExists(output)) {
+    result.skipped_ = true;
+    result.ok_ = true;
+  } else {
+    result.ok_ = backend_.Convert(job.path_, output, result.error_);
+  }
+  result.convert_ = NowSeconds() - started;
+
+  pthread_mutex_lock(&mutex_);
+  if (result.skipped_) {
+    num_skipped_++;
+  } else if (result.ok_) {
+    num_converted_++;
+    hashes_[job.path_] = hash;
+    cache_dirty_ = true;
+  } else {
+    num_failed_++;
+  }
+  if (result.ok_) {
+    failures_.erase(job.path_);
+  } else {
+    failures_[job.path_] = result.error_;
+  }
+  recent_.push_front(result);
+  if (recent_.size() > kMaxRecentResults)
+    recent_.pop_back();
+  busy_.erase(job.path_);
+  status_dirty_ = true;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CXmlWatchService::LoadCache() {
+  hashes_.clear();
+  FILE* file = fopen(cache_file_.c_str(), "r");
+  if (file == NULL)
+    return;
+  // One line per file: hash in hex, a space and the path
+  char line[4096];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    std::string text(line);
+    while (!text.empty() && (text[text.size() - 1] == '\n' ||
+                             text[text.size() - 1] == '\r')) {
+      text.erase(text.size() - 1);
+    }
+    size_t space = text.find(' ');
+    if (space == std::string::npos || space + 1 >= text.size())
+      continue;
+    hashes_[text.substr(space + 1)] =
+        strtoull(text.substr(0, space).c_str(), NULL, 16);
+  }
+  fclose(file);
+}
+
+void CXmlWatchService::SaveCache() {
+  std::string contents;
+  pthread_mutex_lock(&mutex_);
+  std::map<std::string, uint64_t>::const_iterator it = hashes_.begin();
+  for (; it != hashes_.end(); ++it) {
+    char hash[32];
+    snprintf(hash, sizeof(hash), "%016llx ",
+             static_cast<unsigned long long>(it->second));
+    contents += hash;
+    contents += it->first;
+    contents += '\n';
+  }
+  cache_dirty_ = false;
+  pthread_mutex_unlock(&mutex_);
+  if (!ReplaceFile(cache_file_, contents))
+    fprintf(stderr, "cannot write %s\n", cache_file_.c_str());
+}
+
+void CXmlWatchService::WriteStatus(const std::string& root, double now) {
+  // Files not queued yet, split into those still changing and those
+  // waiting for room in the queue
+  double debounce = debounce_ms_ * 1.0e-3;
+  size_t num_settling = 0;
+  std::map<std::string, double>::const_iterator pending = pending_.begin();
+  for (; pending != pending_.end(); ++pending) {
+    if (now - pending->second < debounce)
+      num_settling++;
+  }
+
+  std::string json("{\n  \"root\": ");
+  AppendJsonString(json, root);
+  pthread_mutex_lock(&mutex_);
+  AppendJsonNumber(json, ",\n  ", "settling", num_settling, "%.0f");
+  AppendJsonNumber(json, ",\n  ", "waiting",
+                   pending_.size() - num_settling, "%.0f");
+  AppendJsonNumber(json, ",\n  ", "queued", queue_.size(), "%.0f");
+  AppendJsonNumber(json, ",\n  ", "converting", busy_.size() - queue_.size(),
+                   "%.0f");
+  AppendJsonNumber(json, ",\n  ", "converted", num_converted_, "%.0f");
+  AppendJsonNumber(json, ",\n  ", "skipped", num_skipped_, "%.0f");
+  AppendJsonNumber(json, ",\n  ", "failed", num_failed_, "%.0f");
+
+  json += ",\n  \"recent\": [";
+  for (size_t i = 0; i < recent_.size(); ++i) {
+    const CResult& result = recent_[i];
+    json += i == 0 ? "\n    {\"path\": " : ",\n    {\"path\": ";
+    AppendJsonString(json, result.path_);
+    json += ", \"result\": ";
+    json += result.skipped_ ? "\"skipped\"" :
+            result.ok_ ? "\"converted\"" : "\"failed\"";
+    AppendJsonNumber(json, ", ", "wait_ms", result.wait_ * 1.0e3, "%.1f");
+    AppendJsonNumber(json, ", ", "convert_ms", result.convert_ * 1.0e3, "%.1f");
+    json += "}";
+  }
+  json += recent_.empty() ? "]" : "\n  ]";
+
+  json += ",\n  \"failures\": [";
+  std::map<std::string, std::string>::const_iterator failure =
+      failures_.begin();
+  for (; failure != failures_.end(); ++failure) {
+    json += failure == failures_.begin() ? "\n    {\"path\": " :
+                                           ",\n    {\"path\": ";
+    AppendJsonString(json, failure->first);
+    json += ", \"error\": ";
+    AppendJsonString(json, failure->second);
+    json += "}";
+  }
+  json += failures_.empty() ? "]" : "\n  ]";
+  json += "\n}\n";
+  status_dirty_ = false;
+  pthread_mutex_unlock(&mutex_);
+
+  ReplaceFile(status_file_, json);
+}
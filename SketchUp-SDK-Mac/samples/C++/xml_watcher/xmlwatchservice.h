@@ -0,0 +1,107 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_WATCHER_XMLWATCHSERVICE_H
+#define SKPTOXML_WATCHER_XMLWATCHSERVICE_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "./xmlconverterbackend.h"
+
+// CXmlWatchService - Keeps the outputs of the files in a directory tree up
+// to date. A file the backend accepts is converted once it has not changed
+// for the debounce time, by a fixed set of worker threads fed from a bounded
+// queue. Settled files that do not fit in the queue wait for a free slot. A
+// content hash of each converted input is kept in a cache file, so that
+// files saved without changes, or found again after a restart, are skipped.
+// The backlog, the latency of the latest files and the failures are written
+// to a JSON status file.
+class CXmlWatchService {
+ public:
+  explicit CXmlWatchService(CXmlConverterBackend& backend);
+  ~CXmlWatchService();
+
+  // Converts the files already in root, then watches it until Stop is
+  // called. Returns false if root cannot be watched or the watch was lost.
+  bool Run(const std::string& root);
+
+  // Makes Run return once the conversions under way are done. Safe to call
+  // from a signal handler.
+  void Stop() { stop_ = 1; }
+
+  void set_num_workers(int num) { num_workers_ = num; }
+  void set_queue_capacity(size_t capacity) { queue_capacity_ = capacity; }
+  // Time a file must stay unchanged before it is converted
+  void set_debounce_ms(int ms) { debounce_ms_ = ms; }
+  // Default to .skptoxml_status.json and .skptoxml_cache in the root
+  void set_status_file(const std::string& path) { status_file_ = path; }
+  void set_cache_file(const std::string& path) { cache_file_ = path; }
+
+ private:
+  struct CJob {
+    std::string path_;
+    double queued_;
+  };
+
+  // Times in seconds, from queueing to the start of the conversion and
+  // from there to its end
+  struct CResult {
+    std::string path_;
+    bool skipped_;
+    bool ok_;
+    std::string error_;
+    double wait_;
+    double convert_;
+  };
+
+  static void* WorkerMain(void* param);
+  void RunWorker();
+  void ProcessJob(const CJob& job);
+
+  // Moves the settled files into the queue while it has room. Returns the
+  // time until the next file settles, -1 if none is waiting.
+  double Schedule(double now);
+
+  void LoadCache();
+  void SaveCache();
+  void WriteStatus(const std::string& root, double now);
+
+ private:
+  CXmlConverterBackend& backend_;
+  int num_workers_;
+  size_t queue_capacity_;
+  int debounce_ms_;
+  std::string status_file_;
+  std::string cache_file_;
+  volatile sig_atomic_t stop_;
+
+  // Main thread only: the time of the last change of each file not queued
+  std::map<std::string, double> pending_;
+
+  // Shared with the workers, under mutex_
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  bool stopping_;
+  std::deque<CJob> queue_;
+  // Files queued or being converted
+  std::set<std::string> busy_;
+  std::map<std::string, uint64_t> hashes_;
+  bool cache_dirty_;
+  bool status_dirty_;
+  size_t num_converted_;
+  size_t num_skipped_;
+  size_t num_failed_;
+  // Latest first
+  std::deque<CResult> recent_;
+  // Files whose last conversion failed, with the error
+  std::map<std::string, std::string> failures_;
+};
+
+#endif // SKPTOXML_WATCHER_XMLWATCHSERVICE_H
@@ -14,6 +14,7 @@ public class ModelPostProcessor : AssetPostprocessor {
 	public GameObject linesObject;
 
 	public Edge[] edges;
+	private Dictionary<string,XmlNode> definitions;
 
 	public static string savePath ="Assets/Within/Resources/Models/LinesMeshes/";
 	public static string materialPath ="Assets/Within/Resources/Materials/BaseLine.mat";
@@ -59,7 +60,7 @@ public class ModelPostProcessor : AssetPostprocessor {
 	}
 
 
-	void writeFace(XmlNode xmlFace,Vector3 offset,List<Edge> edgeList)
+	void writeFace(XmlNode xmlFace,Vector3 offset,List<Edge> edgeList,ref int segmentIndex,bool[] duplicates)
 	{
 		XmlNodeList faceChilds = xmlFace.ChildNodes;
 		foreach(XmlNode faceChild in faceChilds)
@@ -95,7 +96,10 @@ public class ModelPostProcessor : AssetPostprocessor {
 						}
 						
 						e.normal = norm;
-						edgeList.Add(e);
+						// Skip sides another group already draws
+						bool duplicate = duplicates != null && segmentIndex < duplicates.Length && duplicates[segmentIndex];
+						segmentIndex++;
+						if(!duplicate) edgeList.Add(e);
 					}
 				}
 				if(faceChild.Name == "Triangles")
@@ -115,18 +119,142 @@ public class ModelPostProcessor : AssetPostprocessor {
 		} 
 	}
 
+	// Outline segments the exporter flagged as drawn by another group or as
+	// hidden by the export hints, one per loop side and edge in document
+	// order. Null if the file has neither table.
+	bool[] readDuplicateOutlines(XmlDocument xmlDoc)
+	{
+		bool[] duplicates = readOutlineFlags(xmlDoc, "DuplicateOutlines");
+		bool[] hidden = readOutlineFlags(xmlDoc, "HiddenOutlines");
+		if(duplicates == null) return hidden;
+		if(hidden == null) return duplicates;
+
+		for(int i=0;i<duplicates.Length && i<hidden.Length;i++)
+		{
+			duplicates[i] = duplicates[i] || hidden[i];
+		}
+		return duplicates;
+	}
+
+	bool[] readOutlineFlags(XmlDocument xmlDoc, string tag)
+	{
+		XmlNodeList list = xmlDoc.GetElementsByTagName(tag);
+		if(list.Count == 0) return null;
+
+		int count = int.Parse(list[0].Attributes["Count"].Value);
+		string bits = list[0].Attributes["Bits"].Value;
+		bool[] flags = new bool[count];
+		for(int i=0;i<count;i++)
+		{
+			int value = System.Convert.ToInt32(bits.Substring((i/8)*2,2),16);
+			flags[i] = (value & (1 << (i%8))) != 0;
+		}
+		return flags;
+	}
+
+	// Component definitions by name, for the segments of their instances.
+	// Models of a package only name them, each is in a file of its own in
+	// the store directory next to the model.
+	Dictionary<string,XmlNode> readDefinitions(XmlDocument xmlDoc, string path)
+	{
+		Dictionary<string,XmlNode> result = new Dictionary<string,XmlNode>();
+		XmlNodeList list = xmlDoc.GetElementsByTagName("ComponentDefinitions");
+		if(list.Count == 0) return result;
+
+		XmlAttribute store = list[0].Attributes["Store"];
+		foreach(XmlNode definition in list[0].ChildNodes)
+		{
+			if(definition.Name != "ComponentDefinition") continue;
+			string name = definition.Attributes["Name"].Value;
+			XmlNode node = definition;
+			if(store != null && !definition.HasChildNodes)
+			{
+				string file = path.Substring(0,path.LastIndexOf("/")+1)+store.Value+"/"+name+".xml";
+				if(!File.Exists(file)) continue;
+				XmlDocument storeDoc = new XmlDocument();
+				storeDoc.Load(file);
+				node = storeDoc.DocumentElement;
+			}
+			if(!result.ContainsKey(name)) result.Add(name,node);
+		}
+		return result;
+	}
+
+	// Number of outline segments the exporter counts for elements that are not
+	// drawn here, so that the flags stay in step. Instances count the
+	// segments of their definition.
+	int countSegments(XmlNode node)
+	{
+		return countSegments(node,0);
+	}
+
+	int countSegments(XmlNode node, int depth)
+	{
+		if(node.Name == "Edge") return 1;
+		if(depth > 64) return 0;
+		if(node.Name == "ComponentInstance")
+		{
+			XmlNode reference = node["ComponentDefinition"];
+			XmlNode definition;
+			if(reference == null || reference.Attributes["Name"] == null ||
+			   !definitions.TryGetValue(reference.Attributes["Name"].Value,out definition))
+				return 0;
+			return countSegments(definition,depth+1);
+		}
+		int count = 0;
+		foreach(XmlNode child in node.ChildNodes)
+		{
+			if(node.Name == "Face")
+			{
+				if(child.Name == "Loop" && child.ChildNodes.Count >= 2) count += child.ChildNodes.Count;
+			}
+			else if(node.Name == "Group" || node.Name == "ComponentDefinition")
+			{
+				count += countSegments(child,depth+1);
+			}
+			else if(node.Name == "Curve")
+			{
+				count += countSegments(child,depth);
+			}
+		}
+		return count;
+	}
+
 	void CreateOutlines(GameObject obj)
 	{
 
 		//Lineify ln = obj.AddComponent<Lineify>();
 
 
+		// The exporter writes the lines mesh straight into savePath when it
+		// knows the project, only the object referencing it is left to make
+		Mesh prebuilt = AssetDatabase.LoadAssetAtPath(savePath+obj.name+"_Lines_newLines.asset",typeof(Mesh)) as Mesh;
+		if(prebuilt != null)
+		{
+			MakeLinesObject(obj);
+			linesObject.GetComponent<MeshFilter>().sharedMesh = prebuilt;
+			return;
+		}
+
 		List<Edge> edges = new List<Edge>();
-		XmlDocument xmlDoc = new XmlDocument(); 
 		int pos = assetPath.LastIndexOf("/")+1;
 		string path = assetPath.Substring(0,pos)+obj.name+".xml";
 		Debug.Log(path);
 
+		// The native loader hands the outlines over in bulk, reading the XML
+		// here is the fallback when the plugin is not installed
+		Edge[] nativeEdges = XmlLoader.ReadOutlines(path);
+		if(nativeEdges != null)
+			edges.AddRange(nativeEdges);
+		else
+			readOutlines(path,edges);
+
+		CreateLinesObject(obj,edges);
+	}
+
+	void readOutlines(string path,List<Edge> edges)
+	{
+		XmlDocument xmlDoc = new XmlDocument(); 
 		TextAsset sr = Resources.LoadAssetAtPath<TextAsset>(path) as TextAsset;
 		string xmlText = sr.text;
 		xmlText = xmlText.Insert(0,"<Document>\n");
@@ -137,6 +265,9 @@ public class ModelPostProcessor : AssetPostprocessor {
 		xmlDoc.LoadXml(xmlText);
 
 		XmlNodeList topLevelList = xmlDoc.GetElementsByTagName("Geometry")[0].ChildNodes;
+		bool[] duplicates = readDuplicateOutlines(xmlDoc);
+		definitions = readDefinitions(xmlDoc,path);
+		int segmentIndex = 0;
 
 		foreach (XmlNode topLevel in topLevelList)
 		{
@@ -151,23 +282,43 @@ public class ModelPostProcessor : AssetPostprocessor {
 
 				foreach(XmlNode face in topLevel.ChildNodes)
 				{
-					writeFace(face,offset,edges);
+					if(face.Name == "Face")
+						writeFace(face,offset,edges,ref segmentIndex,duplicates);
+					else
+						segmentIndex += countSegments(face);
 				}
 
 			}
-			if(topLevel.Name == "Face")
+			else if(topLevel.Name == "Face")
+			{
+				writeFace(topLevel,offset,edges,ref segmentIndex,duplicates);
+			}
+			else
 			{
-				writeFace(topLevel,offset,edges);
+				segmentIndex += countSegments(topLevel);
 			}
 			    
 		}
+	}
 
-		GameObject linesGo = new GameObject();
-		linesGo.name = obj.name+"_Lines";
-		MeshFilter mf = linesGo.AddComponent<MeshFilter>();
+	void CreateLinesObject(GameObject obj,List<Edge> edges)
+	{
+		MakeLinesObject(obj);
+		MeshFilter mf = linesObject.GetComponent<MeshFilter>();
 		mf.sharedMesh = new Mesh();
 		mf.sharedMesh.name = "Lines_" + obj.name;
 
+		this.edges = edges.ToArray();
+		GenerateLines();
+		SaveMesh();
+	}
+
+	void MakeLinesObject(GameObject obj)
+	{
+		GameObject linesGo = new GameObject();
+		linesGo.name = obj.name+"_Lines";
+		linesGo.AddComponent<MeshFilter>();
+
 		linesGo.transform.localPosition = Vector3.zero;
 		linesGo.transform.localRotation = Quaternion.Euler(new Vector3(90,0,0));
 		linesGo.transform.localScale = new Vector3(-1,-1,-1);
@@ -176,10 +327,6 @@ public class ModelPostProcessor : AssetPostprocessor {
 		linesGo.renderer.material = AssetDatabase.LoadAssetAtPath(materialPath,typeof(Material)) as Material;
 		linesGo.transform.parent = obj.transform.root;
 		linesObject = linesGo;
-
-		this.edges = edges.ToArray();
-		GenerateLines();
-		SaveMesh();
 	}
 	
 	private void SaveMesh()
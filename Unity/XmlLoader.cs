@@ -0,0 +1,139 @@
+﻿using UnityEngine;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+
+// Bindings to the XmlLoader native plugin (xml_loader/xmlloader.h), which
+// reads an export with the exporter's own C++ reader and hands the geometry
+// over in a few bulk copies.
+public static class XmlLoader {
+
+	const string library = "XmlLoader";
+
+	[DllImport(library)] static extern IntPtr XmlLoaderOpen(string filename);
+	[DllImport(library)] static extern void XmlLoaderClose(IntPtr model);
+	[DllImport(library)] static extern int XmlLoaderGetVertexCount(IntPtr model);
+	[DllImport(library)] static extern int XmlLoaderGetVertices(IntPtr model, float[] positions, float[] normals, int capacity);
+	[DllImport(library)] static extern int XmlLoaderGetIndexCount(IntPtr model);
+	[DllImport(library)] static extern int XmlLoaderGetIndices(IntPtr model, int[] indices, int capacity);
+	[DllImport(library)] static extern int XmlLoaderGetSegmentCount(IntPtr model);
+	[DllImport(library)] static extern int XmlLoaderGetSegments(IntPtr model, float[] points, float[] normals, int[] groups, byte[] duplicates, int capacity);
+	[DllImport(library)] static extern int XmlLoaderGetGroupCount(IntPtr model);
+	[DllImport(library)] static extern int XmlLoaderGetGroupTransforms(IntPtr model, float[] matrices, int capacity);
+
+	const float metersPerInch = 0.0254f;
+
+	// Opens an export, IntPtr.Zero if the plugin is not installed or the
+	// file cannot be read
+	static IntPtr Open(string path)
+	{
+		try
+		{
+			return XmlLoaderOpen(Path.GetFullPath(path));
+		}
+		catch(DllNotFoundException)
+		{
+			return IntPtr.Zero;
+		}
+		catch(EntryPointNotFoundException)
+		{
+			return IntPtr.Zero;
+		}
+	}
+
+	// Outline edges of the faces in meters, without the sides another group
+	// already draws. Null if the native loader cannot be used.
+	public static Edge[] ReadOutlines(string path)
+	{
+		IntPtr model = Open(path);
+		if(model == IntPtr.Zero) return null;
+		try
+		{
+			int count = XmlLoaderGetSegmentCount(model);
+			float[] points = new float[count*6];
+			float[] normals = new float[count*3];
+			byte[] duplicates = new byte[count];
+			count = XmlLoaderGetSegments(model,points,normals,null,duplicates,count);
+
+			List<Edge> edges = new List<Edge>(count);
+			for(int i=0;i<count;i++)
+			{
+				Vector3 normal = new Vector3(normals[i*3],normals[i*3+1],normals[i*3+2]);
+				// Stand-alone edges have no face normal and are not outlined
+				if(duplicates[i] != 0 || normal == Vector3.zero) continue;
+				Edge e = new Edge();
+				e.A = new Vector3(points[i*6],points[i*6+1],points[i*6+2]) * metersPerInch;
+				e.B = new Vector3(points[i*6+3],points[i*6+4],points[i*6+5]) * metersPerInch;
+				e.normal = normal;
+				edges.Add(e);
+			}
+			return edges.ToArray();
+		}
+		finally
+		{
+			XmlLoaderClose(model);
+		}
+	}
+
+	// The faces as one triangle mesh in meters. Null if the native loader
+	// cannot be used.
+	public static Mesh ReadFaces(string path)
+	{
+		IntPtr model = Open(path);
+		if(model == IntPtr.Zero) return null;
+		try
+		{
+			int vertexCount = XmlLoaderGetVertexCount(model);
+			float[] positions = new float[vertexCount*3];
+			float[] normals = new float[vertexCount*3];
+			vertexCount = XmlLoaderGetVertices(model,positions,normals,vertexCount);
+			int indexCount = XmlLoaderGetIndexCount(model);
+			int[] indices = new int[indexCount];
+			indexCount = XmlLoaderGetIndices(model,indices,indexCount);
+
+			Vector3[] vertices = new Vector3[vertexCount];
+			Vector3[] vertexNormals = new Vector3[vertexCount];
+			for(int i=0;i<vertexCount;i++)
+			{
+				vertices[i] = new Vector3(positions[i*3],positions[i*3+1],positions[i*3+2]) * metersPerInch;
+				vertexNormals[i] = new Vector3(normals[i*3],normals[i*3+1],normals[i*3+2]);
+			}
+			Mesh mesh = new Mesh();
+			mesh.vertices = vertices;
+			mesh.normals = vertexNormals;
+			mesh.triangles = indices;
+			mesh.RecalculateBounds();
+			return mesh;
+		}
+		finally
+		{
+			XmlLoaderClose(model);
+		}
+	}
+
+	// World transformations of the top level groups and component instances,
+	// in inches as in the file. Null if the native loader cannot be used.
+	public static Matrix4x4[] ReadGroupTransforms(string path)
+	{
+		IntPtr model = Open(path);
+		if(model == IntPtr.Zero) return null;
+		try
+		{
+			int count = XmlLoaderGetGroupCount(model);
+			float[] values = new float[count*16];
+			count = XmlLoaderGetGroupTransforms(model,values,count);
+			Matrix4x4[] matrices = new Matrix4x4[count];
+			for(int i=0;i<count;i++)
+			{
+				// Both column-major
+				for(int k=0;k<16;k++) matrices[i][k] = values[i*16+k];
+			}
+			return matrices;
+		}
+		finally
+		{
+			XmlLoaderClose(model);
+		}
+	}
+}